@@ -0,0 +1,184 @@
+// BlockStream.hpp
+//
+// Block loops whose reads, arithmetic and writes overlap
+//----------------------------------------
+#ifndef BLOCKSTREAM_HPP_
+#define BLOCKSTREAM_HPP_
+
+#include <vector>
+#include <thread>
+#include <functional>
+#include <exception>
+
+#include "Raster.hpp"
+#include "ThreadPool.hpp"
+
+namespace GeoStar {
+
+  /** \brief BlockStream -- runs a block-by-block operator with its I/O and arithmetic overlapped
+
+  The pixel-wise operators read a block, work on it, and write it, so the disk waits for the
+  arithmetic and the cores wait for the disk.  BlockStream keeps a few blocks in flight: while
+  one block is worked on, the calling thread writes the block before it and reads the blocks
+  after it.  Each block has a set of slots, all the size of a block; the first slots are read
+  from the input rasters, the step fills in the others, and one of them is written out.
+
+  \see Raster::BlockIterator, ThreadPool, BoundedQueue
+
+  \Par Example
+	out = 2*in + 1, with in and out the same size:
+	\code
+	GeoStar::BlockStream<float> stream(out, std::vector<const GeoStar::Raster *>(1, in), 2, out, 1);
+	stream.run([](GeoStar::BlockStream<float>::Block &b) {
+	  GeoStar::parallel_for(b.n, [&](long int begin, long int end) {
+	    for(long int i=begin; i<end; ++i) b.slots[1][i] = 2*b.slots[0][i] + 1;
+	  });
+	});
+	\endcode
+
+  \Par Details
+	Blocks follow the BlockIterator of the layout raster and are written in order.  All HDF5
+	access, reads and writes, stays on the calling thread; the step runs on one helper thread, and
+	spreads its work over the File::set_num_threads pool with parallel_for as usual.  Blocks do
+	not overlap, so the output may be one of the inputs.  An exception thrown by the step, or by a
+	read or write, is rethrown on the calling thread once the blocks in flight have drained.  With
+	one thread the loop runs as a plain read/step/write loop.
+  */
+  template<typename T>
+  class BlockStream {
+
+  public:
+    struct Block {
+      std::vector<std::vector<T> > slots;
+      long int n;                   // pixels in this block
+      long int slice[4];            // x0, y0, dx, dy
+      std::exception_ptr error;
+    };
+
+    typedef std::function<void(Block &)> Step;
+
+    // slots 0 .. inputs.size()-1 of every block are read from inputs; slot outSlot is written
+    // to output, or nothing is written if output is NULL.  depth is the number of blocks in flight.
+    BlockStream(const Raster *layout, const std::vector<const Raster *> &inputs, const int &nSlots,
+                Raster *output, const int &outSlot, const int &depth = 3)
+      : reader(layout), writer(layout), inputs(inputs), blocks(depth < 1 ? 1 : depth) {
+      if(output != NULL) {
+        outputs.push_back(output);
+        outSlots.push_back(outSlot);
+      }
+      allocate(nSlots);
+    }
+
+    // slot outSlots[k] is written to outputs[k], for each k
+    BlockStream(const Raster *layout, const std::vector<const Raster *> &inputs, const int &nSlots,
+                const std::vector<Raster *> &outputs, const std::vector<int> &outSlots,
+                const int &depth = 3)
+      : reader(layout), writer(layout), inputs(inputs), outputs(outputs), outSlots(outSlots),
+        blocks(depth < 1 ? 1 : depth) {
+      allocate(nSlots);
+    }
+
+    void run(const Step &step) {
+      if(ThreadPool::instance().get_num_threads() <= 1 || blocks.size() < 2) {
+        Block &b = blocks[0];
+        while(readNext(b)) {
+          step(b);
+          writeNext(b);
+        }
+        return;
+      }
+
+      BoundedQueue<Block *> todo(blocks.size()), done(blocks.size());
+      std::thread worker([&]() {
+          Block *b;
+          while(todo.pop(b)) {
+            try {
+              step(*b);
+            } catch(...) {
+              b->error = std::current_exception();
+            }// end: try
+            done.push(b);
+          }// endwhile
+        });
+
+      // the worker is stopped however the loop ends
+      struct Stop {
+        BoundedQueue<Block *> &todo;
+        std::thread &worker;
+        ~Stop() {
+          todo.close();
+          worker.join();
+        }
+      } stop = {todo, worker};
+
+      std::vector<Block *> idle;
+      for(size_t i=0; i<blocks.size(); ++i) idle.push_back(&blocks[i]);
+      size_t inFlight = 0;
+      bool more = true;
+      std::exception_ptr error;
+
+      while(inFlight > 0 || (more && !error)) {
+        if(more && !error && !idle.empty()) {
+          Block *b = idle.back();
+          try {
+            more = readNext(*b);
+          } catch(...) {
+            error = std::current_exception();
+            more = false;
+          }// end: try
+          if(more) {
+            idle.pop_back();
+            todo.push(b);
+            ++inFlight;
+          }
+          continue;
+        }// endif
+
+        Block *b;
+        done.pop(b);
+        --inFlight;
+        idle.push_back(b);
+        if(b->error && !error) error = b->error;
+        b->error = std::exception_ptr();
+        if(error) continue;
+        try {
+          writeNext(*b);
+        } catch(...) {
+          error = std::current_exception();
+        }// end: try
+      }// endwhile
+
+      if(error) std::rethrow_exception(error);
+    }// end: run
+
+  private:
+    Raster::BlockIterator reader, writer;
+    std::vector<const Raster *> inputs;
+    std::vector<Raster *> outputs;
+    std::vector<int> outSlots;
+    std::vector<Block> blocks;
+
+    void allocate(const int &nSlots) {
+      for(size_t i=0; i<blocks.size(); ++i) {
+        blocks[i].slots.assign(nSlots, std::vector<T>(reader.maxSize()));
+      }
+    }
+
+    bool readNext(Block &b) {
+      if(!reader.next()) return false;
+      b.n = reader.size();
+      for(int i=0; i<4; ++i) b.slice[i] = reader.slice()[i];
+      for(size_t i=0; i<inputs.size(); ++i) reader.read(inputs[i], b.slots[i]);
+      return true;
+    }
+
+    void writeNext(Block &b) {
+      writer.next();
+      for(size_t i=0; i<outputs.size(); ++i) writer.write(outputs[i], b.slots[outSlots[i]]);
+    }
+
+  }; // end class: BlockStream
+
+}// end namespace GeoStar
+
+#endif //BLOCKSTREAM_HPP_
@@ -0,0 +1,360 @@
+// DrawBatch.cpp
+//
+// Implementation of the batched shape rasterizer
+// Documentation in DrawBatch.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "DrawBatch.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    // pixels x0 .. x1-1 of row y, from shape seq; tile is filled in when the span is split
+    struct Span {
+      long int tile, seq, y, x0, x1;
+      double color;
+    };
+
+    // collects the clipped spans of one shape
+    struct SpanSink {
+      std::vector<Span> &spans;
+      long int nx, ny, seq;
+      double color;
+
+      SpanSink(std::vector<Span> &spans, const long int &nx, const long int &ny)
+        : spans(spans), nx(nx), ny(ny), seq(0), color(0) {}
+
+      void add(const long int &y, long int x0, long int x1) {
+        if(y < 0 || y >= ny) return;
+        x0 = std::max(x0, 0L);
+        x1 = std::min(x1, nx);
+        if(x0 >= x1) return;
+        // runs of a Bresenham line arrive a pixel at a time
+        if(!spans.empty()) {
+          Span &last = spans.back();
+          if(last.seq == seq && last.y == y && last.x1 == x0) {
+            last.x1 = x1;
+            return;
+          }
+        }
+        Span s = {0, seq, y, x0, x1, color};
+        spans.push_back(s);
+      }
+    };
+
+    const double EPS = 1e-9;
+
+    // the x range where row y crosses a circle; false if it misses
+    bool circleRow(const double &cx, const double &cy, const double &r, const double &y,
+                   double &lo, double &hi) {
+      const double d = y - cy;
+      const double h2 = r*r - d*d;
+      if(h2 < -EPS) return false;
+      const double h = std::sqrt(std::max(h2, 0.0));
+      lo = cx - h;
+      hi = cx + h;
+      return true;
+    }// end: circleRow
+
+    // the x range where row y crosses a convex polygon; false if it misses
+    bool convexRow(const double *px, const double *py, const int &n, const double &y,
+                   double &lo, double &hi) {
+      bool hit = false;
+      for(int i=0; i<n; ++i) {
+        const int j = (i+1) % n;
+        const double ya = py[i], yb = py[j];
+        if(y < std::min(ya, yb) - EPS || y > std::max(ya, yb) + EPS) continue;
+        double xa, xb;
+        if(std::fabs(yb - ya) < EPS) {
+          xa = std::min(px[i], px[j]);
+          xb = std::max(px[i], px[j]);
+        } else {
+          xa = xb = px[i] + (y - ya) * (px[j] - px[i]) / (yb - ya);
+        }
+        lo = hit ? std::min(lo, xa) : xa;
+        hi = hit ? std::max(hi, xb) : xb;
+        hit = true;
+      }// endfor: i
+      return hit;
+    }// end: convexRow
+
+
+    void rasterCircle(SpanSink &out, const double *p) {
+      const double cx = p[0], cy = p[1], r = p[2];
+      const long int y0 = std::max(0L, (long int)std::ceil(cy - r - EPS));
+      const long int y1 = std::min(out.ny - 1, (long int)std::floor(cy + r + EPS));
+      double lo, hi;
+      for(long int y=y0; y<=y1; ++y) {
+        if(circleRow(cx, cy, r, y, lo, hi)) {
+          out.add(y, (long int)std::ceil(lo - EPS), (long int)std::floor(hi + EPS) + 1);
+        }
+      }// endfor: y
+    }// end: rasterCircle
+
+
+    void rasterLine(SpanSink &out, const double *p) {
+      const double x0 = p[0], y0 = p[1], x1 = p[2], y1 = p[3], r = p[4];
+
+      if(r == 0) {
+        // Bresenham between the rounded end points
+        long int x = (long int)std::floor(x0 + 0.5), y = (long int)std::floor(y0 + 0.5);
+        const long int xe = (long int)std::floor(x1 + 0.5), ye = (long int)std::floor(y1 + 0.5);
+        const long int dx = std::labs(xe - x), dy = -std::labs(ye - y);
+        const long int sx = (x < xe) ? 1 : -1, sy = (y < ye) ? 1 : -1;
+        long int err = dx + dy;
+        for(;;) {
+          out.add(y, x, x+1);
+          if(x == xe && y == ye) break;
+          const long int e2 = 2*err;
+          if(e2 >= dy) { err += dy; x += sx; }
+          if(e2 <= dx) { err += dx; y += sy; }
+        }// endfor
+        return;
+      }// endif
+
+      // the capsule: the two end circles and the band of width 2r between them
+      const double len = std::sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0));
+      const double nx = (len > 0) ? -(y1-y0) / len * r : 0, ny = (len > 0) ? (x1-x0) / len * r : 0;
+      const double qx[4] = {x0 + nx, x1 + nx, x1 - nx, x0 - nx};
+      const double qy[4] = {y0 + ny, y1 + ny, y1 - ny, y0 - ny};
+
+      const long int ya = std::max(0L, (long int)std::ceil(std::min(y0, y1) - r - EPS));
+      const long int yb = std::min(out.ny - 1, (long int)std::floor(std::max(y0, y1) + r + EPS));
+      for(long int y=ya; y<=yb; ++y) {
+        // the capsule is convex, so its row is the hull of the three pieces' rows
+        double lo = 0, hi = -1, a, b;
+        bool hit = false;
+        if(circleRow(x0, y0, r, y, a, b)) { lo = a; hi = b; hit = true; }
+        if(circleRow(x1, y1, r, y, a, b)) {
+          lo = hit ? std::min(lo, a) : a; hi = hit ? std::max(hi, b) : b; hit = true;
+        }
+        if(len > 0 && convexRow(qx, qy, 4, y, a, b)) {
+          lo = hit ? std::min(lo, a) : a; hi = hit ? std::max(hi, b) : b; hit = true;
+        }
+        if(hit) out.add(y, (long int)std::ceil(lo - EPS), (long int)std::floor(hi + EPS) + 1);
+      }// endfor: y
+    }// end: rasterLine
+
+
+    void rasterBox(SpanSink &out, const double *p) {
+      const long int x0 = (long int)p[0], y0 = (long int)p[1], x1 = (long int)p[2], y1 = (long int)p[3];
+      for(long int y=std::max(0L, y0); y<std::min(out.ny, y1); ++y) out.add(y, x0, x1);
+    }// end: rasterBox
+
+
+    // scanline fill with an active edge list: the crossings of row y are the edges with
+    // ymin <= y < ymax
+    void rasterPolygon(SpanSink &out, const std::vector<double> &p) {
+      struct Edge {
+        double ymin, ymax, x0, slope;   // x at row y is x0 + (y - ymin) * slope
+        bool operator<(const Edge &e) const { return ymin < e.ymin; }
+      };
+
+      const size_t n = p.size() / 2;
+      std::vector<Edge> edges;
+      for(size_t i=0; i<n; ++i) {
+        const size_t j = (i+1) % n;
+        double xa = p[2*i], ya = p[2*i+1], xb = p[2*j], yb = p[2*j+1];
+        if(ya == yb) continue;
+        if(ya > yb) { std::swap(xa, xb); std::swap(ya, yb); }
+        Edge e = {ya, yb, xa, (xb - xa) / (yb - ya)};
+        edges.push_back(e);
+      }// endfor: i
+      if(edges.empty()) return;
+      std::sort(edges.begin(), edges.end());
+
+      double top = edges[0].ymax;
+      for(size_t i=0; i<edges.size(); ++i) top = std::max(top, edges[i].ymax);
+      const long int y0 = std::max(0L, (long int)std::ceil(edges[0].ymin));
+      const long int y1 = std::min(out.ny, (long int)std::ceil(top));
+
+      std::vector<const Edge *> active;
+      std::vector<double> xs;
+      size_t next = 0;
+      for(long int y=y0; y<y1; ++y) {
+        while(next < edges.size() && edges[next].ymin <= y) active.push_back(&edges[next++]);
+        xs.clear();
+        size_t keep = 0;
+        for(size_t k=0; k<active.size(); ++k) {
+          const Edge *e = active[k];
+          if(e->ymax <= y) continue;
+          active[keep++] = e;
+          xs.push_back(e->x0 + (y - e->ymin) * e->slope);
+        }// endfor: k
+        active.resize(keep);
+        std::sort(xs.begin(), xs.end());
+        for(size_t k=0; k+1<xs.size(); k+=2) {
+          out.add(y, (long int)std::ceil(xs[k]), (long int)std::ceil(xs[k+1]));
+        }
+      }// endfor: y
+    }// end: rasterPolygon
+
+  }// end anonymous namespace
+
+
+
+  DrawBatch::DrawBatch() {}
+
+
+
+  void DrawBatch::circle(const double &x0, const double &y0, const double &radius, const double &color) {
+    RadiusSizeException RadiusSizeError;
+    if(radius < 0) throw RadiusSizeError;
+    Shape s;
+    s.kind = CIRCLE;
+    s.color = color;
+    s.p.push_back(x0);
+    s.p.push_back(y0);
+    s.p.push_back(radius);
+    shapes.push_back(s);
+  }// end: circle
+
+
+
+  void DrawBatch::line(const double &x0, const double &y0, const double &x1, const double &y1,
+                       const double &radius, const double &color) {
+    RadiusSizeException RadiusSizeError;
+    if(radius < 0) throw RadiusSizeError;
+    Shape s;
+    s.kind = LINE;
+    s.color = color;
+    const double p[5] = {x0, y0, x1, y1, radius};
+    s.p.assign(p, p+5);
+    shapes.push_back(s);
+  }// end: line
+
+
+
+  void DrawBatch::box(const long int &x0, const long int &y0, const long int &x1, const long int &y1,
+                      const double &color) {
+    if(x0 >= x1 || y0 >= y1) return;
+    Shape s;
+    s.kind = BOX;
+    s.color = color;
+    const double p[4] = {(double)x0, (double)y0, (double)x1, (double)y1};
+    s.p.assign(p, p+4);
+    shapes.push_back(s);
+  }// end: box
+
+
+
+  void DrawBatch::rectangle(const long int &x0, const long int &y0, const long int &dx, const long int &dy,
+                            const long int &radius, const double &color) {
+    RadiusSizeException RadiusSizeError;
+    if(radius < 0) throw RadiusSizeError;
+    const long int x1 = x0 + dx, y1 = y0 + dy;
+    box(x0, y0, x1, std::min(y1, y0 + radius), color);                     // top
+    box(x0, std::max(y0, y1 - radius), x1, y1, color);                     // bottom
+    box(x0, y0, std::min(x1, x0 + radius), y1, color);                     // left
+    box(std::max(x0, x1 - radius), y0, x1, y1, color);                     // right
+  }// end: rectangle
+
+
+
+  void DrawBatch::filledRectangle(const long int &x0, const long int &y0, const long int &dx,
+                                  const long int &dy, const long int &radius,
+                                  const double &lineColor, const double &fillColor) {
+    RadiusSizeException RadiusSizeError;
+    if(radius < 0) throw RadiusSizeError;
+    box(x0, y0, x0 + dx, y0 + dy, fillColor);
+    rectangle(x0, y0, dx, dy, radius, lineColor);
+  }// end: filledRectangle
+
+
+
+  void DrawBatch::polygon(const std::vector<double> &x, const std::vector<double> &y, const double &color) {
+    SliceSizeException SliceSizeError;
+    if(x.size() != y.size()) throw SliceSizeError;
+    if(x.size() < 3) return;
+    Shape s;
+    s.kind = POLYGON;
+    s.color = color;
+    s.p.resize(2*x.size());
+    for(size_t i=0; i<x.size(); ++i) {
+      s.p[2*i] = x[i];
+      s.p[2*i+1] = y[i];
+    }
+    shapes.push_back(s);
+  }// end: polygon
+
+
+
+  void DrawBatch::apply(Raster *ras) const {
+    GEOSTAR_PROFILE_SCOPE("DrawBatch::apply");
+    const long int nx = ras->get_nx(), ny = ras->get_ny();
+    if(shapes.empty() || nx == 0 || ny == 0) return;
+
+    const long int tx = (ras->get_chunk_nx() > 0) ? ras->get_chunk_nx() : 256;
+    const long int ty = (ras->get_chunk_ny() > 0) ? ras->get_chunk_ny() : 256;
+    const long int tilesX = (nx + tx - 1) / tx;
+
+    // 1. every shape to spans, clipped to the raster
+    std::vector<Span> spans;
+    SpanSink sink(spans, nx, ny);
+    for(size_t i=0; i<shapes.size(); ++i) {
+      const Shape &s = shapes[i];
+      sink.seq = i;
+      sink.color = s.color;
+      switch(s.kind) {
+      case CIRCLE:  rasterCircle(sink, &s.p[0]); break;
+      case LINE:    rasterLine(sink, &s.p[0]); break;
+      case BOX:     rasterBox(sink, &s.p[0]); break;
+      default:      rasterPolygon(sink, s.p); break;
+      }// end case
+    }// endfor: i
+
+    // 2. split at the tile columns, and sort by tile keeping the drawing order
+    std::vector<Span> tiled;
+    tiled.reserve(spans.size());
+    for(size_t i=0; i<spans.size(); ++i) {
+      Span s = spans[i];
+      const long int row = (s.y / ty) * tilesX;
+      while(s.x0 < s.x1) {
+        Span part = s;
+        part.x1 = std::min(s.x1, (s.x0 / tx + 1) * tx);
+        part.tile = row + s.x0 / tx;
+        tiled.push_back(part);
+        s.x0 = part.x1;
+      }// endwhile
+    }// endfor: i
+    spans.clear();
+    std::stable_sort(tiled.begin(), tiled.end(),
+                     [](const Span &a, const Span &b) { return a.tile < b.tile; });
+
+    // 3. one read-modify-write of the covered box of each tile
+    std::vector<double> data;
+    for(size_t first=0; first<tiled.size(); ) {
+      size_t last = first;
+      long int bx0 = tiled[first].x0, bx1 = tiled[first].x1, by0 = tiled[first].y, by1 = tiled[first].y + 1;
+      while(last < tiled.size() && tiled[last].tile == tiled[first].tile) {
+        bx0 = std::min(bx0, tiled[last].x0);
+        bx1 = std::max(bx1, tiled[last].x1);
+        by0 = std::min(by0, tiled[last].y);
+        by1 = std::max(by1, tiled[last].y + 1);
+        ++last;
+      }// endwhile
+      const long int w = bx1 - bx0;
+      const Slice slice(bx0, by0, w, by1 - by0);
+      data.resize(slice.size());
+      ras->read(slice, &data[0]);
+      for(size_t k=first; k<last; ++k) {
+        const Span &s = tiled[k];
+        std::fill(data.begin() + (s.y - by0)*w + (s.x0 - bx0), data.begin() + (s.y - by0)*w + (s.x1 - bx0),
+                  s.color);
+      }// endfor: k
+      ras->write(slice, &data[0]);
+      first = last;
+    }// endfor: first
+  }// end: apply
+
+}// end namespace GeoStar
@@ -373,6 +373,38 @@ namespace GeoStar {
           }
     };
 
+    class RasterExprException: public exception
+    {
+      virtual const char* what() const throw()
+          {
+              return "RasterExprError: expression has no rasters";
+          }
+    };
+
+    class FFTPlanException: public exception
+    {
+      virtual const char* what() const throw()
+          {
+              return "FFTPlanError: FFTW could not make a plan";
+          }
+    };
+
+    class FFTMemoryException: public exception
+    {
+      virtual const char* what() const throw()
+          {
+              return "FFTMemoryError: FFTW could not allocate the transform buffer";
+          }
+    };
+
+    class KernelSizeException: public exception
+    {
+      virtual const char* what() const throw()
+          {
+              return "KernelSizeError";
+          }
+    };
+
 	class RadiusSizeException: public exception
     {
       virtual const char* what() const throw()
@@ -381,6 +413,22 @@ namespace GeoStar {
           }
     };
 
+    class HistogramBinException: public exception
+    {
+      virtual const char* what() const throw()
+          {
+              return "HistogramBinError";
+          }
+    };
+
+    class PipelineException: public exception
+    {
+      virtual const char* what() const throw()
+          {
+              return "PipelineError: node is not in this pipeline";
+          }
+    };
+
 
 
 
@@ -0,0 +1,584 @@
+// FFT.cpp
+//
+// Implementation of the 2-D FFT engine
+// Documentation in FFT.hpp
+//--------------------------------------------
+
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <memory>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "FFT.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+#include <fftw3.h>
+
+namespace GeoStar {
+
+  namespace {
+
+    // one entry of the plan cache
+    enum PlanKind { C2C, R2C, C2R };
+
+    struct PlanKey {
+      int kind, rank, n0, n1, howmany, stride, dist, sign, threads;
+      unsigned flags;
+
+      bool operator<(const PlanKey &k) const {
+        const int a[9] = {kind, rank, n0, n1, howmany, stride, dist, sign, threads};
+        const int b[9] = {k.kind, k.rank, k.n0, k.n1, k.howmany, k.stride, k.dist, k.sign, k.threads};
+        for(int i=0; i<9; ++i) {
+          if(a[i] != b[i]) return a[i] < b[i];
+        }
+        return flags < k.flags;
+      }
+    };
+
+    struct Settings {
+      std::mutex mutex;               // the FFTW planner is not thread-safe
+      bool threadsReady;
+      bool wisdomLoaded;
+      std::string wisdomFile;
+      size_t memoryLimit;
+      unsigned flags;
+      std::map<PlanKey, fftw_plan> plans;
+
+      Settings() : threadsReady(false), wisdomLoaded(false), memoryLimit(size_t(1) << 30),
+                   flags(FFTW_MEASURE) {}
+
+      ~Settings() {
+        for(std::map<PlanKey, fftw_plan>::iterator it=plans.begin(); it!=plans.end(); ++it) {
+          fftw_destroy_plan(it->second);
+        }
+      }
+    };
+
+    Settings &settings() {
+      static Settings s;
+      return s;
+    }// end: settings
+
+
+
+    // where a pass reads or writes pixels: a raster, through Raster::readSelection and
+    // writeSelection so a loaded raster is served from memory, or an anonymous staging dataset.
+    // An empty Store stands for a missing part.
+    struct Store {
+      const Raster *ras;
+      H5::DataSet *dataset;
+
+      Store() : ras(NULL), dataset(NULL) {}
+      Store(H5::DataSet *d) : ras(NULL), dataset(d) {}
+
+      void read(void *data, const H5::DataType &type, const H5::DataSpace &memspace,
+                const H5::DataSpace &space) const {
+        if(ras) ras->readSelection(data, type, memspace, space);
+        else dataset->read(data, type, memspace, space);
+      }
+
+      void write(const void *data, const H5::DataType &type, const H5::DataSpace &memspace,
+                 const H5::DataSpace &space) const {
+        if(ras) ras->writeSelection(data, type, memspace, space);
+        else dataset->write(data, type, memspace, space);
+      }
+    };
+
+    // selects [x0,y0,dx,dy] in the file space of a raster dataset
+    H5::DataSpace fileSpace(const Store &store, const long int *slice) {
+      H5::DataSpace space = store.dataset->getSpace();
+      hsize_t offset[2] = {(hsize_t)slice[1], (hsize_t)slice[0]};
+      hsize_t count[2]  = {(hsize_t)slice[3], (hsize_t)slice[2]};
+      space.selectHyperslab(H5S_SELECT_SET, count, offset);
+      return space;
+    }// end: fileSpace
+
+    // a dy x dx memory space over an interleaved complex buffer, selecting the real (part 0)
+    // or imaginary (part 1) values
+    H5::DataSpace complexSpace(const long int *slice, const int &part) {
+      hsize_t dims[2]   = {(hsize_t)slice[3], 2*(hsize_t)slice[2]};
+      hsize_t offset[2] = {0, (hsize_t)part};
+      hsize_t stride[2] = {1, 2};
+      hsize_t count[2]  = {(hsize_t)slice[3], (hsize_t)slice[2]};
+      H5::DataSpace space(2, dims);
+      space.selectHyperslab(H5S_SELECT_SET, count, offset, stride);
+      return space;
+    }// end: complexSpace
+
+    inline bool isComplex(const Store &store) {
+      return store.dataset && store.dataset->getTypeClass() == H5T_COMPOUND;
+    }
+
+    void readPart(const Store &store, const long int *slice, const int &part, fftw_complex *data) {
+      long int n = slice[2]*slice[3];
+      if(!store.dataset) {
+        for(long int i=0; i<n; ++i) data[i][part] = 0.0;
+        return;
+      }
+      H5::DataSpace memspace = complexSpace(slice, part);
+      H5::DataSpace space = fileSpace(store, slice);
+      store.read((void *)data, H5::PredType::NATIVE_DOUBLE, memspace, space);
+    }// end: readPart
+
+    void writePart(const Store &store, const long int *slice, const int &part, const fftw_complex *data) {
+      if(!store.dataset) return;
+      H5::DataSpace memspace = complexSpace(slice, part);
+      H5::DataSpace space = fileSpace(store, slice);
+      store.write((const void *)data, H5::PredType::NATIVE_DOUBLE, memspace, space);
+    }// end: writePart
+
+    // a complex raster holds both parts, and im is not used.  The memory compound of two doubles
+    // has the layout of fftw_complex, so the pixels go straight into the buffer.
+    void readPair(const Store &re, const Store &im, const long int *slice, fftw_complex *data) {
+      if(isComplex(re)) {
+        hsize_t dims[2] = {(hsize_t)slice[3], (hsize_t)slice[2]};
+        H5::DataSpace memspace(2, dims);
+        H5::DataSpace space = fileSpace(re, slice);
+        re.read((void *)data, Raster::getHdf5Type<std::complex<double> >(), memspace, space);
+        return;
+      }
+      readPart(re, slice, 0, data);
+      readPart(im, slice, 1, data);
+    }// end: readPair
+
+    void writePair(const Store &re, const Store &im, const long int *slice, const fftw_complex *data) {
+      if(isComplex(re)) {
+        hsize_t dims[2] = {(hsize_t)slice[3], (hsize_t)slice[2]};
+        H5::DataSpace memspace(2, dims);
+        H5::DataSpace space = fileSpace(re, slice);
+        re.write((const void *)data, Raster::getHdf5Type<std::complex<double> >(), memspace, space);
+        return;
+      }
+      writePart(re, slice, 0, data);
+      writePart(im, slice, 1, data);
+    }// end: writePair
+
+    // real rows stored pitch doubles apart, as FFTW's in-place r2c and c2r transforms want them
+    H5::DataSpace paddedSpace(const long int *slice, const long int &pitch) {
+      hsize_t dims[2]   = {(hsize_t)slice[3], (hsize_t)pitch};
+      hsize_t offset[2] = {0, 0};
+      hsize_t count[2]  = {(hsize_t)slice[3], (hsize_t)slice[2]};
+      H5::DataSpace space(2, dims);
+      space.selectHyperslab(H5S_SELECT_SET, count, offset);
+      return space;
+    }// end: paddedSpace
+
+    void readPadded(const Store &store, const long int *slice, const long int &pitch, double *data) {
+      H5::DataSpace memspace = paddedSpace(slice, pitch);
+      H5::DataSpace space = fileSpace(store, slice);
+      store.read((void *)data, H5::PredType::NATIVE_DOUBLE, memspace, space);
+    }// end: readPadded
+
+    void writePadded(const Store &store, const long int *slice, const long int &pitch, double *data,
+                     const double &scale) {
+      if(scale != 1.0) {
+        parallel_for(slice[3], [&](long int begin, long int end) {
+          for(long int y=begin; y<end; ++y) {
+            double *row = data + y*pitch;
+            for(long int x=0; x<slice[2]; ++x) row[x] *= scale;
+          }// endfor: y
+        }, 16);
+      }
+      H5::DataSpace memspace = paddedSpace(slice, pitch);
+      H5::DataSpace space = fileSpace(store, slice);
+      store.write((const void *)data, H5::PredType::NATIVE_DOUBLE, memspace, space);
+    }// end: writePadded
+
+    void scaleComplex(fftw_complex *data, const long int &n, const double &scale) {
+      if(scale == 1.0) return;
+      parallel_for(n, [&](long int begin, long int end) {
+        for(long int i=begin; i<end; ++i) {
+          data[i][0] *= scale;
+          data[i][1] *= scale;
+        }// endfor: i
+      });
+    }// end: scaleComplex
+
+    // a dataset in the same file as like that is never linked into a group: it is deleted
+    // when the returned object is closed.
+    H5::DataSet anonymousDataset(const H5::DataSet *like, const H5::DataType &type,
+                                 const long int &nx, const long int &ny) {
+      RasterCreationErrorException RasterCreationError;
+      hsize_t dims[2] = {(hsize_t)ny, (hsize_t)nx};
+      H5::DataSpace space(2, dims);
+      hid_t file = H5Iget_file_id(like->getId());
+      hid_t id = H5Dcreate_anon(file, type.getId(), space.getId(), H5P_DEFAULT, H5P_DEFAULT);
+      H5Fclose(file);
+      if(id < 0) throw RasterCreationError;
+      H5::DataSet dataset(id);
+      H5Dclose(id);
+      return dataset;
+    }// end: anonymousDataset
+
+    // a transform's buffer of n complex values from fftw_malloc, freed however the transform
+    // ends; FFTMemoryException if there is no room for it
+    struct FFTWFree {
+      void operator()(fftw_complex *p) const { fftw_free(p); }
+    };
+    typedef std::unique_ptr<fftw_complex[], FFTWFree> ComplexBuffer;
+
+    ComplexBuffer complexBuffer(const size_t &n) {
+      FFTMemoryException FFTMemoryError;
+      fftw_complex *p = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * n);
+      if(!p) throw FFTMemoryError;
+      return ComplexBuffer(p);
+    }// end: complexBuffer
+
+    // the plan cache behind FFT::plan and the real transforms.  C2C plans are in place with
+    // the given stride and dist.  R2C and C2R plans are in place over rows of n[rank-1] reals
+    // padded to 2*(n[rank-1]/2+1) doubles, consecutive rows dist complex values apart for rank 1.
+    fftw_plan cachedPlan(const PlanKind &kind, const int &rank, const int *n, const int &howmany,
+                         const int &stride, const int &dist, const int &sign) {
+      GEOSTAR_PROFILE_SCOPE("FFT::plan");
+      FFTPlanException FFTPlanError;
+      Settings &s = settings();
+      std::lock_guard<std::mutex> lock(s.mutex);
+
+      if(!s.threadsReady) {
+        fftw_init_threads();
+        s.threadsReady = true;
+      }
+      if(!s.wisdomLoaded) {
+        if(!s.wisdomFile.empty()) fftw_import_wisdom_from_filename(s.wisdomFile.c_str());
+        s.wisdomLoaded = true;
+      }
+
+      PlanKey key;
+      key.kind = kind;
+      key.rank = rank;
+      key.n0 = n[0];
+      key.n1 = (rank > 1) ? n[1] : 1;
+      key.howmany = howmany;
+      key.stride = stride;
+      key.dist = dist;
+      key.sign = sign;
+      key.threads = ThreadPool::instance().get_num_threads();
+      key.flags = s.flags;
+
+      std::map<PlanKey, fftw_plan>::iterator it = s.plans.find(key);
+      if(it != s.plans.end()) {
+        GEOSTAR_PROFILE_HIT("FFT::plan");
+        return it->second;
+      }
+      GEOSTAR_PROFILE_MISS("FFT::plan");
+
+      // FFTW_MEASURE overwrites its array, so plan on a buffer of the same shape
+      const int last = n[rank-1];
+      const int half = last/2 + 1;
+      long int extent;
+      if(kind == C2C) {
+        long int total = (long int)key.n0 * key.n1;
+        extent = (long int)(howmany-1)*dist + (total-1)*stride + 1;
+      } else {
+        long int rows = (rank > 1) ? n[0] : 1;
+        extent = (long int)(howmany-1)*dist + rows*half;
+      }
+      ComplexBuffer buffer = complexBuffer(extent);
+      fftw_complex *scratch = buffer.get();
+
+      fftw_plan_with_nthreads(key.threads);
+      fftw_plan p;
+      if(kind == C2C) {
+        p = fftw_plan_many_dft(rank, n, howmany, scratch, NULL, stride, dist,
+                               scratch, NULL, stride, dist, sign, s.flags);
+      } else {
+        int realEmbed[2] = {n[0], 2*half};
+        int complexEmbed[2] = {n[0], half};
+        if(rank == 1) {
+          realEmbed[0] = 2*half;
+          complexEmbed[0] = half;
+        }
+        if(kind == R2C) {
+          p = fftw_plan_many_dft_r2c(rank, n, howmany, (double *)scratch, realEmbed, 1, 2*dist,
+                                     scratch, complexEmbed, 1, dist, s.flags);
+        } else {
+          p = fftw_plan_many_dft_c2r(rank, n, howmany, scratch, complexEmbed, 1, dist,
+                                     (double *)scratch, realEmbed, 1, 2*dist, s.flags);
+        }
+      }
+      if(!p) throw FFTPlanError;
+
+      s.plans[key] = p;
+      if(!s.wisdomFile.empty()) fftw_export_wisdom_to_filename(s.wisdomFile.c_str());
+      return p;
+    }// end: cachedPlan
+
+    inline Store storeOf(const Raster *ras) {
+      Store store;
+      store.ras = ras;
+      store.dataset = ras ? ras->rasterobj : NULL;
+      return store;
+    }
+
+  }// end anonymous namespace
+
+
+
+  void FFT::set_wisdom_file(const std::string &path) {
+    Settings &s = settings();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.wisdomFile = path;
+    s.wisdomLoaded = false;
+  }// end: set_wisdom_file
+
+  std::string FFT::get_wisdom_file() {
+    Settings &s = settings();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.wisdomFile;
+  }// end: get_wisdom_file
+
+  void FFT::set_memory_limit(const size_t &bytes) {
+    Settings &s = settings();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.memoryLimit = bytes;
+  }// end: set_memory_limit
+
+  size_t FFT::get_memory_limit() {
+    Settings &s = settings();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.memoryLimit;
+  }// end: get_memory_limit
+
+  void FFT::set_planner_flags(const unsigned &flags) {
+    Settings &s = settings();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.flags = flags;
+  }// end: set_planner_flags
+
+
+
+  fftw_plan FFT::plan(const int &rank, const int *n, const int &howmany, const int &stride,
+                      const int &dist, const int &sign) {
+    return cachedPlan(C2C, rank, n, howmany, stride, dist, sign);
+  }// end: plan
+
+
+
+  void FFT::readComplex(const Raster *re, const Raster *im, const long int *slice, fftw_complex *data) {
+    readPair(storeOf(re), storeOf(im), slice, data);
+  }// end: readComplex
+
+  void FFT::writeComplex(fftw_complex *data, const long int *slice, const double &scale,
+                         Raster *re, Raster *im) {
+    scaleComplex(data, slice[2]*slice[3], scale);
+    writePair(storeOf(re), storeOf(im), slice, data);
+  }// end: writeComplex
+
+
+
+  void FFT::transform(fftw_complex *data, const long int &nx, const long int &ny, const int &sign) {
+    const int n[2] = {(int)ny, (int)nx};
+    fftw_plan p = plan(2, n, 1, 1, (int)(nx*ny), sign);
+    fftw_execute_dft(p, data, data);
+  }// end: transform
+
+
+
+  void FFT::transform(const Raster *inReal, const Raster *inImg, Raster *outReal, Raster *outImg,
+                      const int &sign, const double &scale) {
+    GEOSTAR_PROFILE_SCOPE("FFT::transform");
+    RasterSizeErrorException RasterSizeError;
+
+    long int nx = inReal->get_nx();
+    long int ny = inReal->get_ny();
+    if(inImg && (inImg->get_nx() != nx || inImg->get_ny() != ny)) throw RasterSizeError;
+    if(outReal && (outReal->get_nx() != nx || outReal->get_ny() != ny)) throw RasterSizeError;
+    if(outImg && (outImg->get_nx() != nx || outImg->get_ny() != ny)) throw RasterSizeError;
+    if(!outReal && !outImg) return;
+
+    const size_t limit = get_memory_limit();
+    const size_t rowBytes = sizeof(fftw_complex) * nx;
+    const size_t colBytes = sizeof(fftw_complex) * ny;
+
+    // 1. the whole raster fits: one read, one 2-D transform, one write.
+    if(rowBytes * ny <= limit) {
+      const long int slice[4] = {0, 0, nx, ny};
+      ComplexBuffer buffer = complexBuffer(nx * ny);
+      fftw_complex *data = buffer.get();
+      const int n[2] = {(int)ny, (int)nx};
+      fftw_plan p = plan(2, n, 1, 1, (int)(nx*ny), sign);
+
+      readComplex(inReal, inImg, slice, data);
+      fftw_execute_dft(p, data, data);
+      writeComplex(data, slice, scale, outReal, outImg);
+      return;
+    }
+
+    // 2. out of core.  The row pass leaves its result in an anonymous complex<double> dataset,
+    //    so the intermediate spectrum is not cut to the outputs' type, and the column pass reads
+    //    it back in panels of whole columns and writes the outputs.
+    H5::DataSet stage = anonymousDataset(storeOf(outReal ? outReal : outImg).dataset,
+                                         Raster::getHdf5Type<std::complex<double> >(), nx, ny);
+
+    long int bandRows = std::max(1L, std::min(ny, (long int)(limit / rowBytes)));
+    long int panelCols = std::max(1L, std::min(nx, (long int)(limit / colBytes)));
+    long int bufferSize = std::max(bandRows * nx, panelCols * ny);
+    ComplexBuffer buffer = complexBuffer(bufferSize);
+    fftw_complex *data = buffer.get();
+
+    // rows, bandRows at a time
+    for(long int y0=0; y0<ny; y0+=bandRows) {
+      const long int rows = std::min(bandRows, ny-y0);
+      const long int slice[4] = {0, y0, nx, rows};
+      const int n[1] = {(int)nx};
+      fftw_plan p = plan(1, n, (int)rows, 1, (int)nx, sign);
+
+      readComplex(inReal, inImg, slice, data);
+      fftw_execute_dft(p, data, data);
+      writePair(&stage, Store(), slice, data);
+    }// endfor: y0
+
+    // columns, panelCols at a time; a panel is ny rows of cols values
+    for(long int x0=0; x0<nx; x0+=panelCols) {
+      const long int cols = std::min(panelCols, nx-x0);
+      const long int slice[4] = {x0, 0, cols, ny};
+      const int n[1] = {(int)ny};
+      fftw_plan p = plan(1, n, (int)cols, (int)cols, 1, sign);
+
+      readPair(&stage, Store(), slice, data);
+      fftw_execute_dft(p, data, data);
+      writeComplex(data, slice, scale, outReal, outImg);
+    }// endfor: x0
+  }// end: transform
+
+
+
+  void FFT::forwardReal(const Raster *in, Raster *out) {
+    GEOSTAR_PROFILE_SCOPE("FFT::forwardReal");
+    RasterSizeErrorException RasterSizeError;
+    DataTypeException DataTypeError;
+
+    const long int nx = in->get_nx();
+    const long int ny = in->get_ny();
+    const long int half = nx/2 + 1;
+    if(out->get_nx() != half || out->get_ny() != ny) throw RasterSizeError;
+    if(!isComplex(storeOf(out))) throw DataTypeError;
+
+    const size_t limit = get_memory_limit();
+    const size_t rowBytes = sizeof(fftw_complex) * half;
+    const size_t colBytes = sizeof(fftw_complex) * ny;
+
+    // 1. in memory: real rows are read into the padded buffer and transformed where they lie
+    if(rowBytes * ny <= limit) {
+      const long int inSlice[4] = {0, 0, nx, ny};
+      const long int outSlice[4] = {0, 0, half, ny};
+      ComplexBuffer buffer = complexBuffer(half * ny);
+      fftw_complex *data = buffer.get();
+      const int n[2] = {(int)ny, (int)nx};
+      fftw_plan p = cachedPlan(R2C, 2, n, 1, 1, (int)(half*ny), FFTW_FORWARD);
+
+      readPadded(storeOf(in), inSlice, 2*half, (double *)data);
+      fftw_execute_dft_r2c(p, (double *)data, data);
+      writePair(storeOf(out), Store(), outSlice, data);
+      return;
+    }
+
+    // 2. out of core: r2c over bands of rows into an anonymous complex dataset, so the row
+    //    pass stays in double precision, then c2c over panels of its columns into out
+    H5::DataSet stage = anonymousDataset(storeOf(out).dataset, Raster::getHdf5Type<std::complex<double> >(),
+                                         half, ny);
+
+    long int bandRows = std::max(1L, std::min(ny, (long int)(limit / rowBytes)));
+    long int panelCols = std::max(1L, std::min(half, (long int)(limit / colBytes)));
+    long int bufferSize = std::max(bandRows * half, panelCols * ny);
+    ComplexBuffer buffer = complexBuffer(bufferSize);
+    fftw_complex *data = buffer.get();
+
+    for(long int y0=0; y0<ny; y0+=bandRows) {
+      const long int rows = std::min(bandRows, ny-y0);
+      const long int inSlice[4] = {0, y0, nx, rows};
+      const long int outSlice[4] = {0, y0, half, rows};
+      const int n[1] = {(int)nx};
+      fftw_plan p = cachedPlan(R2C, 1, n, (int)rows, 1, (int)half, FFTW_FORWARD);
+
+      readPadded(storeOf(in), inSlice, 2*half, (double *)data);
+      fftw_execute_dft_r2c(p, (double *)data, data);
+      writePair(&stage, Store(), outSlice, data);
+    }// endfor: y0
+
+    for(long int x0=0; x0<half; x0+=panelCols) {
+      const long int cols = std::min(panelCols, half-x0);
+      const long int slice[4] = {x0, 0, cols, ny};
+      const int n[1] = {(int)ny};
+      fftw_plan p = plan(1, n, (int)cols, (int)cols, 1, FFTW_FORWARD);
+
+      readPair(&stage, Store(), slice, data);
+      fftw_execute_dft(p, data, data);
+      writePair(storeOf(out), Store(), slice, data);
+    }// endfor: x0
+  }// end: forwardReal
+
+
+
+  void FFT::inverseReal(const Raster *in, Raster *out, const double &scale) {
+    GEOSTAR_PROFILE_SCOPE("FFT::inverseReal");
+    RasterSizeErrorException RasterSizeError;
+    DataTypeException DataTypeError;
+
+    const long int nx = out->get_nx();
+    const long int ny = out->get_ny();
+    const long int half = nx/2 + 1;
+    if(in->get_nx() != half || in->get_ny() != ny) throw RasterSizeError;
+    if(!isComplex(storeOf(in))) throw DataTypeError;
+
+    const size_t limit = get_memory_limit();
+    const size_t rowBytes = sizeof(fftw_complex) * half;
+    const size_t colBytes = sizeof(fftw_complex) * ny;
+
+    // 1. in memory
+    if(rowBytes * ny <= limit) {
+      const long int inSlice[4] = {0, 0, half, ny};
+      const long int outSlice[4] = {0, 0, nx, ny};
+      ComplexBuffer buffer = complexBuffer(half * ny);
+      fftw_complex *data = buffer.get();
+      const int n[2] = {(int)ny, (int)nx};
+      fftw_plan p = cachedPlan(C2R, 2, n, 1, 1, (int)(half*ny), FFTW_BACKWARD);
+
+      readPair(storeOf(in), Store(), inSlice, data);
+      fftw_execute_dft_c2r(p, data, (double *)data);
+      writePadded(storeOf(out), outSlice, 2*half, (double *)data, scale);
+      return;
+    }
+
+    // 2. out of core: c2c over panels of columns into an anonymous complex dataset, so the
+    //    input spectrum is left alone, then c2r over bands of rows into out
+    H5::DataSet stage = anonymousDataset(storeOf(out).dataset, Raster::getHdf5Type<std::complex<double> >(),
+                                         half, ny);
+
+    long int bandRows = std::max(1L, std::min(ny, (long int)(limit / rowBytes)));
+    long int panelCols = std::max(1L, std::min(half, (long int)(limit / colBytes)));
+    long int bufferSize = std::max(bandRows * half, panelCols * ny);
+    ComplexBuffer buffer = complexBuffer(bufferSize);
+    fftw_complex *data = buffer.get();
+
+    for(long int x0=0; x0<half; x0+=panelCols) {
+      const long int cols = std::min(panelCols, half-x0);
+      const long int slice[4] = {x0, 0, cols, ny};
+      const int n[1] = {(int)ny};
+      fftw_plan p = plan(1, n, (int)cols, (int)cols, 1, FFTW_BACKWARD);
+
+      readPair(storeOf(in), Store(), slice, data);
+      fftw_execute_dft(p, data, data);
+      writePair(&stage, Store(), slice, data);
+    }// endfor: x0
+
+    for(long int y0=0; y0<ny; y0+=bandRows) {
+      const long int rows = std::min(bandRows, ny-y0);
+      const long int inSlice[4] = {0, y0, half, rows};
+      const long int outSlice[4] = {0, y0, nx, rows};
+      const int n[1] = {(int)nx};
+      fftw_plan p = cachedPlan(C2R, 1, n, (int)rows, 1, (int)half, FFTW_BACKWARD);
+
+      readPair(&stage, Store(), inSlice, data);
+      fftw_execute_dft_c2r(p, data, (double *)data);
+      writePadded(storeOf(out), outSlice, 2*half, (double *)data, scale);
+    }// endfor: y0
+  }// end: inverseReal
+
+}// end namespace GeoStar
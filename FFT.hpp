@@ -0,0 +1,118 @@
+// FFT.hpp
+//
+// Planned, threaded 2-D Fourier transforms of rasters
+//----------------------------------------
+#ifndef FFT_HPP_
+#define FFT_HPP_
+
+#include <string>
+#include <cstddef>
+
+#include <fftw3.h>
+
+namespace GeoStar {
+  class Raster;
+
+  /** \brief FFT -- the 2-D FFT engine behind Raster::FFT_2D, FFT_2D_Inv and lowPassFilter
+
+  Transforms a raster (or a real/imaginary pair of rasters) with FFTW and writes the result to a
+  pair of output rasters.  When the complex array fits in the memory limit, the whole raster is
+  read once, transformed with a single 2-D plan, and written once.  Larger rasters are done out
+  of core: first in bands of full rows, then in panels of full columns, with the intermediate
+  result kept in double precision, so it matches the in-memory result whatever the outputs' type,
+  to rounding: the two round differently in the last bits, which an integer output can see as 1
+  where a value falls on a whole number.
+  No scratch datasets are left in the Image.
+
+  \see Raster::FFT_2D, Raster::FFT_2D_Inv, Raster::lowPassFilter, File::set_num_threads
+
+  \Par Example
+	a forward transform of ras, then the inverse, with wisdom kept next to the data:
+	\code
+	GeoStar::FFT::set_wisdom_file("/data/run/fftw.wisdom");
+
+	GeoStar::FFT::transform(ras, NULL, rasReal, rasImg, FFTW_FORWARD, 1.0);
+	GeoStar::FFT::transform(rasReal, rasImg, rasBack, NULL, FFTW_BACKWARD, 1.0/(nx*ny));
+
+	// the same, through the half spectrum
+	GeoStar::Raster *spec = img->create_raster("spec", GeoStar::COMPLEX_REAL64, nx/2+1, ny);
+	GeoStar::FFT::forwardReal(ras, spec);
+	GeoStar::FFT::inverseReal(spec, rasBack, 1.0/(nx*ny));
+	\endcode
+
+  \Par Details
+	Plans are made with FFTW_MEASURE (see set_planner_flags) and the threaded FFTW, using as many
+	threads as File::set_num_threads.  Plans are kept for the life of the process.  Wisdom is off
+	by default, so the library writes no files of its own; set_wisdom_file turns it on, and FFTW
+	wisdom is then loaded from the file before the first plan and saved to it after every new
+	one, so a second run at the same size skips planning entirely.  Processes running at the same
+	time should each have their own file.  An empty name turns wisdom off again.
+
+	All HDF5 access happens on the calling thread.  Pixels are read straight into the
+	interleaved complex buffer, so no per-row copies are made, and a missing imaginary input is
+	taken as all zeros.  The out-of-core path keeps the row pass's result in an anonymous
+	complex<double> HDF5 dataset in the output's file, which goes away when the transform is done;
+	only the column pass writes the outputs.
+
+	A complex raster (COMPLEX_REAL64 and friends) can stand in for a real/imaginary pair anywhere:
+	pass it as inReal or outReal and leave the imaginary raster NULL.  It is read and written
+	directly in the interleaved layout FFTW uses.
+
+	For real input, forwardReal and inverseReal use FFTW's r2c and c2r transforms and keep only
+	the nx/2+1 columns of the spectrum that are not redundant, in a single complex raster.  That
+	is half the work and a quarter of the storage of transform() with two output rasters.
+
+	The default memory limit is 1 GB of complex data (a 8192x8192 raster).  A buffer FFTW cannot
+	allocate throws FFTMemoryException, a plan it cannot make FFTPlanException; the buffers are
+	freed whatever is thrown.
+  */
+  class FFT {
+
+  public:
+    // FFTW_FORWARD (-1) or FFTW_BACKWARD (+1), unnormalized; every output pixel is multiplied
+    // by scale.  inImg and outImg may be NULL.  All rasters must be the same size.
+    static void transform(const Raster *inReal, const Raster *inImg, Raster *outReal, Raster *outImg,
+                          const int &sign, const double &scale);
+
+    // the forward transform of a real raster as its half spectrum: out is a complex raster
+    // (COMPLEX_REAL64 or COMPLEX_REAL128) of nx/2+1 by ny pixels, unnormalized.
+    static void forwardReal(const Raster *in, Raster *out);
+
+    // the inverse of forwardReal: in is a nx/2+1 by ny half spectrum, out the real raster of
+    // nx by ny pixels.  Every output pixel is multiplied by scale.
+    static void inverseReal(const Raster *in, Raster *out, const double &scale);
+
+    // an in-place 2-D transform of a ny x nx row-major array allocated with fftw_malloc
+    static void transform(fftw_complex *data, const long int &nx, const long int &ny, const int &sign);
+
+    // reads the [x0,y0,dx,dy] slice of re (and im, or zeros if NULL) into data, interleaved
+    static void readComplex(const Raster *re, const Raster *im, const long int *slice, fftw_complex *data);
+
+    // writes data*scale to the [x0,y0,dx,dy] slice of re and im; either may be NULL.
+    // data is scaled in place when scale is not 1.
+    static void writeComplex(fftw_complex *data, const long int *slice, const double &scale,
+                             Raster *re, Raster *im);
+
+    // where FFTW wisdom is kept; "" (the default) for none
+    static void set_wisdom_file(const std::string &path);
+    static std::string get_wisdom_file();
+
+    // the largest complex array, in bytes, transformed in memory
+    static void set_memory_limit(const size_t &bytes);
+    static size_t get_memory_limit();
+
+    // FFTW planner flags, FFTW_MEASURE by default
+    static void set_planner_flags(const unsigned &flags);
+
+    // a ready in-place plan for howmany transforms of size n, elements stride apart and dist
+    // between transforms; see fftw_plan_many_dft.  rank 2 makes an n[0] x n[1] transform.
+    // Run it with fftw_execute_dft(p, data, data) on any fftw_malloc'd array; planning uses a
+    // buffer of its own, so nothing the caller holds is overwritten.  Plans belong to FFT.
+    static fftw_plan plan(const int &rank, const int *n, const int &howmany, const int &stride,
+                          const int &dist, const int &sign);
+
+  }; // end class: FFT
+
+}// end namespace GeoStar
+
+#endif //FFT_HPP_
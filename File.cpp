@@ -13,6 +13,8 @@
 #include "Image.hpp"
 #include "Exceptions.hpp"
 #include "attributes.hpp"
+#include "ThreadPool.hpp"
+#include "TileCache.hpp"
 
 #include "boost/filesystem.hpp"
 
@@ -58,6 +60,46 @@ namespace GeoStar {
 
 
 
+#ifdef GEOSTAR_MPI
+  // rank 0 looks for the file, so every rank takes the same branch
+  File::File(const std::string &name, const std::string &access, MPI_Comm comm) {
+    FileAccessException FileAccessError;
+    FileExistsException FileExistsError;
+    FileDoesNotExistException FileDoesNotExistError;
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int exists = 0;
+    if(rank == 0) exists = boost::filesystem::exists(boost::filesystem::path(name)) ? 1 : 0;
+    MPI_Bcast(&exists, 1, MPI_INT, 0, comm);
+
+    H5::FileAccPropList fapl;
+    H5Pset_fapl_mpio(fapl.getId(), comm, MPI_INFO_NULL);
+    if(access=="new") {
+      // existence is an error:
+      if(exists) throw FileExistsError;
+      fileobj = new H5::H5File( name, H5F_ACC_EXCL, H5::FileCreatPropList::DEFAULT, fapl );
+
+    } else if(access=="existing") {
+      // non-existence is an error:
+      if(!exists) throw FileDoesNotExistError;
+      fileobj = new H5::H5File( name, H5F_ACC_RDWR, H5::FileCreatPropList::DEFAULT, fapl );
+
+    } else {
+      throw FileAccessError;
+    }// endif
+
+    filename = name;
+    filetype="geostar::hdf5";
+
+    // set objtype attribute.
+    write_object_type(filetype);
+
+  }// end-File-constructor
+#endif
+
+
+
   bool File::groupExists(const std::string &name) {
     try{
       H5::Exception::dontPrint();
@@ -70,4 +112,33 @@ namespace GeoStar {
   }// end: groupExists
 
 
+  void File::set_num_threads(const int &n) {
+    ThreadPool::instance().set_num_threads(n);
+  }// end: set_num_threads
+
+  int File::get_num_threads() {
+    return ThreadPool::instance().get_num_threads();
+  }// end: get_num_threads
+
+
+  void File::set_tile_cache_size(const size_t &bytes) {
+    TileCache::instance().set_capacity(bytes);
+  }// end: set_tile_cache_size
+
+  size_t File::get_tile_cache_size() {
+    return TileCache::instance().get_capacity();
+  }// end: get_tile_cache_size
+
+  TileCache::Stats File::get_tile_cache_stats() {
+    return TileCache::instance().get_stats();
+  }// end: get_tile_cache_stats
+
+  void File::reset_tile_cache_stats() {
+    TileCache::instance().reset_stats();
+  }// end: reset_tile_cache_stats
+
+  void File::flush_tile_cache() {
+    TileCache::instance().flush();
+  }// end: flush_tile_cache
+
 }// end namespace GeoStar
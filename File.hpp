@@ -13,6 +13,11 @@
 
 #include "Image.hpp"
 #include "attributes.hpp"
+#include "TileCache.hpp"
+
+#ifdef GEOSTAR_MPI
+#include <mpi.h>
+#endif
 
 namespace GeoStar {
 
@@ -119,6 +124,54 @@ There are 3 functions to deal with HDF5 groups in the file: checking on existenc
   */
     File(const std::string &name, const std::string &access);
 
+#ifdef GEOSTAR_MPI
+  /** \brief File constructor, MPI version, opens one file for all the ranks of an MPI job.
+
+   Every rank of comm calls this together, with the same name and access, and gets the same
+   file, opened through the MPI-IO driver of parallel HDF5.  The ranks then share its rasters:
+   Raster::rankRows gives each its rows, Raster::readRows and Raster::writeRows move them in
+   collective transfers, and TileExecutor::run and Raster::statistics take comm to split their
+   work over the ranks.
+
+   \see File, Raster::rankRows, TileExecutor::run
+
+   \param[in] name
+       The name of the file, the same on every rank.
+
+   \param[in] access
+       "new" or "existing", as for the serial constructor.
+
+   \param[in] comm
+       The ranks that open the file.
+
+   \returns
+       A valid File object on success, on every rank.
+
+   \par Exceptions
+       Exceptions that may be raised by this method, on every rank together:
+       FileAccessException 
+       FileExistsException 
+       FileDoesNotExistException 
+
+   \par Example
+       each rank of the job opens a Landsat scene and takes its share of the rows of a band:
+       \code
+       MPI_Init(&argc, &argv);
+       GeoStar::File *file = new GeoStar::File("scene.h5", "existing", MPI_COMM_WORLD);
+       GeoStar::Raster *band = file->open_image("landsat")->open_raster("B4");
+       \endcode
+
+    \par Details
+       Rank 0 checks whether the file exists, and tells the others, so they all throw or none
+       does.  Everything that changes the file's structure (creating or opening images and
+       rasters, attributes, deleting them) is collective in parallel HDF5: every rank must do the
+       same calls in the same order.  Pixel reads and writes are not, and go through each rank's
+       own tile cache as usual, which writes back whole tiles: ranks must not write the same
+       tiles, and Raster::rankRows deals out rows that keep them apart.
+  */
+    File(const std::string &name, const std::string &access, MPI_Comm comm);
+#endif
+
 
   /** \brief File::write_object_type allows one to change the value of the attribute string 
       named "object_type" that is attached to this file.
@@ -260,7 +313,12 @@ There are 3 functions to deal with HDF5 groups in the file: checking on existenc
        using the File object destructor.
 
   */
+    // writes this file's changed tiles first; the destructor cannot throw, so a failed write is lost
     inline ~File() {
+      try {
+        TileCache::instance().flush(*fileobj);
+      } catch(...) {
+      }// end: try
       delete fileobj;
     }
 
@@ -539,6 +597,108 @@ There are 3 functions to deal with HDF5 groups in the file: checking on existenc
       return fileobj->openGroup(name);
     }
 
+
+  /** \brief File::set_num_threads sets the number of threads used by the Raster operators.
+
+   File::set_num_threads sizes the process-wide thread pool that the pixel-wise Raster operators
+   (thresh, scale, the arithmetic operators, bitShift, addSaltPepper, autoLocalThresh) share.
+   The setting applies to every open file.
+
+   \see get_num_threads, ThreadPool
+
+   \param[in] n
+       The number of threads, including the calling thread.  0 means one per hardware thread,
+       which is the default; 1 turns threading off.
+
+   \par Exceptions
+       Exceptions that may be raised by this method:
+       none
+
+   \par Example
+       \code
+       #include "geostar.hpp"
+       int main()
+       {
+           GeoStar::File::set_num_threads(8);
+           GeoStar::File *file = new GeoStar::File("sirc_raco","existing");
+           ...
+       }//end-main
+       \endcode
+
+    \par Details
+       All HDF5 calls stay on the thread that called the operator; only the arithmetic on each
+       block is shared out, so this is safe with an HDF5 library built without thread-safety.
+  */
+    static void set_num_threads(const int &n);
+
+  /** \brief File::get_num_threads returns the number of threads used by the Raster operators.
+
+   \see set_num_threads
+  */
+    static int get_num_threads();
+
+
+  /** \brief File::set_tile_cache_size sets the memory budget of the tile cache shared by all rasters.
+
+   Raster reads and writes go through one process-wide cache of tiles (chunks of a chunked
+   raster, 256x256 blocks of a contiguous one), evicting the least recently used tile of any
+   raster when the budget is reached.  The setting applies to every open file.
+
+   \see get_tile_cache_size, get_tile_cache_stats, flush_tile_cache, TileCache
+
+   \param[in] bytes
+       The budget in bytes; the default is 256 MB.  0 turns the cache off, and every read and
+       write goes straight to HDF5.
+
+   \par Exceptions
+       Exceptions that may be raised by this method:
+       H5::Exception, if changed tiles evicted by a smaller budget cannot be written
+
+   \par Example
+       \code
+       #include "geostar.hpp"
+       int main()
+       {
+           GeoStar::File::set_tile_cache_size(1024UL*1024*1024);
+           GeoStar::File *file = new GeoStar::File("sirc_raco","existing");
+           ...
+           GeoStar::TileCache::Stats s = GeoStar::File::get_tile_cache_stats();
+           std::cout << s.hits << " hits " << s.misses << " misses\n";
+       }//end-main
+       \endcode
+
+    \par Details
+       Changed tiles are written back when evicted, when the last Raster on their dataset is
+       destroyed, when their File is destroyed, and on flush_tile_cache.  The File destructor
+       cannot throw, so a tile it fails to write is lost: call flush_tile_cache first to see the error.
+  */
+    static void set_tile_cache_size(const size_t &bytes);
+
+  /** \brief File::get_tile_cache_size returns the memory budget of the tile cache.
+
+   \see set_tile_cache_size
+  */
+    static size_t get_tile_cache_size();
+
+  /** \brief File::get_tile_cache_stats returns the hit, miss, eviction and write-back counts
+      of the tile cache, and the bytes it holds.
+
+   \see set_tile_cache_size, reset_tile_cache_stats
+  */
+    static TileCache::Stats get_tile_cache_stats();
+
+  /** \brief File::reset_tile_cache_stats sets the tile cache counters back to zero.
+
+   \see get_tile_cache_stats
+  */
+    static void reset_tile_cache_stats();
+
+  /** \brief File::flush_tile_cache writes every changed tile in the cache to its file.
+
+   \see set_tile_cache_size
+  */
+    static void flush_tile_cache();
+
   }; // end class: File
   
 }// end namespace GeoStar
@@ -9,6 +9,11 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <stdint.h>
 #include "H5Cpp.h"
 
 #include "File.hpp"
@@ -16,6 +21,9 @@
 #include "Raster.hpp"
 #include "Exceptions.hpp"
 #include "attributes.hpp"
+#include "ThreadPool.hpp"
+#include "PixelConvert.hpp"
+#include "Profiler.hpp"
 
 extern "C" {
 #include "tiff.h"
@@ -60,6 +68,13 @@ namespace GeoStar {
   }// end-Image-constructor
 
 
+  Image::Image(const H5::Group &group, const std::string &name) {
+    imageobj = new H5::Group(group);
+    imagename = name;
+    imagetype = "geostar::image";
+  }// end-Image-constructor
+
+
 
 
 
@@ -75,59 +90,288 @@ namespace GeoStar {
   }// end: datasetExists
 
 
+  H5::DataSet Image::openDataset(const std::string &name,
+                                 const H5::DSetAccPropList &access_plist) {
+    RasterOpenErrorException RasterOpenError;
+
+    // hdf5-1.10.0's C++ API has no access-plist variant of openDataSet, so use the C call:
+    hid_t id = H5Dopen2(imageobj->getId(), name.c_str(), access_plist.getId());
+    if(id < 0) throw RasterOpenError;
+    H5::DataSet dataset(id);
+    H5Dclose(id);
+    return dataset;
+  }// end: openDataset
+
+
+  namespace {
+
+    // the raster type a GDAL band is stored as, and the GDAL type of a raster type
+    RasterType nativeRasterType(const GDALDataType &type) {
+      switch(type) {
+      case GDT_Byte:     return INT8U;
+      case GDT_UInt16:   return INT16U;
+      case GDT_Int16:    return INT16S;
+      case GDT_UInt32:   return INT32U;
+      case GDT_Int32:    return INT32S;
+      case GDT_Float64:  return REAL64;
+      case GDT_CInt16:   return COMPLEX_INT32;
+      case GDT_CInt32:   return COMPLEX_INT64;
+      case GDT_CFloat32: return COMPLEX_REAL64;
+      case GDT_CFloat64: return COMPLEX_REAL128;
+      default:           return REAL32;
+      }
+    }// end: nativeRasterType
+
+    GDALDataType gdalType(const RasterType &type) {
+      switch(type) {
+      case INT8U:           return GDT_Byte;
+      case INT16U:          return GDT_UInt16;
+      case INT16S:          return GDT_Int16;
+      case INT32U:          return GDT_UInt32;
+      case INT32S:          return GDT_Int32;
+      case REAL32:          return GDT_Float32;
+      case REAL64:          return GDT_Float64;
+      case COMPLEX_INT32:   return GDT_CInt16;
+      case COMPLEX_INT64:   return GDT_CInt32;
+      case COMPLEX_REAL64:  return GDT_CFloat32;
+      case COMPLEX_REAL128: return GDT_CFloat64;
+      default:              return GDT_Unknown;
+      }
+    }// end: gdalType
+
+    inline bool isRealGdal(const GDALDataType &type) {
+      return type == GDT_Byte || type == GDT_UInt16 || type == GDT_Int16 || type == GDT_UInt32
+        || type == GDT_Int32 || type == GDT_Float32 || type == GDT_Float64;
+    }
+
+
+    // the native HDF5 type of a real GDAL type, as PixelConvert takes it
+    const H5::DataType &nativeType(const GDALDataType &type) {
+      switch(type) {
+      case GDT_Byte:    return H5::PredType::NATIVE_UINT8;
+      case GDT_UInt16:  return H5::PredType::NATIVE_UINT16;
+      case GDT_Int16:   return H5::PredType::NATIVE_INT16;
+      case GDT_UInt32:  return H5::PredType::NATIVE_UINT32;
+      case GDT_Int32:   return H5::PredType::NATIVE_INT32;
+      case GDT_Float32: return H5::PredType::NATIVE_FLOAT;
+      default:          return H5::PredType::NATIVE_DOUBLE;
+      }
+    }// end: nativeType
+
+
+    // one strip of rows of one band on its way from GDAL to HDF5
+    struct Strip {
+      int band;                   // index into the bands being read
+      long int y0, rows;
+      std::vector<char> raw;      // as read, in the band's GDAL type
+      std::vector<char> out;      // converted to the raster's type, when that differs
+      const char *data;           // whichever of the two is written
+    };
+
+  }// end anonymous namespace
+
+
+
+  std::vector<Raster *> Image::read_file(const std::string &infile, const std::string &name,
+                                         const std::vector<int> &bands, const RasterType &type,
+                                         const RasterCreateOptions &options) {
+    return read_bands(infile, name, bands, &type, options);
+  }// end-function: read_file
+
+
+  std::vector<Raster *> Image::read_file(const std::string &infile, const std::string &name,
+                                         const std::vector<int> &bands,
+                                         const RasterCreateOptions &options) {
+    return read_bands(infile, name, bands, NULL, options);
+  }// end-function: read_file
+
+
   Raster *Image::read_file(const std::string &infile, const std::string &name,
-				const int &nChannels){
+				const int &nChannels, const RasterCreateOptions &options){
+    return read_bands(infile, name, std::vector<int>(1, nChannels), NULL, options)[0];
+  }// end-function: read_file
+
+
+  std::vector<Raster *> Image::read_bands(const std::string &infile, const std::string &name,
+                                          const std::vector<int> &bandList, const RasterType *type,
+                                          const RasterCreateOptions &options) {
     // 1. open the data file
-    // 2. figure out data characteristics
-    // 3. create empty raster
-    // 4. fill raster.
+    // 2. figure out the characteristics of each band
+    // 3. create the empty rasters
+    // 4. fill them: a reader thread pulls strips from GDAL, a converter thread converts them on
+    //    the pool, and this thread writes them to HDF5, the three overlapping.
+    GEOSTAR_PROFILE_SCOPE("Image::read_file");
     FileOpenErrorException FileOpenError;
+    RasterCreationErrorException RasterCreationError;
+    RasterReadErrorException RasterReadError;
 
     // 1. open the data file
-    GDALDataset *poDataset;
     GDALAllRegister();
-    char cname[infile.length()+10]; // need a copy because it's declared const
-    strcpy(cname, infile.c_str());
-    poDataset = (GDALDataset *) GDALOpen(cname, GA_ReadOnly );
+    GDALDataset *poDataset = (GDALDataset *) GDALOpen(infile.c_str(), GA_ReadOnly);
     if( poDataset == NULL ) throw FileOpenError;
 
-    // 2. figure out data characteristics
-    GDALRasterBand *poBand;
-    poBand = poDataset->GetRasterBand( nChannels ); //channel number
-    int nx = poBand->GetXSize();
-    int ny = poBand->GetYSize();
-
-    // 3. create empty raster
-    Raster *ras = create_raster(name,GeoStar::REAL32,nx,ny);
-
-    // 4. fill raster:
-    std::vector<long int> slice(4);
-    slice[0]=0;  slice[1]=0;
-    slice[2]=nx; slice[3]=1;
-
-    float *buf;
-    buf = (float *) CPLMalloc(sizeof(float)*nx);
-	
-
-    for(int iy=0;iy<ny;++iy){
-      CPLErr err = poBand->RasterIO( GF_Read, 
-                    0, iy, nx, 1,
-                    buf, nx, 1, GDT_Float32,
-                    0, 0 );
-      slice[1]=iy;
-	vector<float> writeBuf(buf, buf + nx);
-      ras->write(slice, writeBuf);
-    } // endfor
-
-	
-
-    CPLFree(buf);
+    // 2. figure out the characteristics of each band; no list means all of them
+    std::vector<int> bands = bandList;
+    if(bands.empty()) {
+      for(int b=1; b<=poDataset->GetRasterCount(); ++b) bands.push_back(b);
+    }
+    const int nBands = bands.size();
+    std::vector<GDALRasterBand *> poBand(nBands);
+    std::vector<GDALDataType> readType(nBands), writeType(nBands);
+    std::vector<RasterType> rasType(nBands);
+    for(int b=0; b<nBands; ++b) {
+      poBand[b] = poDataset->GetRasterBand(bands[b]);
+      if(poBand[b] == NULL) {
+        GDALClose(poDataset);
+        throw FileOpenError;
+      }
+      readType[b] = poBand[b]->GetRasterDataType();
+      rasType[b] = (type != NULL) ? *type : nativeRasterType(readType[b]);
+      writeType[b] = gdalType(rasType[b]);
+      if(writeType[b] == GDT_Unknown) {
+        GDALClose(poDataset);
+        throw RasterCreationError;
+      }
+      // PixelConvert handles the real types; GDAL converts anything else itself
+      if(!isRealGdal(readType[b]) || !isRealGdal(writeType[b])) readType[b] = writeType[b];
+    }// endfor: b
+    const int nx = poDataset->GetRasterXSize();
+    const int ny = poDataset->GetRasterYSize();
+
+    // 3. create the empty rasters; one band keeps the name, more are numbered after it
+    std::vector<Raster *> ras(nBands, (Raster *)NULL);
+    try {
+      for(int b=0; b<nBands; ++b) {
+        const std::string rasName = (nBands == 1) ? name : name + std::to_string(bands[b]);
+        ras[b] = create_raster(rasName, rasType[b], nx, ny, options);
+      }
+    } catch(...) {
+      for(int b=0; b<nBands; ++b) delete ras[b];
+      GDALClose(poDataset);
+      throw;
+    }
+
+    // strips are whole rows, a multiple of the chunk height (or the GDAL block height when
+    // the raster is not chunked), about a million pixels
+    std::vector<long int> stripRows(nBands);
+    size_t stripBytes = 0;
+    for(int b=0; b<nBands; ++b) {
+      int bx = 0, by = 0;
+      poBand[b]->GetBlockSize(&bx, &by);
+      long int unit = ras[b]->get_chunk_ny();
+      if(unit <= 0) unit = std::max(by, 1);
+      stripRows[b] = unit * std::max(1L, (1L << 20) / ((long int)nx*unit));
+      stripRows[b] = std::min(stripRows[b], (long int)ny);
+      const size_t pixel = std::max(GDALGetDataTypeSizeBytes(readType[b]),
+                                    GDALGetDataTypeSizeBytes(writeType[b]));
+      stripBytes = std::max(stripBytes, (size_t)stripRows[b]*nx*pixel);
+    }// endfor: b
+
+    // 4. fill the rasters.  A fixed set of strips circulates through the three stages, so
+    //    nothing is allocated per row or per strip.
+    const int nStrips = 4;
+    std::vector<Strip> strips(nStrips);
+    BoundedQueue<Strip *> freeStrips(nStrips), readStrips(nStrips), doneStrips(nStrips);
+    for(int k=0; k<nStrips; ++k) {
+      strips[k].raw.resize(stripBytes);
+      strips[k].out.resize(stripBytes);
+      freeStrips.push(&strips[k]);
+    }
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto fail = [&](std::exception_ptr e) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if(!error) error = e;
+      freeStrips.close();
+      readStrips.close();
+      doneStrips.close();
+    };
+
+    std::thread reader([&]() {
+        try {
+          for(int b=0; b<nBands; ++b) {
+            const int size = GDALGetDataTypeSizeBytes(readType[b]);
+            for(long int y0=0; y0<ny; y0+=stripRows[b]) {
+              Strip *s;
+              if(!freeStrips.pop(s)) return;
+              s->band = b;
+              s->y0 = y0;
+              s->rows = std::min(stripRows[b], ny-y0);
+              CPLErr err;
+              {
+                GEOSTAR_PROFILE_BYTES("GDAL::read", (double)size*nx*s->rows);
+                err = poBand[b]->RasterIO(GF_Read, 0, y0, nx, s->rows, &s->raw[0], nx, s->rows,
+                                          readType[b], size, (long int)size*nx);
+              }
+              if(err != CE_None) throw RasterReadError;
+              if(!readStrips.push(s)) return;
+            }// endfor: y0
+          }// endfor: b
+          readStrips.close();
+        } catch(...) {
+          fail(std::current_exception());
+        }
+      });
+
+    std::thread converter([&]() {
+        try {
+          Strip *s;
+          while(readStrips.pop(s)) {
+            const int b = s->band;
+            s->data = &s->raw[0];
+            if(readType[b] != writeType[b]) {
+              const int inSize = GDALGetDataTypeSizeBytes(readType[b]);
+              const int outSize = GDALGetDataTypeSizeBytes(writeType[b]);
+              parallel_for(s->rows*nx, [&](long int begin, long int end) {
+                  PixelConvert::convert(&s->raw[begin*inSize], nativeType(readType[b]),
+                                        &s->out[begin*outSize], nativeType(writeType[b]), end-begin);
+                });
+              s->data = &s->out[0];
+            }
+            if(!doneStrips.push(s)) return;
+          }// endwhile
+          doneStrips.close();
+        } catch(...) {
+          fail(std::current_exception());
+        }
+      });
+
+    // the writer: HDF5 stays on this thread, written in the raster's own type through
+    // writeSelection, so the TileCache, the saved statistics and the Profiler see every strip
+    try {
+      std::vector<H5::DataType> memType(nBands);
+      for(int b=0; b<nBands; ++b) {
+        const hid_t native = H5Tget_native_type(ras[b]->rasterobj->getDataType().getId(), H5T_DIR_ASCEND);
+        memType[b] = H5::DataType(native);
+        H5Tclose(native);
+      }
+      Strip *s;
+      while(doneStrips.pop(s)) {
+        Raster *r = ras[s->band];
+        hsize_t dims[2] = {(hsize_t)s->rows, (hsize_t)nx};
+        hsize_t offset[2] = {(hsize_t)s->y0, 0};
+        H5::DataSpace memspace(2, dims);
+        H5::DataSpace space = r->rasterobj->getSpace();
+        space.selectHyperslab(H5S_SELECT_SET, dims, offset);
+        r->writeSelection((const void *)s->data, memType[s->band], memspace, space);
+        if(!freeStrips.push(s)) break;
+      }// endwhile
+    } catch(...) {
+      fail(std::current_exception());
+    }
+    reader.join();
+    converter.join();
     GDALClose(poDataset);
 
-    // 5. return the new raster object
+    if(error) {
+      for(int b=0; b<nBands; ++b) delete ras[b];
+      std::rethrow_exception(error);
+    }
+
+    // 5. return the new raster objects
     return ras;
 
-  }// end-function: read_file
+  }// end-function: read_bands
 
 
 
@@ -9,6 +9,7 @@
 #define IMAGE_HPP_
 
 #include <string>
+#include <vector>
 
 #include "H5Cpp.h"
 #include "Raster.hpp"
@@ -52,6 +53,11 @@ There are tools to check if a dataset exists before creating or opening one.
     std::string imagename;
     std::string imagetype;
 
+    // the ingest pipeline behind read_file; type NULL keeps each band's own type
+    std::vector<Raster *> read_bands(const std::string &infile, const std::string &name,
+                                     const std::vector<int> &bands, const RasterType *type,
+                                     const RasterCreateOptions &options);
+
   public:
     H5::Group *imageobj;
 
@@ -109,6 +115,9 @@ There are tools to check if a dataset exists before creating or opening one.
     */
     Image(File *file, const std::string &name);
 
+    // wraps an image group that is already open, as Raster::getParent does; nothing is checked
+    Image(const H5::Group &group, const std::string &name);
+
 
     /** \brief write_object_type -- allows you to write the type attribute of the image
 
@@ -259,6 +268,10 @@ There are tools to check if a dataset exists before creating or opening one.
    \param[in] ny
 	this is the size of the raster in the y-direction.
 
+   \param[in] options
+	optional storage layout: chunk (tile) size, deflate/shuffle compression and fill value.
+	The default is an uncompressed contiguous dataset.  See RasterCreateOptions.
+
    \returns
        A valid Raster object on success.
 
@@ -295,8 +308,9 @@ There are tools to check if a dataset exists before creating or opening one.
   */
     inline Raster *create_raster(const std::string &name, 
                                  const RasterType &type,
-                                 const int &nx, const int &ny) {
-      return new Raster(this,name,type,nx,ny);
+                                 const int &nx, const int &ny,
+                                 const RasterCreateOptions &options = RasterCreateOptions()) {
+      return new Raster(this,name,type,nx,ny,options);
     }
 
 
@@ -462,6 +476,14 @@ There are tools to check if a dataset exists before creating or opening one.
       return imageobj->createDataSet(name,data_type,data_space);
     }
 
+    // same as above, with a dataset creation property list (chunking, filters, fill value).
+    inline H5::DataSet createDataset(const std::string &name, 
+                                     const H5::DataType &data_type,
+                                     const H5::DataSpace &data_space,
+                                     const H5::DSetCreatPropList &create_plist) {
+      return imageobj->createDataSet(name,data_type,data_space,create_plist);
+    }
+
     /** \brief openDataset opens the named dataset and returns it.
 
    File::openDataset  opens the named dataset and returns it.
@@ -508,18 +530,14 @@ There are tools to check if a dataset exists before creating or opening one.
       return imageobj->openDataSet(name);
     }
 
+    // same as above, with a dataset access property list (e.g. chunk-cache size).
+    H5::DataSet openDataset(const std::string &name, const H5::DSetAccPropList &access_plist);
 
-    // read a single-channel image file
-    // infile is the name of the intput image file
-    // name is the string to identify the new raster that is created
-    // if the image is more than 1 channel, it just uses the first.
-    // for now, it creates a float channel.
-    // returns the newly-created Raster.
 
 /** \brief read_file reads a file and returns a new raster
 
    read_file reads a single channel image file.  If the image is more than 1 channel, it reads the channel
-	number specified in nChannels parameter.  For now, a float channel is created.
+	number specified in nChannels parameter.  The raster keeps the data type of the channel.
    
    \see  Read, Write
 
@@ -532,12 +550,16 @@ There are tools to check if a dataset exists before creating or opening one.
    \param[in] nChannels
 	This is an integer that specifies what channel of the image you want to read from.
 
+   \param[in] options
+	optional storage layout for the new raster (chunking, compression, fill value).
+	See RasterCreateOptions.
+
    \returns
        A new raster with the channel data inside on success.
 
    \par Exceptions
 	Exceptions that may be raised by this method:
-       FileOpenError
+       FileOpenError, RasterReadError
 
    \par Example
        Example creating a raster named "test" from 1 channel of a file named "data.tif"
@@ -563,12 +585,77 @@ There are tools to check if a dataset exists before creating or opening one.
        \endcode
 
     \par Details
-	The raster will be created to be the same size and have the same values as the channel
-	you are reading from.  The infile must exist, otherwise an exception is thrown.
+	The raster will be created to be the same size and have the same values and data type as the channel
+	you are reading from: an 8-bit channel gives an INT8U raster, a 16-bit Landsat band an INT16U one.  The
+	infile must exist, and have channel nChannels, otherwise an exception is thrown.  This is the one-band case
+	of the multi-band read_file below, and is read the same way.
  
   */
 
-    Raster *read_file(const std::string &infile, const std::string &name, const int &nChannels);
+    Raster *read_file(const std::string &infile, const std::string &name, const int &nChannels,
+                      const RasterCreateOptions &options = RasterCreateOptions());
+
+
+/** \brief read_file reads several channels of a file in one pass and returns a raster for each
+
+   Reads the channels listed in bands, or all of them when bands is empty, from one open of the file.
+	Each raster keeps the data type of its channel, or is converted to type when one is given.
+
+   \see  Read, Write, BoundedQueue
+
+   \param[in] infile
+	This is a string that holds the name of the file you are reading from
+
+   \param[in] name
+       The name of the new raster when one channel is read.  With more, channel b is named name
+	followed by b, so "B" gives "B1", "B2", ...
+
+   \param[in] bands
+	The channel numbers to read, counting from 1.  Empty means every channel of the file.
+
+   \param[in] type
+	optional: the data type of every new raster.  Real values are converted as Raster::write
+	converts them: truncated towards zero, and clamped to the range of an integer type.
+
+   \param[in] options
+	optional storage layout for the new rasters (chunking, compression, fill value).
+	See RasterCreateOptions.
+
+   \returns
+       The new rasters, in the order of bands.
+
+   \par Exceptions
+	Exceptions that may be raised by this method:
+       FileOpenError if the file cannot be opened or lacks a channel, RasterCreationError if type
+	has no GDAL equivalent, RasterReadError if GDAL fails part way through.
+
+   \par Example
+       Ingesting all eleven bands of a scene as "B1" .. "B11", chunked 512x512:
+
+       \code
+       std::vector<GeoStar::Raster *> bands;
+       bands = img->read_file("scene.tif", "B", std::vector<int>(),
+                              GeoStar::RasterCreateOptions().setChunk(512, 512));
+       \endcode
+
+    \par Details
+	The file is read in strips of whole rows: a multiple of the chunk height of the new raster, or of
+	GDAL's block height when it is not chunked, of about a million pixels.  Three stages overlap: a reader
+	thread pulls strips from GDAL in the channel's own type, a converter thread converts them with
+	PixelConvert on the File::set_num_threads pool when the raster type differs, and the calling thread
+	writes them to HDF5 in the raster's own type, so HDF5 does no type conversion.  A fixed set of four
+	strip buffers circulates between the stages through BoundedQueues, so nothing is allocated per row.
+	HDF5 is only called from the calling thread.  If any stage fails, the others stop and the error is
+	rethrown here.
+  */
+
+    std::vector<Raster *> read_file(const std::string &infile, const std::string &name,
+                                    const std::vector<int> &bands,
+                                    const RasterCreateOptions &options = RasterCreateOptions());
+
+    std::vector<Raster *> read_file(const std::string &infile, const std::string &name,
+                                    const std::vector<int> &bands, const RasterType &type,
+                                    const RasterCreateOptions &options = RasterCreateOptions());
 
 
   }; // end class: Image
@@ -0,0 +1,248 @@
+// IntegralImage.cpp
+//
+// Implementation of the summed-area tables and the local-mean thresholds
+// Documentation in IntegralImage.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "Neighborhood.hpp"
+#include "IntegralImage.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  void IntegralImage::build(const Raster *in, Raster *sums, Raster *squares) {
+    GEOSTAR_PROFILE_SCOPE("IntegralImage::build");
+    RasterSizeErrorException RasterSizeError;
+
+    const long int nx = in->get_nx();
+    const long int ny = in->get_ny();
+    if(sums != NULL && (sums->get_nx() != nx || sums->get_ny() != ny)) throw RasterSizeError;
+    if(squares != NULL && (squares->get_nx() != nx || squares->get_ny() != ny)) throw RasterSizeError;
+    if((sums == NULL && squares == NULL) || nx == 0 || ny == 0) return;
+
+    long int band = in->get_chunk_ny();
+    if(band <= 0) band = std::max(1L, (1L << 20) / nx);
+
+    // the last row of the tables so far, which the next band starts from
+    std::vector<double> data, sq, carry(nx, 0.0), carrySq(nx, 0.0);
+
+    for(long int y0=0; y0<ny; y0+=band) {
+      const long int rows = std::min(band, ny-y0);
+      data.resize(rows*nx);
+      if(squares != NULL) sq.resize(rows*nx);
+      in->read(Slice(0, y0, nx, rows), &data[0]);
+
+      // 1. along the rows
+      parallel_for(rows, [&](long int begin, long int end) {
+        for(long int k=begin; k<end; ++k) {
+          double *p = &data[k*nx];
+          double *q = (squares != NULL) ? &sq[k*nx] : NULL;
+          double acc = 0.0, acc2 = 0.0;
+          for(long int x=0; x<nx; ++x) {
+            const double v = p[x];
+            acc += v;
+            p[x] = acc;
+            if(q) {
+              acc2 += v*v;
+              q[x] = acc2;
+            }
+          }// endfor: x
+        }// endfor: k
+      }, 1);
+
+      // 2. down the columns, in strips of columns
+      parallel_for(nx, [&](long int x0, long int x1) {
+        for(long int k=0; k<rows; ++k) {
+          double *p = &data[k*nx];
+          const double *above = (k > 0) ? p - nx : &carry[0];
+          for(long int x=x0; x<x1; ++x) p[x] += above[x];
+          if(squares != NULL) {
+            double *q = &sq[k*nx];
+            const double *aboveSq = (k > 0) ? q - nx : &carrySq[0];
+            for(long int x=x0; x<x1; ++x) q[x] += aboveSq[x];
+          }
+        }// endfor: k
+        std::copy(data.begin() + (rows-1)*nx + x0, data.begin() + (rows-1)*nx + x1, carry.begin() + x0);
+        if(squares != NULL) {
+          std::copy(sq.begin() + (rows-1)*nx + x0, sq.begin() + (rows-1)*nx + x1, carrySq.begin() + x0);
+        }
+      });
+
+      if(sums != NULL) sums->write(Slice(0, y0, nx, rows), &data[0]);
+      if(squares != NULL) squares->write(Slice(0, y0, nx, rows), &sq[0]);
+    }// endfor: y0
+  }// end: build
+
+
+
+  IntegralImage::IntegralImage(const Raster *sums, const Raster *squares)
+    : sums(sums), squares(squares), nx(sums->get_nx()), ny(sums->get_ny()) {
+    RasterSizeErrorException RasterSizeError;
+    if(squares != NULL && (squares->get_nx() != nx || squares->get_ny() != ny)) throw RasterSizeError;
+  }// end-IntegralImage-constructor
+
+
+
+  bool IntegralImage::clip(long int *box) const {
+    box[0] = std::max(box[0], 0L);
+    box[1] = std::max(box[1], 0L);
+    box[2] = std::min(box[2], nx-1);
+    box[3] = std::min(box[3], ny-1);
+    return box[0] <= box[2] && box[1] <= box[3];
+  }// end: clip
+
+
+
+  // S(x1,y1) - S(x0-1,y1) - S(x1,y0-1) + S(x0-1,y0-1), with S = 0 left of and above the raster
+  double IntegralImage::total(const Raster *table, const long int *box) const {
+    double corner, result;
+    table->read(Slice(box[2], box[3], 1, 1), &result);
+    if(box[0] > 0) {
+      table->read(Slice(box[0]-1, box[3], 1, 1), &corner);
+      result -= corner;
+    }
+    if(box[1] > 0) {
+      table->read(Slice(box[2], box[1]-1, 1, 1), &corner);
+      result -= corner;
+    }
+    if(box[0] > 0 && box[1] > 0) {
+      table->read(Slice(box[0]-1, box[1]-1, 1, 1), &corner);
+      result += corner;
+    }
+    return result;
+  }// end: total
+
+
+
+  double IntegralImage::boxSum(const long int &x0, const long int &y0,
+                               const long int &x1, const long int &y1) const {
+    long int box[4] = {x0, y0, x1, y1};
+    if(!clip(box)) return 0;
+    return total(sums, box);
+  }// end: boxSum
+
+
+
+  double IntegralImage::boxMean(const long int &x0, const long int &y0,
+                                const long int &x1, const long int &y1) const {
+    long int box[4] = {x0, y0, x1, y1};
+    if(!clip(box)) return 0;
+    const double area = (double)(box[2]-box[0]+1) * (box[3]-box[1]+1);
+    return total(sums, box) / area;
+  }// end: boxMean
+
+
+
+  double IntegralImage::boxVariance(const long int &x0, const long int &y0,
+                                    const long int &x1, const long int &y1) const {
+    RasterDoesNotExistException RasterDoesNotExist;
+    if(squares == NULL) throw RasterDoesNotExist;
+
+    long int box[4] = {x0, y0, x1, y1};
+    if(!clip(box)) return 0;
+    const double area = (double)(box[2]-box[0]+1) * (box[3]-box[1]+1);
+    const double mean = total(sums, box) / area;
+    const double var = total(squares, box) / area - mean*mean;
+    return var > 0 ? var : 0;
+  }// end: boxVariance
+
+
+
+  void IntegralImage::threshold(const Raster *in, Raster *out, const Method &method,
+                                const long int &n, const double &k, const double &range,
+                                const BorderMode &border) {
+    GEOSTAR_PROFILE_SCOPE("IntegralImage::threshold");
+    RasterSizeErrorException RasterSizeError;
+    IntegerParameterException IntegerParameterError;
+    if(n < 1 || n % 2 == 0) throw IntegerParameterError;
+
+    const long int nx = in->get_nx();
+    const long int ny = in->get_ny();
+    if(out->get_nx() != nx || out->get_ny() != ny) throw RasterSizeError;
+
+    const long int r = n/2;
+    const double area = (double)n * n;
+    RowWindow win(in, r, r, border);
+    std::vector<double> sums, squares, outData;
+
+    while(win.next()) {
+      const long int rows = win.rows();
+      const long int total = rows + 2*r;
+      const long int w = win.width() + 1;     // tables have a zero row and column in front
+
+      // the band is summed around the mean of its first row, so the squares stay small
+      double shift = 0;
+      const double *first = win.row(r) + r;
+      for(long int x=0; x<nx; ++x) shift += first[x];
+      shift /= nx;
+
+      sums.resize((total+1)*w);
+      squares.resize((total+1)*w);
+      std::fill(sums.begin(), sums.begin()+w, 0.0);
+      std::fill(squares.begin(), squares.begin()+w, 0.0);
+      outData.resize(rows*nx);
+
+      // 1. along the rows
+      parallel_for(total, [&](long int begin, long int end) {
+        for(long int q=begin; q<end; ++q) {
+          const double *p = win.row(q);
+          double *s = &sums[(q+1)*w];
+          double *s2 = &squares[(q+1)*w];
+          double acc = 0.0, acc2 = 0.0;
+          s[0] = s2[0] = 0.0;
+          for(long int x=0; x<w-1; ++x) {
+            const double d = p[x] - shift;
+            acc += d;
+            acc2 += d*d;
+            s[x+1] = acc;
+            s2[x+1] = acc2;
+          }// endfor: x
+        }// endfor: q
+      }, 1);
+
+      // 2. down the columns, in strips of columns
+      parallel_for(w, [&](long int x0, long int x1) {
+        for(long int q=1; q<=total; ++q) {
+          double *s = &sums[q*w];
+          double *s2 = &squares[q*w];
+          for(long int x=x0; x<x1; ++x) {
+            s[x] += s[x-w];
+            s2[x] += s2[x-w];
+          }
+        }// endfor: q
+      });
+
+      // 3. the window around every pixel: padded rows y .. y+n-1, padded columns x .. x+n-1
+      parallel_for(rows, [&](long int begin, long int end) {
+        for(long int y=begin; y<end; ++y) {
+          const double *top = &sums[y*w], *bottom = &sums[(y+n)*w];
+          const double *top2 = &squares[y*w], *bottom2 = &squares[(y+n)*w];
+          const double *p = win.row(y+r) + r;
+          double *o = &outData[y*nx];
+          for(long int x=0; x<nx; ++x) {
+            const double sum = bottom[x+n] - bottom[x] - top[x+n] + top[x];
+            const double sum2 = bottom2[x+n] - bottom2[x] - top2[x+n] + top2[x];
+            const double m = sum / area;
+            const double var = sum2 / area - m*m;
+            const double sd = var > 0 ? std::sqrt(var) : 0;
+            const double mean = m + shift;
+            const double t = (method == NIBLACK) ? mean + k*sd : mean * (1 + k*(sd/range - 1));
+            o[x] = (p[x] < t) ? 0 : p[x];
+          }// endfor: x
+        }// endfor: y
+      }, 1);
+
+      win.write(out, &outData[0]);
+    }// endwhile
+  }// end: threshold
+
+}// end namespace GeoStar
@@ -0,0 +1,83 @@
+// IntegralImage.hpp
+//
+// Summed-area tables: box sums, means and variances in constant time
+//----------------------------------------
+#ifndef INTEGRALIMAGE_HPP_
+#define INTEGRALIMAGE_HPP_
+
+#include <vector>
+
+#include "Kernel.hpp"
+
+namespace GeoStar {
+  class Raster;
+
+  /** \brief IntegralImage -- summed-area tables and the box statistics they give in O(1)
+
+  Pixel (x,y) of the integral image of a raster is the sum of all its pixels (x',y') with x' <= x
+  and y' <= y, and of its integral squares the sum of their squares.  The sum over any rectangle is
+  then four lookups whatever its size, and with the squares its mean and variance.  build makes
+  both in one pass; an IntegralImage made on them answers boxSum, boxMean and boxVariance.  The
+  local-mean thresholds (Niblack, Sauvola) use the same tables, band by band in memory, so a
+  101x101 window costs what a 3x3 does.
+
+  \see Raster::integralImage, Raster::integralSquares, Raster::niblackThresh, Raster::sauvolaThresh,
+  Neighborhood
+
+  \Par Example
+	the mean and variance of a 200 x 100 box, from tables made once:
+	\code
+	GeoStar::Raster *sums = img->create_raster("sums", GeoStar::REAL64, ras->get_nx(), ras->get_ny());
+	GeoStar::Raster *squares = img->create_raster("squares", GeoStar::REAL64, ras->get_nx(), ras->get_ny());
+	GeoStar::IntegralImage::build(ras, sums, squares);
+	sums->load();
+	squares->load();
+	GeoStar::IntegralImage table(sums, squares);
+	double m = table.boxMean(1000, 500, 1199, 599), v = table.boxVariance(1000, 500, 1199, 599);
+	\endcode
+
+  \Par Details
+	build reads the raster once in bands of rows: the rows of a band are summed along in parallel,
+	and then the columns, in strips, down the band starting from the last row of the band before.
+	The tables should be REAL64 rasters: anything narrower loses the low digits of the sums.  A
+	box query reads its four corners through the rasters, so load them (Raster::load) before many
+	queries.  The thresholds do not keep tables: each band of rows, with its margin, is summed in
+	memory around its mean, which keeps the variances accurate on bright scenes.
+  */
+  class IntegralImage {
+
+  public:
+    enum Method { NIBLACK, SAUVOLA };
+
+    // the integral image and integral squares of in; either output may be NULL.  Outputs are the
+    // size of in.
+    static void build(const Raster *in, Raster *sums, Raster *squares);
+
+    // queries on tables made by build; squares may be NULL if boxVariance is not used
+    IntegralImage(const Raster *sums, const Raster *squares = NULL);
+
+    // the sum, mean and variance of the pixels x0..x1, y0..y1 (inclusive), clipped to the raster
+    double boxSum(const long int &x0, const long int &y0, const long int &x1, const long int &y1) const;
+    double boxMean(const long int &x0, const long int &y0, const long int &x1, const long int &y1) const;
+    double boxVariance(const long int &x0, const long int &y0, const long int &x1, const long int &y1) const;
+
+    // out = in where in is at least the local threshold of the n x n window around the pixel, and
+    // 0 elsewhere.  Niblack: mean + k*stddev.  Sauvola: mean * (1 + k*(stddev/range - 1)).
+    static void threshold(const Raster *in, Raster *out, const Method &method, const long int &n,
+                          const double &k, const double &range, const BorderMode &border);
+
+  private:
+    const Raster *sums, *squares;
+    long int nx, ny;
+
+    // the clipped box; false if it is empty
+    bool clip(long int *box) const;
+
+    // the box total of one table
+    double total(const Raster *table, const long int *box) const;
+
+  }; // end class: IntegralImage
+
+}// end namespace GeoStar
+
+#endif //INTEGRALIMAGE_HPP_
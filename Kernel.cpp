@@ -0,0 +1,342 @@
+// Kernel.cpp
+//
+// Implementation of the convolution kernels and engine
+// Documentation in Kernel.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "Kernel.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GEOSTAR_KERNEL_AVX2
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GEOSTAR_KERNEL_NEON
+#endif
+
+namespace GeoStar {
+
+  namespace {
+
+    // acc[i] += w*src[i] for i in [0,n): the inner loop of every pass
+    typedef void (*AxpyFunction)(double *acc, const double *src, const double w, const long int n);
+
+    void axpyPlain(double *acc, const double *src, const double w, const long int n) {
+      for(long int i=0; i<n; ++i) acc[i] += w*src[i];
+    }// end: axpyPlain
+
+#ifdef GEOSTAR_KERNEL_AVX2
+    __attribute__((target("avx2,fma")))
+    void axpyAVX2(double *acc, const double *src, const double w, const long int n) {
+      const __m256d vw = _mm256_set1_pd(w);
+      long int i = 0;
+      for(; i+8<=n; i+=8) {
+        __m256d a0 = _mm256_loadu_pd(acc+i);
+        __m256d a1 = _mm256_loadu_pd(acc+i+4);
+        a0 = _mm256_fmadd_pd(vw, _mm256_loadu_pd(src+i), a0);
+        a1 = _mm256_fmadd_pd(vw, _mm256_loadu_pd(src+i+4), a1);
+        _mm256_storeu_pd(acc+i, a0);
+        _mm256_storeu_pd(acc+i+4, a1);
+      }// endfor: i
+      for(; i<n; ++i) acc[i] += w*src[i];
+    }// end: axpyAVX2
+#endif
+
+#ifdef GEOSTAR_KERNEL_NEON
+    void axpyNEON(double *acc, const double *src, const double w, const long int n) {
+      const float64x2_t vw = vdupq_n_f64(w);
+      long int i = 0;
+      for(; i+4<=n; i+=4) {
+        float64x2_t a0 = vld1q_f64(acc+i);
+        float64x2_t a1 = vld1q_f64(acc+i+2);
+        a0 = vfmaq_f64(a0, vw, vld1q_f64(src+i));
+        a1 = vfmaq_f64(a1, vw, vld1q_f64(src+i+2));
+        vst1q_f64(acc+i, a0);
+        vst1q_f64(acc+i+2, a1);
+      }// endfor: i
+      for(; i<n; ++i) acc[i] += w*src[i];
+    }// end: axpyNEON
+#endif
+
+    // the best loop this CPU can run
+    AxpyFunction axpyFunction() {
+#ifdef GEOSTAR_KERNEL_AVX2
+      static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+      if(avx2) return axpyAVX2;
+#endif
+#ifdef GEOSTAR_KERNEL_NEON
+      return axpyNEON;
+#endif
+      return axpyPlain;
+    }// end: axpyFunction
+
+
+    // the source pixel behind index i of the upsampled line: with up = 2 source pixel k sits
+    // at 2k+1 and the even positions are zeros.
+    inline long int sourceIndex(const long int &i, const long int &n, const int &up,
+                                const BorderMode &border) {
+      long int m = borderIndex(i, n*up, border);
+      if(m < 0 || up == 1) return m;
+      return (m % 2) ? m/2 : -1;
+    }
+
+
+  }// end anonymous namespace
+
+
+
+  long int borderIndex(long int i, const long int &n, const BorderMode &border) {
+    if(i >= 0 && i < n) return i;
+    switch(border) {
+    case BORDER_ZERO:
+      return -1;
+    case BORDER_REPLICATE:
+      return (i < 0) ? 0 : n-1;
+    case BORDER_WRAP:
+      i %= n;
+      return (i < 0) ? i+n : i;
+    default: {
+      if(n == 1) return 0;
+      const long int period = 2*(n-1);
+      i %= period;
+      if(i < 0) i += period;
+      return (i < n) ? i : period-i;
+    }
+    }// end: switch
+  }// end: borderIndex
+
+
+
+  Kernel::Kernel(const long int &nx, const long int &ny, const std::vector<double> &weights)
+    : nx(nx), ny(ny), weights(weights), separable_(false) {
+    KernelSizeException KernelSizeError;
+    if(nx < 1 || ny < 1 || (long int)weights.size() != nx*ny) throw KernelSizeError;
+    factor();
+  }// end-Kernel-constructor
+
+
+  Kernel Kernel::separable(const std::vector<double> &row, const std::vector<double> &col) {
+    const long int nx = row.size();
+    const long int ny = col.size();
+    std::vector<double> w(nx*ny);
+    for(long int y=0; y<ny; ++y) {
+      for(long int x=0; x<nx; ++x) w[y*nx + x] = col[y]*row[x];
+    }// endfor: y
+    return Kernel(nx, ny, w);
+  }// end: separable
+
+
+  Kernel Kernel::binomial(const int &n) {
+    KernelSizeException KernelSizeError;
+    if(n < 1) throw KernelSizeError;
+    std::vector<double> b(1, 1.0);
+    for(int i=1; i<n; ++i) {
+      std::vector<double> next(i+1, 1.0);
+      for(int j=1; j<i; ++j) next[j] = b[j-1] + b[j];
+      b.swap(next);
+    }// endfor: i
+    const double sum = std::pow(2.0, n-1);
+    for(size_t i=0; i<b.size(); ++i) b[i] /= sum;
+    return separable(b, b);
+  }// end: binomial
+
+
+  Kernel Kernel::scaled(const double &s) const {
+    std::vector<double> w(weights);
+    for(size_t i=0; i<w.size(); ++i) w[i] *= s;
+    return Kernel(nx, ny, w);
+  }// end: scaled
+
+
+  // a kernel is separable when it has rank one: every row is a multiple of the row holding
+  // the largest weight.
+  void Kernel::factor() {
+    separable_ = false;
+    row.clear();
+    col.clear();
+
+    long int peak = 0;
+    for(long int i=1; i<nx*ny; ++i) {
+      if(std::fabs(weights[i]) > std::fabs(weights[peak])) peak = i;
+    }
+    const double big = weights[peak];
+    if(big == 0.0) return;
+
+    const long int px = peak % nx;
+    const long int py = peak / nx;
+    std::vector<double> r(nx), c(ny);
+    for(long int x=0; x<nx; ++x) r[x] = weights[py*nx + x];
+    for(long int y=0; y<ny; ++y) c[y] = weights[y*nx + px] / big;
+
+    const double tol = 1e-12 * std::fabs(big);
+    for(long int y=0; y<ny; ++y) {
+      for(long int x=0; x<nx; ++x) {
+        if(std::fabs(c[y]*r[x] - weights[y*nx + x]) > tol) return;
+      }
+    }// endfor: y
+
+    separable_ = true;
+    row.swap(r);
+    col.swap(c);
+  }// end: factor
+
+
+
+  void Kernel::apply(const Raster *in, Raster *out, const BorderMode &border,
+                     const int &up, const int &down) const {
+    GEOSTAR_PROFILE_SCOPE("Kernel::apply");
+    RasterSizeErrorException RasterSizeError;
+    IntegerParameterException IntegerParameterError;
+    if(up < 1 || up > 2 || down < 1 || down > 2) throw IntegerParameterError;
+
+    const long int inNx = in->get_nx();
+    const long int inNy = in->get_ny();
+    const long int vnx = inNx*up;          // size after upsampling
+    const long int vny = inNy*up;
+    const long int outNx = vnx/down;
+    const long int outNy = vny/down;
+    if(out->get_nx() != outNx || out->get_ny() != outNy) throw RasterSizeError;
+    if(outNx == 0 || outNy == 0) return;
+
+    const AxpyFunction axpy = axpyFunction();
+
+    // flipped taps, so both passes are correlations; (ax,ay) is the centre of the flipped kernel
+    const long int ax = nx-1 - nx/2;
+    const long int ay = ny-1 - ny/2;
+    std::vector<double> taps(nx*ny);            // 2-D, or col in [0,ny) and row in [ny,ny+nx)
+    if(separable_) {
+      taps.resize(nx+ny);
+      for(long int i=0; i<ny; ++i) taps[i] = col[ny-1-i];
+      for(long int j=0; j<nx; ++j) taps[ny+j] = row[nx-1-j];
+    } else {
+      for(long int i=0; i<ny; ++i) {
+        for(long int j=0; j<nx; ++j) taps[i*nx + j] = weights[(ny-1-i)*nx + (nx-1-j)];
+      }
+    }// endif
+
+    // a padded row holds pixel u of the upsampled row at u+ax; columns are found once
+    const long int padNx = vnx + nx - 1;
+    std::vector<long int> xsource(padNx);
+    for(long int q=0; q<padNx; ++q) xsource[q] = sourceIndex(q-ax, inNx, up, border);
+
+    // the rolling window: one filtered row per source row still needed.  A separable kernel
+    // keeps rows filtered along x and decimated, a 2-D one keeps the padded rows.
+    const long int stageNx = separable_ ? outNx : padNx;
+    std::map<long int, std::vector<double> > window;
+
+    long int band = out->get_chunk_ny();
+    if(band <= 0) band = std::max(1L, std::min(outNy, (1L << 20) / outNx));
+
+    std::vector<double> outData(band*outNx);
+    std::vector<const double *> rowPtr(band*ny);
+    std::vector<double> raw;
+
+    for(long int y0=0; y0<outNy; y0+=band) {
+      const long int rows = std::min(band, outNy-y0);
+
+      // source rows behind each tap of each output row in the band
+      std::vector<long int> srcRow(rows*ny);
+      std::vector<long int> need;
+      for(long int y=0; y<rows; ++y) {
+        const long int vy = down*(y0+y) + down-1;
+        for(long int i=0; i<ny; ++i) {
+          long int s = sourceIndex(vy-ay+i, inNy, up, border);
+          srcRow[y*ny + i] = s;
+          if(s >= 0) need.push_back(s);
+        }
+      }// endfor: y
+      std::sort(need.begin(), need.end());
+      need.erase(std::unique(need.begin(), need.end()), need.end());
+
+      // drop rows that have scrolled out, and find the ones to make
+      for(std::map<long int, std::vector<double> >::iterator it=window.begin(); it!=window.end(); ) {
+        if(std::binary_search(need.begin(), need.end(), it->first)) ++it;
+        else window.erase(it++);
+      }
+      std::vector<long int> missing;
+      for(size_t k=0; k<need.size(); ++k) {
+        if(window.find(need[k]) == window.end()) missing.push_back(need[k]);
+      }
+
+      // one read per run of consecutive rows
+      raw.resize(missing.size()*inNx);
+      for(size_t k=0; k<missing.size(); ) {
+        size_t end = k+1;
+        while(end < missing.size() && missing[end] == missing[end-1]+1) ++end;
+        in->read(Slice(0, missing[k], inNx, end-k), &raw[k*inNx]);
+        k = end;
+      }// endfor: k
+
+      std::vector<std::vector<double> *> made(missing.size());
+      for(size_t k=0; k<missing.size(); ++k) {
+        made[k] = &window[missing[k]];
+        made[k]->assign(stageNx, 0.0);
+      }
+
+      // filter the new rows along x
+      parallel_for(missing.size(), [&](long int begin, long int end) {
+        std::vector<double> pad(padNx), full(vnx);
+        for(long int k=begin; k<end; ++k) {
+          const double *src = &raw[k*inNx];
+          double *stage = &(*made[k])[0];
+          double *p = separable_ ? &pad[0] : stage;
+          for(long int q=0; q<padNx; ++q) p[q] = (xsource[q] < 0) ? 0.0 : src[xsource[q]];
+          if(!separable_) continue;
+
+          if(down == 1) {
+            for(long int j=0; j<nx; ++j) axpy(stage, p+j, taps[ny+j], vnx);
+          } else {
+            std::fill(full.begin(), full.end(), 0.0);
+            for(long int j=0; j<nx; ++j) axpy(&full[0], p+j, taps[ny+j], vnx);
+            for(long int x=0; x<outNx; ++x) stage[x] = full[down*x + down-1];
+          }
+        }// endfor: k
+      }, 1);
+
+      for(long int k=0; k<rows*ny; ++k) {
+        rowPtr[k] = (srcRow[k] < 0) ? NULL : &window[srcRow[k]][0];
+      }
+
+      // then down the columns, one output row at a time
+      parallel_for(rows, [&](long int begin, long int end) {
+        std::vector<double> full;
+        if(!separable_) full.resize(vnx);
+        for(long int y=begin; y<end; ++y) {
+          double *acc = &outData[y*outNx];
+          std::fill(acc, acc+outNx, 0.0);
+          if(separable_) {
+            for(long int i=0; i<ny; ++i) {
+              if(rowPtr[y*ny + i]) axpy(acc, rowPtr[y*ny + i], taps[i], outNx);
+            }
+            continue;
+          }
+          double *sum = (down == 1) ? acc : &full[0];
+          if(down != 1) std::fill(full.begin(), full.end(), 0.0);
+          for(long int i=0; i<ny; ++i) {
+            if(!rowPtr[y*ny + i]) continue;
+            for(long int j=0; j<nx; ++j) axpy(sum, rowPtr[y*ny + i] + j, taps[i*nx + j], vnx);
+          }
+          if(down != 1) {
+            for(long int x=0; x<outNx; ++x) acc[x] = full[down*x + down-1];
+          }
+        }// endfor: y
+      }, 1);
+
+      out->write(Slice(0, y0, outNx, rows), &outData[0]);
+    }// endfor: y0
+  }// end: apply
+
+}// end namespace GeoStar
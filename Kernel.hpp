@@ -0,0 +1,103 @@
+// Kernel.hpp
+//
+// Convolution kernels and the banded convolution engine behind Raster::convolve
+//----------------------------------------
+#ifndef KERNEL_HPP_
+#define KERNEL_HPP_
+
+#include <vector>
+
+namespace GeoStar {
+  class Raster;
+
+  // how pixels outside the raster are made up when the kernel hangs over an edge.
+  // for a row a b c d:
+  //   BORDER_ZERO       0 0 | a b c d | 0 0
+  //   BORDER_REPLICATE  a a | a b c d | d d
+  //   BORDER_REFLECT    c b | a b c d | c b     (mirrored about the edge pixel)
+  //   BORDER_WRAP       c d | a b c d | a b
+  enum BorderMode { BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT, BORDER_WRAP };
+
+  // the pixel that stands in for index i of a line of n pixels, or -1 for a zero
+  long int borderIndex(long int i, const long int &n, const BorderMode &border);
+
+
+  /** \brief Kernel -- a 2-D convolution kernel
+
+  Holds the weights of a nx by ny convolution kernel, centred on pixel (nx/2, ny/2).  When the
+  kernel is the outer product of a column and a row it is found to be separable, and
+  Raster::convolve runs it as two 1-D passes: nx+ny multiply-adds per pixel instead of nx*ny.
+
+  \see Raster::convolve, Raster::downsample, Raster::upsample, Raster::gradientMask
+
+  \Par Example
+	a 5x5 binomial blur, and a Sobel edge detector that is found to be separable:
+	\code
+	GeoStar::Kernel blur = GeoStar::Kernel::binomial(5);
+	ras->convolve(blur, rasBlur);
+
+	double sobel[9] = {-1, 0, 1,
+	                   -2, 0, 2,
+	                   -1, 0, 1};
+	GeoStar::Kernel edge(3, 3, std::vector<double>(sobel, sobel+9));
+	ras->convolve(edge, rasEdge, GeoStar::BORDER_REPLICATE);
+	\endcode
+
+  \Par Details
+	Weights are stored row-major, ny rows of nx.  The result is a true convolution, so the kernel
+	is flipped relative to a correlation; for the usual symmetric kernels that makes no difference.
+
+	The engine works down the raster in bands of output rows.  Each input row is read once,
+	filtered along the row, and kept in a rolling window of filtered rows until the last output
+	row that needs it has been made, so a pass costs one read and one write of the raster however
+	large the kernel.  Filtering is spread over File::set_num_threads threads, and the inner
+	multiply-add loops use AVX2/FMA on x86 CPUs that have it (chosen at run time) and NEON on
+	64-bit ARM, with a plain loop everywhere else.
+  */
+  class Kernel {
+
+  public:
+    // a nx by ny kernel; weights holds ny rows of nx values
+    Kernel(const long int &nx, const long int &ny, const std::vector<double> &weights);
+
+    // the outer product col * row: a row.size() by col.size() kernel
+    static Kernel separable(const std::vector<double> &row, const std::vector<double> &col);
+
+    // the n by n binomial (Gaussian) kernel, normalized to sum to one.  binomial(5) is the
+    // 1 4 6 4 1 kernel of the Gaussian pyramid.
+    static Kernel binomial(const int &n);
+
+    inline long int get_nx() const { return nx; }
+    inline long int get_ny() const { return ny; }
+
+    // weight (x,y)
+    inline double at(const long int &x, const long int &y) const { return weights[y*nx + x]; }
+
+    // every weight multiplied by s
+    Kernel scaled(const double &s) const;
+
+    // true if the kernel is col * row; the factors are then given by get_row and get_col
+    inline bool is_separable() const { return separable_; }
+    inline const std::vector<double> &get_row() const { return row; }
+    inline const std::vector<double> &get_col() const { return col; }
+
+    // the engine: convolves in, upsampled by up with zeros between its pixels, then keeps every
+    // down-th pixel, and writes the result to out.  out must be (nx*up)/down by (ny*up)/down.
+    // up and down are 1 or 2; Raster::convolve, downsample and upsample are built on this.
+    void apply(const Raster *in, Raster *out, const BorderMode &border,
+               const int &up = 1, const int &down = 1) const;
+
+  private:
+    long int nx, ny;
+    std::vector<double> weights;
+
+    bool separable_;
+    std::vector<double> row, col;
+
+    void factor();
+
+  }; // end class: Kernel
+
+}// end namespace GeoStar
+
+#endif //KERNEL_HPP_
@@ -0,0 +1,244 @@
+// LUT.cpp
+//
+// Implementation of the lookup tables
+// Documentation in LUT.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <stdint.h>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "LUT.hpp"
+#include "PixelConvert.hpp"
+#include "ThreadPool.hpp"
+#include "BlockStream.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    // entry k of the table is the result for the In pixel whose bits are k
+    template<typename In, typename Out>
+    void buildTable(const LUT &lut, std::vector<Out> &table) {
+      typedef typename std::make_unsigned<In>::type Bits;
+      const size_t entries = (size_t)std::numeric_limits<Bits>::max() + 1;
+      std::vector<double> values(entries);
+      for(size_t k=0; k<entries; ++k) values[k] = lut((double)(In)(Bits)k);
+      table.resize(entries);
+      PixelConvert::convert(&values[0], H5::PredType::NATIVE_DOUBLE, &table[0], Raster::getHdf5Type<Out>(),
+                            entries);
+    }// end: buildTable
+
+
+    // four independent lookups at a time; in may be out
+    template<typename In, typename Out>
+    inline void lookup(const In *in, Out *out, const long int &n, const Out *table) {
+      typedef typename std::make_unsigned<In>::type Bits;
+      long int i = 0;
+      for(; i+4<=n; i+=4) {
+        const Out a = table[(Bits)in[i]], b = table[(Bits)in[i+1]];
+        const Out c = table[(Bits)in[i+2]], d = table[(Bits)in[i+3]];
+        out[i] = a;
+        out[i+1] = b;
+        out[i+2] = c;
+        out[i+3] = d;
+      }// endfor: i
+      for(; i<n; ++i) out[i] = table[(Bits)in[i]];
+    }// end: lookup
+
+
+    // one type in and out: looked up in place, the I/O overlapped by a BlockStream
+    template<typename In, typename Out>
+    void applyTable(const Raster *in, Raster *out, const std::vector<Out> &table, std::true_type) {
+      BlockStream<In> stream(in, std::vector<const Raster *>(1, in), 1, out, 0);
+      stream.run([&](typename BlockStream<In>::Block &b) {
+          In *data = &b.slots[0][0];
+          parallel_for(b.n, [&](long int begin, long int end) {
+              lookup(data + begin, data + begin, end - begin, &table[0]);
+            });
+        });
+    }// end: applyTable
+
+    // two types: each block read as In and written as Out
+    template<typename In, typename Out>
+    void applyTable(const Raster *in, Raster *out, const std::vector<Out> &table, std::false_type) {
+      Raster::BlockIterator blocks(in);
+      std::vector<In> src;
+      std::vector<Out> dst(blocks.maxSize());
+      while(blocks.next()) {
+        blocks.read(in, src);
+        parallel_for(blocks.size(), [&](long int begin, long int end) {
+            lookup(&src[begin], &dst[begin], end - begin, &table[0]);
+          });
+        blocks.write(out, dst);
+      }// endwhile
+    }// end: applyTable
+
+
+    // the jobs, run with the pixel types of the rasters
+    struct Compile {
+      const LUT &lut;
+      std::vector<char> &table;
+
+      template<typename In, typename Out>
+      void run() {
+        std::vector<Out> typed;
+        buildTable<In, Out>(lut, typed);
+        table.assign((const char *)&typed[0], (const char *)&typed[0] + typed.size()*sizeof(Out));
+      }
+    };
+
+    struct Apply {
+      const LUT &lut;
+      const Raster *in;
+      Raster *out;
+
+      template<typename In, typename Out>
+      void run() {
+        std::vector<Out> table;
+        buildTable<In, Out>(lut, table);
+        applyTable<In, Out>(in, out, table, std::is_same<In, Out>());
+      }
+    };
+
+
+    template<typename Job, typename In>
+    void dispatchOut(const RasterType &out, Job &job) {
+      DataTypeException DataTypeError;
+      switch(out) {
+      case INT8U:  job.template run<In, uint8_t>(); break;
+      case INT8S:  job.template run<In, int8_t>(); break;
+      case INT16U: job.template run<In, uint16_t>(); break;
+      case INT16S: job.template run<In, int16_t>(); break;
+      case INT32U: job.template run<In, uint32_t>(); break;
+      case INT32S: job.template run<In, int32_t>(); break;
+      case INT64U: job.template run<In, uint64_t>(); break;
+      case INT64S: job.template run<In, int64_t>(); break;
+      case REAL32: job.template run<In, float>(); break;
+      case REAL64: job.template run<In, double>(); break;
+      default: throw DataTypeError;
+      }// end case
+    }// end: dispatchOut
+
+    template<typename Job>
+    void dispatch(const RasterType &in, const RasterType &out, Job &job) {
+      DataTypeException DataTypeError;
+      switch(in) {
+      case INT8U:  dispatchOut<Job, uint8_t>(out, job); break;
+      case INT8S:  dispatchOut<Job, int8_t>(out, job); break;
+      case INT16U: dispatchOut<Job, uint16_t>(out, job); break;
+      case INT16S: dispatchOut<Job, int16_t>(out, job); break;
+      default: throw DataTypeError;
+      }// end case
+    }// end: dispatch
+
+  }// end anonymous namespace
+
+
+
+  LUT::LUT() {
+  }// end: LUT
+
+
+
+  LUT &LUT::then(const Step &f) {
+    steps.push_back(f);
+    return *this;
+  }// end: then
+
+
+
+  // the float operators compare and round in float
+  LUT &LUT::threshold(const double &value) {
+    return then([value](const double &v) {
+        const float f = (float)v;
+        return (f < value) ? 0.0 : (double)f;
+      });
+  }// end: threshold
+
+
+
+  LUT &LUT::scale(const double &offset, const double &mult) {
+    return then([offset, mult](const double &v) {
+        int i = mult*((float)v - offset);
+        if(i < 0) i = 0;
+        return (double)(float)i;
+      });
+  }// end: scale
+
+
+
+  LUT &LUT::shift(const int &bits, const bool &right) {
+    const double factor = right ? 1 / pow(2, bits) : pow(2, bits);
+    return then([factor](const double &v) {
+        return (double)(float)((float)v * factor);
+      });
+  }// end: shift
+
+
+
+  LUT &LUT::linear(const double &inLow, const double &inHigh, const double &outLow,
+                   const double &outHigh) {
+    const double mult = inHigh > inLow ? (outHigh - outLow) / (inHigh - inLow) : 0;
+    const double lo = std::min(outLow, outHigh), hi = std::max(outLow, outHigh);
+    return then([=](const double &v) {
+        double r = outLow + mult * (v - inLow);
+        if(r < lo) r = lo;
+        if(r > hi) r = hi;
+        return r;
+      });
+  }// end: linear
+
+
+
+  LUT &LUT::gamma(const double &g, const double &inLow, const double &inHigh, const double &outLow,
+                  const double &outHigh) {
+    const double width = inHigh - inLow;
+    return then([=](const double &v) {
+        double t = width > 0 ? (v - inLow) / width : 0;
+        if(t < 0) t = 0;
+        if(t > 1) t = 1;
+        return outLow + (outHigh - outLow) * std::pow(t, g);
+      });
+  }// end: gamma
+
+
+
+  double LUT::operator()(const double &v) const {
+    double r = v;
+    for(size_t i=0; i<steps.size(); ++i) r = steps[i](r);
+    return r;
+  }// end: operator()
+
+
+
+  bool LUT::supported(const RasterType &in) {
+    return in == INT8U || in == INT8S || in == INT16U || in == INT16S;
+  }// end: supported
+
+
+
+  void LUT::compile(const RasterType &in, const RasterType &out, std::vector<char> &table) const {
+    Compile job = {*this, table};
+    dispatch(in, out, job);
+  }// end: compile
+
+
+
+  void LUT::apply(const Raster *in, Raster *out) const {
+    GEOSTAR_PROFILE_SCOPE("LUT::apply");
+    RasterSizeErrorException RasterSizeError;
+    if(in->get_nx() != out->get_nx() || in->get_ny() != out->get_ny()) throw RasterSizeError;
+    Apply job = {*this, in, out};
+    dispatch(in->get_datatype(), out->get_datatype(), job);
+  }// end: apply
+
+}// end namespace GeoStar
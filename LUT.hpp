@@ -0,0 +1,92 @@
+// LUT.hpp
+//
+// Point operations on integer rasters, compiled into lookup tables
+//----------------------------------------
+#ifndef LUT_HPP_
+#define LUT_HPP_
+
+#include <vector>
+#include <functional>
+
+#include "RasterType.hpp"
+
+namespace GeoStar {
+  class Raster;
+
+  /** \brief LUT -- a chain of point operations, applied to integer rasters through one table
+
+  A point operation maps each pixel value to a new one on its own, and an 8 or 16-bit raster has
+  at most 65,536 values.  A LUT is a list of steps (threshold, scale, shift, a linear or gamma
+  stretch, or any function) that is evaluated once for every possible input value, into a table
+  of output pixels in the output raster's type.  Applying it is then one table lookup per pixel
+  on the pixels as stored, with no conversion to float and back, so a chain of five steps costs
+  what one does.
+
+  \see Raster::applyLUT, Raster::thresh, Raster::scale, Raster::bitShift, Raster::stretch
+
+  \Par Example
+	a 16-bit Landsat band to an 8-bit display band, contrast stretched with a gamma of 0.8:
+	\code
+	GeoStar::Raster *out = img->create_raster("B4_8bit", GeoStar::INT8U, ras->get_nx(), ras->get_ny());
+	ras->applyLUT(GeoStar::LUT().threshold(5000).gamma(0.8, 5000, 25000, 0, 255), out);
+	\endcode
+
+  \Par Details
+	Steps run in the order they were added, each on the result of the one before, in double.
+	threshold, scale and shift round their result to float, as the float operators do, so a one
+	step LUT writes exactly what thresh, scale or bitShift write.  The last result is converted to
+	the output type as a write of doubles would be (PixelConvert): truncated, saturated at the
+	limits, NaN to 0.  Only INT8U, INT8S, INT16U and INT16S inputs have tables (256 or 65,536
+	entries); the output may be any real type.  The raster is streamed block by block, the lookups
+	spread over the File::set_num_threads pool.
+  */
+  class LUT {
+
+  public:
+    typedef std::function<double(const double &)> Step;
+
+    // the identity
+    LUT();
+
+    // v -> f(v)
+    LUT &then(const Step &f);
+
+    // v -> 0 if v < value, else v (Raster::thresh)
+    LUT &threshold(const double &value);
+
+    // v -> max(0, (int)(mult*(v-offset))) (Raster::scale)
+    LUT &scale(const double &offset, const double &mult);
+
+    // v -> v / 2^bits when right is set, v * 2^bits otherwise (Raster::bitShift)
+    LUT &shift(const int &bits, const bool &right);
+
+    // inLow .. inHigh onto outLow .. outHigh, clipped to the output range (Raster::stretch)
+    LUT &linear(const double &inLow, const double &inHigh, const double &outLow, const double &outHigh);
+
+    // as linear, through the curve t -> t^g of the clipped, normalised input t
+    LUT &gamma(const double &g, const double &inLow, const double &inHigh, const double &outLow,
+               const double &outHigh);
+
+    // the chain applied to one value
+    double operator()(const double &v) const;
+
+    inline size_t size() const { return steps.size(); }
+
+    // whether rasters of this type can be looked up
+    static bool supported(const RasterType &in);
+
+    // the table for input type in and output type out: entry k holds, as an out pixel, the
+    // result for the in pixel whose bits are k.  table is resized to entries * pixel size
+    void compile(const RasterType &in, const RasterType &out, std::vector<char> &table) const;
+
+    // out = the chain of in, pixel by pixel; out may be in
+    void apply(const Raster *in, Raster *out) const;
+
+  private:
+    std::vector<Step> steps;
+
+  }; // end class: LUT
+
+}// end namespace GeoStar
+
+#endif //LUT_HPP_
@@ -7,8 +7,16 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include "H5Cpp.h"
 #include "Exceptions.hpp"
 #include "Map.hpp"
+#include "Raster.hpp"
+#include "PixelConvert.hpp"
+#include "LUT.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
 #include "/usr/local/include/cairo/cairo.h"
 #include "/usr/local/include/cairo/cairo-pdf.h"
 
@@ -144,6 +152,87 @@ namespace GeoStar {
 
   }//end - addLatLongGrid
 
+  void Map::drawRaster(const Raster &ras, const Slice &window, size_t x, size_t y,
+		size_t width, size_t height, double low, double high,
+		const std::vector<uint32_t> &colormap, const std::vector<Raster *> &levels) {
+	GEOSTAR_PROFILE_SCOPE("Map::drawRaster");
+	MapSizeException MapSizeError;
+	SliceSizeException SliceSizeError;
+	if (width == 0 || height == 0) throw MapSizeError;
+	if (colormap.size() != 0 && colormap.size() != 256) throw SliceSizeError;
+
+	//the pixels, from the coarsest level that will do
+	std::vector<float> vals;
+	if (levels.empty()) ras.readWindow(window, width, height, vals);
+	else ras.readWindow(window, width, height, vals, levels);
+
+	if (!(low < high)) {
+	  Raster::Statistics stats = ras.statistics();
+	  low = stats.min;
+	  high = stats.max;
+	  if (!(low < high)) high = low + 1;
+	}
+
+	//colormap entries, premultiplied for cairo; grey levels without one
+	uint32_t lut[256];
+	for (int k = 0; k < 256; ++k) {
+	  const uint32_t c = colormap.empty() ? (0xff000000u | (k << 16) | (k << 8) | k) : colormap[k];
+	  const uint32_t a = c >> 24;
+	  const uint32_t r = ((c >> 16) & 0xff) * a / 255, g = ((c >> 8) & 0xff) * a / 255, b = (c & 0xff) * a / 255;
+	  lut[k] = (a << 24) | (r << 16) | (g << 8) | b;
+	}
+
+	//an integer raster has few enough values that each gets its pixel, stretched and coloured, at once
+	std::vector<uint32_t> valueLut;
+	if (LUT::supported(ras.get_datatype())) {
+	  std::vector<char> index;
+	  LUT().linear(low, high, 0, 255).compile(ras.get_datatype(), INT8U, index);
+	  valueLut.resize(index.size());
+	  for (size_t k = 0; k < index.size(); ++k) valueLut[k] = lut[(unsigned char)index[k]];
+	}
+	const long int valueMask = (long int)valueLut.size() - 1;
+
+	//straight into an image map, through a surface the size of the rectangle on a pdf
+	const bool direct = cairo_surface_get_type(image) == CAIRO_SURFACE_TYPE_IMAGE;
+	if (direct && (x >= sizeX || y >= sizeY)) return;
+	cairo_surface_t *target = direct ? image : cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	const size_t ox = direct ? x : 0, oy = direct ? y : 0;
+	const size_t w = direct ? std::min(width, sizeX - x) : width;
+	const size_t h = direct ? std::min(height, sizeY - y) : height;
+	cairo_surface_flush(target);
+	unsigned char *pixels = cairo_image_surface_get_data(target);
+	const int stride = cairo_image_surface_get_stride(target);
+
+	const double s = 255.0 / (high - low);
+	std::vector<unsigned char> idx(h * w);
+	parallel_for(h, [&](long int begin, long int end) {
+	  for (long int j = begin; j < end; ++j) {
+	    const float *v = &vals[j * width];
+	    uint32_t *out = (uint32_t *)(pixels + (oy + j) * stride) + ox;
+	    if (!valueLut.empty()) {
+	      //the value's bits index the table, for signed types too
+	      for (size_t i = 0; i < w; ++i) out[i] = valueLut[(long int)v[i] & valueMask];
+	      continue;
+	    }
+	    unsigned char *q = &idx[j * w];
+	    PixelConvert::convert(v, H5::PredType::NATIVE_FLOAT, q, H5::PredType::NATIVE_UINT8, w,
+				  s, -low * s);
+	    for (size_t i = 0; i < w; ++i) out[i] = (v[i] == v[i]) ? lut[q[i]] : 0;
+	  }//endfor - j
+	}, 16);
+
+	if (direct) {
+	  cairo_surface_mark_dirty_rectangle(image, x, y, w, h);
+	} else {
+	  cairo_surface_mark_dirty(target);
+	  cairo_t *cr = cairo_create(image);
+	  cairo_set_source_surface(cr, target, x, y);
+	  cairo_paint(cr);
+	  cairo_destroy(cr);
+	  cairo_surface_destroy(target);
+	}
+  }//end - drawRaster
+
    
 
 }//end - namespace GeoStar
@@ -9,11 +9,14 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <stdint.h>
 #include "Exceptions.hpp"
 #include "/usr/local/include/cairo/cairo.h"
 #include "/usr/local/include/cairo/cairo-pdf.h"
 
 namespace GeoStar {
+  class Raster;
+  struct Slice;
 
 /** \brief Map -- Data structure for creating maps
 
@@ -26,7 +29,7 @@ It employs a range of drawing techniques and will output to a PNG or PDF format
 At the moment, this class operates seperately from the file->image->raster heirarchy of GeoStar
 and the HDF5 library.
 
-All operations in this class require the raw map image in png format to create the map
+The image comes either from a png file (readPNG) or straight from a GeoStar Raster (drawRaster).
 
 They also require the latitude/longitude of the image so that proper labels can be generated.
 
@@ -417,6 +420,71 @@ public:
    void addLatLongGrid(double latTop, double longTop, 
 			double latBottom, double longBottom);
 
+/** \brief drawRaster() -- draws a window of a raster onto the map
+
+    This function puts the pixels of a window of a Raster into a rectangle of the map,
+	stretched from [low, high] onto 0 .. 255 and coloured through a 256-entry colormap,
+	without going through a png file.
+
+    \see readPNG(), Raster::readWindow, Raster::buildOverviews, Raster::statistics
+
+    \param[in] ras
+	The raster to draw.
+
+    \param[in] window
+	The part of the raster to draw, in pixels of ras.
+
+    \param[in] x, y
+	The upper left hand corner of the rectangle on the map.
+
+    \param[in] width, height
+	The size of the rectangle on the map.
+
+    \param[in] low, high
+	The pixel values drawn as colormap entries 0 and 255; values outside are clipped.  If low
+	is not below high, the minimum and maximum of the raster are used.
+
+    \param[in] colormap
+	256 colours, 0xAARRGGBB.  Empty for grey levels.
+
+    \param[in] levels
+	Reduced-resolution copies of ras, such as levels 1 .. n of ras->gaussianPyramid.  Empty
+	to use the overviews stored by Raster::buildOverviews, if there are any.
+
+    \returns
+	nothing
+
+    \Par Exceptions
+	MapSizeException if the rectangle is empty, SliceSizeException if the window is empty or
+	reaches outside ras, or if the colormap does not have 256 entries.
+
+    \Par Example
+	A Landsat band at 1/8 of its size, its overviews doing the reduction:
+	\code
+	ras->buildOverviews();
+	GeoStar::Map *map = new GeoStar::Map(1100, 1200);
+	map->drawRaster(*ras, GeoStar::Slice(0, 0, ras->get_nx(), ras->get_ny()),
+	                100, 100, ras->get_nx()/8, ras->get_ny()/8, 0, 0);
+	map->writePNG("B7.png");
+	\endcode
+
+    \Par Details
+	The pixels come from Raster::readWindow: the coarsest of ras and its levels that still has
+	a pixel for every map pixel is read, and each map pixel takes the nearest of its pixels, so a
+	map an eighth the size of the raster reads the 1/8 level rather than the full raster.
+	Reading as float and stretching to 8 bits are done by PixelConvert, with its SSE2 kernels;
+	the colormap is a table lookup, and both are spread over the File::set_num_threads pool by
+	rows.  On an image
+	map the pixels go straight into the ARGB32 data of the surface; on a PDF map they go into an
+	image surface the size of the rectangle, which is then painted onto the page.  NaN pixels
+	are transparent.  Unlike readPNG, drawRaster does not change the image area used by
+	addLatLongGrid.
+    */
+   void drawRaster(const Raster &ras, const Slice &window, size_t x, size_t y,
+		   size_t width, size_t height, double low, double high,
+		   const std::vector<uint32_t> &colormap = std::vector<uint32_t>(),
+		   const std::vector<Raster *> &levels = std::vector<Raster *>());
+
    
 
 
@@ -0,0 +1,438 @@
+// Neighborhood.cpp
+//
+// Implementation of the row windows and neighborhood filters
+// Documentation in Neighborhood.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdint.h>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "Neighborhood.hpp"
+#include "TileExecutor.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    struct MinOp {
+      inline double operator()(const double &a, const double &b) const { return (b < a) ? b : a; }
+    };
+
+    struct MaxOp {
+      inline double operator()(const double &a, const double &b) const { return (b > a) ? b : a; }
+    };
+
+    // van Herk/Gil-Werman along a row: out[x] = op over p[x .. x+n-1] for x in [0,nOut).
+    // g and h are scratch of length nOut+n-1.
+    template<class Op>
+    void herkRow(const double *p, const long int &n, const long int &nOut, double *g, double *h,
+                 double *out, const Op &op) {
+      const long int len = nOut + n - 1;
+      for(long int q=0; q<len; ++q) g[q] = (q % n == 0) ? p[q] : op(g[q-1], p[q]);
+      for(long int q=len-1; q>=0; --q) h[q] = (q % n == n-1 || q == len-1) ? p[q] : op(h[q+1], p[q]);
+      for(long int x=0; x<nOut; ++x) out[x] = op(h[x], g[x+n-1]);
+    }// end: herkRow
+
+    // the same down columns [x0,x1) of rows rows of width nx: s is overwritten with the forward
+    // running values, h holds the backward ones, out gets rows-n+1 rows.
+    template<class Op>
+    void herkColumns(double *s, double *h, double *out, const long int &rows, const long int &n,
+                     const long int &nx, const long int &x0, const long int &x1, const Op &op) {
+      for(long int k=rows-1; k>=0; --k) {
+        double *hk = h + k*nx;
+        const double *sk = s + k*nx;
+        if(k % n == n-1 || k == rows-1) {
+          for(long int x=x0; x<x1; ++x) hk[x] = sk[x];
+        } else {
+          const double *hn = hk + nx;
+          for(long int x=x0; x<x1; ++x) hk[x] = op(hn[x], sk[x]);
+        }
+      }// endfor: k
+      for(long int k=1; k<rows; ++k) {
+        if(k % n == 0) continue;
+        double *sk = s + k*nx;
+        const double *sp = sk - nx;
+        for(long int x=x0; x<x1; ++x) sk[x] = op(sp[x], sk[x]);
+      }// endfor: k
+      for(long int y=0; y+n-1<rows; ++y) {
+        double *o = out + y*nx;
+        const double *hy = h + y*nx;
+        const double *gy = s + (y+n-1)*nx;
+        for(long int x=x0; x<x1; ++x) o[x] = op(hy[x], gy[x]);
+      }// endfor: y
+    }// end: herkColumns
+
+    // Perreault-Hebert median of the 8-bit pixels of a tile.  Each padded
+    // column keeps a histogram of the n rows around the current output row; the kernel histogram
+    // slides along the row by adding one column histogram and taking another away.  Counts are
+    // kept at two levels, 16 coarse bins of 16 fine bins each: the coarse kernel histogram is
+    // updated at every pixel and a fine one only when the median falls in it, so a step costs
+    // about 2*16 + 2*16 additions whatever n is.
+    void medianByte(const TileExecutor::Tile &t, const long int &n) {
+      const long int cols = t.dx + n-1;          // padded columns of the tile
+      const long int half = (n*n + 1) / 2;
+      std::vector<uint32_t> colFine(cols*256, 0), colCoarse(cols*16, 0);
+
+      // column histograms of rows 0 .. n-1 of the tile
+      for(long int k=0; k<n; ++k) {
+        const double *p = t.row(k);
+        for(long int c=0; c<cols; ++c) {
+          const int v = std::min(255, std::max(0, (int)p[c]));
+          ++colFine[c*256 + v];
+          ++colCoarse[c*16 + (v >> 4)];
+        }
+      }// endfor: k
+
+      std::vector<uint32_t> kFine(256), kCoarse(16);
+      std::vector<long int> fineAt(16);            // window start each fine bucket was made for
+
+      for(long int y=0; y<t.dy; ++y) {
+        if(y > 0) {
+          // move the column histograms down one row
+          const double *gone = t.row(y-1);
+          const double *come = t.row(y+n-1);
+          for(long int c=0; c<cols; ++c) {
+            const int a = std::min(255, std::max(0, (int)gone[c]));
+            const int b = std::min(255, std::max(0, (int)come[c]));
+            --colFine[c*256 + a];
+            --colCoarse[c*16 + (a >> 4)];
+            ++colFine[c*256 + b];
+            ++colCoarse[c*16 + (b >> 4)];
+          }
+        }// endif
+
+        std::fill(kCoarse.begin(), kCoarse.end(), 0);
+        for(long int c=0; c<n; ++c) {
+          for(int b=0; b<16; ++b) kCoarse[b] += colCoarse[c*16 + b];
+        }
+        std::fill(fineAt.begin(), fineAt.end(), -(n+1));
+
+        double *o = t.out(y);
+        for(long int x=0; x<t.dx; ++x) {
+          if(x > 0) {
+            const uint32_t *add = &colCoarse[(x+n-1)*16];
+            const uint32_t *sub = &colCoarse[(x-1)*16];
+            for(int b=0; b<16; ++b) kCoarse[b] += add[b] - sub[b];
+          }
+
+          long int count = 0;
+          int b = 0;
+          while(count + (long int)kCoarse[b] < half) count += kCoarse[b++];
+
+          // bring fine bucket b up to window start x
+          uint32_t *fine = &kFine[b*16];
+          const long int from = fineAt[b];
+          if(x - from >= n) {
+            std::fill(fine, fine+16, 0);
+            for(long int c=x; c<x+n; ++c) {
+              const uint32_t *h = &colFine[c*256 + b*16];
+              for(int i=0; i<16; ++i) fine[i] += h[i];
+            }
+          } else {
+            for(long int c=from; c<x; ++c) {
+              const uint32_t *add = &colFine[(c+n)*256 + b*16];
+              const uint32_t *sub = &colFine[c*256 + b*16];
+              for(int i=0; i<16; ++i) fine[i] += add[i] - sub[i];
+            }
+          }
+          fineAt[b] = x;
+
+          int i = 0;
+          while(count + (long int)fine[i] < half) count += fine[i++];
+          o[x] = b*16 + i;
+        }// endfor: x
+      }// endfor: y
+    }// end: medianByte
+
+    // 16-bit pixels: a sliding window histogram with 256 coarse bins over 65536 fine ones.  The
+    // window moves along the row one column at a time, so a step costs 2*n additions.
+    void medianShort(const TileExecutor::Tile &t, const long int &n) {
+      const long int half = (n*n + 1) / 2;
+      std::vector<uint32_t> fine(65536, 0), coarse(256, 0);
+
+      for(long int y=0; y<t.dy; ++y) {
+        for(long int k=0; k<n; ++k) {
+          const double *p = t.row(y+k);
+          for(long int c=0; c<n; ++c) {
+            const int v = std::min(65535, std::max(0, (int)p[c]));
+            ++fine[v];
+            ++coarse[v >> 8];
+          }
+        }// endfor: k
+
+        double *o = t.out(y);
+        for(long int x=0; x<t.dx; ++x) {
+          if(x > 0) {
+            for(long int k=0; k<n; ++k) {
+              const double *p = t.row(y+k);
+              const int a = std::min(65535, std::max(0, (int)p[x-1]));
+              const int b = std::min(65535, std::max(0, (int)p[x+n-1]));
+              --fine[a];
+              --coarse[a >> 8];
+              ++fine[b];
+              ++coarse[b >> 8];
+            }
+          }// endif
+
+          long int count = 0;
+          int b = 0;
+          while(count + (long int)coarse[b] < half) count += coarse[b++];
+          int v = b << 8;
+          while(count + (long int)fine[v] < half) count += fine[v++];
+          o[x] = v;
+        }// endfor: x
+
+        // empty the histograms for the next row
+        for(long int k=0; k<n; ++k) {
+          const double *p = t.row(y+k) + t.dx - 1;
+          for(long int c=0; c<n; ++c) {
+            const int v = std::min(65535, std::max(0, (int)p[c]));
+            --fine[v];
+            --coarse[v >> 8];
+          }
+        }// endfor: k
+      }// endfor: y
+    }// end: medianShort
+
+    // any other type: select the middle of each window
+    void medianSelect(const TileExecutor::Tile &t, const long int &n) {
+      std::vector<double> w(n*n);
+      for(long int y=0; y<t.dy; ++y) {
+        double *o = t.out(y);
+        for(long int x=0; x<t.dx; ++x) {
+          for(long int k=0; k<n; ++k) std::copy(t.row(y+k) + x, t.row(y+k) + x + n, &w[k*n]);
+          std::nth_element(w.begin(), w.begin() + n*n/2, w.end());
+          o[x] = w[n*n/2];
+        }
+      }// endfor: y
+    }// end: medianSelect
+
+  }// end anonymous namespace
+
+
+
+  RowWindow::RowWindow(const Raster *in, const long int &rx, const long int &ry,
+                       const BorderMode &border, const long int &band)
+    : in(in), nx(in->get_nx()), ny(in->get_ny()), rx(rx), ry(ry), band(band), border(border),
+      bandY0(0), bandRows(0) {
+    if(this->band <= 0) {
+      this->band = in->get_chunk_ny();
+      if(this->band <= 0 && nx > 0) this->band = (1L << 20) / nx;
+      this->band = std::max(this->band, 4*(2*ry+1));
+    }
+
+    xsource.resize(width());
+    for(long int q=0; q<width(); ++q) xsource[q] = borderIndex(q-rx, nx, border);
+    zeros.assign(width(), 0.0);
+  }// end-RowWindow-constructor
+
+
+  bool RowWindow::next() {
+    const long int start = bandY0 + bandRows;
+    if(start >= ny || nx <= 0) return false;
+    bandY0 = start;
+    bandRows = std::min(band, ny-start);
+
+    // input row behind each padded row of the band
+    const long int n = bandRows + 2*ry;
+    std::vector<long int> source(n), need;
+    for(long int k=0; k<n; ++k) {
+      source[k] = borderIndex(bandY0-ry+k, ny, border);
+      if(source[k] >= 0) need.push_back(source[k]);
+    }
+    std::sort(need.begin(), need.end());
+    need.erase(std::unique(need.begin(), need.end()), need.end());
+
+    // drop rows above the band, and read the new ones in runs
+    for(std::map<long int, std::vector<double> >::iterator it=cache.begin(); it!=cache.end(); ) {
+      if(std::binary_search(need.begin(), need.end(), it->first)) ++it;
+      else cache.erase(it++);
+    }
+    std::vector<long int> missing;
+    for(size_t k=0; k<need.size(); ++k) {
+      if(cache.find(need[k]) == cache.end()) missing.push_back(need[k]);
+    }
+
+    raw.resize(missing.size()*nx);
+    for(size_t k=0; k<missing.size(); ) {
+      size_t end = k+1;
+      while(end < missing.size() && missing[end] == missing[end-1]+1) ++end;
+      in->read(Slice(0, missing[k], nx, end-k), &raw[k*nx]);
+      k = end;
+    }// endfor: k
+
+    std::vector<double *> made(missing.size());
+    for(size_t k=0; k<missing.size(); ++k) {
+      std::vector<double> &r = cache[missing[k]];
+      r.resize(width());
+      made[k] = &r[0];
+    }
+    parallel_for(missing.size(), [&](long int begin, long int end) {
+      for(long int k=begin; k<end; ++k) {
+        const double *src = &raw[k*nx];
+        for(long int q=0; q<width(); ++q) made[k][q] = (xsource[q] < 0) ? 0.0 : src[xsource[q]];
+      }
+    }, 1);
+
+    rowPtr.resize(n);
+    for(long int k=0; k<n; ++k) rowPtr[k] = (source[k] < 0) ? &zeros[0] : &cache[source[k]][0];
+    return true;
+  }// end: next
+
+
+  void RowWindow::write(Raster *out, const double *data) const {
+    out->write(Slice(0, bandY0, out->get_nx(), bandRows), data);
+  }// end: write
+
+
+
+  void Neighborhood::filter(const Raster *in, Raster *out, const Statistic &stat, const long int &n,
+                            const BorderMode &border) {
+    GEOSTAR_PROFILE_SCOPE("Neighborhood::filter");
+    RasterSizeErrorException RasterSizeError;
+    IntegerParameterException IntegerParameterError;
+    if(n < 1 || n % 2 == 0) throw IntegerParameterError;
+
+    const long int nx = in->get_nx();
+    const long int ny = in->get_ny();
+    if(out->get_nx() != nx || out->get_ny() != ny) throw RasterSizeError;
+
+    const long int r = n/2;
+    const bool sums = (stat == MEAN || stat == HARMONIC_MEAN);
+    const bool wantMin = !sums && stat != MAXIMUM;
+    const bool wantMax = !sums && stat != MINIMUM;
+
+    // a zero pixel has no reciprocal: the harmonic mean keeps a count of the zeros in each
+    // window beside its sum of reciprocals, and is 0 where the count is not
+    const bool harmonic = (stat == HARMONIC_MEAN);
+
+    RowWindow win(in, r, r, border);
+    std::vector<double> lo, loH, hi, hiH, outData, outHi;
+    std::vector<long int> zeros;
+
+    while(win.next()) {
+      const long int rows = win.rows();
+      const long int total = rows + 2*r;
+      if(wantMin) { lo.resize(total*nx); loH.resize(total*nx); }
+      if(wantMax) { hi.resize(total*nx); hiH.resize(total*nx); }
+      if(sums) lo.resize(total*nx);
+      if(harmonic) zeros.resize(total*nx);
+      outData.resize(rows*nx);
+      if(wantMin && wantMax) outHi.resize(rows*nx);
+
+      // 1. along the rows
+      parallel_for(total, [&](long int begin, long int end) {
+        std::vector<double> g(win.width()), h(win.width());
+        for(long int k=begin; k<end; ++k) {
+          const double *p = win.row(k);
+          if(sums) {
+            double *s = &lo[k*nx];
+            double acc = 0.0;
+            if(stat == MEAN) {
+              for(long int q=0; q<n; ++q) acc += p[q];
+              s[0] = acc;
+              for(long int x=1; x<nx; ++x) s[x] = (acc += p[x+n-1] - p[x-1]);
+            } else {
+              long int *z = &zeros[k*nx];
+              long int count = 0;
+              for(long int q=0; q<n; ++q) {
+                if(p[q] == 0.0) ++count;
+                else acc += 1.0/p[q];
+              }
+              s[0] = acc;
+              z[0] = count;
+              for(long int x=1; x<nx; ++x) {
+                const double add = p[x+n-1], sub = p[x-1];
+                if(add == 0.0) ++count;
+                else acc += 1.0/add;
+                if(sub == 0.0) --count;
+                else acc -= 1.0/sub;
+                s[x] = acc;
+                z[x] = count;
+              }// endfor: x
+            }
+            continue;
+          }
+          if(wantMin) herkRow(p, n, nx, &g[0], &h[0], &lo[k*nx], MinOp());
+          if(wantMax) herkRow(p, n, nx, &g[0], &h[0], &hi[k*nx], MaxOp());
+        }// endfor: k
+      }, 1);
+
+      // 2. down the columns, in strips of columns
+      parallel_for(nx, [&](long int x0, long int x1) {
+        if(sums) {
+          std::vector<double> acc(lo.begin(), lo.begin()+nx);
+          std::vector<long int> count;
+          if(harmonic) count.assign(zeros.begin(), zeros.begin()+nx);
+          for(long int k=1; k<n; ++k) {
+            for(long int x=x0; x<x1; ++x) acc[x] += lo[k*nx + x];
+            if(harmonic) for(long int x=x0; x<x1; ++x) count[x] += zeros[k*nx + x];
+          }
+          for(long int y=0; y<rows; ++y) {
+            if(y > 0) {
+              const double *add = &lo[(y+n-1)*nx];
+              const double *sub = &lo[(y-1)*nx];
+              for(long int x=x0; x<x1; ++x) acc[x] += add[x] - sub[x];
+              if(harmonic) {
+                const long int *zadd = &zeros[(y+n-1)*nx];
+                const long int *zsub = &zeros[(y-1)*nx];
+                for(long int x=x0; x<x1; ++x) count[x] += zadd[x] - zsub[x];
+              }
+            }
+            double *o = &outData[y*nx];
+            if(stat == MEAN) for(long int x=x0; x<x1; ++x) o[x] = acc[x] / (n*n);
+            else             for(long int x=x0; x<x1; ++x) o[x] = count[x] > 0 ? 0.0 : (n*n) / acc[x];
+          }// endfor: y
+          return;
+        }
+        if(wantMin) herkColumns(&lo[0], &loH[0], &outData[0], total, n, nx, x0, x1, MinOp());
+        if(wantMax) herkColumns(&hi[0], &hiH[0], wantMin ? &outHi[0] : &outData[0], total, n, nx, x0, x1, MaxOp());
+        if(stat == RANGE) {
+          for(long int i=0; i<rows; ++i) {
+            for(long int x=x0; x<x1; ++x) outData[i*nx + x] = outHi[i*nx + x] - outData[i*nx + x];
+          }
+        } else if(stat == MIDPOINT) {
+          for(long int i=0; i<rows; ++i) {
+            for(long int x=x0; x<x1; ++x) outData[i*nx + x] = (outHi[i*nx + x] + outData[i*nx + x]) / 2;
+          }
+        }
+      }, 256);
+
+      win.write(out, &outData[0]);
+    }// endwhile
+  }// end: filter
+
+
+
+  void Neighborhood::median(const Raster *in, Raster *out, const long int &radius,
+                            const BorderMode &border) {
+    GEOSTAR_PROFILE_SCOPE("Neighborhood::median");
+    RasterSizeErrorException RasterSizeError;
+    IntegerParameterException IntegerParameterError;
+    if(radius < 0) throw IntegerParameterError;
+
+    const long int nx = in->get_nx();
+    const long int ny = in->get_ny();
+    if(out->get_nx() != nx || out->get_ny() != ny) throw RasterSizeError;
+
+    const long int n = 2*radius + 1;
+    const RasterType type = in->get_datatype();
+
+    // tiles are independent; each keeps its own histograms
+    TileExecutor tiles(in, radius, radius, border);
+    tiles.run(out, [&](const TileExecutor::Tile &t) {
+        if(type == INT8U)       medianByte(t, n);
+        else if(type == INT16U) medianShort(t, n);
+        else                    medianSelect(t, n);
+      });
+  }// end: median
+
+}// end namespace GeoStar
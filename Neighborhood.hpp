@@ -0,0 +1,113 @@
+// Neighborhood.hpp
+//
+// Streaming row windows and the sliding-window neighborhood filters
+//----------------------------------------
+#ifndef NEIGHBORHOOD_HPP_
+#define NEIGHBORHOOD_HPP_
+
+#include <vector>
+#include <map>
+
+#include "Kernel.hpp"
+
+namespace GeoStar {
+  class Raster;
+
+  /** \brief RowWindow -- streams a raster through bands of rows with a margin around them
+
+  A neighborhood filter with an n x n window needs, for each band of output rows, the input rows
+  of the band plus (n-1)/2 rows above and below it, each padded with (n-1)/2 pixels on the left and
+  right.  RowWindow hands those rows out band by band, as doubles, with the border already filled
+  in.  Rows shared by neighbouring bands are kept, so every input row is read from the file once.
+
+  \see Neighborhood, BorderMode, Raster::medianFilter
+
+  \Par Example
+	visiting the padded rows around every band of a raster:
+	\code
+	GeoStar::RowWindow win(ras, r, r, GeoStar::BORDER_REFLECT);
+	while(win.next()) {
+	  // output rows win.y0() .. win.y0()+win.rows()-1
+	  // input rows win.row(0) .. win.row(win.rows()+2*r-1), each win.width() long
+	}
+	\endcode
+
+  \Par Details
+	The band height is the chunk height of the raster when it is chunked, and about a million
+	pixels otherwise, but never less than four window heights, so the margin stays a small part of
+	each band.  Runs of consecutive new rows are read with one HDF5 call.  All HDF5 access is on
+	the calling thread.
+  */
+  class RowWindow {
+
+  public:
+    // rx, ry: the margin in pixels left/right and above/below.  band 0 picks the band height.
+    RowWindow(const Raster *in, const long int &rx, const long int &ry, const BorderMode &border,
+              const long int &band = 0);
+
+    // moves to the next band; false when the raster is done
+    bool next();
+
+    // the band: output rows [y0, y0+rows)
+    inline long int y0() const { return bandY0; }
+    inline long int rows() const { return bandRows; }
+
+    // padded row k of the band, k in [0, rows()+2*ry): input row y0()-ry+k, pixels -rx .. nx+rx-1
+    inline const double *row(const long int &k) const { return rowPtr[k]; }
+    inline long int width() const { return nx + 2*rx; }
+
+    // writes rows() rows of out, starting at y0(), from data
+    void write(Raster *out, const double *data) const;
+
+  private:
+    const Raster *in;
+    long int nx, ny, rx, ry, band;
+    BorderMode border;
+
+    long int bandY0, bandRows;
+    std::vector<long int> xsource;                    // padded column -> input column, -1 for 0
+    std::map<long int, std::vector<double> > cache;   // padded input rows by row number
+    std::vector<double> zeros;
+    std::vector<const double *> rowPtr;
+    std::vector<double> raw;
+
+  }; // end class: RowWindow
+
+
+  /** \brief Neighborhood -- sliding-window filters whose cost does not depend on the window size
+
+  Each output pixel is a statistic of the n x n window centred on it.  Minimum and maximum use the
+  van Herk/Gil-Werman algorithm, a running min/max over blocks of n that needs three comparisons
+  per pixel per axis; the means use running sums.  Both are done along the rows and then down the
+  columns of each band, so a 63x63 window costs the same per pixel as a 3x3.
+
+  The median of an INT8U raster uses the Perreault-Hebert constant-time algorithm: a histogram per
+  column, and a two-level (16 x 16 bin) window histogram that slides along the row by adding and
+  removing whole column histograms.  INT16U rasters use a sliding 256 x 256 bin window
+  histogram, which costs 2n updates per pixel, and other types select the middle of each window.
+
+  \see Raster::minFilter, Raster::maxFilter, Raster::meanFilter, Raster::rangeFilter,
+  Raster::midpointFilter, Raster::harmonicMean, Raster::medianFilter, RowWindow
+
+  \Par Details
+	Rows, or for the median the tiles of a TileExecutor, are processed in parallel on the
+	File::set_num_threads pool.  Pixels are worked on as doubles and converted to the output raster's type when written.
+  */
+  class Neighborhood {
+
+  public:
+    enum Statistic { MINIMUM, MAXIMUM, RANGE, MIDPOINT, MEAN, HARMONIC_MEAN };
+
+    // the statistic of the n x n window around every pixel of in, written to out.  n must be
+    // odd and out the same size as in.
+    static void filter(const Raster *in, Raster *out, const Statistic &stat, const long int &n,
+                       const BorderMode &border);
+
+    // the median of the (2*radius+1) square window around every pixel of in, written to out
+    static void median(const Raster *in, Raster *out, const long int &radius, const BorderMode &border);
+
+  }; // end class: Neighborhood
+
+}// end namespace GeoStar
+
+#endif //NEIGHBORHOOD_HPP_
@@ -0,0 +1,79 @@
+// Noise.cpp
+//
+// Implementation of the counter-based noise
+// Documentation in Noise.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <cmath>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "Noise.hpp"
+#include "ThreadPool.hpp"
+#include "BlockStream.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    const double TWO_PI = 6.28318530717958647692;
+
+    template<typename T>
+    void addNoise(const Raster *in, Raster *out, const Noise::Mode &mode, const double &amount,
+                  const uint64_t &seed, const double &pepper, const double &salt) {
+      const Philox philox(seed);
+      const long int nx = in->get_nx();
+      const bool integer = out->get_datatype() <= INT64S;
+
+      BlockStream<T> stream(in, std::vector<const Raster *>(1, in), 1, out, 0);
+      stream.run([&](typename BlockStream<T>::Block &b) {
+          std::vector<T> &data = b.slots[0];
+          const long int x0 = b.slice[0], y0 = b.slice[1], dx = b.slice[2];
+          parallel_for(b.n, [&](long int begin, long int end) {
+              uint32_t r[4];
+              for(long int j=begin; j<end; ++j) {
+                // the counter is the pixel's place in the raster, not in the block
+                const uint64_t index = (uint64_t)(y0 + j/dx) * nx + (x0 + j%dx);
+                philox.generate(index, 0, r);
+                const double u = Philox::uniform(r[0], r[1]);
+                double v = data[j];
+                if(mode == Noise::SALT_PEPPER) {
+                  if(u <= amount) v = pepper;
+                  else if(u >= 1 - amount) v = salt;
+                  else continue;
+                } else {
+                  const double z = std::sqrt(-2.0 * std::log(u)) * std::cos(TWO_PI * Philox::uniform(r[2], r[3]));
+                  v = (mode == Noise::GAUSSIAN) ? v + amount * z : v * (1 + amount * z);
+                }
+                data[j] = integer ? std::floor(v + 0.5) : v;
+              }// endfor: j
+            });
+        });
+    }// end: addNoise
+
+  }// end anonymous namespace
+
+
+
+  void Noise::apply(const Raster *in, Raster *out, const Mode &mode, const double &amount,
+                    const uint64_t &seed, const double &pepper, const double &salt) {
+    GEOSTAR_PROFILE_SCOPE("Noise::apply");
+    RasterSizeErrorException RasterSizeError;
+    if(in->get_nx() != out->get_nx() || in->get_ny() != out->get_ny()) throw RasterSizeError;
+
+    // float holds every value of the narrow types exactly
+    switch(out->get_datatype()) {
+    case INT8U: case INT8S: case INT16U: case INT16S: case REAL32:
+      addNoise<float>(in, out, mode, amount, seed, pepper, salt);
+      break;
+    default:
+      addNoise<double>(in, out, mode, amount, seed, pepper, salt);
+      break;
+    }// end case
+  }// end: apply
+
+}// end namespace GeoStar
@@ -0,0 +1,106 @@
+// Noise.hpp
+//
+// Counter-based random numbers and the noise they make
+//----------------------------------------
+#ifndef NOISE_HPP_
+#define NOISE_HPP_
+
+#include <stdint.h>
+
+namespace GeoStar {
+  class Raster;
+
+  /** \brief Philox -- the Philox4x32-10 counter-based generator of Salmon et al.
+
+  A counter-based generator has no state: the random numbers for counter c under key k are a
+  fixed function of c and k, ten rounds of multiplies and xors.  Keyed by a seed and counted by
+  pixel index, every pixel gets its own numbers however the raster is split into blocks and
+  threads, so the same seed always gives the same noise, on one thread or forty.
+
+  \see Noise
+
+  \Par Example
+	four 32-bit numbers for pixel i:
+	\code
+	uint32_t r[4];
+	GeoStar::Philox(seed).generate(i, 0, r);
+	\endcode
+  */
+  class Philox {
+
+  public:
+    inline Philox(const uint64_t &seed) : k0((uint32_t)seed), k1((uint32_t)(seed >> 32)) {}
+
+    // the four words for the 128-bit counter (lo, hi)
+    inline void generate(const uint64_t &lo, const uint64_t &hi, uint32_t *out) const {
+      uint32_t c0 = (uint32_t)lo, c1 = (uint32_t)(lo >> 32), c2 = (uint32_t)hi, c3 = (uint32_t)(hi >> 32);
+      uint32_t a = k0, b = k1;
+      for(int round=0; round<10; ++round) {
+        const uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+        const uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+        const uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ a;
+        const uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ b;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        a += 0x9E3779B9u;
+        b += 0xBB67AE85u;
+      }// endfor: round
+      out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    // a double in (0,1) from two words
+    static inline double uniform(const uint32_t &hi, const uint32_t &lo) {
+      return ((((uint64_t)hi << 21) ^ (lo >> 11)) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+  private:
+    uint32_t k0, k1;
+
+  }; // end class: Philox
+
+
+
+  /** \brief Noise -- salt-and-pepper, Gaussian and speckle noise, reproducible and parallel
+
+  Every pixel draws its numbers from Philox, keyed by the seed and counted by the pixel's index
+  y * nx + x, so the noise of a pixel depends only on the seed and where it is.  The raster is
+  streamed block by block (BlockStream) and each block is split over the File::set_num_threads
+  pool with no shared generator, and the output is bit-identical whatever the thread count.
+
+  \see Raster::addSaltPepper, Raster::addGaussianNoise, Raster::addSpeckleNoise, Philox
+
+  \Par Example
+	three noisy copies of a band for a training set, each reproducible from its seed:
+	\code
+	for(uint64_t s=1; s<=3; ++s) {
+	  GeoStar::Raster *out = img->create_raster("noisy" + std::to_string(s), GeoStar::INT8U,
+	                                            ras->get_nx(), ras->get_ny());
+	  ras->addGaussianNoise(out, 4.0, s);
+	  delete out;
+	}
+	\endcode
+
+  \Par Details
+	Salt and pepper: a uniform u per pixel; u <= p gives pepper, u >= 1 - p salt, and other pixels
+	are copied.  Gaussian: in + sigma * z.  Speckle: in * (1 + sigma * z).  z is a standard normal
+	from the Box-Muller transform of the pixel's two uniforms.  Integer outputs are rounded to the
+	nearest value and saturate at the limits of their type.  Outputs of up to 16-bit integers or
+	REAL32 are worked in float, others in double.
+  */
+  class Noise {
+
+  public:
+    enum Mode { SALT_PEPPER, GAUSSIAN, SPECKLE };
+
+    // out = in with noise of the mode: amount is p for SALT_PEPPER, sigma for the others.  pepper
+    // and salt are the values salt-and-pepper noise sets.
+    static void apply(const Raster *in, Raster *out, const Mode &mode, const double &amount,
+                      const uint64_t &seed, const double &pepper = 0, const double &salt = 15000);
+
+  }; // end class: Noise
+
+}// end namespace GeoStar
+
+#endif //NOISE_HPP_
@@ -0,0 +1,646 @@
+// Pipeline.cpp
+//
+// Implementation of the operator graph
+// Documentation in Pipeline.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Image.hpp"
+#include "Raster.hpp"
+#include "Pipeline.hpp"
+#include "PixelConvert.hpp"
+#include "ThreadPool.hpp"
+#include "BlockStream.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  // one node of the graph
+  struct Pipeline::Vertex {
+    enum Kind { SOURCE, POINT, ARITHMETIC, OPERATOR };
+
+    Kind kind;
+    std::vector<Node> in;
+    RasterType type;
+    long int nx, ny;
+
+    Raster *ras;                   // SOURCE
+    LUT lut;                       // POINT
+    RasterExpr::Op op;             // ARITHMETIC
+    Pipeline::Op apply;            // OPERATOR
+
+    // the rasters the node is written to, and the overview levels built on each (-1 for none)
+    std::vector<std::pair<Raster *, int> > outputs;
+
+    Vertex() : kind(SOURCE), type(REAL32), nx(0), ny(0), ras(NULL), op(RasterExpr::PLUS) {}
+  };
+
+
+
+  namespace {
+
+    // the pixel type of a node that is computed pixel by pixel
+    const H5::PredType &pixelType(const RasterType &type) {
+      DataTypeException DataTypeError;
+      switch(type) {
+      case INT8U:  return H5::PredType::NATIVE_UINT8;
+      case INT8S:  return H5::PredType::NATIVE_INT8;
+      case INT16U: return H5::PredType::NATIVE_UINT16;
+      case INT16S: return H5::PredType::NATIVE_INT16;
+      case INT32U: return H5::PredType::NATIVE_UINT32;
+      case INT32S: return H5::PredType::NATIVE_INT32;
+      case INT64U: return H5::PredType::NATIVE_UINT64;
+      case INT64S: return H5::PredType::NATIVE_INT64;
+      case REAL32: return H5::PredType::NATIVE_FLOAT;
+      case REAL64: return H5::PredType::NATIVE_DOUBLE;
+      default: throw DataTypeError;
+      }// end case
+    }// end: pixelType
+
+    // bytes in a pixel of any type
+    size_t pixelSize(const RasterType &type) {
+      switch(type) {
+      case COMPLEX_INT16:   return 2;
+      case COMPLEX_INT32:   return 4;
+      case COMPLEX_INT64:   return 8;
+      case COMPLEX_INT128:  return 16;
+      case COMPLEX_REAL64:  return 8;
+      case COMPLEX_REAL128: return 16;
+      default:              return pixelType(type).getSize();
+      }// end case
+    }// end: pixelSize
+
+    // the n values at v, as pixels of type would hold them
+    void roundTo(const RasterType &type, double *v, const long int &n, std::vector<char> &scratch) {
+      if(type == REAL64 || n <= 0) return;
+      const H5::PredType &to = pixelType(type);
+      scratch.resize(n * to.getSize());
+      PixelConvert::convert(v, H5::PredType::NATIVE_DOUBLE, &scratch[0], to, n);
+      PixelConvert::convert(&scratch[0], to, v, H5::PredType::NATIVE_DOUBLE, n);
+    }// end: roundTo
+
+    // the float arithmetic of RasterExpr
+    inline float combine(const RasterExpr::Op &op, const float &a, const float &b) {
+      switch(op) {
+      case RasterExpr::PLUS:      return a + b;
+      case RasterExpr::MINUS:     return a - b;
+      case RasterExpr::TIMES:     return a * b;
+      case RasterExpr::DIVIDEDBY: return (b == 0) ? 255 : a / b;
+      default:                    return 0;
+      }// end case
+    }// end: combine
+
+
+    // a point node on an 8 or 16-bit input: its results, converted, for every input value
+    struct Table {
+      std::vector<double> values;
+      long int base;               // the input value of entry 0
+    };
+
+    // the nodes one pass computes, the stored nodes it reads and the rasters it writes
+    struct Pass {
+      long int nx, ny;
+      std::vector<Pipeline::Node> members;
+      std::vector<Pipeline::Node> leaves;
+      std::vector<std::pair<Pipeline::Node, Raster *> > writes;
+    };
+
+    void addOnce(std::vector<Pipeline::Node> &list, const Pipeline::Node &node) {
+      if(std::find(list.begin(), list.end(), node) == list.end()) list.push_back(node);
+    }// end: addOnce
+
+  }// end anonymous namespace
+
+
+
+  Pipeline::Pipeline(Image *scratch)
+    : scratch(scratch), memoryBudget((size_t)256 << 20), passes(0), peakMemory(0), memFile(NULL),
+      memImage(NULL), diskImage(NULL), ownsDisk(false), memoryUsed(0) {
+  }// end-Pipeline-constructor
+
+
+
+  Pipeline::~Pipeline() {
+    try {
+      close();
+    } catch(...) {
+    }// end: try
+  }// end-Pipeline-destructor
+
+
+
+  Pipeline::Node Pipeline::add(const std::shared_ptr<Vertex> &v) {
+    vertices.push_back(v);
+    return (Node)vertices.size() - 1;
+  }// end: add
+
+
+
+  const Pipeline::Vertex &Pipeline::vertex(const Node &node) const {
+    PipelineException PipelineError;
+    if(node < 0 || node >= (Node)vertices.size()) throw PipelineError;
+    return *vertices[node];
+  }// end: vertex
+
+
+
+  Pipeline::Node Pipeline::source(Raster *ras) {
+    std::shared_ptr<Vertex> v(new Vertex);
+    v->kind = Vertex::SOURCE;
+    v->ras = ras;
+    v->type = ras->get_datatype();
+    v->nx = ras->get_nx();
+    v->ny = ras->get_ny();
+    return add(v);
+  }// end: source
+
+
+
+  Pipeline::Node Pipeline::pixelwise(const Node &in, const LUT &lut, const RasterType &type) {
+    const Vertex &from = vertex(in);
+    pixelType(from.type);
+    pixelType(type);
+    std::shared_ptr<Vertex> v(new Vertex);
+    v->kind = Vertex::POINT;
+    v->in.push_back(in);
+    v->type = type;
+    v->nx = from.nx;
+    v->ny = from.ny;
+    v->lut = lut;
+    return add(v);
+  }// end: pixelwise
+
+  Pipeline::Node Pipeline::point(const Node &in, const LUT &lut) {
+    return pixelwise(in, lut, vertex(in).type);
+  }// end: point
+
+  Pipeline::Node Pipeline::point(const Node &in, const LUT &lut, const RasterType &type) {
+    return pixelwise(in, lut, type);
+  }// end: point
+
+  Pipeline::Node Pipeline::thresh(const Node &in, const double &value) {
+    return point(in, LUT().threshold(value));
+  }// end: thresh
+
+  Pipeline::Node Pipeline::scale(const Node &in, const double &offset, const double &mult) {
+    return point(in, LUT().scale(offset, mult));
+  }// end: scale
+
+  Pipeline::Node Pipeline::bitShift(const Node &in, const int &bits, const bool &right) {
+    return point(in, LUT().shift(bits, right));
+  }// end: bitShift
+
+  Pipeline::Node Pipeline::convert(const Node &in, const RasterType &type) {
+    return pixelwise(in, LUT(), type);
+  }// end: convert
+
+
+
+  Pipeline::Node Pipeline::arithmetic(const RasterExpr::Op &op, const Node &lhs, const Node &rhs) {
+    RasterSizeErrorException RasterSizeError;
+    const Vertex &a = vertex(lhs);
+    const Vertex &b = vertex(rhs);
+    pixelType(a.type);
+    pixelType(b.type);
+    if(a.nx != b.nx || a.ny != b.ny) throw RasterSizeError;
+    std::shared_ptr<Vertex> v(new Vertex);
+    v->kind = Vertex::ARITHMETIC;
+    v->in.push_back(lhs);
+    v->in.push_back(rhs);
+    v->type = a.type;
+    v->nx = a.nx;
+    v->ny = a.ny;
+    v->op = op;
+    return add(v);
+  }// end: arithmetic
+
+  Pipeline::Node Pipeline::plus(const Node &lhs, const Node &rhs) {
+    return arithmetic(RasterExpr::PLUS, lhs, rhs);
+  }
+  Pipeline::Node Pipeline::minus(const Node &lhs, const Node &rhs) {
+    return arithmetic(RasterExpr::MINUS, lhs, rhs);
+  }
+  Pipeline::Node Pipeline::times(const Node &lhs, const Node &rhs) {
+    return arithmetic(RasterExpr::TIMES, lhs, rhs);
+  }
+  Pipeline::Node Pipeline::divide(const Node &lhs, const Node &rhs) {
+    return arithmetic(RasterExpr::DIVIDEDBY, lhs, rhs);
+  }
+
+
+
+  Pipeline::Node Pipeline::apply(const std::vector<Node> &in, const RasterType &type, const long int &nx,
+                                 const long int &ny, const Op &op) {
+    IntegerParameterException IntegerParameterError;
+    if(nx < 0 || ny < 0) throw IntegerParameterError;
+    for(size_t i=0; i<in.size(); ++i) vertex(in[i]);
+    std::shared_ptr<Vertex> v(new Vertex);
+    v->kind = Vertex::OPERATOR;
+    v->in = in;
+    v->type = type;
+    v->nx = nx;
+    v->ny = ny;
+    v->apply = op;
+    return add(v);
+  }// end: apply
+
+  Pipeline::Node Pipeline::apply(const std::vector<Node> &in, const RasterType &type, const Op &op) {
+    PipelineException PipelineError;
+    if(in.empty()) throw PipelineError;
+    const Vertex &first = vertex(in[0]);
+    return apply(in, type, first.nx, first.ny, op);
+  }// end: apply
+
+
+
+  Pipeline::Node Pipeline::lowPassFilter(const Node &in, const RasterType &type) {
+    const Vertex &from = vertex(in);
+    const long int nx = from.nx, ny = from.ny;
+    // the spectrum rasters lowPassFilter writes are intermediates too
+    return apply(std::vector<Node>(1, in), type, [this, nx, ny](const std::vector<Raster *> &r, Raster *out) {
+        Raster *re = temporary(REAL32, nx, ny);
+        Raster *im = NULL;
+        try {
+          im = temporary(REAL32, nx, ny);
+          r[0]->lowPassFilter(memImage != NULL ? memImage : diskImage, re, im, out);
+        } catch(...) {
+          release(re);
+          if(im) release(im);
+          throw;
+        }// end: try
+        release(re);
+        release(im);
+      });
+  }// end: lowPassFilter
+
+  Pipeline::Node Pipeline::medianFilter(const Node &in, const int &radius, const RasterType &type,
+                                        const BorderMode &border) {
+    return apply(std::vector<Node>(1, in), type, [radius, border](const std::vector<Raster *> &r, Raster *out) {
+        r[0]->medianFilter(out, radius, border);
+      });
+  }// end: medianFilter
+
+  Pipeline::Node Pipeline::convolve(const Node &in, const Kernel &kernel, const RasterType &type,
+                                    const BorderMode &border) {
+    return apply(std::vector<Node>(1, in), type, [kernel, border](const std::vector<Raster *> &r, Raster *out) {
+        r[0]->convolve(kernel, out, border);
+      });
+  }// end: convolve
+
+  Pipeline::Node Pipeline::resize(const Node &in, const long int &nx, const long int &ny,
+                                  const RasterType &type, const ResampleKernel &kernel) {
+    return apply(std::vector<Node>(1, in), type, nx, ny, [kernel](const std::vector<Raster *> &r, Raster *out) {
+        r[0]->resize(out, kernel);
+      });
+  }// end: resize
+
+
+
+  void Pipeline::output(const Node &node, Raster *ras, const int &overviews) {
+    RasterSizeErrorException RasterSizeError;
+    const Vertex &v = vertex(node);
+    if(ras->get_nx() != v.nx || ras->get_ny() != v.ny) throw RasterSizeError;
+    vertices[node]->outputs.push_back(std::make_pair(ras, overviews));
+  }// end: output
+
+
+
+  Raster *Pipeline::temporary(const RasterType &type, const long int &nx, const long int &ny) {
+    const size_t bytes = (size_t)nx * ny * pixelSize(type);
+    Image *img;
+    if(memoryUsed + bytes <= memoryBudget) {
+      if(memFile == NULL) {
+        // a file that only lives in memory: the core driver, with no backing store
+        static long int serial = 0;
+        H5::FileAccPropList access;
+        access.setCore((size_t)1 << 24, false);
+        memFile = new H5::H5File("geostar_pipeline_" + std::to_string(++serial) + ".h5", H5F_ACC_TRUNC,
+                                 H5::FileCreatPropList::DEFAULT, access);
+        memImage = new Image(memFile->createGroup("pipeline"), "pipeline");
+      }// endif
+      img = memImage;
+    } else {
+      if(diskImage == NULL) {
+        diskImage = scratch;
+        for(size_t i=0; diskImage == NULL && i<vertices.size(); ++i) {
+          if(vertices[i]->kind == Vertex::SOURCE) diskImage = vertices[i]->ras->getParent();
+        }// endfor: i
+        for(size_t i=0; diskImage == NULL && i<vertices.size(); ++i) {
+          if(!vertices[i]->outputs.empty()) diskImage = vertices[i]->outputs[0].first->getParent();
+        }// endfor: i
+        ownsDisk = (scratch == NULL);
+      }// endif
+      img = diskImage;
+    }// endif
+
+    long int n = (long int)temporaries.size();
+    std::string name;
+    do {
+      name = "pipeline_" + std::to_string(n++);
+    } while(img->datasetExists(name));
+
+    Raster *ras = new Raster(img, name, type, nx, ny);
+    const size_t held = (img == memImage) ? bytes : 0;
+    temporaries[ras] = std::make_pair(img, held);
+    memoryUsed += held;
+    peakMemory = std::max(peakMemory, memoryUsed);
+    return ras;
+  }// end: temporary
+
+
+
+  void Pipeline::release(Raster *ras) {
+    std::map<Raster *, std::pair<Image *, size_t> >::iterator found = temporaries.find(ras);
+    if(found == temporaries.end()) return;
+    Image *img = found->second.first;
+    memoryUsed -= found->second.second;
+    temporaries.erase(found);
+    const std::string name = ras->get_name();
+    ras->dropOverviews();
+    delete ras;
+    H5Ldelete(img->imageobj->getId(), name.c_str(), H5P_DEFAULT);
+  }// end: release
+
+
+
+  void Pipeline::close() {
+    while(!temporaries.empty()) release(temporaries.begin()->first);
+    if(memImage) delete memImage;
+    memImage = NULL;
+    if(memFile) {
+      memFile->close();
+      delete memFile;
+    }// endif
+    memFile = NULL;
+    if(ownsDisk && diskImage) delete diskImage;
+    diskImage = NULL;
+    ownsDisk = false;
+    memoryUsed = 0;
+  }// end: close
+
+
+
+  void Pipeline::run() {
+    GEOSTAR_PROFILE_SCOPE("Pipeline::run");
+    passes = 0;
+    peakMemory = 0;
+    const long int n = (long int)vertices.size();
+
+    // the nodes that lead to an output; inputs always come before the nodes that read them
+    std::vector<char> needed(n, 0);
+    for(long int i=n-1; i>=0; --i) {
+      const Vertex &v = *vertices[i];
+      if(!v.outputs.empty()) needed[i] = 1;
+      if(needed[i]) for(size_t k=0; k<v.in.size(); ++k) needed[v.in[k]] = 1;
+    }// endfor: i
+
+    // the nodes kept in a raster for later stages: sources, operators and what operators read.
+    // Pixel-wise nodes are fused through everything else.
+    std::vector<char> stored(n, 0);
+    for(long int i=0; i<n; ++i) {
+      const Vertex &v = *vertices[i];
+      if(!needed[i]) continue;
+      if(v.kind == Vertex::SOURCE || v.kind == Vertex::OPERATOR) stored[i] = 1;
+      if(v.kind == Vertex::OPERATOR) for(size_t k=0; k<v.in.size(); ++k) stored[v.in[k]] = 1;
+    }// endfor: i
+
+    // the wave each node is computed in: sources are there at wave 0, a stage runs the wave after
+    // the last stored node it reads.  after[i] is that wave for the pass computing node i.
+    std::vector<long int> wave(n, 0), after(n, 0);
+    long int waves = 1;
+    for(long int i=0; i<n; ++i) {
+      const Vertex &v = *vertices[i];
+      if(!needed[i] || v.kind == Vertex::SOURCE) continue;
+      long int last = 0;
+      for(size_t k=0; k<v.in.size(); ++k) {
+        const Node j = v.in[k];
+        const bool pixelwise = vertices[j]->kind == Vertex::POINT || vertices[j]->kind == Vertex::ARITHMETIC;
+        last = std::max(last, (stored[j] || !pixelwise) ? wave[j] : after[j]);
+      }// endfor: k
+      after[i] = last;
+      wave[i] = last + 1;
+      waves = std::max(waves, wave[i] + 1);
+    }// endfor: i
+
+    // the fused passes, one per wave and size: every pixel-wise node that is stored or written
+    // is computed, with the pixel-wise nodes it reads, back to stored ones.  Stored nodes with
+    // outputs that they are not computed into are copied in the wave after them.
+    std::vector<Pass> fused;
+    std::map<std::pair<long int, std::pair<long int, long int> >, size_t> passOf;
+    std::vector<Raster *> store(n, (Raster *)NULL);
+    auto passFor = [&](const long int &w, const long int &nx, const long int &ny) -> Pass & {
+      const std::pair<long int, std::pair<long int, long int> > key(w, std::make_pair(nx, ny));
+      if(passOf.find(key) == passOf.end()) {
+        passOf[key] = fused.size();
+        Pass p;
+        p.nx = nx;
+        p.ny = ny;
+        fused.push_back(p);
+      }// endif
+      return fused[passOf[key]];
+    };
+
+    for(long int i=0; i<n; ++i) {
+      const Vertex &v = *vertices[i];
+      if(!needed[i]) continue;
+      const bool pixelwise = v.kind == Vertex::POINT || v.kind == Vertex::ARITHMETIC;
+      if(v.kind == Vertex::SOURCE) store[i] = v.ras;
+
+      // an operator or a stored node is written to an output of its type, if it has one
+      if(!pixelwise || stored[i]) {
+        for(size_t k=0; k<v.outputs.size() && store[i] == NULL; ++k) {
+          if(v.outputs[k].first->get_datatype() == v.type) store[i] = v.outputs[k].first;
+        }// endfor: k
+      }// endif
+
+      if(pixelwise && (stored[i] || !v.outputs.empty())) {
+        Pass &p = passFor(wave[i], v.nx, v.ny);
+        for(size_t k=0; k<v.outputs.size(); ++k) p.writes.push_back(std::make_pair(i, v.outputs[k].first));
+
+        // the pixel-wise nodes behind this one, back to stored nodes
+        std::vector<Node> todo(1, i);
+        while(!todo.empty()) {
+          const Node j = todo.back();
+          todo.pop_back();
+          const Vertex &u = *vertices[j];
+          const bool fusable = u.kind == Vertex::POINT || u.kind == Vertex::ARITHMETIC;
+          if(j != i && (stored[j] || !fusable)) {
+            addOnce(p.leaves, j);
+            continue;
+          }// endif
+          if(std::find(p.members.begin(), p.members.end(), j) != p.members.end()) continue;
+          p.members.push_back(j);
+          for(size_t k=0; k<u.in.size(); ++k) todo.push_back(u.in[k]);
+        }// endwhile
+      } else if(!pixelwise) {
+        // outputs that are not the store are copies
+        for(size_t k=0; k<v.outputs.size(); ++k) {
+          if(v.outputs[k].first == store[i]) continue;
+          Pass &p = passFor(wave[i] + 1, v.nx, v.ny);
+          addOnce(p.leaves, i);
+          p.writes.push_back(std::make_pair(i, v.outputs[k].first));
+          waves = std::max(waves, wave[i] + 2);
+        }// endfor: k
+      }// endif
+    }// endfor: i
+
+    // the stages reading each stored node; its intermediate goes when the last one is done
+    std::vector<long int> readers(n, 0);
+    for(size_t p=0; p<fused.size(); ++p) {
+      std::sort(fused[p].members.begin(), fused[p].members.end());
+      for(size_t k=0; k<fused[p].leaves.size(); ++k) ++readers[fused[p].leaves[k]];
+    }// endfor: p
+    for(long int i=0; i<n; ++i) {
+      if(needed[i] && vertices[i]->kind == Vertex::OPERATOR) {
+        std::vector<Node> in;
+        for(size_t k=0; k<vertices[i]->in.size(); ++k) addOnce(in, vertices[i]->in[k]);
+        for(size_t k=0; k<in.size(); ++k) ++readers[in[k]];
+      }// endif
+    }// endfor: i
+
+    // tables for the point nodes on 8 and 16-bit nodes
+    std::vector<Table> tables(n);
+    for(long int i=0; i<n; ++i) {
+      const Vertex &v = *vertices[i];
+      if(!needed[i] || v.kind != Vertex::POINT) continue;
+      const RasterType from = vertices[v.in[0]]->type;
+      if(!LUT::supported(from)) continue;
+      const long int entries = (from == INT8U || from == INT8S) ? 256 : 65536;
+      Table &t = tables[i];
+      t.base = (from == INT8S) ? -128 : (from == INT16S) ? -32768 : 0;
+      t.values.resize(entries);
+      for(long int k=0; k<entries; ++k) t.values[k] = v.lut((double)(t.base + k));
+      std::vector<char> scratchBytes;
+      roundTo(v.type, &t.values[0], entries, scratchBytes);
+    }// endfor: i
+
+    try {
+      for(long int w=1; w<waves; ++w) {
+        // the operators of the wave
+        for(long int i=0; i<n; ++i) {
+          const Vertex &v = *vertices[i];
+          if(!needed[i] || v.kind != Vertex::OPERATOR || wave[i] != w) continue;
+          GEOSTAR_PROFILE_SCOPE("Pipeline::operator");
+          std::vector<Raster *> in;
+          for(size_t k=0; k<v.in.size(); ++k) in.push_back(store[v.in[k]]);
+          if(store[i] == NULL) store[i] = temporary(v.type, v.nx, v.ny);
+          v.apply(in, store[i]);
+          ++passes;
+
+          std::vector<Node> done;
+          for(size_t k=0; k<v.in.size(); ++k) addOnce(done, v.in[k]);
+          for(size_t k=0; k<done.size(); ++k) {
+            if(--readers[done[k]] == 0) release(store[done[k]]);
+          }// endfor: k
+        }// endfor: i
+
+        // the fused passes of the wave
+        for(std::map<std::pair<long int, std::pair<long int, long int> >, size_t>::iterator it = passOf.begin();
+            it != passOf.end(); ++it) {
+          if(it->first.first != w) continue;
+          GEOSTAR_PROFILE_SCOPE("Pipeline::pass");
+          Pass &p = fused[it->second];
+
+          // stored members are written to their store as well as their outputs
+          for(size_t k=0; k<p.members.size(); ++k) {
+            const Node j = p.members[k];
+            if(!stored[j]) continue;
+            if(store[j] == NULL) store[j] = temporary(vertices[j]->type, p.nx, p.ny);
+            bool written = false;
+            for(size_t m=0; m<p.writes.size(); ++m) written |= p.writes[m].second == store[j];
+            if(!written) p.writes.push_back(std::make_pair(j, store[j]));
+          }// endfor: k
+
+          // slots: the leaves, then the members in order
+          std::map<Node, int> slot;
+          std::vector<const Raster *> in;
+          for(size_t k=0; k<p.leaves.size(); ++k) {
+            slot[p.leaves[k]] = (int)k;
+            in.push_back(store[p.leaves[k]]);
+          }// endfor: k
+          for(size_t k=0; k<p.members.size(); ++k) slot[p.members[k]] = (int)(p.leaves.size() + k);
+          std::vector<Raster *> outs;
+          std::vector<int> outSlots;
+          for(size_t k=0; k<p.writes.size(); ++k) {
+            outs.push_back(p.writes[k].second);
+            outSlots.push_back(slot[p.writes[k].first]);
+          }// endfor: k
+
+          // each member as its inputs' slots, so the block loop does no lookups
+          struct Member {
+            const Vertex *v;
+            const Table *table;
+            int out, a, b;
+          };
+          std::vector<Member> members;
+          for(size_t k=0; k<p.members.size(); ++k) {
+            const Vertex &v = *vertices[p.members[k]];
+            Member m;
+            m.v = &v;
+            m.table = tables[p.members[k]].values.empty() ? NULL : &tables[p.members[k]];
+            m.out = slot[p.members[k]];
+            m.a = slot[v.in[0]];
+            m.b = (v.in.size() > 1) ? slot[v.in[1]] : -1;
+            members.push_back(m);
+          }// endfor: k
+
+          BlockStream<double> stream(outs[0], in, (int)slot.size(), outs, outSlots);
+          stream.run([&](BlockStream<double>::Block &block) {
+              std::vector<std::vector<double> > &slots = block.slots;
+              // every range runs all the members, so their results stay in cache
+              parallel_for(block.n, [&](long int begin, long int end) {
+                  const long int len = end - begin;
+                  std::vector<char> scratchBytes;
+                  for(size_t k=0; k<members.size(); ++k) {
+                    const Member &m = members[k];
+                    double *out = &slots[m.out][begin];
+                    const double *a = &slots[m.a][begin];
+                    if(m.table) {
+                      const double *values = &m.table->values[0];
+                      const long int base = m.table->base;
+                      for(long int q=0; q<len; ++q) out[q] = values[(long int)a[q] - base];
+                      continue;
+                    }// endif
+                    if(m.v->kind == Vertex::POINT) {
+                      for(long int q=0; q<len; ++q) out[q] = m.v->lut(a[q]);
+                    } else {
+                      const double *b = &slots[m.b][begin];
+                      const RasterExpr::Op op = m.v->op;
+                      for(long int q=0; q<len; ++q) out[q] = combine(op, (float)a[q], (float)b[q]);
+                    }// endif
+                    roundTo(m.v->type, out, len, scratchBytes);
+                  }// endfor: k
+                });
+            });
+          ++passes;
+
+          for(size_t k=0; k<p.leaves.size(); ++k) {
+            if(--readers[p.leaves[k]] == 0) release(store[p.leaves[k]]);
+          }// endfor: k
+        }// endfor: it
+      }// endfor: w
+
+      // overviews on the outputs that asked for them
+      for(long int i=0; i<n; ++i) {
+        const Vertex &v = *vertices[i];
+        for(size_t k=0; k<v.outputs.size(); ++k) {
+          if(v.outputs[k].second < 0) continue;
+          v.outputs[k].first->buildOverviews(v.outputs[k].second);
+          ++passes;
+        }// endfor: k
+      }// endfor: i
+    } catch(...) {
+      close();
+      throw;
+    }// end: try
+    close();
+  }// end: run
+
+}// end namespace GeoStar
@@ -0,0 +1,189 @@
+// Pipeline.hpp
+//
+// Chains of raster operations, scheduled as one graph
+//----------------------------------------
+#ifndef PIPELINE_HPP_
+#define PIPELINE_HPP_
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+
+#include "RasterType.hpp"
+#include "RasterExpr.hpp"
+#include "Kernel.hpp"
+#include "Resample.hpp"
+#include "LUT.hpp"
+
+namespace H5 {
+  class H5File;
+}
+
+namespace GeoStar {
+  class Raster;
+  class Image;
+
+  /** \brief Pipeline -- a chain of raster operations declared as a graph, and run as few passes
+
+  Run one Raster method after another and every step is a full pass over the disk, with a scratch
+  raster left in the image for each intermediate result.  A Pipeline is told the whole chain
+  first: sources, the operations on them (each a node of the graph), and the rasters the results
+  go to.  run() then works out the passes.  Pixel-wise steps (thresholds, scales, shifts, LUTs,
+  arithmetic between nodes) are fused: a chain of them, and every branch of the same size ready at
+  the same time, is computed block by block in one pass, reading each input once.  The other
+  operators (filters, FFT low pass, resampling, or any function of rasters) are run as they are,
+  on intermediates the Pipeline makes for them.  Intermediates are kept in memory while they fit
+  in the memory budget and in temporary datasets otherwise, and are deleted as soon as the last
+  step that reads them is done.
+
+  \see RasterExpr, LUT, BlockStream
+
+  \Par Example
+	a Landsat band low-pass filtered, scaled to 8 bits and thresholded, with an overview pyramid for
+	display, and a band ratio from the same pass over the inputs:
+	\code
+	GeoStar::Pipeline chain;
+	GeoStar::Pipeline::Node b4 = chain.source(img->open_raster("B4"));
+	GeoStar::Pipeline::Node b5 = chain.source(img->open_raster("B5"));
+
+	GeoStar::Pipeline::Node smooth = chain.lowPassFilter(b4, GeoStar::REAL32);
+	GeoStar::Pipeline::Node bytes = chain.point(smooth, GeoStar::LUT().scale(5000, 0.0125), GeoStar::INT8U);
+	chain.output(chain.thresh(bytes, 40), img->create_raster("B4_mask", GeoStar::INT8U, nx, ny), 0);
+	chain.output(chain.divide(b5, b4), img->create_raster("B5_B4", GeoStar::REAL32, nx, ny));
+	chain.run();
+	\endcode
+
+  \Par Details
+	Every node has a pixel type and a size; pixel-wise nodes take theirs from their (first) input
+	unless given one.  A node's value is what the same step written to a raster of its type
+	would hold: the steps compute as the Raster operators do (in float for thresh, scale, shift
+	and arithmetic) and the result is converted to the node's type (PixelConvert: truncated,
+	saturated, NaN to 0) before the next step uses it, so a fused chain writes exactly what the
+	chain of Raster calls writes.  Pixel-wise steps on an 8 or 16-bit node are looked up in a
+	table, with the conversion folded in.
+
+	run() groups the nodes into stages.  A stage is one operator, or one fused pass that computes
+	each of its nodes once per block, with its reads, arithmetic and writes overlapped
+	(BlockStream).  Stages run in waves: each one as soon as the stages it reads from are done.
+	The fused passes of one wave that have the same size are merged, so independent branches,
+	different bands for example, share a single pass over the blocks.  The operators of a wave
+	run one after another: HDF5 is only called from the calling thread, and each spreads its work
+	over the File::set_num_threads pool.
+
+	Only nodes that lead to an output are computed.  A node that is an output and is read by
+	later stages is written to its output raster, when that raster has the node's type, and read
+	from there.  Any other node an operator reads, or that an operator writes, is an intermediate:
+	made in an HDF5 file in memory while the intermediates alive at one time fit in the memory
+	budget (256 MB by default), and otherwise in the scratch image, the one given to the
+	constructor or the image of the first source, as a dataset named "pipeline_<n>" that is
+	unlinked when done (HDF5 reuses its space while the file is open, and h5repack reclaims it).
+
+	Rasters given to source and output are the caller's; they must stay open until run() returns.
+	The graph is kept, so run() may be called again after the sources change.
+
+	Node numbers from another Pipeline throw PipelineException, points or arithmetic on complex
+	nodes throw DataTypeException, and nodes of different sizes in divide and friends, or an
+	output raster of another size, throw RasterSizeErrorException, all when the node is added.
+  */
+  class Pipeline {
+
+  public:
+    typedef long int Node;
+
+    // an operator: reads the rasters of its input nodes, writes out
+    typedef std::function<void(const std::vector<Raster *> &in, Raster *out)> Op;
+
+    // scratch is where intermediates go that do not fit in memory; NULL for the image of the
+    // first source
+    Pipeline(Image *scratch = NULL);
+    ~Pipeline();
+
+    // a raster read by the pipeline
+    Node source(Raster *ras);
+
+    // pixel by pixel through lut, in double: in's type, or type
+    Node point(const Node &in, const LUT &lut);
+    Node point(const Node &in, const LUT &lut, const RasterType &type);
+
+    // as Raster::thresh, Raster::scale and Raster::bitShift, into in's type
+    Node thresh(const Node &in, const double &value);
+    Node scale(const Node &in, const double &offset, const double &mult);
+    Node bitShift(const Node &in, const int &bits, const bool &right);
+
+    // in, converted to type
+    Node convert(const Node &in, const RasterType &type);
+
+    // lhs op rhs in float, as RasterExpr, into lhs's type
+    Node plus(const Node &lhs, const Node &rhs);
+    Node minus(const Node &lhs, const Node &rhs);
+    Node times(const Node &lhs, const Node &rhs);
+    Node divide(const Node &lhs, const Node &rhs);
+
+    // op on the rasters of in, into a raster of type and size nx x ny, or of the size of in[0]
+    Node apply(const std::vector<Node> &in, const RasterType &type, const long int &nx,
+               const long int &ny, const Op &op);
+    Node apply(const std::vector<Node> &in, const RasterType &type, const Op &op);
+
+    // the Raster operators of the same name, into type
+    Node lowPassFilter(const Node &in, const RasterType &type);
+    Node medianFilter(const Node &in, const int &radius, const RasterType &type,
+                      const BorderMode &border = BORDER_REFLECT);
+    Node convolve(const Node &in, const Kernel &kernel, const RasterType &type,
+                  const BorderMode &border = BORDER_REFLECT);
+    Node resize(const Node &in, const long int &nx, const long int &ny, const RasterType &type,
+                const ResampleKernel &kernel = RESAMPLE_BILINEAR);
+
+    // node is written to ras; overviews >= 0 then builds that many overview levels on it
+    // (Raster::buildOverviews, 0 for all)
+    void output(const Node &node, Raster *ras, const int &overviews = -1);
+
+    // runs the graph
+    void run();
+
+    // the passes the last run made: fused passes and operators
+    inline long int get_passes() const { return passes; }
+
+    // the most bytes of intermediates held in memory at once in the last run
+    inline size_t get_peak_memory() const { return peakMemory; }
+
+    inline void set_memory_budget(const size_t &bytes) { memoryBudget = bytes; }
+    inline size_t get_memory_budget() const { return memoryBudget; }
+
+    // one node of the graph; defined in Pipeline.cpp
+    struct Vertex;
+
+  private:
+    std::vector<std::shared_ptr<Vertex> > vertices;
+    Image *scratch;
+    size_t memoryBudget;
+    long int passes;
+    size_t peakMemory;
+
+    // run() state: the in-memory file and its image, the scratch image (deleted by close when
+    // it was opened here), and the intermediates with their image and bytes held in memory
+    H5::H5File *memFile;
+    Image *memImage;
+    Image *diskImage;
+    bool ownsDisk;
+    std::map<Raster *, std::pair<Image *, size_t> > temporaries;
+    size_t memoryUsed;
+
+    Node add(const std::shared_ptr<Vertex> &v);
+    const Vertex &vertex(const Node &node) const;
+    Node pixelwise(const Node &in, const LUT &lut, const RasterType &type);
+    Node arithmetic(const RasterExpr::Op &op, const Node &lhs, const Node &rhs);
+
+    // a raster for an intermediate, in memory if it fits; release deletes it
+    Raster *temporary(const RasterType &type, const long int &nx, const long int &ny);
+    void release(Raster *ras);
+    void close();
+
+    Pipeline(const Pipeline &);
+    Pipeline &operator=(const Pipeline &);
+
+  }; // end class: Pipeline
+
+}// end namespace GeoStar
+
+#endif //PIPELINE_HPP_
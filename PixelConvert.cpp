@@ -0,0 +1,305 @@
+// PixelConvert.cpp
+//
+// Implementation of the pixel type conversions
+// Documentation in PixelConvert.hpp
+//--------------------------------------------
+
+
+#include <limits>
+#include <type_traits>
+#include <stdint.h>
+
+#include "H5Cpp.h"
+#include "PixelConvert.hpp"
+#include "Profiler.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace GeoStar {
+
+  namespace {
+
+    enum Kind { NONE, U8, S8, U16, S16, U32, S32, U64, S64, F32, F64 };
+
+    Kind kindOf(const H5::DataType &type) {
+      const hid_t id = type.getId();
+      const size_t size = H5Tget_size(id);
+      switch(H5Tget_class(id)) {
+      case H5T_INTEGER: {
+        if(H5Tget_order(id) != H5Tget_order(H5T_NATIVE_INT)) return NONE;
+        const bool isSigned = (H5Tget_sign(id) == H5T_SGN_2);
+        switch(size) {
+        case 1: return isSigned ? S8 : U8;
+        case 2: return isSigned ? S16 : U16;
+        case 4: return isSigned ? S32 : U32;
+        case 8: return isSigned ? S64 : U64;
+        default: return NONE;
+        }// end case
+      }
+      case H5T_FLOAT:
+        if(size == 4 && H5Tequal(id, H5T_NATIVE_FLOAT) > 0) return F32;
+        if(size == 8 && H5Tequal(id, H5T_NATIVE_DOUBLE) > 0) return F64;
+        return NONE;
+      default:
+        return NONE;
+      }// end case
+    }// end: kindOf
+
+
+    // integer to integer, exact, saturating at the limits of D
+    template<typename D, typename S>
+    inline D clampInteger(const S &v) {
+      typedef std::numeric_limits<D> L;
+      if(std::is_signed<S>::value && v < 0) {
+        if(!std::is_signed<D>::value) return 0;
+        return ((long long)v < (long long)L::min()) ? L::min() : (D)v;
+      }
+      return ((unsigned long long)v > (unsigned long long)L::max()) ? L::max() : (D)v;
+    }
+
+    // floating point to D: saturating, truncated towards zero, NaN to 0
+    template<typename D>
+    inline D clampReal(const double &v, std::true_type) {
+      typedef std::numeric_limits<D> L;
+      if(v != v) return 0;
+      if(v <= (double)L::min()) return L::min();
+      if(v >= (double)L::max()) return L::max();
+      return (D)v;
+    }
+    template<typename D>
+    inline D clampReal(const double &v, std::false_type) {
+      return (D)v;
+    }
+
+    template<typename D, typename S>
+    inline D plainCast(const S &v, std::true_type) {          // S is an integer
+      return std::is_integral<D>::value ? clampInteger<D>(v) : (D)v;
+    }
+    template<typename D, typename S>
+    inline D plainCast(const S &v, std::false_type) {         // S is a float
+      return clampReal<D>((double)v, std::is_integral<D>());
+    }
+
+
+    template<typename S, typename D>
+    void loop(const S *src, D *dst, const size_t &n, const bool &plain, const double &scale,
+              const double &offset) {
+      if(plain) {
+        for(size_t i=0; i<n; ++i) dst[i] = plainCast<D>(src[i], std::is_integral<S>());
+      } else {
+        for(size_t i=0; i<n; ++i) dst[i] = clampReal<D>(src[i]*scale + offset, std::is_integral<D>());
+      }
+    }// end: loop
+
+
+#ifdef __SSE2__
+    // the SSE2 kernels: 8 pixels at a time through four 32-bit lanes, the scalar loop does the rest
+
+    inline __m128 affine(const __m128 &v, const __m128 &s, const __m128 &o, const bool &plain) {
+      return plain ? v : _mm_add_ps(_mm_mul_ps(v, s), o);
+    }
+
+    template<typename S>
+    size_t toFloat(const S *src, float *dst, const size_t &n, const bool &plain, const float &scale,
+                   const float &offset);
+
+    template<>
+    size_t toFloat<uint8_t>(const uint8_t *src, float *dst, const size_t &n, const bool &plain,
+                            const float &scale, const float &offset) {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+      size_t i = 0;
+      for(; i+16<=n; i+=16) {
+        const __m128i b = _mm_loadu_si128((const __m128i *)(src+i));
+        const __m128i lo = _mm_unpacklo_epi8(b, zero), hi = _mm_unpackhi_epi8(b, zero);
+        _mm_storeu_ps(dst+i,    affine(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), s, o, plain));
+        _mm_storeu_ps(dst+i+4,  affine(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), s, o, plain));
+        _mm_storeu_ps(dst+i+8,  affine(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), s, o, plain));
+        _mm_storeu_ps(dst+i+12, affine(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), s, o, plain));
+      }// endfor: i
+      return i;
+    }
+
+    template<>
+    size_t toFloat<uint16_t>(const uint16_t *src, float *dst, const size_t &n, const bool &plain,
+                             const float &scale, const float &offset) {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+      size_t i = 0;
+      for(; i+8<=n; i+=8) {
+        const __m128i w = _mm_loadu_si128((const __m128i *)(src+i));
+        _mm_storeu_ps(dst+i,   affine(_mm_cvtepi32_ps(_mm_unpacklo_epi16(w, zero)), s, o, plain));
+        _mm_storeu_ps(dst+i+4, affine(_mm_cvtepi32_ps(_mm_unpackhi_epi16(w, zero)), s, o, plain));
+      }// endfor: i
+      return i;
+    }
+
+    template<>
+    size_t toFloat<int16_t>(const int16_t *src, float *dst, const size_t &n, const bool &plain,
+                            const float &scale, const float &offset) {
+      const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+      size_t i = 0;
+      for(; i+8<=n; i+=8) {
+        const __m128i w = _mm_loadu_si128((const __m128i *)(src+i));
+        // the value in the top half of each lane, shifted down with its sign
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16);
+        _mm_storeu_ps(dst+i,   affine(_mm_cvtepi32_ps(lo), s, o, plain));
+        _mm_storeu_ps(dst+i+4, affine(_mm_cvtepi32_ps(hi), s, o, plain));
+      }// endfor: i
+      return i;
+    }
+
+    // clamps four floats to [lo,hi], NaN to 0 (maxps returns its second operand for a NaN), and
+    // truncates them to 32-bit integers
+    inline __m128i clampTruncate(const __m128 &v, const __m128 &lo, const __m128 &hi) {
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 notNaN = _mm_cmpeq_ps(v, v);
+      const __m128 c = _mm_min_ps(_mm_max_ps(v, lo), hi);
+      return _mm_cvttps_epi32(_mm_or_ps(_mm_and_ps(notNaN, c), _mm_andnot_ps(notNaN, zero)));
+    }
+
+    template<typename D>
+    size_t fromFloat(const float *src, D *dst, const size_t &n, const bool &plain, const float &scale,
+                     const float &offset);
+
+    template<>
+    size_t fromFloat<uint8_t>(const float *src, uint8_t *dst, const size_t &n, const bool &plain,
+                              const float &scale, const float &offset) {
+      const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+      const __m128 lo = _mm_set1_ps(0.0f), hi = _mm_set1_ps(255.0f);
+      size_t i = 0;
+      for(; i+16<=n; i+=16) {
+        const __m128i a = clampTruncate(affine(_mm_loadu_ps(src+i),    s, o, plain), lo, hi);
+        const __m128i b = clampTruncate(affine(_mm_loadu_ps(src+i+4),  s, o, plain), lo, hi);
+        const __m128i c = clampTruncate(affine(_mm_loadu_ps(src+i+8),  s, o, plain), lo, hi);
+        const __m128i d = clampTruncate(affine(_mm_loadu_ps(src+i+12), s, o, plain), lo, hi);
+        _mm_storeu_si128((__m128i *)(dst+i),
+                         _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+      }// endfor: i
+      return i;
+    }
+
+    template<>
+    size_t fromFloat<uint16_t>(const float *src, uint16_t *dst, const size_t &n, const bool &plain,
+                               const float &scale, const float &offset) {
+      const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+      const __m128 lo = _mm_set1_ps(0.0f), hi = _mm_set1_ps(65535.0f);
+      // SSE2 only packs to signed 16 bits, so the values are shifted down by 32768 and back
+      const __m128i bias = _mm_set1_epi32(32768);
+      const __m128i flip = _mm_set1_epi16((short)0x8000);
+      size_t i = 0;
+      for(; i+8<=n; i+=8) {
+        const __m128i a = _mm_sub_epi32(clampTruncate(affine(_mm_loadu_ps(src+i),   s, o, plain), lo, hi), bias);
+        const __m128i b = _mm_sub_epi32(clampTruncate(affine(_mm_loadu_ps(src+i+4), s, o, plain), lo, hi), bias);
+        _mm_storeu_si128((__m128i *)(dst+i), _mm_xor_si128(_mm_packs_epi32(a, b), flip));
+      }// endfor: i
+      return i;
+    }
+
+    template<>
+    size_t fromFloat<int16_t>(const float *src, int16_t *dst, const size_t &n, const bool &plain,
+                              const float &scale, const float &offset) {
+      const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+      const __m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+      size_t i = 0;
+      for(; i+8<=n; i+=8) {
+        const __m128i a = clampTruncate(affine(_mm_loadu_ps(src+i),   s, o, plain), lo, hi);
+        const __m128i b = clampTruncate(affine(_mm_loadu_ps(src+i+4), s, o, plain), lo, hi);
+        _mm_storeu_si128((__m128i *)(dst+i), _mm_packs_epi32(a, b));
+      }// endfor: i
+      return i;
+    }
+#endif // __SSE2__
+
+
+    // the vector kernel for the pair, if there is one, then the scalar loop for what is left
+    template<typename S, typename D>
+    struct Converter {
+      static void run(const S *src, D *dst, const size_t &n, const bool &plain, const double &scale,
+                      const double &offset) {
+        loop(src, dst, n, plain, scale, offset);
+      }
+    };
+
+#ifdef __SSE2__
+    template<typename S>
+    struct ToFloatKernel {
+      static void run(const S *src, float *dst, const size_t &n, const bool &plain, const double &scale,
+                      const double &offset) {
+        const size_t done = toFloat(src, dst, n, plain, (float)scale, (float)offset);
+        loop(src+done, dst+done, n-done, plain, scale, offset);
+      }
+    };
+    template<> struct Converter<uint8_t, float> : ToFloatKernel<uint8_t> {};
+    template<> struct Converter<uint16_t, float> : ToFloatKernel<uint16_t> {};
+    template<> struct Converter<int16_t, float> : ToFloatKernel<int16_t> {};
+
+    template<typename D>
+    struct FromFloatKernel {
+      static void run(const float *src, D *dst, const size_t &n, const bool &plain, const double &scale,
+                      const double &offset) {
+        const size_t done = fromFloat(src, dst, n, plain, (float)scale, (float)offset);
+        loop(src+done, dst+done, n-done, plain, scale, offset);
+      }
+    };
+    template<> struct Converter<float, uint8_t> : FromFloatKernel<uint8_t> {};
+    template<> struct Converter<float, uint16_t> : FromFloatKernel<uint16_t> {};
+    template<> struct Converter<float, int16_t> : FromFloatKernel<int16_t> {};
+#endif // __SSE2__
+
+
+    template<typename S>
+    void convertFrom(const S *src, const Kind &to, void *dst, const size_t &n, const bool &plain,
+                     const double &scale, const double &offset) {
+      switch(to) {
+      case U8:  Converter<S, uint8_t>::run(src, (uint8_t *)dst, n, plain, scale, offset); break;
+      case S8:  Converter<S, int8_t>::run(src, (int8_t *)dst, n, plain, scale, offset); break;
+      case U16: Converter<S, uint16_t>::run(src, (uint16_t *)dst, n, plain, scale, offset); break;
+      case S16: Converter<S, int16_t>::run(src, (int16_t *)dst, n, plain, scale, offset); break;
+      case U32: Converter<S, uint32_t>::run(src, (uint32_t *)dst, n, plain, scale, offset); break;
+      case S32: Converter<S, int32_t>::run(src, (int32_t *)dst, n, plain, scale, offset); break;
+      case U64: Converter<S, uint64_t>::run(src, (uint64_t *)dst, n, plain, scale, offset); break;
+      case S64: Converter<S, int64_t>::run(src, (int64_t *)dst, n, plain, scale, offset); break;
+      case F32: Converter<S, float>::run(src, (float *)dst, n, plain, scale, offset); break;
+      case F64: Converter<S, double>::run(src, (double *)dst, n, plain, scale, offset); break;
+      default: break;
+      }// end case
+    }// end: convertFrom
+
+  }// end anonymous namespace
+
+
+
+  bool PixelConvert::supported(const H5::DataType &type) {
+    return kindOf(type) != NONE;
+  }// end: supported
+
+
+
+  bool PixelConvert::convert(const void *src, const H5::DataType &from, void *dst, const H5::DataType &to,
+                             const size_t &n, const double &scale, const double &offset) {
+    const Kind in = kindOf(from), out = kindOf(to);
+    if(in == NONE || out == NONE) return false;
+    GEOSTAR_PROFILE_BYTES("PixelConvert", (double)n*to.getSize());
+    const bool plain = (scale == 1.0 && offset == 0.0);
+
+    switch(in) {
+    case U8:  convertFrom((const uint8_t *)src, out, dst, n, plain, scale, offset); break;
+    case S8:  convertFrom((const int8_t *)src, out, dst, n, plain, scale, offset); break;
+    case U16: convertFrom((const uint16_t *)src, out, dst, n, plain, scale, offset); break;
+    case S16: convertFrom((const int16_t *)src, out, dst, n, plain, scale, offset); break;
+    case U32: convertFrom((const uint32_t *)src, out, dst, n, plain, scale, offset); break;
+    case S32: convertFrom((const int32_t *)src, out, dst, n, plain, scale, offset); break;
+    case U64: convertFrom((const uint64_t *)src, out, dst, n, plain, scale, offset); break;
+    case S64: convertFrom((const int64_t *)src, out, dst, n, plain, scale, offset); break;
+    case F32: convertFrom((const float *)src, out, dst, n, plain, scale, offset); break;
+    case F64: convertFrom((const double *)src, out, dst, n, plain, scale, offset); break;
+    default: break;
+    }// end case
+    return true;
+  }// end: convert
+
+}// end namespace GeoStar
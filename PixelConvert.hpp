@@ -0,0 +1,57 @@
+// PixelConvert.hpp
+//
+// Conversion of pixel buffers between the native numeric types
+//----------------------------------------
+#ifndef PIXELCONVERT_HPP_
+#define PIXELCONVERT_HPP_
+
+#include <cstddef>
+
+#include "H5Cpp.h"
+
+namespace GeoStar {
+
+  /** \brief PixelConvert -- converts pixels between the native integer and float types
+
+  An operator that reads an INT16U raster into a vector<float> needs every pixel converted, and
+  HDF5 does it with its general conversion machinery, buffer by buffer.  PixelConvert does the
+  same conversions in plain loops, with SSE2 kernels for the common ones (8- and 16-bit integers to
+  and from float), and TileCache::copyOut, TileCache::copyIn, the uncached path of
+  Raster::readSelection and Raster::writeSelection, and the ingest in Image::read_file use it, so
+  HDF5 itself only moves pixels in the type they are stored in.
+
+  \see TileCache::copyOut, Raster::readSelection, Image::read_file, RasterType
+
+  \Par Example
+	the DN of a band of 16-bit data as reflectance, 2.0e-5 * DN - 0.1, straight from the raw counts:
+	\code
+	std::vector<uint16_t> dn(n);
+	std::vector<float> refl(n);
+	GeoStar::PixelConvert::convert(&dn[0], H5::PredType::NATIVE_UINT16, &refl[0],
+	                               H5::PredType::NATIVE_FLOAT, n, 2.0e-5, -0.1);
+	\endcode
+
+  \Par Details
+	The results are the ones HDF5 gives: integers saturate at the limits of the target type,
+	floats are truncated towards zero on the way to an integer, and NaN becomes 0 (HDF5 does that
+	for the 8- and 16-bit types, and leaves whatever the CPU gives for the wider ones).  With a scale or
+	offset each pixel becomes scale * value + offset, worked out in double (in float on the SSE2
+	paths) before the saturating cast.  Compound (complex) and non-native types are not handled:
+	convert returns false and the caller goes to HDF5.  src and dst must not overlap.
+  */
+  class PixelConvert {
+
+  public:
+    // true for the native 8- to 64-bit integers, float and double
+    static bool supported(const H5::DataType &type);
+
+    // converts n pixels of from at src into to at dst; false, with nothing done, if either type is
+    // not supported
+    static bool convert(const void *src, const H5::DataType &from, void *dst, const H5::DataType &to,
+                        const size_t &n, const double &scale = 1.0, const double &offset = 0.0);
+
+  }; // end class: PixelConvert
+
+}// end namespace GeoStar
+
+#endif //PIXELCONVERT_HPP_
@@ -0,0 +1,260 @@
+// Profiler.cpp
+//
+// Implementation of the profiling counters
+// Documentation in Profiler.hpp
+//--------------------------------------------
+
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "Exceptions.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    struct Event {
+      const char *name;
+      double start;            // microseconds since the epoch
+      double duration;
+      double bytes;
+    };
+
+    struct Totals {
+      unsigned long calls, hits, misses;
+      double bytes, seconds;
+    };
+
+    // what one thread recorded; only that thread writes it, readers take its lock
+    struct ThreadLog {
+      int id;
+      std::mutex mutex;
+      std::vector<Event> events;
+      std::map<const char *, Totals> totals;
+    };
+
+    struct Registry {
+      std::mutex mutex;
+      std::vector<ThreadLog *> logs;   // kept for the life of the process, like the threads
+      std::atomic<bool> enabled;
+      std::atomic<size_t> eventLimit;
+      std::chrono::steady_clock::time_point epoch;
+      Registry() : enabled(true), eventLimit(1 << 20), epoch(std::chrono::steady_clock::now()) {}
+    };
+
+    Registry &registry() {
+      static Registry r;
+      return r;
+    }
+
+    ThreadLog &threadLog() {
+      static thread_local ThreadLog *log = NULL;
+      if(log == NULL) {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        log = new ThreadLog;
+        log->id = (int)r.logs.size();
+        r.logs.push_back(log);
+      }
+      return *log;
+    }
+
+    inline double now() {
+      return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()
+                                                       - registry().epoch).count();
+    }
+
+    inline Totals &totalsOf(ThreadLog &log, const char *name) {
+      std::map<const char *, Totals>::iterator it = log.totals.find(name);
+      if(it != log.totals.end()) return it->second;
+      Totals &t = log.totals[name];
+      t.calls = t.hits = t.misses = 0;
+      t.bytes = t.seconds = 0;
+      return t;
+    }
+
+    void count(const char *name, const bool &hit) {
+      if(!registry().enabled) return;
+      ThreadLog &log = threadLog();
+      std::lock_guard<std::mutex> lock(log.mutex);
+      Totals &t = totalsOf(log, name);
+      if(hit) ++t.hits;
+      else ++t.misses;
+    }
+
+    // names go into the trace as JSON strings
+    std::string quoted(const std::string &s) {
+      std::string out = "\"";
+      for(size_t i=0; i<s.size(); ++i) {
+        if(s[i] == '"' || s[i] == '\\') out += '\\';
+        out += s[i];
+      }
+      return out + "\"";
+    }
+
+  }// end anonymous namespace
+
+
+
+  bool Profiler::compiled() {
+#ifdef GEOSTAR_PROFILE
+    return true;
+#else
+    return false;
+#endif
+  }// end: compiled
+
+
+
+  void Profiler::set_enabled(const bool &on) {
+    registry().enabled = on;
+  }// end: set_enabled
+
+  bool Profiler::get_enabled() {
+    return registry().enabled;
+  }// end: get_enabled
+
+
+
+  void Profiler::set_event_limit(const size_t &events) {
+    registry().eventLimit = events;
+  }// end: set_event_limit
+
+  size_t Profiler::get_event_limit() {
+    return registry().eventLimit;
+  }// end: get_event_limit
+
+
+
+  void Profiler::reset() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for(size_t i=0; i<r.logs.size(); ++i) {
+      std::lock_guard<std::mutex> logLock(r.logs[i]->mutex);
+      r.logs[i]->events.clear();
+      r.logs[i]->totals.clear();
+    }//endfor: i
+  }// end: reset
+
+
+
+  // the same name from two translation units may be two pointers, so they meet by value here
+  std::vector<Profiler::Counter> Profiler::counters(const bool &perThread) {
+    Registry &r = registry();
+    std::map<std::pair<std::string, int>, Counter> merged;
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for(size_t i=0; i<r.logs.size(); ++i) {
+      ThreadLog &log = *r.logs[i];
+      std::lock_guard<std::mutex> logLock(log.mutex);
+      for(std::map<const char *, Totals>::const_iterator it = log.totals.begin(); it != log.totals.end(); ++it) {
+        const int thread = perThread ? log.id : -1;
+        std::map<std::pair<std::string, int>, Counter>::iterator m =
+          merged.find(std::make_pair(std::string(it->first), thread));
+        if(m == merged.end()) {
+          Counter c = {it->first, thread, 0, 0, 0, 0, 0};
+          m = merged.insert(std::make_pair(std::make_pair(c.name, thread), c)).first;
+        }
+        m->second.calls += it->second.calls;
+        m->second.bytes += it->second.bytes;
+        m->second.seconds += it->second.seconds;
+        m->second.hits += it->second.hits;
+        m->second.misses += it->second.misses;
+      }//endfor: it
+    }//endfor: i
+
+    std::vector<Counter> out;
+    for(std::map<std::pair<std::string, int>, Counter>::const_iterator m = merged.begin(); m != merged.end(); ++m)
+      out.push_back(m->second);
+    return out;
+  }// end: counters
+
+
+
+  void Profiler::report(std::ostream &out) {
+    std::vector<Counter> c = counters();
+    std::stable_sort(c.begin(), c.end(), [](const Counter &a, const Counter &b) {
+        return a.seconds > b.seconds;
+      });
+    if(!compiled()) out << "(built without GEOSTAR_PROFILE)\n";
+    out << std::left << std::setw(28) << "name" << std::right << std::setw(10) << "calls"
+        << std::setw(12) << "seconds" << std::setw(12) << "MB" << std::setw(10) << "MB/s"
+        << std::setw(10) << "hits" << std::setw(10) << "misses" << "\n";
+    for(size_t i=0; i<c.size(); ++i) {
+      const double mb = c[i].bytes / 1048576.0;
+      out << std::left << std::setw(28) << c[i].name << std::right << std::setw(10) << c[i].calls
+          << std::fixed << std::setprecision(4) << std::setw(12) << c[i].seconds
+          << std::setprecision(1) << std::setw(12) << mb
+          << std::setw(10) << ((c[i].seconds > 0) ? mb / c[i].seconds : 0.0)
+          << std::setw(10) << c[i].hits << std::setw(10) << c[i].misses << "\n";
+      out.unsetf(std::ios::floatfield);
+    }//endfor: i
+  }// end: report
+
+
+
+  void Profiler::writeChromeTrace(const std::string &file) {
+    FileCreationErrorException FileCreationError;
+    std::ofstream out(file.c_str());
+    if(!out) throw FileCreationError;
+
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    for(size_t i=0; i<r.logs.size(); ++i) {
+      ThreadLog &log = *r.logs[i];
+      std::lock_guard<std::mutex> logLock(log.mutex);
+      out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+          << log.id << ", \"args\": {\"name\": \"thread " << log.id << "\"}}";
+      first = false;
+      for(size_t e=0; e<log.events.size(); ++e) {
+        const Event &ev = log.events[e];
+        out << ",\n{\"name\": " << quoted(ev.name) << ", \"cat\": \"geostar\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+            << log.id << ", \"ts\": " << ev.start << ", \"dur\": " << ev.duration
+            << ", \"args\": {\"bytes\": " << std::setprecision(0) << ev.bytes << "}}" << std::setprecision(3);
+      }//endfor: e
+    }//endfor: i
+    out << "\n]}\n";
+  }// end: writeChromeTrace
+
+
+
+  Profiler::Scope::Scope(const char *n, const double &b) : name(n), bytes(b), start(-1) {
+    if(registry().enabled) start = now();
+  }// end: Scope
+
+
+  Profiler::Scope::~Scope() {
+    if(start < 0) return;
+    const double duration = now() - start;
+    ThreadLog &log = threadLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+    Totals &t = totalsOf(log, name);
+    ++t.calls;
+    t.bytes += bytes;
+    t.seconds += duration * 1e-6;
+    if(log.events.size() < registry().eventLimit) {
+      Event ev = {name, start, duration, bytes};
+      log.events.push_back(ev);
+    }
+  }// end: ~Scope
+
+
+
+  void Profiler::hit(const char *name) {
+    count(name, true);
+  }// end: hit
+
+  void Profiler::miss(const char *name) {
+    count(name, false);
+  }// end: miss
+
+}// end namespace GeoStar
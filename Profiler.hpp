@@ -0,0 +1,118 @@
+// Profiler.hpp
+//
+// Optional timers and counters on the I/O paths and the operators
+//----------------------------------------
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace GeoStar {
+
+  /** \brief Profiler -- calls, bytes, time and cache hits of the hot paths, per operator and thread
+
+  Built with GEOSTAR_PROFILE defined (make PROF=-DGEOSTAR_PROFILE), the I/O paths and the
+  operators time themselves: each Raster read and write, the HDF5 transfers and PixelConvert
+  conversions beneath them, the tile cache, Image::read_file, the FFT plans, and each operator
+  (Raster::thresh, Kernel::apply, FFT::forwardReal, ...).  Every timed region is one event,
+  kept by the thread it ran on, and the events add up to one counter per name and thread:
+  calls, bytes moved, seconds, and for caches hits and misses.
+
+  Without GEOSTAR_PROFILE the GEOSTAR_PROFILE_ macros are empty and cost nothing; the Profiler
+  functions still link, and report nothing was recorded.
+
+  \see ThreadPool, TileCache, FFT
+
+  \Par Example
+	where did the time of a filter go:
+	\code
+	GeoStar::Profiler::reset();
+	ras->medianFilter(out, 3);
+	GeoStar::Profiler::report(std::cout);
+	GeoStar::Profiler::writeChromeTrace("median.json");   // open in chrome://tracing or Perfetto
+	\endcode
+
+  \Par Details
+	Times are inclusive: Raster::read under Kernel::apply is counted in both.  Bytes are the
+	pixels a region moved in its memory type, and are 0 for the operators themselves.  Each thread
+	records into its own log behind its own, uncontended, lock, so profiling does not serialise
+	the pool.  Threads are numbered in the order they first recorded, the calling thread usually
+	0.  A thread keeps at most event_limit events for the trace (default 1M); later events
+	still count in the totals.
+  */
+  class Profiler {
+
+  public:
+    struct Counter {
+      std::string name;
+      int thread;              // -1 for the sum over all threads
+      unsigned long calls;
+      double bytes;
+      double seconds;
+      unsigned long hits;
+      unsigned long misses;
+    };
+
+    // whether the library was built with GEOSTAR_PROFILE
+    static bool compiled();
+
+    // recording may be paused, and is on to begin with
+    static void set_enabled(const bool &on);
+    static bool get_enabled();
+
+    static void set_event_limit(const size_t &events);
+    static size_t get_event_limit();
+
+    // forgets every event and counter
+    static void reset();
+
+    // one counter per name, summed over threads, or one per name and thread; sorted by name
+    static std::vector<Counter> counters(const bool &perThread = false);
+
+    // a table of the counters summed over threads, the longest first
+    static void report(std::ostream &out);
+
+    // the events in the Chrome trace event format
+    static void writeChromeTrace(const std::string &file);
+
+    // a timed region, from construction to destruction; name must outlive the Profiler
+    class Scope {
+    public:
+      Scope(const char *name, const double &bytes = 0);
+      ~Scope();
+
+    private:
+      const char *name;
+      double bytes;
+      double start;           // negative while recording is paused
+
+      Scope(const Scope &);
+      Scope &operator=(const Scope &);
+    }; // end class: Scope
+
+    static void hit(const char *name);
+    static void miss(const char *name);
+
+  }; // end class: Profiler
+
+}// end namespace GeoStar
+
+
+// a Scope to the end of the enclosing block, named by its line so that blocks may nest
+#ifdef GEOSTAR_PROFILE
+#define GEOSTAR_PROFILE_JOIN2(a, b) a##b
+#define GEOSTAR_PROFILE_JOIN(a, b) GEOSTAR_PROFILE_JOIN2(a, b)
+#define GEOSTAR_PROFILE_SCOPE(name) GeoStar::Profiler::Scope GEOSTAR_PROFILE_JOIN(geostar_profile_, __LINE__)(name)
+#define GEOSTAR_PROFILE_BYTES(name, bytes) GeoStar::Profiler::Scope GEOSTAR_PROFILE_JOIN(geostar_profile_, __LINE__)(name, bytes)
+#define GEOSTAR_PROFILE_HIT(name) GeoStar::Profiler::hit(name)
+#define GEOSTAR_PROFILE_MISS(name) GeoStar::Profiler::miss(name)
+#else
+#define GEOSTAR_PROFILE_SCOPE(name) do {} while(0)
+#define GEOSTAR_PROFILE_BYTES(name, bytes) do {} while(0)
+#define GEOSTAR_PROFILE_HIT(name) do {} while(0)
+#define GEOSTAR_PROFILE_MISS(name) do {} while(0)
+#endif
+
+#endif //PROFILER_HPP_
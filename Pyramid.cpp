@@ -0,0 +1,302 @@
+// Pyramid.cpp
+//
+// Implementation of the single-pass pyramid builder
+// Documentation in Pyramid.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "Kernel.hpp"
+#include "Neighborhood.hpp"
+#include "Pyramid.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    // the 1 4 6 4 1 binomial taps of Raster::downsample
+    const double TAP[5] = {1.0/16, 4.0/16, 6.0/16, 4.0/16, 1.0/16};
+
+    typedef std::map<long int, std::vector<double> > RowMap;
+
+    // output rows are made one at a time and written in bands
+    class BandWriter {
+    public:
+      BandWriter() : ras(NULL), nx(0), y0(0), rows(0), band(0) {}
+
+      void open(Raster *r) {
+        ras = r;
+        if(ras == NULL) return;
+        nx = ras->get_nx();
+        band = ras->get_chunk_ny();
+        if(band <= 0) band = std::max(1L, (1L << 20) / nx);
+        buf.resize(band*nx);
+      }
+
+      void push(const double *row) {
+        if(ras == NULL) return;
+        std::copy(row, row+nx, buf.begin() + rows*nx);
+        if(++rows == band) flush();
+      }
+
+      void flush() {
+        if(ras == NULL || rows == 0) return;
+        ras->write(Slice(0, y0, nx, rows), &buf[0]);
+        y0 += rows;
+        rows = 0;
+      }
+
+    private:
+      Raster *ras;
+      long int nx, y0, rows, band;
+      std::vector<double> buf;
+    };
+
+
+    struct Level {
+      long int nx, ny;
+
+      // level k >= 1: rows of level k-1 filtered along the row and decimated, by row of level k-1
+      RowMap stage;
+      long int parentRows;     // rows of level k-1 seen so far
+      long int next;           // next row of this level to make
+      std::vector<long int> stageIndex;    // 5 source columns of level k-1 per column
+
+      // residual: this level's rows, and level k+1's rows expanded along the row, by row
+      bool residual;
+      RowMap own, expanded;
+      long int ownRows, childRows, nextResidual;
+      std::vector<long int> expandIndex;   // 5 source columns of level k+1 per column, -1 for 0
+
+      BandWriter gaussOut, laplaceOut;
+    };
+
+
+    // the row of level k standing in for virtual row v of level k+1 with rows of level k at its
+    // odd rows, or -1 for a zero row.  ny is the height of level k.
+    inline long int expandSource(const long int &v, const long int &ny) {
+      const long int m = borderIndex(v, ny, BORDER_REFLECT);
+      return (m % 2) ? m/2 : -1;
+    }
+
+
+    class Cascade {
+    public:
+      Cascade(const std::vector<Level *> &levels) : L(levels), top(levels.size()-1) {}
+
+      // row y of level k has been made; stage, when given, is that row already filtered for
+      // level k+1.
+      void feed(const long int &k, const long int &y, const double *row, const double *stage = NULL) {
+        Level &lev = *L[k];
+        if(k > 0) lev.gaussOut.push(row);
+
+        if(k == top) {
+          lev.laplaceOut.push(row);
+        } else if(lev.residual) {
+          lev.own[y].assign(row, row+lev.nx);
+          ++lev.ownRows;
+        }
+
+        if(k > 0 && L[k-1]->residual) {
+          Level &parent = *L[k-1];
+          std::vector<double> &e = parent.expanded[y];
+          e.assign(parent.nx, 0.0);
+          for(long int x=0; x<parent.nx; ++x) {
+            double sum = 0.0;
+            for(int i=0; i<5; ++i) {
+              const long int s = parent.expandIndex[5*x + i];
+              if(s >= 0) sum += 2.0*TAP[i]*row[s];
+            }
+            e[x] = sum;
+          }// endfor: x
+          ++parent.childRows;
+          residuals(k-1);
+        }
+
+        if(k < top) {
+          Level &child = *L[k+1];
+          std::vector<double> &s = child.stage[y];
+          if(stage != NULL) {
+            s.assign(stage, stage+child.nx);
+          } else {
+            s.resize(child.nx);
+            for(long int x=0; x<child.nx; ++x) {
+              const long int *ix = &child.stageIndex[5*x];
+              s[x] = TAP[0]*row[ix[0]] + TAP[1]*row[ix[1]] + TAP[2]*row[ix[2]]
+                + TAP[3]*row[ix[3]] + TAP[4]*row[ix[4]];
+            }// endfor: x
+          }
+          ++child.parentRows;
+          gaussians(k+1);
+        }
+
+        if(lev.residual && k < top) residuals(k);
+      }// end: feed
+
+    private:
+      const std::vector<Level *> &L;
+      const long int top;
+
+      // makes every row of level k >= 1 whose five source rows have arrived
+      void gaussians(const long int &k) {
+        Level &lev = *L[k];
+        const long int parentNy = L[k-1]->ny;
+        std::vector<double> out(lev.nx);
+        while(lev.next < lev.ny) {
+          const long int y = lev.next;
+          long int src[5];
+          bool ready = true;
+          for(int i=0; i<5; ++i) {
+            src[i] = borderIndex(2*y+1 + i-2, parentNy, BORDER_REFLECT);
+            if(src[i] >= lev.parentRows) ready = false;
+          }
+          if(!ready) break;
+
+          const double *p[5];
+          for(int i=0; i<5; ++i) p[i] = &lev.stage[src[i]][0];
+          for(long int x=0; x<lev.nx; ++x) {
+            out[x] = TAP[0]*p[0][x] + TAP[1]*p[1][x] + TAP[2]*p[2][x] + TAP[3]*p[3][x] + TAP[4]*p[4][x];
+          }
+          ++lev.next;
+
+          // rows below every source row of the next output row are done with
+          if(lev.next < lev.ny) {
+            long int keep = parentNy;
+            for(int i=0; i<5; ++i) {
+              keep = std::min(keep, borderIndex(2*lev.next+1 + i-2, parentNy, BORDER_REFLECT));
+            }
+            lev.stage.erase(lev.stage.begin(), lev.stage.lower_bound(keep));
+          } else {
+            lev.stage.clear();
+          }
+
+          feed(k, y, &out[0]);
+        }// endwhile
+      }// end: gaussians
+
+      // makes every residual row of level k whose own and expanded rows have arrived
+      void residuals(const long int &k) {
+        Level &lev = *L[k];
+        std::vector<double> out(lev.nx);
+        while(lev.nextResidual < lev.ny) {
+          const long int v = lev.nextResidual;
+          if(v >= lev.ownRows) break;
+          long int src[5];
+          bool ready = true;
+          for(int i=0; i<5; ++i) {
+            src[i] = expandSource(v + i-2, lev.ny);
+            if(src[i] >= lev.childRows) ready = false;
+          }
+          if(!ready) break;
+
+          const std::vector<double> &own = lev.own[v];
+          std::copy(own.begin(), own.end(), out.begin());
+          for(int i=0; i<5; ++i) {
+            if(src[i] < 0) continue;
+            const double w = 2.0*TAP[i];
+            const double *e = &lev.expanded[src[i]][0];
+            for(long int x=0; x<lev.nx; ++x) out[x] -= w*e[x];
+          }// endfor: i
+          lev.laplaceOut.push(&out[0]);
+          lev.own.erase(v);
+          ++lev.nextResidual;
+
+          long int keep = lev.ny;
+          for(long int u=lev.nextResidual-2; u<=lev.nextResidual+2; ++u) {
+            const long int s = expandSource(u, lev.ny);
+            if(s >= 0) keep = std::min(keep, s);
+          }
+          lev.expanded.erase(lev.expanded.begin(), lev.expanded.lower_bound(keep));
+        }// endwhile
+      }// end: residuals
+    };
+
+  }// end anonymous namespace
+
+
+
+  void Pyramid::build(const Raster *base, const std::vector<Raster *> &gauss,
+                      const std::vector<Raster *> &laplace) {
+    GEOSTAR_PROFILE_SCOPE("Pyramid::build");
+    RasterSizeErrorException RasterSizeError;
+    const long int top = (long int)std::max(gauss.size(), laplace.size()) - 1;
+    if(top < 1) return;
+
+    // the levels, checking every output raster against its level's size
+    std::vector<Level> levels(top+1);
+    std::vector<Level *> L(top+1);
+    for(long int k=0; k<=top; ++k) {
+      Level &lev = levels[k];
+      L[k] = &lev;
+      lev.nx = base->get_nx() >> k;
+      lev.ny = base->get_ny() >> k;
+      if(lev.nx < 1 || lev.ny < 1) throw RasterSizeError;
+      lev.parentRows = lev.next = 0;
+      lev.ownRows = lev.childRows = lev.nextResidual = 0;
+
+      Raster *g = (k > 0 && k < (long int)gauss.size()) ? gauss[k] : NULL;
+      Raster *l = (k < (long int)laplace.size()) ? laplace[k] : NULL;
+      if(g != NULL && (g->get_nx() != lev.nx || g->get_ny() != lev.ny)) throw RasterSizeError;
+      if(l != NULL && (l->get_nx() != lev.nx || l->get_ny() != lev.ny)) throw RasterSizeError;
+      lev.gaussOut.open(g);
+      lev.laplaceOut.open(l);
+      lev.residual = (l != NULL && k < top);
+    }// endfor: k
+
+    for(long int k=0; k<=top; ++k) {
+      Level &lev = levels[k];
+      if(k > 0) {
+        const long int parentNx = levels[k-1].nx;
+        lev.stageIndex.resize(5*lev.nx);
+        for(long int x=0; x<lev.nx; ++x) {
+          for(int i=0; i<5; ++i) lev.stageIndex[5*x + i] = borderIndex(2*x+1 + i-2, parentNx, BORDER_REFLECT);
+        }
+      }
+      if(lev.residual) {
+        lev.expandIndex.resize(5*lev.nx);
+        for(long int x=0; x<lev.nx; ++x) {
+          for(int i=0; i<5; ++i) lev.expandIndex[5*x + i] = expandSource(x + i-2, lev.nx);
+        }
+      }
+    }// endfor: k
+
+    // stream the base through the cascade, band by band.  The band's rows are filtered for level
+    // 1 in parallel, then handed up one at a time.
+    Cascade cascade(L);
+    const long int nx1 = levels[1].nx;
+    RowWindow win(base, 2, 0, BORDER_REFLECT);
+    std::vector<double> stage;
+    while(win.next()) {
+      const long int rows = win.rows();
+      stage.resize(rows*nx1);
+      parallel_for(rows, [&](long int begin, long int end) {
+          for(long int r=begin; r<end; ++r) {
+            const double *p = win.row(r);
+            double *s = &stage[r*nx1];
+            for(long int x=0; x<nx1; ++x) {
+              const double *q = p + 2*x+1;
+              s[x] = TAP[0]*q[0] + TAP[1]*q[1] + TAP[2]*q[2] + TAP[3]*q[3] + TAP[4]*q[4];
+            }
+          }// endfor: r
+        }, 4);
+
+      for(long int r=0; r<rows; ++r) {
+        cascade.feed(0, win.y0()+r, win.row(r)+2, &stage[r*nx1]);
+      }
+    }// endwhile
+
+    for(long int k=0; k<=top; ++k) {
+      levels[k].gaussOut.flush();
+      levels[k].laplaceOut.flush();
+    }
+  }// end: build
+
+}// end namespace GeoStar
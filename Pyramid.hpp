@@ -0,0 +1,57 @@
+// Pyramid.hpp
+//
+// Single-pass Gaussian and Laplacian pyramid builder
+//----------------------------------------
+#ifndef PYRAMID_HPP_
+#define PYRAMID_HPP_
+
+#include <vector>
+
+namespace GeoStar {
+  class Raster;
+
+  /** \brief Pyramid -- builds every level of a Gaussian and Laplacian pyramid in one pass
+
+  Level k+1 of the Gaussian pyramid is level k blurred with the 5x5 binomial kernel and decimated
+  by two, exactly as Raster::downsample makes it.  The Laplacian residual of level k is level k
+  minus level k+1 expanded back to the size of level k, as Raster::upsample does it, and the top of
+  the Laplacian pyramid is the top Gaussian level itself, so the base can be rebuilt from the
+  residuals.
+
+  \see Raster::gaussianPyramid, Raster::laplacianPyramid, Raster::downsample, Raster::upsample
+
+  \Par Example
+	the four Gaussian levels above ras, and its five-level Laplacian pyramid, from one read of ras:
+	\code
+	std::vector<GeoStar::Raster *> gauss(5), laplace(5);
+	for(int k=1; k<5; ++k) gauss[k] = img->create_raster("G" + std::to_string(k), GeoStar::REAL32,
+	                                                      ras->get_nx() >> k, ras->get_ny() >> k);
+	for(int k=0; k<5; ++k) laplace[k] = img->create_raster("L" + std::to_string(k), GeoStar::REAL32,
+	                                                        ras->get_nx() >> k, ras->get_ny() >> k);
+	GeoStar::Pyramid::build(ras, gauss, laplace);
+	\endcode
+
+  \Par Details
+	The base is read once, in bands, and each row is cascaded up through the levels as soon as it
+	arrives: a level keeps only the five filtered rows of the level below that its next row needs,
+	and, when it has a residual, the handful of its own and expanded rows the next residual row
+	needs.  Memory is a few rows per level whatever the size of the raster, no level is read back
+	from the file, and the base is never written.  Output rows are written in bands.  The filtering
+	of the base rows, which is three quarters of the work, is spread over the File::set_num_threads
+	pool; all HDF5 access is on the calling thread.  Borders are reflected, as in downsample.
+  */
+  class Pyramid {
+
+  public:
+    // levels 1 .. gauss.size()-1 of the Gaussian pyramid of base go to gauss[k], and the
+    // Laplacian residuals to laplace[k].  Either vector may be empty, and any entry may be NULL
+    // for a level that is not wanted; gauss[0] is the base and is ignored.  Level k must be
+    // (nx >> k) by (ny >> k).
+    static void build(const Raster *base, const std::vector<Raster *> &gauss,
+                      const std::vector<Raster *> &laplace);
+
+  }; // end class: Pyramid
+
+}// end namespace GeoStar
+
+#endif //PYRAMID_HPP_
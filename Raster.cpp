@@ -11,6 +11,11 @@
 #include <cmath>
 #include <string.h>
 #include <cstdlib>
+#include <random>
+#include <thread>
+#include <map>
+#include <mutex>
+#include <algorithm>
 
 #include "H5Cpp.h"
 #include "Exceptions.hpp"
@@ -19,20 +24,107 @@
 #include "File.hpp"
 
 #include "attributes.hpp"
+#include "ThreadPool.hpp"
+#include "FFT.hpp"
+#include "Pyramid.hpp"
+#include "IntegralImage.hpp"
+#include "DrawBatch.hpp"
+#include "Noise.hpp"
+#include "LUT.hpp"
+#include "TileCache.hpp"
+#include "PixelConvert.hpp"
+#include "Profiler.hpp"
+#include "BlockStream.hpp"
 //#include <opencv2/opencv.hpp>
 #include <fftw3.h>
 #include <complex>
 
 namespace GeoStar {
 
-  Raster::Raster(Image *image, const std::string &name){
+  // smallest prime >= n, used to size the HDF5 chunk-cache hash table.
+  static size_t nextPrime(size_t n) {
+    if(n < 3) return 3;
+    for(;;++n) {
+      bool prime = true;
+      for(size_t d=2; d*d<=n; ++d) {
+        if(n % d == 0) { prime = false; break; }
+      }// endfor: d
+      if(prime) return n;
+    }// endfor: n
+  }// end: nextPrime
+
+
+  // opens a raster dataset of the image.
+  // chunked datasets get a chunk cache that holds one full row of chunks,
+  // so a scanline pass only decompresses each chunk once.
+  static H5::DataSet *openRasterDataset(Image *image, const std::string &name) {
+    H5::DataSet dataset = image->openDataset(name);
+    H5::DSetCreatPropList plist = dataset.getCreatePlist();
+    if(plist.getLayout() != H5D_CHUNKED) return new H5::DataSet(dataset);
+
+    hsize_t chunk[2];
+    plist.getChunk(2, chunk);
+    hsize_t dims[2];
+    dataset.getSpace().getSimpleExtentDims(dims);
+
+    size_t chunksPerRow = (dims[1] + chunk[1] - 1) / chunk[1];
+    size_t nbytes = chunksPerRow * chunk[0] * chunk[1] * dataset.getDataType().getSize();
+    if(nbytes < 1024*1024) nbytes = 1024*1024; // never below the HDF5 default
+
+    // HDF5 recommends ~100 hash slots per cached chunk, and a prime count.
+    H5::DSetAccPropList access;
+    access.setChunkCache(nextPrime(100 * chunksPerRow), nbytes, 1.0);
+    return new H5::DataSet(image->openDataset(name, access));
+  }// end: openRasterDataset
+
+
+  // complex pixels are stored as an HDF5 compound of two members, "r" and "i", of the part type.
+  // the compound has the layout of std::complex<part>, so buffers are read and written directly.
+  static H5::CompType complexPixelType(const H5::PredType &part) {
+    size_t size = part.getSize();
+    H5::CompType type(2*size);
+    type.insertMember("r", 0, part);
+    type.insertMember("i", size, part);
+    return type;
+  }// end: complexPixelType
+
+
+  // the RasterType matching the stored type of an existing dataset
+  static RasterType storedRasterType(const H5::DataSet *dataset) {
+    H5::DataType type = dataset->getDataType();
+    size_t size = type.getSize();
+    if(type.getClass() == H5T_INTEGER) {
+      bool isSigned = (dataset->getIntType().getSign() == H5T_SGN_2);
+      switch(size) {
+      case 1: return isSigned ? INT8S : INT8U;
+      case 2: return isSigned ? INT16S : INT16U;
+      case 4: return isSigned ? INT32S : INT32U;
+      default: return isSigned ? INT64S : INT64U;
+      }
+    }
+    if(type.getClass() == H5T_COMPOUND) {
+      H5::CompType ctype = dataset->getCompType();
+      bool isFloat = (ctype.getMemberClass(0) == H5T_FLOAT);
+      switch(size) {
+      case 2:  return COMPLEX_INT16;
+      case 4:  return COMPLEX_INT32;
+      case 8:  return isFloat ? COMPLEX_REAL64 : COMPLEX_INT64;
+      default: return isFloat ? COMPLEX_REAL128 : COMPLEX_INT128;
+      }
+    }
+    if(type.getClass() == H5T_FLOAT && size == 8) return REAL64;
+    return REAL32;
+  }// end: storedRasterType
+
+
+  Raster::Raster(Image *image, const std::string &name) : parent_group(*image->imageobj) {
     RasterOpenErrorException RasterOpenError;
     RasterDoesNotExistException RasterDoesNotExist;
 
     if(!image->datasetExists(name)) throw RasterDoesNotExist;
 
     // check if its a valid Raster:
-    rasterobj = new H5::DataSet(image->openDataset(name));
+    rasterobj = openRasterDataset(image, name);
     if(read_object_type() != "geostar::raster") {
       delete rasterobj;
       throw RasterOpenError;
@@ -40,7 +132,9 @@ namespace GeoStar {
 
     // finish setting object-specific data:
     rastername = name;
+    raster_datatype = storedRasterType(rasterobj);
     rastertype = "geostar::raster";
+    cache_metadata();
 
   }// end-Raster-constructor
 
@@ -48,12 +142,14 @@ namespace GeoStar {
 
 
   Raster::Raster(Image *image, const std::string &name, const RasterType &type,
-           const int &nx, const int &ny){
+                 const int &nx, const int &ny, const RasterCreateOptions &options)
+    : parent_group(*image->imageobj) {
 
     RasterCreationErrorException RasterCreationError;
     RasterExistsException RasterExistsError;
 
     if(image->datasetExists(name)) throw RasterExistsError;
+    if(options.deflate < 0 || options.deflate > 9) throw RasterCreationError;
 
     // create a 2D dataset
     hsize_t dims[2];
@@ -61,23 +157,92 @@ namespace GeoStar {
     dims[1] = nx;
     H5::DataSpace dataspace(2, dims);
 
+    H5::DataType h5Type;
     switch(type) {
     case INT8U:
-      rasterobj = new H5::DataSet(image->createDataset(name, H5::PredType::NATIVE_UINT8, dataspace));
+      h5Type.copy(H5::PredType::NATIVE_UINT8);
+      break;
+    case INT8S:
+      h5Type.copy(H5::PredType::NATIVE_INT8);
       break;
     case INT16U:
-      rasterobj = new H5::DataSet(image->createDataset(name, H5::PredType::NATIVE_UINT16, dataspace));
+      h5Type.copy(H5::PredType::NATIVE_UINT16);
+      break;
+    case INT16S:
+      h5Type.copy(H5::PredType::NATIVE_INT16);
+      break;
+    case INT32U:
+      h5Type.copy(H5::PredType::NATIVE_UINT32);
+      break;
+    case INT32S:
+      h5Type.copy(H5::PredType::NATIVE_INT32);
+      break;
+    case INT64U:
+      h5Type.copy(H5::PredType::NATIVE_UINT64);
+      break;
+    case INT64S:
+      h5Type.copy(H5::PredType::NATIVE_INT64);
       break;
     case REAL32:
-      rasterobj = new H5::DataSet(image->createDataset(name, H5::PredType::NATIVE_FLOAT, dataspace));
+      h5Type.copy(H5::PredType::NATIVE_FLOAT);
+      break;
+    case REAL64:
+      h5Type.copy(H5::PredType::NATIVE_DOUBLE);
+      break;
+    // complex types are named by their total size: COMPLEX_INT16 is two 8-bit integers
+    case COMPLEX_INT16:
+      h5Type.copy(complexPixelType(H5::PredType::NATIVE_INT8));
+      break;
+    case COMPLEX_INT32:
+      h5Type.copy(complexPixelType(H5::PredType::NATIVE_INT16));
+      break;
+    case COMPLEX_INT64:
+      h5Type.copy(complexPixelType(H5::PredType::NATIVE_INT32));
+      break;
+    case COMPLEX_INT128:
+      h5Type.copy(complexPixelType(H5::PredType::NATIVE_INT64));
+      break;
+    case COMPLEX_REAL64:
+      h5Type.copy(complexPixelType(H5::PredType::NATIVE_FLOAT));
+      break;
+    case COMPLEX_REAL128:
+      h5Type.copy(complexPixelType(H5::PredType::NATIVE_DOUBLE));
       break;
     default:
       throw RasterCreationError;
     }// end case
 
+    // storage layout: chunked and/or compressed if requested
+    H5::DSetCreatPropList plist;
+    if(options.isChunked()) {
+      hsize_t chunk[2];
+      chunk[0] = (options.chunkY > 0) ? options.chunkY : 256;
+      chunk[1] = (options.chunkX > 0) ? options.chunkX : 256;
+      // a chunk never needs to be bigger than the raster itself
+      for(int i=0;i<2;++i) {
+        if(chunk[i] > dims[i]) chunk[i] = dims[i];
+        if(chunk[i] < 1) chunk[i] = 1;
+      }// endfor
+      plist.setChunk(2, chunk);
+      if(options.shuffle) plist.setShuffle();
+      if(options.deflate > 0) plist.setDeflate(options.deflate);
+    }// endif
+    if(options.useFill) {
+      if(h5Type.getClass() == H5T_COMPOUND) {
+        const std::complex<double> fill(options.fillValue, 0.0);
+        plist.setFillValue(getHdf5Type<std::complex<double> >(), &fill);
+      } else {
+        plist.setFillValue(H5::PredType::NATIVE_DOUBLE, &options.fillValue);
+      }
+    }// endif
+
+    image->createDataset(name, h5Type, dataspace, plist);
+    rasterobj = openRasterDataset(image, name);
+
     rastername = name;
     raster_datatype=type;
     rastertype = "geostar::raster";
+    cache_metadata();
 
     // set objtype attribute.
     write_object_type(rastertype);
@@ -86,104 +251,442 @@ namespace GeoStar {
 
 
 
- template <>  H5::PredType Raster::getHdf5Type<uint8_t>() {return
+ template <>  const H5::DataType &Raster::getHdf5Type<uint8_t>() {return
 H5::PredType::NATIVE_UINT8;}
-    template <>  H5::PredType Raster::getHdf5Type<int8_t>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<int8_t>() {return
 H5::PredType::NATIVE_INT8;}
-    template <>  H5::PredType Raster::getHdf5Type<uint16_t>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<uint16_t>() {return
 H5::PredType::NATIVE_UINT16;}
-    template <>  H5::PredType Raster::getHdf5Type<int16_t>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<int16_t>() {return
 H5::PredType::NATIVE_INT16;}
-    template <>  H5::PredType Raster::getHdf5Type<uint32_t>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<uint32_t>() {return
 H5::PredType::NATIVE_UINT32;}
-    template <>  H5::PredType Raster::getHdf5Type<int32_t>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<int32_t>() {return
 H5::PredType::NATIVE_INT32;}
-    template <>  H5::PredType Raster::getHdf5Type<uint64_t>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<uint64_t>() {return
 H5::PredType::NATIVE_UINT64;}
-    template <>  H5::PredType Raster::getHdf5Type<int64_t>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<int64_t>() {return
 H5::PredType::NATIVE_INT64;}
-    template <>  H5::PredType Raster::getHdf5Type<float>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<float>() {return
 H5::PredType::NATIVE_FLOAT;}
-    template <>  H5::PredType Raster::getHdf5Type<double>() {return
+    template <>  const H5::DataType &Raster::getHdf5Type<double>() {return
 H5::PredType::NATIVE_DOUBLE;}
 
 
+  // built on first use and kept for the life of the process, like the predefined types
+    template <>  const H5::DataType &Raster::getHdf5Type<std::complex<float> >() {
+    static const H5::CompType *type = new H5::CompType(complexPixelType(H5::PredType::NATIVE_FLOAT));
+    return *type;
+  }
+    template <>  const H5::DataType &Raster::getHdf5Type<std::complex<double> >() {
+    static const H5::CompType *type = new H5::CompType(complexPixelType(H5::PredType::NATIVE_DOUBLE));
+    return *type;
+  }
+
 
 
-  //returns the actual size of the raster in the x-direction
-  long int Raster::get_nx() const {
-    H5::DataSpace space=rasterobj->getSpace();
-    hsize_t dims[2];
-    space.getSimpleExtentDims(dims);
-    return dims[1];
-  }// end: get_nx
 
-  //returns the actual size of the raster in the y-direction
-  long int Raster::get_ny() const {
-    H5::DataSpace space=rasterobj->getSpace();
+  void Raster::cache_metadata() {
+    loaded = NULL;
+    tiles = NULL;
+    stats_stored = false;
+    overviews_stored = false;
+    const ssize_t len = H5Iget_name(parent_group.getId(), NULL, 0);
+    std::vector<char> path(len+1);
+    H5Iget_name(parent_group.getId(), &path[0], len+1);
+    parent_name = &path[0];
+    refresh_metadata();
+    tiles = TileCache::instance().attach(*rasterobj);
+    set_stats_stored(rasterobj->attrExists("statistics") || rasterobj->attrExists("histogram"));
+    const std::string groupName = rastername + ".overviews";
+    set_overviews_stored(rasterobj->attrExists("overviews") ||
+                         H5Lexists(parent_group.getId(), groupName.c_str(), H5P_DEFAULT) > 0);
+  }// end: cache_metadata
+
+
+  void Raster::refresh_metadata() {
+    raster_space = rasterobj->getSpace();
+    const hid_t native = H5Tget_native_type(rasterobj->getDataType().getId(), H5T_DIR_ASCEND);
+    raster_native = H5::DataType(native);
+    H5Tclose(native);
     hsize_t dims[2];
-    space.getSimpleExtentDims(dims);
-    return dims[0];
-  }// end: get_ny
+    raster_space.getSimpleExtentDims(dims);
+    raster_ny = dims[0];
+    raster_nx = dims[1];
+
+    //chunk size, 0 if contiguous
+    raster_chunk_nx = raster_chunk_ny = 0;
+    H5::DSetCreatPropList plist = rasterobj->getCreatePlist();
+    if(plist.getLayout() == H5D_CHUNKED) {
+      hsize_t chunk[2];
+      plist.getChunk(2, chunk);
+      raster_chunk_ny = chunk[0];
+      raster_chunk_nx = chunk[1];
+    }// endif
+  }// end: refresh_metadata
+
+
+
+  // the in-memory copy of a loaded raster
+  struct Raster::Loaded {
+    std::vector<char> block;     // pixels, plus room to align them
+    char *pixels;                // 64-byte aligned, row-major, in the native form of the file type
+    H5::DataType type;
+    size_t pixelSize;
+    bool dirty;                  // changed since it was read or last flushed
+
+    std::thread flusher;         // an asynchronous flush in flight
+    bool flushFailed;
+
+    PixelScratch scratch;        // for converted transfers
+
+    // waits for an asynchronous flush, and reports it if it failed
+    void wait() {
+      RasterWriteErrorException RasterWriteError;
+      if(flusher.joinable()) flusher.join();
+      if(flushFailed) {
+        flushFailed = false;
+        throw RasterWriteError;
+      }
+    }
+  };
+
+
+
+  // another Raster's buffer on the same dataset serves this one too, so no second copy is made
+  void Raster::load() {
+    if(buffer() != NULL) return;
+
+    // the buffer takes over from the raster's cached tiles
+    TileCache::instance().evict(tiles);
+
+    Loaded *mem = new Loaded;
+    try {
+      mem->type = raster_native;
+      mem->pixelSize = mem->type.getSize();
+      mem->dirty = false;
+      mem->flushFailed = false;
+
+      const size_t nbytes = (size_t)raster_nx * raster_ny * mem->pixelSize;
+      mem->block.resize(nbytes + 64);
+      const uintptr_t base = (uintptr_t)&mem->block[0];
+      mem->pixels = &mem->block[0] + ((64 - base % 64) % 64);
+
+      if(nbytes > 0) rasterobj->read(mem->pixels, mem->type);
+    } catch(...) {
+      delete mem;
+      throw;
+    }// end: try
+    loaded = mem;
+    TileCache::instance().set_loaded(tiles, mem);
+  }// end: load
+
+
+
+  // the raster's own buffer, or the one another Raster open on the dataset loaded
+  Raster::Loaded *Raster::buffer() const {
+    if(loaded != NULL || tiles == NULL) return loaded;
+    return (Loaded *)TileCache::instance().get_loaded(tiles);
+  }// end: buffer
+
+
+
+  void Raster::flush(const bool &async) {
+    if(loaded == NULL) return;
+    loaded->wait();
+    if(!loaded->dirty || raster_nx*raster_ny == 0) return;
+
+    hbool_t threadsafe = 0;
+    if(async && H5is_library_threadsafe(&threadsafe) >= 0 && threadsafe) {
+      // the C call, so nothing in the thread touches the C++ wrappers' reference counts
+      Loaded *mem = loaded;
+      const hid_t dataset = rasterobj->getId();
+      const hid_t type = mem->type.getId();
+      mem->dirty = false;
+      mem->flusher = std::thread([mem, dataset, type]() {
+          if(H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, mem->pixels) < 0) {
+            mem->flushFailed = true;
+            mem->dirty = true;
+          }
+        });
+      return;
+    }// endif
+
+    rasterobj->write(loaded->pixels, loaded->type);
+    loaded->dirty = false;
+  }// end: flush
+
+
+
+  void Raster::unload() {
+    if(loaded == NULL) return;
+    flush();
+    TileCache::instance().set_loaded(tiles, NULL);
+    delete loaded;
+    loaded = NULL;
+  }// end: unload
+
+
+
+  // the destructor cannot throw: a failed flush is lost
+  void Raster::release() {
+    if(loaded != NULL) {
+      try {
+        unload();
+      } catch(...) {
+        if(loaded->flusher.joinable()) loaded->flusher.join();
+        TileCache::instance().set_loaded(tiles, NULL);
+        delete loaded;
+        loaded = NULL;
+      }// end: try
+    }// endif
+    try {
+      TileCache::instance().detach(tiles);
+    } catch(...) {
+    }// end: try
+    tiles = NULL;
+  }// end: release
+
+
+
+  void *Raster::loadedPixels(const H5::DataType &type) {
+    Loaded *mem = buffer();
+    if(mem == NULL || !(type == mem->type)) return NULL;
+    statistics_changed();
+    mem->wait();
+    mem->dirty = true;
+    return mem->pixels;
+  }// end: loadedPixels
+
+
+
+  // a loaded raster is served from its buffer, and any other from the tile cache when the
+  // selection suits it, or HDF5.  A write drops the saved statistics.
+  void Raster::readSelection(void *data, const H5::DataType &memtype, const H5::DataSpace &memspace,
+                             const H5::DataSpace &filespace) const {
+    GEOSTAR_PROFILE_BYTES("Raster::read", (double)filespace.getSelectNpoints()*memtype.getSize());
+    if(Loaded *mem = buffer()) {
+      TileCache::copyOut(mem->pixels, mem->type, filespace, data, memtype, memspace, mem->scratch);
+      return;
+    }
+    if(TileCache::instance().read(tiles, data, memtype, memspace, filespace)) return;
+    if(convertsItself(memtype)) {
+      const hsize_t n = filespace.getSelectNpoints();
+      if(n == 0) return;
+      H5::DataSpace packed(1, &n);
+      if(raster_stage.size() < n*raster_native.getSize()) raster_stage.resize(n*raster_native.getSize());
+      {
+        GEOSTAR_PROFILE_BYTES("HDF5::read", (double)n*raster_native.getSize());
+        rasterobj->read(&raster_stage[0], raster_native, packed, filespace);
+      }
+      TileCache::copyOut(&raster_stage[0], raster_native, packed, data, memtype, memspace, raster_scratch);
+      return;
+    }// endif
+    GEOSTAR_PROFILE_BYTES("HDF5::read", (double)filespace.getSelectNpoints()*memtype.getSize());
+    rasterobj->read(data, memtype, memspace, filespace);
+  }// end: readSelection
+
+
+
+  void Raster::writeSelection(const void *data, const H5::DataType &memtype,
+                              const H5::DataSpace &memspace, const H5::DataSpace &filespace) const {
+    GEOSTAR_PROFILE_BYTES("Raster::write", (double)filespace.getSelectNpoints()*memtype.getSize());
+    statistics_changed();
+    if(Loaded *mem = buffer()) {
+      mem->wait();
+      mem->dirty = true;
+      TileCache::copyIn(data, memtype, memspace, mem->pixels, mem->type, filespace, mem->scratch);
+      return;
+    }
+    if(TileCache::instance().write(tiles, data, memtype, memspace, filespace)) return;
+    if(convertsItself(memtype)) {
+      const hsize_t n = filespace.getSelectNpoints();
+      if(n == 0) return;
+      H5::DataSpace packed(1, &n);
+      if(raster_stage.size() < n*raster_native.getSize()) raster_stage.resize(n*raster_native.getSize());
+      TileCache::copyIn(data, memtype, memspace, &raster_stage[0], raster_native, packed, raster_scratch);
+      GEOSTAR_PROFILE_BYTES("HDF5::write", (double)n*raster_native.getSize());
+      rasterobj->write(&raster_stage[0], raster_native, packed, filespace);
+      return;
+    }// endif
+    GEOSTAR_PROFILE_BYTES("HDF5::write", (double)filespace.getSelectNpoints()*memtype.getSize());
+    rasterobj->write(data, memtype, memspace, filespace);
+  }// end: writeSelection
+
+
+
+  // HDF5 only moves pixels in their stored type when PixelConvert can do the conversion
+  bool Raster::convertsItself(const H5::DataType &memtype) const {
+    return !(memtype == raster_native) && PixelConvert::supported(memtype)
+      && PixelConvert::supported(raster_native);
+  }// end: convertsItself
+
+
+
+  Raster::BlockIterator::BlockIterator(const Raster *ras, const long int &blockX,
+                                       const long int &blockY) {
+    nx = ras->get_nx();
+    ny = ras->get_ny();
+
+    blockNx = blockX;
+    blockNy = blockY;
+    if(blockNx <= 0 || blockNy <= 0) {
+      long int cx = ras->get_chunk_nx();
+      long int cy = ras->get_chunk_ny();
+      if(cx > 0 && cy > 0) {
+        // chunked: one block per chunk
+        blockNx = cx;
+        blockNy = cy;
+      } else {
+        // contiguous: full-width bands of about 1M pixels
+        blockNx = nx;
+        blockNy = (nx > 0) ? (1L << 20) / nx : 1;
+      }// endif
+    }// endif
+    if(blockNx > nx) blockNx = nx;
+    if(blockNy > ny) blockNy = ny;
+    if(blockNx < 1) blockNx = 1;
+    if(blockNy < 1) blockNy = 1;
+
+    memdims[0] = 0;
+    memdims[1] = 0;
+    reset();
+  }// end: BlockIterator
+
+
+
+  void Raster::BlockIterator::reset() {
+    started = false;
+    blockSlice[0] = 0;
+    blockSlice[1] = 0;
+    blockSlice[2] = 0;
+    blockSlice[3] = 0;
+  }// end: reset
+
+
+
+  bool Raster::BlockIterator::next() {
+    if(!started) {
+      started = true;
+      if(nx <= 0 || ny <= 0) return false;
+      blockSlice[0] = 0;
+      blockSlice[1] = 0;
+    } else {
+      // left to right, then top to bottom
+      blockSlice[0] += blockNx;
+      if(blockSlice[0] >= nx) {
+        blockSlice[0] = 0;
+        blockSlice[1] += blockNy;
+      }// endif
+      if(blockSlice[1] >= ny) return false;
+    }// endif
+
+    blockSlice[2] = std::min(blockNx, nx - blockSlice[0]);
+    blockSlice[3] = std::min(blockNy, ny - blockSlice[1]);
+    return true;
+  }// end: next
+
+
+
+  H5::DataSpace &Raster::selectSlice(const Slice &slice, const long int &stride,
+                                     H5::DataSpace &memspace) const {
+    SliceSizeException SliceSizeError;
+    const long int rowLength = (stride > 0) ? stride : slice.dx;
+    if (rowLength < slice.dx) throw SliceSizeError;
+
+    // the rows of the caller's buffer, of which the first dx pixels of each are used
+    hsize_t memdims[2] = {(hsize_t)slice.dy, (hsize_t)rowLength};
+    memspace = H5::DataSpace(2, memdims);
+    hsize_t count[2] = {(hsize_t)slice.dy, (hsize_t)slice.dx};
+    if (rowLength > slice.dx) {
+      hsize_t origin[2] = {0, 0};
+      memspace.selectHyperslab(H5S_SELECT_SET, count, origin);
+    }
+
+    hsize_t start[2] = {(hsize_t)slice.y0, (hsize_t)slice.x0};
+    raster_space.selectHyperslab(H5S_SELECT_SET, count, start);
+    return raster_space;
+  }// end: selectSlice
+
+
+
+  H5::DataSpace &Raster::BlockIterator::selectBlock(const Raster *ras) {
+    // memory dataspace only changes at the edges of the raster:
+    if(memdims[0] != (hsize_t)blockSlice[3] || memdims[1] != (hsize_t)blockSlice[2]) {
+      memdims[0] = blockSlice[3];
+      memdims[1] = blockSlice[2];
+      memspace = H5::DataSpace(2, memdims);
+    }// endif
+
+    // the file dataspace the raster keeps for itself:
+    hsize_t count[2];
+    hsize_t start[2];
+    start[0] = blockSlice[1];
+    start[1] = blockSlice[0];
+    count[0] = blockSlice[3];
+    count[1] = blockSlice[2];
+    ras->raster_space.selectHyperslab(H5S_SELECT_SET, count, start);
+    return ras->raster_space;
+  }// end: selectBlock
+
+
+  namespace {
+
+    // 8 and 16-bit integers into a real raster go through a LUT
+    inline bool lookedUp(const Raster *in, const Raster *out) {
+      return LUT::supported(in->get_datatype()) && out->get_datatype() <= REAL64;
+    }
+
+  }// end anonymous namespace
 
 
   // in-place simple threshhold
   // < value : set to 0.
   void Raster::thresh(const double &value) {
-    long int nx = get_nx();
-    long int ny = get_ny();
-
-    vector<long int>slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=nx;
-    slice[3]=1;
-
-    vector<float>data(nx);
-
-    for(int line=0;line<ny;++line) {
-      slice[1]=line;
-      read(slice, data);
-      for(int pixel=0; pixel<nx;++pixel) {
-        if(data[pixel] < value) data[pixel]=0;
-      }// endfor: pixel
-      write(slice, data);
-    }// endfor: line
+    GEOSTAR_PROFILE_SCOPE("Raster::thresh");
+    if(lookedUp(this, this)) {
+      LUT().threshold(value).apply(this, this);
+      return;
+    }
+    BlockStream<float> stream(this, std::vector<const Raster *>(1, this), 1, this, 0);
+    stream.run([&](BlockStream<float>::Block &b) {
+        std::vector<float> &data = b.slots[0];
+        parallel_for(b.n, [&](long int begin, long int end) {
+          for(long int pixel=begin; pixel<end;++pixel) {
+            if(data[pixel] < value) data[pixel]=0;
+          }// endfor: pixel
+        });
+      });
 
   }// end: thresh
 
 
   // writes to different/existing channel
   void Raster::scale(Raster *ras_out, const double &offset, const double &mult) const {
-    long int nx = get_nx();
-    long int ny = get_ny();
-    int i;
-
-    vector<long int>slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=nx;
-    slice[3]=1;
-
-    vector<float>indata(nx);
-    vector<float>outdata(nx);
-
-    for(int line=0;line<ny;++line) {
-      slice[1]=line;
-      read(slice,indata);
-      for(int pixel=0; pixel<nx;++pixel) {
-        i = mult*(indata[pixel]-offset);
-        if (i<0)   i=0;
-        outdata[pixel]= i;
-      }// endfor: pixel
-      ras_out->write(slice, outdata);
-    }// endfor: line
+    GEOSTAR_PROFILE_SCOPE("Raster::scale");
+    if(lookedUp(this, ras_out)) {
+      LUT().scale(offset, mult).apply(this, ras_out);
+      return;
+    }
+    BlockStream<float> stream(this, std::vector<const Raster *>(1, this), 2, ras_out, 1);
+    stream.run([&](BlockStream<float>::Block &b) {
+        const std::vector<float> &indata = b.slots[0];
+        std::vector<float> &outdata = b.slots[1];
+        parallel_for(b.n, [&](long int begin, long int end) {
+          for(long int pixel=begin; pixel<end;++pixel) {
+            int i = mult*(indata[pixel]-offset);
+            if (i<0)   i=0;
+            outdata[pixel]= i;
+          }// endfor: pixel
+        });
+      });
 
   }// end: scale
 
 
 
   void Raster::copy(const long int *inslice, Raster *ras_out) const {
+    GEOSTAR_PROFILE_SCOPE("Raster::copy");
     SliceSizeException SliceSizeError;
 
 	int i;
@@ -230,6 +733,7 @@ H5::PredType::NATIVE_DOUBLE;}
 
 
   void Raster::set(const long int *slice, const int &value) {
+    GEOSTAR_PROFILE_SCOPE("Raster::set");
     int i;
 
     SliceSizeException SliceSizeError;
@@ -270,34 +774,9 @@ H5::PredType::NATIVE_DOUBLE;}
 	if ((x0 - radius) < 0 || (x0 + radius) > nx) throw RasterSizeError;
 	if ((y0 - radius) < 0 || (y0 + radius) > ny) throw RasterSizeError;
 
-	//slice enclosing circle
-	vector<long int>slice(4);
-	slice[0] = x0 - radius;
-	slice[1] = y0 - radius;
-	slice[2] = 2 * radius;
-	slice[3] = 2 * radius;
-
-	long int size = slice[2] * slice[3];
-	std::vector<float>data(size);
-	
-	read(slice, data);
-
-	//overwrite pixels within the circle
-	double dx = 0, dy = 0;
-	double distsq = 0;
-	double rsq = radius * radius;
-	for (int x = 0; x < slice[2]; ++x) {
-	  for (int y = 0; y < slice[3]; ++y) {
-	    dx = x - radius;
-	    dy = y - radius;
-	    distsq = dx * dx + dy * dy;
-	     if (distsq <= rsq) {
-		data[y * slice[2] + x] = color;
-	      }//endif
-	   }//endfor
-	}//endfor
-
-	write(slice, data);
+	DrawBatch batch;
+	batch.circle(x0, y0, radius, color);
+	batch.apply(this);
 
  }//end drawPoint
 
@@ -317,40 +796,10 @@ H5::PredType::NATIVE_DOUBLE;}
 	if ((slice[0] + slice[2] - radius) < 0 || (slice[0] + slice[2] + radius) > nx) throw RasterSizeError;
 	if ((slice[1] + slice[3] - radius) < 0 || (slice[1] + slice[3] + radius) > ny) throw RasterSizeError;
 
-	std::vector<float> data;
-	read(slice, data);
-
-	drawFilledCircle(slice[0], slice[1], radius, color);
-
-	drawFilledCircle(slice[0] + slice[2], slice[1] + slice[3], radius, color);
-
-	double slope = slice[3] / slice[2];
-	double y = 0;
-
-	double distDivisor = sqrt((slice[2] * slice[2]) + (slice[3] * slice[3]));
-	double lineDist = 0;
-
-	//define equation of line as y-y1 = slope(x-x1)
-	// -> y = slope*x - slope*x1 + y1
-	// but within the slice, x1 and y1 are zero (initial points) so y = slope * x
-	for (int i = 0; i < slice[2]; ++i) {
-	  y = (slope * i);
-	  data[y * slice[3] + i] = color;
-	}
-
-	//now sweep through slice and find any points with distance to line less than the radius
-	//use (Ax + By + C) / sqrt(A^2 + B^2) for the distance calculation
-
-	for (int i = 0; i < slice[3]; ++i) {
-	  for (int j = 0; j < slice[2]; ++j) {
-	    lineDist = fabs((slice[2] * i) - (slice[3] * j)) / distDivisor;
-	    if (lineDist <= radius) {
-		data[i * slice[3] + j] = color;
-		}//endif
-	  }//endfor
-	}//endfor
-
-	write(slice, data);
+	//the segment with round ends of the same radius
+	DrawBatch batch;
+	batch.line(slice[0], slice[1], slice[0] + slice[2], slice[1] + slice[3], radius, color);
+	batch.apply(this);
 		
  }//end drawLine
 
@@ -367,27 +816,10 @@ H5::PredType::NATIVE_DOUBLE;}
 	if (slice[0] < 0 || slice[2] > nx) throw RasterSizeError;
 	if (slice[1] < 0 || slice[3] > ny) throw RasterSizeError;
 
-	//draw edges of desired radius one at a time, setting each region to desired color
-
-	//left edge
-	long int oslice[4] = {slice[0], slice[1], radius, slice[3]};
-	set(oslice, color);
-	//top edge
-	oslice[2] = slice[2];
-	oslice[3] = radius;
-	set(oslice, color);
-	//bottom edge
-	oslice[0] = slice[0];
-	oslice[1] = slice [1] + slice[3] - radius;
-	oslice[2] = slice[2];
-	oslice[3] = radius;
-	set(oslice, color);
-	//right edge
-	oslice[0] = slice[0] + slice[2] - radius;
-	oslice[1] = slice[1];
-	oslice[2] = radius;
-	oslice[3] = slice[3];
-	set(oslice, color);
+	//the four edges, in one pass over the tiles they cross
+	DrawBatch batch;
+	batch.rectangle(slice[0], slice[1], slice[2], slice[3], radius, color);
+	batch.apply(this);
 
  }//endRectangle
 
@@ -404,79 +836,36 @@ void Raster::drawFilledRectangle(std::vector<long int>slice, const int radius, c
 	if (slice[0] < 0 || slice[2] > nx) throw RasterSizeError;
 	if (slice[1] < 0 || slice[3] > ny) throw RasterSizeError;
 
-	//set whole slice to filled color first
-	long int oslice[4] = {slice[0], slice[1], slice[2], slice[3]};
-	set(oslice, fillColor);
-
-	//draw edges of desired radius one at a time, setting each region to desired color
-
-	//left edge
-	oslice[2] = radius;
-	set(oslice, lineColor);
-	//top edge
-	oslice[2] = slice[2];
-	oslice[3] = radius;
-	set(oslice, lineColor);
-	//bottom edge
-	oslice[0] = slice[0];
-	oslice[1] = slice [1] + slice[3] - radius;
-	oslice[2] = slice[2];
-	oslice[3] = radius;
-	set(oslice, lineColor);
-	//right edge
-	oslice[0] = slice[0] + slice[2] - radius;
-	oslice[1] = slice[1];
-	oslice[2] = radius;
-	oslice[3] = slice[3];
-	set(oslice, lineColor);		
+	//the fill, then the edges over it
+	DrawBatch batch;
+	batch.filledRectangle(slice[0], slice[1], slice[2], slice[3], radius, lineColor, fillColor);
+	batch.apply(this);
 
  }//endFilledRectangle
 
-  void Raster::addSaltPepper(Raster *rasterOut, const double low) {
-	RasterSizeErrorException RasterSizeError;
+  void Raster::addSaltPepper(Raster *rasterOut, const double low, const uint64_t &seed) {
 	ProbabilityException ProbabilityError;
 	//check if probability parameters are right
 	if(low < 0 || low > 0.5) throw ProbabilityError;
 
-	const double high = 1 - low;
-
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_out = rasterOut->get_nx();
-	long int ny_out = rasterOut->get_ny();
-	//check raster bounds
-	if (nx != nx_out) throw RasterSizeError;
-	if (ny != ny_out) throw RasterSizeError;
+	//each pixel's random value between 0 and 1 comes from the seed and its position, so
+	//blocks and threads share no generator
+	Noise::apply(this, rasterOut, Noise::SALT_PEPPER, low, seed, 0, 15000);
 
-	double temp = 0;
-	std::vector<long int> slice(4);
-	slice[0] = 0;
-	slice[1] = 0;
-	slice[2] = nx;
-	slice[3] = 1;
-
-	//init random seed, to limit pseudorandom results
-	srand((unsigned)time(NULL));
-
-	std::vector<double> data(nx);
-
-	//loop through image line by line, calculating random value between 0 and 1		
-	for (int i = 0; i < ny; ++i) {
-		slice[1] = i;
-		read(slice, data);
-	 for (int j = 0; j < nx; ++j) {
-		temp = ((double)rand() / (double)(RAND_MAX));
-		//set values equal to 0 if below low thresh, or higher than high thresh
-		if (temp <= low) data[j] = 0;
-		else if (temp >= high) data[j] = 15000;
-	  }//endfor
-	rasterOut->write(slice, data);
-	}//endfor
-	
-	
  }//end--addSaltPepper
 
+  void Raster::addGaussianNoise(Raster *rasterOut, const double sigma, const uint64_t &seed) const {
+	Noise::apply(this, rasterOut, Noise::GAUSSIAN, sigma, seed);
+
+ }//end--addGaussianNoise
+
+  void Raster::addSpeckleNoise(Raster *rasterOut, const double sigma, const uint64_t &seed) const {
+	Noise::apply(this, rasterOut, Noise::SPECKLE, sigma, seed);
+
+ }//end--addSpeckleNoise
+
  void Raster::bitShift(Raster *rasterOut, int bits, bool direction) {
+	GEOSTAR_PROFILE_SCOPE("Raster::bitShift");
 	RasterSizeErrorException RasterSizeError;
 	BitException BitError;
 
@@ -489,42 +878,118 @@ void Raster::drawFilledRectangle(std::vector<long int>slice, const int radius, c
 	if (nx != nx_out) throw RasterSizeError;
 	if (ny != ny_out) throw RasterSizeError;
 
-	std::vector<long int> slice(4);
-	slice[0] = 0;
-	slice[1] = 0;
-	slice[2] = nx;
-	slice[3] = 1;
-	
-	std::vector<float> data(nx);
-	
-	//loop through image and bitshift right or left, line by line
-	if (direction) {
-	double inverse = 1 / pow(2, bits);
-	  for (int i = 0; i < ny; ++i) {
-		slice[1] = i;
-		read(slice, data);
-	    for (int j = 0; j < nx; ++j) {
-		data[j] *= inverse;
-	    }//endfor
-	    rasterOut->write(slice, data);
-	  }//endfor
-	}//endif
-	
-	else {
-	for (int i = 0; i < ny; ++i) {
-		slice[1] = i;
-		read(slice, data);
-	 for (int j = 0; j < nx; ++j) {
-		data[j] *= pow(2, bits);
-	  }//endfor
-	rasterOut->write(slice, data);
-	}//endfor
-	}//endelse
+	if (lookedUp(this, rasterOut)) {
+	  LUT().shift(bits, direction).apply(this, rasterOut);
+	  return;
+	}
+
+	//loop through image and bitshift right or left, block by block
+	const double factor = direction ? 1 / pow(2, bits) : pow(2, bits);
+	BlockStream<float> stream(this, std::vector<const Raster *>(1, this), 1, rasterOut, 0);
+	stream.run([&](BlockStream<float>::Block &b) {
+		std::vector<float> &data = b.slots[0];
+	    parallel_for(b.n, [&](long int begin, long int end) {
+		for (long int j = begin; j < end; ++j) {
+		    data[j] *= factor;
+		}//endfor
+	    });
+	});
 
 
  }//end--bitShift
 
+  namespace {
+
+  // count, min, max, mean and sum of squared deviations of part of a raster.  Parts are merged with
+  // the pairwise update of Chan, Golub and LeVeque; NaN pixels are skipped.
+  struct Moments {
+    long int n;
+    double min, max, mean, m2;
+
+    Moments() : n(0), min(0), max(0), mean(0), m2(0) {}
+
+    void merge(const Moments &m) {
+      if(m.n == 0) return;
+      if(n == 0) {
+        *this = m;
+        return;
+      }
+      const double delta = m.mean - mean;
+      const long int total = n + m.n;
+      mean += delta * m.n / total;
+      m2 += m.m2 + delta * delta * ((double)n * m.n / total);
+      if(m.min < min) min = m.min;
+      if(m.max > max) max = m.max;
+      n = total;
+    }
+
+    template<typename T>
+    void add(const T *data, const long int &count) {
+      Moments part;
+      double sum = 0;
+      for(long int i=0; i<count; ++i) {
+        const double v = data[i];
+        if(v != v) continue;
+        if(part.n == 0) part.min = part.max = v;
+        else if(v < part.min) part.min = v;
+        else if(v > part.max) part.max = v;
+        sum += v;
+        ++part.n;
+      }// endfor: i
+      if(part.n == 0) return;
+      part.mean = sum / part.n;
+      for(long int i=0; i<count; ++i) {
+        const double d = data[i] - part.mean;
+        if(d == d) part.m2 += d*d;
+      }// endfor: i
+      merge(part);
+    }
+  };
+
+  // the moments of n pixels, split over the pool; the parts are kept by the start of their
+  // range and merged in order, so the result does not depend on which thread finished first
+  Moments momentsOf(const double *data, const long int &n) {
+    std::mutex lock;
+    std::map<long int, Moments> parts;
+    parallel_for(n, [&](long int begin, long int end) {
+        Moments part;
+        part.add(data + begin, end-begin);
+        std::lock_guard<std::mutex> hold(lock);
+        parts[begin] = part;
+      });
+    Moments total;
+    for(std::map<long int, Moments>::const_iterator it=parts.begin(); it!=parts.end(); ++it) {
+      total.merge(it->second);
+    }// endfor: it
+    return total;
+  }// end: momentsOf
+
+  // adds the n pixels that fall in [low, high] to counts, split over the pool
+  void countBins(const double *data, const long int &n, const double &low, const double &high,
+                 std::vector<unsigned long> &counts) {
+    const long int bins = (long int)counts.size();
+    const double perBin = high > low ? bins / (high - low) : 0;
+    std::mutex lock;
+    parallel_for(n, [&](long int begin, long int end) {
+        std::vector<unsigned long> part(bins, 0);
+        for(long int i=begin; i<end; ++i) {
+          const double v = data[i];
+          if(!(v >= low && v <= high)) continue;
+          long int k = (long int)((v - low) * perBin);
+          if(k >= bins) k = bins-1;
+          ++part[k];
+        }// endfor: i
+        std::lock_guard<std::mutex> hold(lock);
+        for(long int k=0; k<bins; ++k) counts[k] += part[k];
+      });
+  }// end: countBins
+
+  }// end anonymous namespace
+
+
+
   void Raster::autoLocalThresh(Raster *rasterOut, const int partitions) {
+	GEOSTAR_PROFILE_SCOPE("Raster::autoLocalThresh");
 	PartitionException PartitionError;
 	RasterSizeErrorException RasterSizeError;
 
@@ -539,699 +1004,849 @@ void Raster::drawFilledRectangle(std::vector<long int>slice, const int radius, c
 	if (partitions <= 0) throw PartitionError;
 	if (partitions > 150) throw PartitionError;
 
-	double partitionSizeX = nx / partitions;
-	double partitionSizeY = ny / partitions;
-	
-   vector<long int>slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=partitionSizeX;
-    slice[3]=1;
-
-    vector<double>data;
-    double threshhold = 0;
-    double max = 0;
-    double min = 0;
-
-//first define the slice loops, x and y which go through the sectors.  reset thresh variables
-for (int y = 0; y < partitions; ++y) {
- for (int x = 0; x < partitions; ++x) {
-	slice[0] = x * partitionSizeX;
-	max = 0;
-	min = 100000; //assign large num to min to init - can't reassign variable to a data pt with every read
-	threshhold = 0;
-//then the interior loops, which go into the actual sectors and do the reading and writing
-
-//first find max and min and compute average
-   for (int i = 0; i < partitionSizeY; ++i) {
-	slice[1] = i + y * partitionSizeY;
-	read(slice, data);
-     for (int j = 0; j < partitionSizeX; ++j) {
-	if (data[j] < min) min = data[j];
-	if (data[j] > max) max = data[j];
-	}//endfor - j
-    }//endfor - i
-
-	//not sure exactly what factor this should be divided by.  Gets better as partitions grow.
-	threshhold = (max + min) / 3;
-	
+	if (nx == 0 || ny == 0) return;
+
+	//exactly partitions sectors across and down: sector k covers [k*n/partitions, (k+1)*n/partitions),
+	//so sizes differ by at most one pixel.  A band of sectors is gone through twice, in strips of about
+	//a million pixels: once for the max and min of every sector, then to threshhold and write, so memory
+	//stays at two strips whatever the size of the raster.
+	const long int stripRows = std::max(1L, (1L << 20) / nx);
+	std::vector<double> strip, stripOut;
+	std::vector<Moments> m(partitions);
+	for (long int py = 0; py < partitions; ++py) {
+	  const long int y0 = py * ny / partitions;
+	  const long int dy = (py + 1) * ny / partitions - y0;
+	  if (dy == 0) continue;
+
+	  //first find max and min of each partition
+	  std::fill(m.begin(), m.end(), Moments());
+	  for (long int s0 = 0; s0 < dy; s0 += stripRows) {
+		const long int rows = std::min(stripRows, dy - s0);
+		strip.resize(rows * nx);
+		read(Slice(0, y0 + s0, nx, rows), &strip[0]);
+		parallel_for(partitions, [&](long int begin, long int end) {
+		  for (long int px = begin; px < end; ++px) {
+			const long int x0 = px * nx / partitions;
+			const long int dx = (px + 1) * nx / partitions - x0;
+			for (long int i = 0; i < rows; ++i) {
+			  m[px].add(&strip[i*nx + x0], dx);
+			}//endfor - i
+		  }//endfor - px
+		}, 1);
+	  }//endfor - s0
+
+	  //then perform threshholding operation
+	  for (long int s0 = 0; s0 < dy; s0 += stripRows) {
+		const long int rows = std::min(stripRows, dy - s0);
+		strip.resize(rows * nx);
+		stripOut.resize(rows * nx);
+		read(Slice(0, y0 + s0, nx, rows), &strip[0]);
+		parallel_for(partitions, [&](long int begin, long int end) {
+		  for (long int px = begin; px < end; ++px) {
+			const long int x0 = px * nx / partitions;
+			const long int dx = (px + 1) * nx / partitions - x0;
+
+			//not sure exactly what factor this should be divided by.  Gets better as partitions grow.
+			double threshhold = (m[px].max + m[px].min) / 3;
+
+			for (long int p = 0; p < rows; ++p) {
+			  const double *in = &strip[p*nx + x0];
+			  double *row = &stripOut[p*nx + x0];
+			  for (long int q = 0; q < dx; ++q) {
+				row[q] = (in[q] < threshhold) ? 0 : in[q];
+			  }//endfor - q
+			}//endfor - p
+		  }//endfor - px
+		}, 1);
+		rasterOut->write(Slice(0, y0 + s0, nx, rows), &stripOut[0]);
+	  }//endfor - s0
+	}//endfor - py
 
-//then perform threshholding operation
-   for (int p = 0; p < partitionSizeY; ++p) {
-	slice[1] = p + y * partitionSizeY;
-	read(slice, data);
-     for (int q = 0; q < partitionSizeX; ++q) {
-	if (data[q] < threshhold) data[q] = 0;
-	}//endfor - q
-	rasterOut->write(slice, data);
-    }//endfor - p
+ }//end - autoLocalThresh
 
-  }//endfor - x
-}//endfor - y
 
- }//end - autoLocalThresh
 
+  bool Raster::get_stats_stored() const {
+    return tiles ? TileCache::instance().get_stats_stored(tiles) : stats_stored;
+  }// end: get_stats_stored
 
 
-  void Raster::FFT_2D(GeoStar::Image *img, Raster *rasOutReal, Raster *rasOutImg) {
-	RasterSizeErrorException RasterSizeError;
 
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_outReal = rasOutReal->get_nx();
-	long int ny_outReal = rasOutReal->get_ny();
-	long int nx_outImg = rasOutImg->get_nx();
-	long int ny_outImg = rasOutImg->get_ny();
-	//check raster bounds
-	if (nx != nx_outReal) throw RasterSizeError;
-	if (ny != ny_outReal) throw RasterSizeError;
-	if (nx != nx_outImg) throw RasterSizeError;
-	if (ny != ny_outImg) throw RasterSizeError;
-
-	fftw_complex *in, *out;
-	in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * nx);
-	out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * nx);
-	fftw_plan plan;
-	plan = fftw_plan_dft_1d(nx, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
-
-	std::vector<long int>sliceFFTW(4);
-    		sliceFFTW[0]=0;
-    		sliceFFTW[1]=0;
-    		sliceFFTW[2]=nx;
-    		sliceFFTW[3]=1;
-	std::vector<double> dataReal(nx);
-	std::vector<double> dataImg(nx);
-	
-	GeoStar::Raster *rasBufferReal = img->create_raster("BufferReal", GeoStar::REAL32, nx, ny);
-	GeoStar::Raster *rasBufferImg = img->create_raster("BufferImg", GeoStar::REAL32, nx, ny);
-
-	//transform row by row
-	for (int y = 0; y < ny; ++y) {	
-	sliceFFTW[1] = y;
-	read(sliceFFTW, dataReal);
-	for(int i=0;i<nx;i++) { 
-	   in[i][0]=dataReal[i]; 
-	   in[i][1]=0.0;
-	}
+  void Raster::set_stats_stored(const bool &stored) const {
+    if(tiles) TileCache::instance().set_stats_stored(tiles, stored);
+    else stats_stored = stored;
+  }// end: set_stats_stored
 
-	
-	fftw_execute(plan);
-	
-	for (int i = 0; i < nx; i++) {
-		dataReal[i] = out[i][0];
-		dataImg[i] = out[i][1];
-	}
-	rasBufferReal->write(sliceFFTW, dataReal);
-	rasBufferImg->write(sliceFFTW, dataImg);
-	
-	}//endfor - row-by-row
 
-	//now delete objects and reinitialize for the ny size - cols transform
-	fftw_destroy_plan(plan);
-	fftw_free(in); fftw_free(out);
 
-	fftw_complex *inCols, *outCols;
-	inCols = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * ny);
-	outCols = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * ny);
-	fftw_plan planCols;
-	planCols = fftw_plan_dft_1d(ny, inCols, outCols, FFTW_FORWARD, FFTW_ESTIMATE);
+  bool Raster::get_overviews_stored() const {
+    return tiles ? TileCache::instance().get_overviews_stored(tiles) : overviews_stored;
+  }// end: get_overviews_stored
 
-		sliceFFTW[0] = 0;
-    		sliceFFTW[1] = 0;
-    		sliceFFTW[2] = 1;
-		sliceFFTW[3] = ny;
 
-	dataReal.reserve(ny);
-	dataImg.reserve(ny);
-	
-	//transform col-by-col	
-	for (int x = 0; x < nx; ++x) {
-	sliceFFTW[0] = x;
-	rasBufferReal->read(sliceFFTW, dataReal);
-	rasBufferImg->read(sliceFFTW, dataImg);
-	for (int i = 0; i < ny; ++i) {
-		inCols[i][0] = dataReal[i];
-		inCols[i][1] = dataImg[i];
-	}
-	
-	fftw_execute(planCols);
-	
-	for (int i = 0; i < ny; ++i) {
-		dataReal[i] = outCols[i][0];
-		dataImg[i] = outCols[i][1];
-	}
-	rasOutReal->write(sliceFFTW, dataReal);
-	rasOutImg->write(sliceFFTW, dataImg);
 
-	}//endfor - col-by-col
+  void Raster::set_overviews_stored(const bool &stored) const {
+    if(tiles) TileCache::instance().set_overviews_stored(tiles, stored);
+    else overviews_stored = stored;
+  }// end: set_overviews_stored
 
-	delete rasBufferReal;
-	delete rasBufferImg;
-	fftw_destroy_plan(planCols);
-	fftw_free(inCols); fftw_free(outCols);
 
-   }//end - FFT_2D
 
-  void Raster::FFT_2D_Inv(GeoStar::Image *img, Raster *rasOut, Raster *rasInImg) {
-	RasterSizeErrorException RasterSizeError;
+  void Raster::statistics_changed() const {
+    if(get_stats_stored()) {
+      set_stats_stored(false);
+      delete_attribute((H5::H5Location *)rasterobj, "statistics");
+      delete_attribute((H5::H5Location *)rasterobj, "histogram");
+    }
+    if(get_overviews_stored()) remove_overviews();
+  }// end: statistics_changed
 
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_out = rasOut->get_nx();
-	long int ny_out = rasOut->get_ny();
-	long int nx_img = rasInImg->get_nx();
-	long int ny_img = rasInImg->get_ny();
-	//check raster bounds
-	if (nx != nx_out) throw RasterSizeError;
-	if (ny != ny_out) throw RasterSizeError;
-	if (nx != nx_img) throw RasterSizeError;
-	if (ny != ny_img) throw RasterSizeError;
-
-	fftw_complex *in, *out;
-	in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * ny);
-	out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * ny);
-	fftw_plan plan;
-	plan = fftw_plan_dft_1d(ny, in, out, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-	std::vector<long int>sliceFFTW(4);
-    		sliceFFTW[0]=0;
-    		sliceFFTW[1]=0;
-    		sliceFFTW[2]=1;
-    		sliceFFTW[3]=ny;
-	std::vector<double> dataReal(ny);
-	std::vector<double> dataImg(ny);
-	
-	GeoStar::Raster *rasBufferReal = img->create_raster("BufferRealInv", GeoStar::REAL32, nx, ny);
-	GeoStar::Raster *rasBufferImg = img->create_raster("BufferImgInv", GeoStar::REAL32, nx, ny);
-
-	//transform col by col
-	for (int x = 0; x < nx; ++x) {	
-	sliceFFTW[0] = x;
-	read(sliceFFTW, dataReal);
-	rasInImg->read(sliceFFTW, dataImg);
-	for(int i=0;i<ny;i++) { 
-	   in[i][0]=dataReal[i]; 
-	   in[i][1]=dataImg[i];
-	}
 
-	
-	fftw_execute(plan);
-	
-	for (int i = 0; i < ny; i++) {
-		dataReal[i] = out[i][0];
-		dataImg[i] = out[i][1];
-	}
-	rasBufferReal->write(sliceFFTW, dataReal);
-	rasBufferImg->write(sliceFFTW, dataImg);
-	
-	}//endfor - col-by-col
 
-	//now delete objects and reinitialize for the nx size - rows transform
-	fftw_destroy_plan(plan);
-	fftw_free(in); fftw_free(out);
+  void Raster::remove_overviews() const {
+    set_overviews_stored(false);
+    delete_attribute((H5::H5Location *)rasterobj, "overviews");
+    const std::string groupName = rastername + ".overviews";
+    if(H5Lexists(parent_group.getId(), groupName.c_str(), H5P_DEFAULT) > 0) {
+      H5Ldelete(parent_group.getId(), groupName.c_str(), H5P_DEFAULT);
+    }
+  }// end: remove_overviews
+
+
+
+  // the attribute holds count, min, max, mean, stddev
+  Raster::Statistics Raster::statistics() const {
+    GEOSTAR_PROFILE_SCOPE("Raster::statistics");
+    Statistics s;
+    std::vector<double> saved;
+    if(get_stats_stored() && read_double_attribute((H5::H5Location *)rasterobj, "statistics", saved)
+       && saved.size() == 5) {
+      s.count = (long int)saved[0];
+      s.min = saved[1];
+      s.max = saved[2];
+      s.mean = saved[3];
+      s.stddev = saved[4];
+      return s;
+    }// endif
+
+    Moments total;
+    BlockStream<double> stream(this, std::vector<const Raster *>(1, this), 1, NULL, 0);
+    stream.run([&](BlockStream<double>::Block &b) {
+        total.merge(momentsOf(&b.slots[0][0], b.n));
+      });
+
+    s.count = total.n;
+    s.min = total.min;
+    s.max = total.max;
+    s.mean = total.mean;
+    s.stddev = total.n > 0 ? std::sqrt(total.m2 / total.n) : 0;
+
+    saved.resize(5);
+    saved[0] = s.count;
+    saved[1] = s.min;
+    saved[2] = s.max;
+    saved[3] = s.mean;
+    saved[4] = s.stddev;
+    try {
+      write_double_attribute((H5::H5Location *)rasterobj, "statistics", saved);
+      set_stats_stored(true);
+    } catch(...) {
+      // e.g. a file opened read-only: the statistics are just not kept
+    }// end: try
+    return s;
+  }// end: statistics
+
+
+
+  Raster::Histogram Raster::histogram(const int &bins) const {
+    HistogramBinException HistogramBinError;
+    if(bins < 1) throw HistogramBinError;
+    const Statistics s = statistics();
+    return histogram(bins, s.min, s.max);
+  }// end: histogram
+
+
+
+  // the attribute holds bins, low, high, then the counts
+  Raster::Histogram Raster::histogram(const int &bins, const double &low, const double &high) const {
+    GEOSTAR_PROFILE_SCOPE("Raster::histogram");
+    HistogramBinException HistogramBinError;
+    if(bins < 1) throw HistogramBinError;
+
+    Histogram h;
+    h.low = low;
+    h.high = high;
+    std::vector<double> saved;
+    if(get_stats_stored() && read_double_attribute((H5::H5Location *)rasterobj, "histogram", saved)
+       && saved.size() == (size_t)bins + 3 && saved[0] == bins && saved[1] == low && saved[2] == high) {
+      h.counts.assign(bins, 0);
+      for(int k=0; k<bins; ++k) h.counts[k] = (unsigned long)saved[k+3];
+      return h;
+    }// endif
+
+    h.counts.assign(bins, 0);
+    BlockStream<double> stream(this, std::vector<const Raster *>(1, this), 1, NULL, 0);
+    stream.run([&](BlockStream<double>::Block &b) {
+        countBins(&b.slots[0][0], b.n, low, high, h.counts);
+      });
+
+    saved.resize(bins + 3);
+    saved[0] = bins;
+    saved[1] = low;
+    saved[2] = high;
+    for(int k=0; k<bins; ++k) saved[k+3] = h.counts[k];
+    try {
+      write_double_attribute((H5::H5Location *)rasterobj, "histogram", saved);
+      set_stats_stored(true);
+    } catch(...) {
+    }// end: try
+    return h;
+  }// end: histogram
+
+
+
+#ifdef GEOSTAR_MPI
+  // rows are dealt out a chunk row at a time
+  void Raster::rankRows(const int &rank, const int &ranks, long int &y0, long int &y1) const {
+    const long int unit = raster_chunk_ny > 0 ? raster_chunk_ny : TileCache::CONTIGUOUS_TILE;
+    const long int units = (raster_ny + unit - 1) / unit;
+    y0 = std::min(raster_ny, unit * (units * rank / ranks));
+    y1 = std::min(raster_ny, unit * (units * (rank+1) / ranks));
+  }// end: rankRows
+
+
+
+  namespace {
+
+  // the rows [y0, y0+rows) of the dataset, or nothing for 0 rows
+  H5::DataSpace rowSpace(const H5::DataSet *obj, const long int &nx, const long int &ny,
+                         const long int &y0, const long int &rows) {
+    RasterSizeErrorException RasterSizeError;
+    if(rows < 0 || (rows > 0 && (y0 < 0 || y0 + rows > ny))) throw RasterSizeError;
+    H5::DataSpace space = obj->getSpace();
+    if(rows == 0) {
+      space.selectNone();
+    } else {
+      hsize_t start[2] = {(hsize_t)y0, 0};
+      hsize_t count[2] = {(hsize_t)rows, (hsize_t)nx};
+      space.selectHyperslab(H5S_SELECT_SET, count, start);
+    }// endif
+    return space;
+  }// end: rowSpace
+
+  // a transfer every rank of the communicator takes part in
+  H5::DSetMemXferPropList collective() {
+    H5::DSetMemXferPropList xfer;
+    H5Pset_dxpl_mpio(xfer.getId(), H5FD_MPIO_COLLECTIVE);
+    return xfer;
+  }// end: collective
+
+  // the slabs of rows [y0, y1) no larger than about 4M pixels, and the most any rank of comm has
+  long int slabRows(const long int &nx, const long int &y0, const long int &y1, MPI_Comm comm,
+                    long int &slabs) {
+    const long int rows = std::max(1L, (4L << 20) / std::max(1L, nx));
+    long int mine = (y1 - y0 + rows - 1) / rows;
+    MPI_Allreduce(&mine, &slabs, 1, MPI_LONG, MPI_MAX, comm);
+    return rows;
+  }// end: slabRows
+
+  }// end anonymous namespace
+
+
+
+  // the rows go through raster_native so only PixelConvert converts them.  A loaded raster
+  // still takes part in the collective transfer, with nothing selected, and serves its rows
+  // from the buffer, which may be newer than the file.
+  void Raster::readRows(const long int &y0, const long int &rows, double *data) const {
+    GEOSTAR_PROFILE_SCOPE("Raster::readRows");
+    DataTypeException DataTypeError;
+    if(!PixelConvert::supported(raster_native)) throw DataTypeError;
+    const Loaded *mem = buffer();
+    const bool fromFile = (mem == NULL && rows > 0);
+    H5::DataSpace filespace = rowSpace(rasterobj, raster_nx, raster_ny, y0, rows);
+    const hsize_t n = rows > 0 ? rows * raster_nx : 1;
+    H5::DataSpace memspace(1, &n);
+    if(!fromFile) {
+      filespace.selectNone();
+      memspace.selectNone();
+    }
 
-	fftw_complex *inRows, *outRows;
-	inRows = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * nx);
-	outRows = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * nx);
-	fftw_plan planRows;
-	planRows = fftw_plan_dft_1d(nx, inRows, outRows, FFTW_BACKWARD, FFTW_ESTIMATE);
+    TileCache::instance().flush(tiles);
+    std::vector<unsigned char> stage(fromFile ? n * raster_native.getSize() : 1);
+    {
+      GEOSTAR_PROFILE_BYTES("HDF5::read", fromFile ? (double)stage.size() : 0.0);
+      rasterobj->read(&stage[0], raster_native, memspace, filespace, collective());
+    }
+    if(fromFile) {
+      PixelConvert::convert(&stage[0], raster_native, data, H5::PredType::NATIVE_DOUBLE, n);
+    } else if(rows > 0) {
+      PixelConvert::convert(mem->pixels + y0 * raster_nx * mem->pixelSize, mem->type,
+                            data, H5::PredType::NATIVE_DOUBLE, n);
+    }// endif
+  }// end: readRows
+
+
+
+  // a loaded raster gets the rows in its buffer too, so a later flush does not undo the write
+  void Raster::writeRows(const long int &y0, const long int &rows, const double *data) {
+    GEOSTAR_PROFILE_SCOPE("Raster::writeRows");
+    DataTypeException DataTypeError;
+    if(!PixelConvert::supported(raster_native)) throw DataTypeError;
+    H5::DataSpace filespace = rowSpace(rasterobj, raster_nx, raster_ny, y0, rows);
+    const hsize_t n = rows > 0 ? rows * raster_nx : 1;
+    H5::DataSpace memspace(1, &n);
+    if(rows == 0) memspace.selectNone();
+
+    std::vector<unsigned char> stage(n * raster_native.getSize());
+    if(rows > 0) PixelConvert::convert(data, H5::PredType::NATIVE_DOUBLE, &stage[0], raster_native, n);
+    TileCache::instance().flush(tiles);
+    {
+      GEOSTAR_PROFILE_BYTES("HDF5::write", (double)stage.size());
+      rasterobj->write(&stage[0], raster_native, memspace, filespace, collective());
+    }
+    Loaded *mem = buffer();
+    if(mem != NULL && rows > 0) {
+      mem->wait();
+      memcpy(mem->pixels + y0 * raster_nx * mem->pixelSize, &stage[0], n * mem->pixelSize);
+    }// endif
+    TileCache::instance().evict(tiles);
+    statistics_changed();
+  }// end: writeRows
+
+
+
+  // every rank's moments are gathered, so all of them merge the same parts in the same order
+  Raster::Statistics Raster::statistics(MPI_Comm comm) const {
+    GEOSTAR_PROFILE_SCOPE("Raster::statistics");
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+    long int y0, y1, slabs;
+    rankRows(rank, ranks, y0, y1);
+    const long int rows = slabRows(raster_nx, y0, y1, comm, slabs);
+
+    Moments mine;
+    std::vector<double> data;
+    for(long int k=0; k<slabs; ++k) {
+      const long int y = std::min(y1, y0 + k*rows);
+      const long int dy = std::min(y1, y + rows) - y;
+      data.resize(std::max(1L, dy * raster_nx));
+      readRows(y, dy, &data[0]);
+      mine.merge(momentsOf(&data[0], dy * raster_nx));
+    }// endfor: k
+
+    double part[5] = {(double)mine.n, mine.min, mine.max, mine.mean, mine.m2};
+    std::vector<double> parts(5 * ranks);
+    MPI_Allgather(part, 5, MPI_DOUBLE, &parts[0], 5, MPI_DOUBLE, comm);
+    Moments total;
+    for(int q=0; q<ranks; ++q) {
+      Moments m;
+      m.n = (long int)parts[5*q];
+      m.min = parts[5*q+1];
+      m.max = parts[5*q+2];
+      m.mean = parts[5*q+3];
+      m.m2 = parts[5*q+4];
+      total.merge(m);
+    }// endfor: q
+
+    Statistics s;
+    s.count = total.n;
+    s.min = total.min;
+    s.max = total.max;
+    s.mean = total.mean;
+    s.stddev = total.n > 0 ? std::sqrt(total.m2 / total.n) : 0;
+    return s;
+  }// end: statistics
+
+
+
+  Raster::Histogram Raster::histogram(const int &bins, MPI_Comm comm) const {
+    HistogramBinException HistogramBinError;
+    if(bins < 1) throw HistogramBinError;
+    const Statistics s = statistics(comm);
+    return histogram(bins, s.min, s.max, comm);
+  }// end: histogram
+
+
+
+  Raster::Histogram Raster::histogram(const int &bins, const double &low, const double &high,
+                                      MPI_Comm comm) const {
+    GEOSTAR_PROFILE_SCOPE("Raster::histogram");
+    HistogramBinException HistogramBinError;
+    if(bins < 1) throw HistogramBinError;
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+    long int y0, y1, slabs;
+    rankRows(rank, ranks, y0, y1);
+    const long int rows = slabRows(raster_nx, y0, y1, comm, slabs);
+
+    std::vector<unsigned long> mine(bins, 0);
+    std::vector<double> data;
+    for(long int k=0; k<slabs; ++k) {
+      const long int y = std::min(y1, y0 + k*rows);
+      const long int dy = std::min(y1, y + rows) - y;
+      data.resize(std::max(1L, dy * raster_nx));
+      readRows(y, dy, &data[0]);
+      countBins(&data[0], dy * raster_nx, low, high, mine);
+    }// endfor: k
+
+    Histogram h;
+    h.low = low;
+    h.high = high;
+    h.counts.assign(bins, 0);
+    MPI_Allreduce(&mine[0], &h.counts[0], bins, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+    return h;
+  }// end: histogram
+#endif
+
+
+
+  double Raster::Histogram::percentile(const double &fraction) const {
+    unsigned long total = 0;
+    for(size_t k=0; k<counts.size(); ++k) total += counts[k];
+    if(total == 0) return low;
+
+    const double target = fraction * total;
+    const double width = binWidth();
+    double below = 0;
+    for(size_t k=0; k<counts.size(); ++k) {
+      if(counts[k] > 0 && below + counts[k] >= target) {
+        double within = (target - below) / counts[k];
+        if(within < 0) within = 0;
+        return low + (k + within) * width;
+      }
+      below += counts[k];
+    }// endfor: k
+    return high;
+  }// end: percentile
+
+
+
+  // Otsu: the split with the largest between-class variance wB*wF*(meanB-meanF)^2
+  double Raster::otsuThreshold(const int &bins) const {
+    GEOSTAR_PROFILE_SCOPE("Raster::otsuThreshold");
+    const Histogram h = histogram(bins);
+
+    double total = 0, sumAll = 0;
+    for(int k=0; k<bins; ++k) {
+      total += h.counts[k];
+      sumAll += (double)k * h.counts[k];
+    }// endfor: k
+
+    double wB = 0, sumB = 0, best = -1;
+    int split = 0;
+    for(int k=0; k<bins; ++k) {
+      wB += h.counts[k];
+      if(wB == 0) continue;
+      const double wF = total - wB;
+      if(wF == 0) break;
+      sumB += (double)k * h.counts[k];
+      const double diff = sumB / wB - (sumAll - sumB) / wF;
+      const double between = wB * wF * diff * diff;
+      if(between > best) {
+        best = between;
+        split = k;
+      }
+    }// endfor: k
+
+    return h.low + (split + 1) * h.binWidth();
+  }// end: otsuThreshold
+
+
+
+  void Raster::stretch(Raster *ras_out, const double &outMin, const double &outMax,
+                       const double &clip) const {
+    GEOSTAR_PROFILE_SCOPE("Raster::stretch");
+    RasterSizeErrorException RasterSizeError;
+    if(ras_out->get_nx() != get_nx() || ras_out->get_ny() != get_ny()) throw RasterSizeError;
+
+    double low, high;
+    if(clip > 0) {
+      const Histogram h = histogram(1024);
+      low = h.percentile(clip);
+      high = h.percentile(1 - clip);
+    } else {
+      const Statistics s = statistics();
+      low = s.min;
+      high = s.max;
+    }// endif
+    if(lookedUp(this, ras_out)) {
+      LUT().linear(low, high, outMin, outMax).apply(this, ras_out);
+      return;
+    }
+    const double mult = high > low ? (outMax - outMin) / (high - low) : 0;
+    const double lo = std::min(outMin, outMax), hi = std::max(outMin, outMax);
 
-		sliceFFTW[0] = 0;
-    		sliceFFTW[1] = 0;
-    		sliceFFTW[2] = nx;
-		sliceFFTW[3] = 1;
+    BlockStream<double> stream(this, std::vector<const Raster *>(1, this), 2, ras_out, 1);
+    stream.run([&](BlockStream<double>::Block &b) {
+        const std::vector<double> &indata = b.slots[0];
+        std::vector<double> &outdata = b.slots[1];
+        parallel_for(b.n, [&](long int begin, long int end) {
+          for(long int pixel=begin; pixel<end; ++pixel) {
+            double v = outMin + mult * (indata[pixel] - low);
+            if(v < lo) v = lo;
+            if(v > hi) v = hi;
+            outdata[pixel] = v;
+          }// endfor: pixel
+        });
+      });
+  }// end: stretch
+
+
+
+  void Raster::applyLUT(const LUT &lut, Raster *ras_out) const {
+    lut.apply(this, ras_out);
+  }// end: applyLUT
 
-	dataReal.reserve(nx);
-	dataImg.reserve(nx);
-	
-	//transform row-by-row	
-	for (int y = 0; y < ny; ++y) {
-	sliceFFTW[1] = y;
-	rasBufferReal->read(sliceFFTW, dataReal);
-	rasBufferImg->read(sliceFFTW, dataImg);
-	for (int i = 0; i < nx; ++i) {
-		inRows[i][0] = dataReal[i];
-		inRows[i][1] = dataImg[i];
-	}
-	
-	fftw_execute(planRows);
-	
-	for (int i = 0; i < nx; ++i) {
-		dataReal[i] = outRows[i][0] / 200000; //just a scaling factor, feel free to adjust as needed
-	}
-	rasOut->write(sliceFFTW, dataReal);
 
-	}//endfor - row-by-row
 
-	delete rasBufferReal;
-	delete rasBufferImg;
-	fftw_destroy_plan(planRows);
-	fftw_free(inRows); fftw_free(outRows);
+  // img is deprecated: FFT keeps its intermediates in memory or in an anonymous dataset
+  void Raster::FFT_2D(GeoStar::Image * /*img*/, Raster *rasOutReal, Raster *rasOutImg) {
+	FFT::transform(this, NULL, rasOutReal, rasOutImg, FFTW_FORWARD, 1.0);
+   }//end - FFT_2D
+
+  void Raster::FFT_2D_Inv(GeoStar::Image * /*img*/, Raster *rasOut, Raster *rasInImg) {
+	FFT::transform(this, rasInImg, rasOut, NULL, FFTW_BACKWARD, 1.0 / 200000); //just a scaling factor, feel free to adjust as needed
+	}//end - FFT_2D_Inv
+
+  void Raster::FFT_2D(Raster *rasOut) {
+	FFT::forwardReal(this, rasOut);
+   }//end - FFT_2D
 
+  void Raster::FFT_2D_Inv(Raster *rasOut) {
+	FFT::inverseReal(this, rasOut, 1.0 / ((double)rasOut->get_nx() * rasOut->get_ny()));
 	}//end - FFT_2D_Inv
 
  void Raster::lowPassFilter(GeoStar::Image *img, Raster *rasInReal, Raster *rasInImg, Raster *rasOut) {
+	GEOSTAR_PROFILE_SCOPE("Raster::lowPassFilter");
 	RasterSizeErrorException RasterSizeError;
-	//check the output raster only, all others are checked in the FFT_2D() function
 	long int nx = get_nx();
 	long int ny = get_ny();
 	if (nx != rasOut->get_nx()) throw RasterSizeError;
 	if (ny != rasOut->get_ny()) throw RasterSizeError;
+	if (nx != rasInReal->get_nx() || ny != rasInReal->get_ny()) throw RasterSizeError;
+	if (nx != rasInImg->get_nx() || ny != rasInImg->get_ny()) throw RasterSizeError;
 
-	//transform
-	FFT_2D(img, rasInReal, rasInImg);
-
-	//set slice in output rasters to zero
+	//the square that is zeroed out of the spectrum
 	const long int width = nx / 5;
 	const long int setSlice[4] = {width, width, width, width};
-	rasInReal->set(setSlice, 0);
-	rasInImg->set(setSlice, 0);
 
-	//transform back
-	rasInReal->FFT_2D_Inv(img, rasOut, rasInImg);
+	if (sizeof(fftw_complex) * nx * ny > FFT::get_memory_limit()) {
+	  //too big for memory: transform through the spectrum rasters
+	  FFT_2D(img, rasInReal, rasInImg);
+	  rasInReal->set(setSlice, 0);
+	  rasInImg->set(setSlice, 0);
+	  rasInReal->FFT_2D_Inv(img, rasOut, rasInImg);
+	  return;
+	}
 
- } //end - lowPassFilter
+	//read once, filter in memory, and write the spectrum and the result
+	SliceSizeException SliceSizeError;
+	if (ny < setSlice[1] + setSlice[3]) throw SliceSizeError;
+
+	const long int slice[4] = {0, 0, nx, ny};
+	fftw_complex *data = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * nx * ny);
+	FFT::readComplex(this, NULL, slice, data);
+	FFT::transform(data, nx, ny, FFTW_FORWARD);
+
+	for (long int y = setSlice[1]; y < setSlice[1] + setSlice[3]; ++y) {
+	  for (long int x = setSlice[0]; x < setSlice[0] + setSlice[2]; ++x) {
+	    data[y*nx + x][0] = 0;
+	    data[y*nx + x][1] = 0;
+	  }
+	}
+	FFT::writeComplex(data, slice, 1.0, rasInReal, rasInImg);
 
- void Raster::downsample(Raster * rasOut) {
-  	RasterSizeErrorException RasterSizeError;
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_out = rasOut->get_nx();
-	long int ny_out = rasOut->get_ny();
-	if (nx / 2 != nx_out) throw RasterSizeError;
-	if (ny / 2 != ny_out) throw RasterSizeError;
-	
-	//define kernel and a double so no integer division
-	//scaling factor
-	double mKernel = 400;
-	double gaussianKernel[5][5] = {{1/mKernel, 4/mKernel, 6/mKernel, 4/mKernel, 1/mKernel}, 
-					{4/mKernel, 16/mKernel, 24/mKernel, 16/mKernel, 4/mKernel},
-					{6/mKernel, 24/mKernel, 36/mKernel, 24/mKernel, 6/mKernel}, 
-					{4/mKernel, 16/mKernel, 24/mKernel, 16/mKernel, 4/mKernel},
-					{1/mKernel, 4/mKernel, 6/mKernel, 4/mKernel, 1/mKernel}};
-
-    vector<long int> slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=nx;
-    slice[3]=1;
-
-    vector<double> data(nx);
-	
-	int mFlipped = 0, nFlipped = 0;
-	double temp;
-
-	for (int i = 0; i < ny; ++i) {
-	  slice[1] = i;
-	  read(slice, data);
-	  for (int j = 0; j < nx; ++j) {
-		temp = 0;
-	     for (int m = 0; m < 5; ++m) {
-		mFlipped = 5 - 1 - m;
-		for (int n = 0; n < 5; ++n) {
-		  nFlipped = 5 - 1 - n;
-		  
-		  //convolve: multiply and accumulate
-		  temp += (data[j] * gaussianKernel[mFlipped][nFlipped]);
-
-
-		}//endfor - n
-	      }//endfor - m
-		data[j] = temp;
-	   }//endfor - j
-	   write(slice, data);
-	}//endfor - i
-
-
-    vector<double> dataOut(nx_out);
-
-	int outIndexSlice = 0, outIndexData = 0;
-
-	//remove all even numbered rows and cols to downsize
-	//change size of slice - write won't work unless the same slice is used for read and write
-	for (int i = 1; i < ny; i += 2) {
-	  slice[1] = i;
-	  slice[2] = nx;
-	  read(slice, data);	
-	  slice[1] = outIndexSlice;
-	  slice[2] = nx_out;
-	  ++outIndexSlice;
-	  outIndexData = 0;
-
-	  for (int j = 1; j < nx; j += 2) {
-		dataOut[outIndexData] = data[j];
-		++outIndexData;
-	  }//endfor - j
-
-	  rasOut->write(slice, dataOut);
-	}//endfor - i
+	FFT::transform(data, nx, ny, FFTW_BACKWARD);
+	FFT::writeComplex(data, slice, 1.0 / 200000, rasOut, NULL);
+	fftw_free(data);
+
+ } //end - lowPassFilter
 
+  void Raster::convolve(const Kernel &kernel, Raster *rasOut, const BorderMode &border) const {
+	kernel.apply(this, rasOut, border);
+  }//end - convolve
 
+ void Raster::downsample(Raster * rasOut) const {
+	//5x5 Gaussian blur, keeping the odd-numbered rows and cols
+	Kernel::binomial(5).apply(this, rasOut, BORDER_REFLECT, 1, 2);
  } //end - downsample
 
   vector<Raster *> Raster::gaussianPyramid(Image *img, int n) {
-	//RasterSizeErrorException if needed
 	IntegerParameterException integerParameterError;
 	if (n < 1) throw integerParameterError;
 	long int nx = get_nx();
 	long int ny = get_ny();
 
-	//make base vector, fill with base layer and first downsample
-	vector<Raster *> output(n);
+	//the base layer and n levels above it, each half the size of the one below,
+	//all made from one read of this raster
+	vector<Raster *> output(n + 1);
 	output[0] = this;
-	output[1] = new Raster(img, "GPyramid1", REAL32, nx / 2, ny / 2);
-
-	downsample(output[1]);
-	//then repeat n - 1 times
-	for (int i = 2; i <= n; ++i) {
-	  output[i] = new Raster(img, "GPyramid" + to_string(i), REAL32, nx / pow(2, i), ny / pow(2, i));
-	  output[i - 1]->downsample(output[i]);
+	for (int i = 1; i <= n; ++i) {
+	  output[i] = new Raster(img, "GPyramid" + to_string(i), REAL32, nx >> i, ny >> i);
 	}
 
+	Pyramid::build(this, output, vector<Raster *>());
 
 	return output;
 
   }//end - gaussianPyramid
 
 
-  void Raster::upsample(Raster *rasOut) {
-	RasterSizeErrorException RasterSizeError;
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_out = rasOut->get_nx();
-	long int ny_out = rasOut->get_ny();
-	if (nx * 2 != nx_out) throw RasterSizeError;
-	if (ny * 2 != ny_out) throw RasterSizeError;
-	
-	//define kernel and a double so no integer division
-	//scaling factor
-	double mKernel = 400;
-	double gaussianKernel[5][5] = {{1/mKernel, 4/mKernel, 6/mKernel, 4/mKernel, 1/mKernel}, 
-					{4/mKernel, 16/mKernel, 24/mKernel, 16/mKernel, 4/mKernel},
-					{6/mKernel, 24/mKernel, 36/mKernel, 24/mKernel, 6/mKernel}, 
-					{4/mKernel, 16/mKernel, 24/mKernel, 16/mKernel, 4/mKernel},
-					{1/mKernel, 4/mKernel, 6/mKernel, 4/mKernel, 1/mKernel}};
-
-    vector<long int> slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=nx;
-    slice[3]=1;
-
-    vector<double> data(nx);
-
-    vector<double> dataOut(nx_out);
-
-	int outIndexSlice = 1, outIndexData = 1;
-
-	//first read existing data to larger raster to upsize - then convolve after
-	// only read in every other row and col in the rasOut
-
-	//change size of slice - write won't work unless the same slice is used for read and write
-	for (int i = 0; i < ny; ++i) {
-	  slice[1] = i;
-	  slice[2] = nx;
-	  read(slice, data);	
-	  slice[1] = outIndexSlice;
-	  slice[2] = nx_out;
-	  outIndexSlice += 2;
-		//just in case dimensions are even and end data is overshot by 1
-		if (outIndexSlice > ny_out) outIndexSlice = ny_out;
-	  outIndexData = 1;
-
-	  for (int j = 0; j < nx; ++j) {
-		dataOut[outIndexData] = data[j];
-		outIndexData += 2;
-		if (outIndexData > nx_out) outIndexData = nx_out;
-	  }//endfor - j
-
-	  rasOut->write(slice, dataOut);
-	}//endfor - i
-
-	
-	//now convolve - approximate missing values with neighboring pixels
-
-	int mFlipped = 0, nFlipped = 0;
-	double temp;
-
-	slice[0] = 0;
-	slice[1] = 0;
-	slice[2] = nx_out;
-	slice[3] = 1;
-
-	for (int i = 1; i < ny_out; i += 2) {
-	  slice[1] = i;
-	  rasOut->read(slice, dataOut);
-	  for (int j = 1; j < nx_out; j += 2) {
-		temp = 0;
-	     for (int m = 0; m < 5; ++m) {
-		mFlipped = 5 - 1 - m;
-		for (int n = 0; n < 5; ++n) {
-		  nFlipped = 5 - 1 - n;
-		  
-		  //convolve: multiply and accumulate
-		  temp += (dataOut[j] * gaussianKernel[mFlipped][nFlipped]);
-
-
-		}//endfor - n
-	      }//endfor - m
-		dataOut[j] = temp;
-		if (j == 1) dataOut[0] = temp;
-		if (j + 1 < nx_out) dataOut[j + 1] = temp;
-	   }//endfor - j
-	   rasOut->write(slice, dataOut);
-	  if (i == 1) {
-	    slice[1] = 0;
-	    rasOut->write(slice, dataOut);
-	}
-	  if (i + 1 < ny_out) {
-	   slice[1] = i + 1;
-	   rasOut->write(slice, dataOut);
-	  }//endif
-	}//endfor - i
-
+  void Raster::upsample(Raster *rasOut) const {
+	//the input goes to the odd-numbered rows and cols, with zeros in between, and the 5x5 Gaussian
+	//fills in the zeros.  Only 1 pixel in 4 is non-zero, so the kernel is scaled by 4.
+	Kernel::binomial(5).scaled(4.0).apply(this, rasOut, BORDER_REFLECT, 2, 1);
 
  }//end - upsample
 
 
   vector<Raster *> Raster::laplacianPyramid(Image *img, int n) {
-	//RasterSizeErrorException if needed
 	IntegerParameterException integerParameterError;
 	if (n < 1) throw integerParameterError;
 	long int nx = get_nx();
 	long int ny = get_ny();
 
-	//make base vector, fill with base layer and first upsample
-	vector<Raster *> output(n);
-	output[0] = this;
-	output[1] = new Raster(img, "LPyramid1", REAL32, nx * 2, ny * 2);
-
-	upsample(output[1]);
-	//then repeat n - 1 times
-	for (int i = 2; i <= n; ++i) {
-	  output[i] = new Raster(img, "LPyramid" + to_string(i), REAL32, nx * pow(2, i), ny * pow(2, i));
-	  output[i - 1]->upsample(output[i]);
+	//n residual levels, each this raster's gaussian level minus the next level expanded, and the
+	//top gaussian level above them
+	vector<Raster *> output(n + 1);
+	for (int i = 0; i <= n; ++i) {
+	  output[i] = new Raster(img, "LPyramid" + to_string(i), REAL32, nx >> i, ny >> i);
 	}
 
+	Pyramid::build(this, vector<Raster *>(), output);
 
 	return output;
 
-  }//end - gaussianPyramid
+  }//end - laplacianPyramid
 
-  void Raster::harmonicMean(GeoStar::Raster * rasOut, int n) {
-	RasterSizeErrorException RasterSizeError;
-	IntegerParameterException IntegerParameterError;
 
-	if (n < 3) throw IntegerParameterError;
-	if (n > 11) throw IntegerParameterError;
-	if (n % 2 == 0) throw IntegerParameterError;
+  void Raster::buildOverviews(const int &levels) {
+	GEOSTAR_PROFILE_SCOPE("Raster::buildOverviews");
+	IntegerParameterException integerParameterError;
+	if (levels < 0) throw integerParameterError;
+	const long int nx = get_nx();
+	const long int ny = get_ny();
 
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_out = rasOut->get_nx();
-	long int ny_out = rasOut->get_ny();
-	if (nx != nx_out) throw RasterSizeError;
-	if (ny != ny_out) throw RasterSizeError;
+	int n = 0;
+	while ((levels == 0 ? ((nx >> n) > 256 || (ny >> n) > 256) : n < levels) &&
+	       (nx >> (n + 1)) > 0 && (ny >> (n + 1)) > 0) ++n;
 
-	int numRegionsY = ny / n;
-	int numRegionsX = nx / n;
+	remove_overviews();
+	if (n == 0) return;
 
-	vector<long int> slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=n;
-    slice[3]=1;
+	const std::string groupName = rastername + ".overviews";
 
-    vector<double> data(n);
-	double temp(0);
+	H5::Group group = parent_group.createGroup(groupName);
+	GeoStar::write_object_type(&group, "geostar::overviews");
+	Image holder(group, parent_name + "/" + groupName);
 
+	vector<Raster *> output(n + 1, NULL);
+	output[0] = this;
+	try {
+	  for (int i = 1; i <= n; ++i) {
+	    output[i] = new Raster(&holder, to_string(i), REAL32, nx >> i, ny >> i,
+	                           RasterCreateOptions().setChunk(256, 256));
+	  }
+	  Pyramid::build(this, output, vector<Raster *>());
+	} catch (...) {
+	  for (int i = 1; i <= n; ++i) delete output[i];
+	  throw;
+	}
+	for (int i = 1; i <= n; ++i) delete output[i];
 
-	//main outer loops that go across the whole image
-  for (int y = 0; y < numRegionsY; ++y) {
-   for (int x = 0; x < numRegionsX; ++x) {
-     slice[0] = x * n;
-	temp = 0;
+	write_double_attribute((H5::H5Location *)rasterobj, "overviews", vector<double>(1, n));
+	set_overviews_stored(true);
 
-	//sum reciprocals
-    for (int ySmall = 0; ySmall < n; ++ySmall) {
-	slice[1] = (y * n) + ySmall;
-	read(slice, data);
-	for (int xSmall = 0; xSmall < n; ++xSmall)
-	temp += 1.0 / data[xSmall];
-	
-	}//endfor - ysmall and xsmall
+  }//end - buildOverviews
 
-	//calc harmonic mean
-	temp = (n * n) / temp; 
 
-	//now write to output raster
-    for (int ySmall = 0; ySmall < n; ++ySmall) {
-	slice[1] = (y * n) + ySmall;
-	read(slice, data);
-	for (int xSmall = 0; xSmall < n; ++xSmall)
-	data[xSmall] = temp;
+  int Raster::overviewCount() const {
+	vector<double> saved;
+	if (!get_overviews_stored() || !read_double_attribute((H5::H5Location *)rasterobj, "overviews", saved) ||
+	    saved.size() != 1) return 0;
+	return (int)saved[0];
 
-	rasOut->write(slice, data);
-	}//endfor - ysmall and xsmall
+  }//end - overviewCount
 
-    }//endfor - x
-  }//endfor - y
 
- }//end - harmonicMean
+  void Raster::dropOverviews() {
+	remove_overviews();
 
-  void Raster::midpointFilter(GeoStar::Raster * rasOut, int n) {
-	RasterSizeErrorException RasterSizeError;
-	IntegerParameterException IntegerParameterError;
+  }//end - dropOverviews
 
-	if (n < 3) throw IntegerParameterError;
-	if (n > 11) throw IntegerParameterError;
-	if (n % 2 == 0) throw IntegerParameterError;
 
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_out = rasOut->get_nx();
-	long int ny_out = rasOut->get_ny();
-	if (nx != nx_out) throw RasterSizeError;
-	if (ny != ny_out) throw RasterSizeError;
-
-	int numRegionsY = ny / n;
-	int numRegionsX = nx / n;
+  Raster *Raster::openOverview(const int &level) const {
+	IntegerParameterException integerParameterError;
+	if (level < 1 || level > overviewCount()) throw integerParameterError;
+	const std::string groupName = rastername + ".overviews";
+	Image holder(parent_group.openGroup(groupName), parent_name + "/" + groupName);
+	return new Raster(&holder, to_string(level));
+
+  }//end - openOverview
+
+
+  namespace {
+
+    // every output pixel takes the nearest pixel of src, which is the base raster reduced by fx, fy
+    void sampleWindow(const Raster *src, const double &fx, const double &fy, const Slice &slice,
+                      const long int &w, const long int &h, float *out) {
+      const double lx0 = slice.x0 / fx, ly0 = slice.y0 / fy;
+      const double ldx = slice.dx / fx, ldy = slice.dy / fy;
+      vector<long int> col(w), row(h);
+      for (long int i = 0; i < w; ++i)
+        col[i] = min(src->get_nx() - 1, (long int)(lx0 + (i + 0.5) * ldx / w));
+      for (long int j = 0; j < h; ++j)
+        row[j] = min(src->get_ny() - 1, (long int)(ly0 + (j + 0.5) * ldy / h));
+      const long int c0 = col[0];
+      const long int cols = col[w - 1] - c0 + 1;
+      for (long int i = 0; i < w; ++i) col[i] -= c0;
+
+      // output rows j0 .. j1-1 come from one read of about a million pixels
+      const long int budget = max(cols, 1L << 20);
+      vector<float> band;
+      for (long int j0 = 0; j0 < h; ) {
+        long int j1 = j0 + 1;
+        while (j1 < h && (row[j1] - row[j0] + 1) * cols <= budget) ++j1;
+        const long int r0 = row[j0];
+        band.resize((row[j1 - 1] - r0 + 1) * cols);
+        src->read(Slice(c0, r0, cols, row[j1 - 1] - r0 + 1), &band[0]);
+        parallel_for(j1 - j0, [&](long int begin, long int end) {
+          for (long int j = j0 + begin; j < j0 + end; ++j) {
+            const float *in = &band[(row[j] - r0) * cols];
+            float *o = out + j * w;
+            for (long int i = 0; i < w; ++i) o[i] = in[col[i]];
+          }
+        }, 16);
+        j0 = j1;
+      }//endfor - bands
+    }// end: sampleWindow
+
+  }// end anonymous namespace
+
+
+  void Raster::readWindow(const Slice &slice, const long int &outWidth, const long int &outHeight,
+                          vector<float> &buffer, const vector<Raster *> &levels) const {
+	GEOSTAR_PROFILE_SCOPE("Raster::readWindow");
+	SliceSizeException SliceSizeError;
+	RasterSizeErrorException RasterSizeError;
+	if (slice.dx <= 0 || slice.dy <= 0 || slice.x0 < 0 || slice.y0 < 0 ||
+	    slice.x0 + slice.dx > get_nx() || slice.y0 + slice.dy > get_ny()) throw SliceSizeError;
+	if (outWidth < 1 || outHeight < 1) throw RasterSizeError;
+
+	//the coarsest level with at least one pixel for every output pixel
+	const Raster *src = this;
+	double fx = 1, fy = 1;
+	for (size_t k = 0; k < levels.size(); ++k) {
+	  if (levels[k] == NULL || levels[k]->get_nx() == 0 || levels[k]->get_ny() == 0) continue;
+	  const double kx = (double)get_nx() / levels[k]->get_nx();
+	  const double ky = (double)get_ny() / levels[k]->get_ny();
+	  if (slice.dx / kx >= outWidth && slice.dy / ky >= outHeight && kx * ky > fx * fy) {
+	    src = levels[k];
+	    fx = kx;
+	    fy = ky;
+	  }
+	}//endfor - levels
+
+	buffer.resize(outWidth * outHeight);
+	sampleWindow(src, fx, fy, slice, outWidth, outHeight, &buffer[0]);
+
+  }//end - readWindow
+
+
+  void Raster::readWindow(const Slice &slice, const long int &outWidth, const long int &outHeight,
+                          vector<float> &buffer) const {
+	//the stored level to use is known from the sizes alone, so only that one is opened
+	int k = 0;
+	const int n = overviewCount();
+	while (k < n && (slice.dx >> (k + 1)) >= outWidth && (slice.dy >> (k + 1)) >= outHeight) ++k;
+	if (k == 0) {
+	  readWindow(slice, outWidth, outHeight, buffer, vector<Raster *>());
+	  return;
+	}
+	vector<Raster *> level(1, openOverview(k));
+	try {
+	  readWindow(slice, outWidth, outHeight, buffer, level);
+	} catch (...) {
+	  delete level[0];
+	  throw;
+	}
+	delete level[0];
 
-	vector<long int> slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=n;
-    slice[3]=1;
+  }//end - readWindow
 
-    vector<double> data(n);
-	double min(0);
-	double max(0);
+  void Raster::minFilter(GeoStar::Raster * rasOut, int n, const BorderMode &border) const {
+	IntegerParameterException IntegerParameterError;
+	if (n < 3) throw IntegerParameterError;
 
+	Neighborhood::filter(this, rasOut, Neighborhood::MINIMUM, n, border);
+ }//end - minFilter
 
-	//main outer loops that go across the whole image
-  for (int y = 0; y < numRegionsY; ++y) {
-   for (int x = 0; x < numRegionsX; ++x) {
-     slice[0] = x * n;
+  void Raster::maxFilter(GeoStar::Raster * rasOut, int n, const BorderMode &border) const {
+	IntegerParameterException IntegerParameterError;
+	if (n < 3) throw IntegerParameterError;
 
-	//find local min and max
-    for (int ySmall = 0; ySmall < n; ++ySmall) {
-	slice[1] = (y * n) + ySmall;
-	read(slice, data);
-	min = data[0];
-	max = data[0];
-	for (int xSmall = 0; xSmall < n; ++xSmall) {
+	Neighborhood::filter(this, rasOut, Neighborhood::MAXIMUM, n, border);
+ }//end - maxFilter
 
-	  if (data[xSmall] < min) min = data[xSmall];
-	  else if (data[xSmall] > max) max = data[xSmall];
+  void Raster::meanFilter(GeoStar::Raster * rasOut, int n, const BorderMode &border) const {
+	IntegerParameterException IntegerParameterError;
+	if (n < 3) throw IntegerParameterError;
 
-	  }//endfor - xsmall
-	}//endfor - ysmall
+	Neighborhood::filter(this, rasOut, Neighborhood::MEAN, n, border);
+ }//end - meanFilter
 
-	//calc midpoint
-	max = (min + max) / 2; 
+  void Raster::harmonicMean(GeoStar::Raster * rasOut, int n, const BorderMode &border) const {
+	IntegerParameterException IntegerParameterError;
+	if (n < 3) throw IntegerParameterError;
 
-	//now write to output raster
-    for (int ySmall = 0; ySmall < n; ++ySmall) {
-	slice[1] = (y * n) + ySmall;
-	read(slice, data);
-	for (int xSmall = 0; xSmall < n; ++xSmall)
-	data[xSmall] = max;
+	Neighborhood::filter(this, rasOut, Neighborhood::HARMONIC_MEAN, n, border);
+ }//end - harmonicMean
 
-	rasOut->write(slice, data);
-	}//endfor - ysmall and xsmall
+  void Raster::medianFilter(GeoStar::Raster * rasOut, int radius, const BorderMode &border) const {
+	Neighborhood::median(this, rasOut, radius, border);
+ }//end - medianFilter
 
-    }//endfor - x
-  }//endfor - y
+  void Raster::midpointFilter(GeoStar::Raster * rasOut, int n, const BorderMode &border) const {
+	IntegerParameterException IntegerParameterError;
+	if (n < 3) throw IntegerParameterError;
 
+	Neighborhood::filter(this, rasOut, Neighborhood::MIDPOINT, n, border);
  }//end - midpointFilter
 
-  void Raster::rangeFilter(GeoStar::Raster * rasOut, int n) {
-	RasterSizeErrorException RasterSizeError;
+  void Raster::rangeFilter(GeoStar::Raster * rasOut, int n, const BorderMode &border) const {
 	IntegerParameterException IntegerParameterError;
-
 	if (n < 3) throw IntegerParameterError;
-	if (n > 11) throw IntegerParameterError;
-	if (n % 2 == 0) throw IntegerParameterError;
-
-	long int nx = get_nx();
-	long int ny = get_ny();
-	long int nx_out = rasOut->get_nx();
-	long int ny_out = rasOut->get_ny();
-	if (nx != nx_out) throw RasterSizeError;
-	if (ny != ny_out) throw RasterSizeError;
-
-	int numRegionsY = ny / n;
-	int numRegionsX = nx / n;
-
-	vector<long int> slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=n;
-    slice[3]=1;
-
-    vector<double> data(n);
-	double min(0);
-	double max(0);
 
+	Neighborhood::filter(this, rasOut, Neighborhood::RANGE, n, border);
+ }//end - rangeFilter
 
-	//main outer loops that go across the whole image
-  for (int y = 0; y < numRegionsY; ++y) {
-   for (int x = 0; x < numRegionsX; ++x) {
-     slice[0] = x * n;
-
-	//find local min and max
-    for (int ySmall = 0; ySmall < n; ++ySmall) {
-	slice[1] = (y * n) + ySmall;
-	read(slice, data);
-	min = data[0];
-	max = data[0];
-	for (int xSmall = 0; xSmall < n; ++xSmall) {
-
-	  if (data[xSmall] < min) min = data[xSmall];
-	  else if (data[xSmall] > max) max = data[xSmall];
-
-	  }//endfor - xsmall
-	}//endfor - ysmall
+  void Raster::integralImage(GeoStar::Raster * out) const {
+	IntegralImage::build(this, out, NULL);
+ }//end - integralImage
 
-	//calc range
-	max = max - min; 
+  void Raster::integralSquares(GeoStar::Raster * out) const {
+	IntegralImage::build(this, NULL, out);
+ }//end - integralSquares
 
-	//now write to output raster
-    for (int ySmall = 0; ySmall < n; ++ySmall) {
-	slice[1] = (y * n) + ySmall;
-	read(slice, data);
-	for (int xSmall = 0; xSmall < n; ++xSmall)
-	data[xSmall] = max;
+  void Raster::niblackThresh(GeoStar::Raster * rasOut, int n, const double &k, const BorderMode &border) const {
+	IntegerParameterException IntegerParameterError;
+	if (n < 3) throw IntegerParameterError;
 
-	rasOut->write(slice, data);
-	}//endfor - ysmall and xsmall
+	IntegralImage::threshold(this, rasOut, IntegralImage::NIBLACK, n, k, 1.0, border);
+ }//end - niblackThresh
 
-    }//endfor - x
-  }//endfor - y
+  void Raster::sauvolaThresh(GeoStar::Raster * rasOut, int n, const double &k, const double &range,
+                             const BorderMode &border) const {
+	IntegerParameterException IntegerParameterError;
+	if (n < 3) throw IntegerParameterError;
 
- }//end - rangeFilter
+	IntegralImage::threshold(this, rasOut, IntegralImage::SAUVOLA, n, k, range, border);
+ }//end - sauvolaThresh
 
  void Raster::gradientMask(GeoStar::Raster * rasOut, int mask) {
+	GEOSTAR_PROFILE_SCOPE("Raster::gradientMask");
 	RasterSizeErrorException RasterSizeError;
 	IntegerParameterException IntegerParameterError;
 
@@ -1291,7 +1906,7 @@ for (int y = 0; y < partitions; ++y) {
 	kernel[1][1] = 0;
 	kernel[1][2] = 2;
 	kernel[2][0] = -1;
-	kernel[2][1] = 2;
+	kernel[2][1] = 0;
 	kernel[2][2] = 1;
 	break;
 	case 5: 
@@ -1342,302 +1957,94 @@ for (int y = 0; y < partitions; ++y) {
 	break;
 	}//end - switch
 
-	double blurKernel[3][3] = {0.0625, 0.125, 0.0625, 0.125, 0.5, 0.125, 0.0625, 0.125, 0.0625};
-
-    vector<long int> slice(4);
-    slice[0]=0;
-    slice[1]=0;
-    slice[2]=nx;
-    slice[3]=1;
-
-    vector<double> data(nx);
-	
-	int mFlipped = 0, nFlipped = 0;
-	double temp;
-
-	for (int i = 0; i < ny; ++i) {
-	  slice[1] = i;
-	  read(slice, data);
-	  for (int j = 0; j < nx; ++j) {
-		temp = 0;
-	     for (int m = 0; m < 3; ++m) {
-		mFlipped = 3 - 1 - m;
-		for (int n = 0; n < 3; ++n) {
-		  nFlipped = 3 - 1 - n;
-		  
-		  //convolve: multiply and accumulate
-		  temp += (data[j] * blurKernel[mFlipped][nFlipped]);
-		}//endfor - n
-	      }//endfor - m
-		data[j] = temp;
-	   }//endfor - j
-	   rasOut->write(slice, data);
-	}//endfor - i
+	vector<double> weights(9);
+	for (int m = 0; m < 3; ++m)
+	  for (int n = 0; n < 3; ++n) weights[m * 3 + n] = kernel[m][n];
 
+	convolve(Kernel(3, 3, weights), rasOut, BORDER_REPLICATE);
 
 }//end - gradientMask
 
 
-  GeoStar::Raster * Raster::operator+(const GeoStar::Raster & r2)
+  GeoStar::RasterExpr Raster::operator+(const GeoStar::Raster & r2) const
   {
-    GeoStar::Image * img = Raster::getParent();
-    std::string str = rastername + "_PLUS_" + r2.rastername;
-    GeoStar::Raster * result = new GeoStar::Raster(img, str, raster_datatype, get_nx(), get_ny());
-    this->add(&r2, result);
-    return result;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::PLUS, *this, r2);
   }
   void Raster::add(const GeoStar::Raster * r2, GeoStar::Raster * ras_out)
   {
-    long int nx = get_nx(), ny = get_ny();
-    if(nx != r2->get_nx() || ny != r2->get_ny())throw RasterSizeErrorException();
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = nx; slice[3] = 1;
-    std::vector<float> bufferA(nx);
-    std::vector<float> bufferB(nx);
-    for(long int i = 0; i < ny; i++)
-    {
-      slice[1] = i;
-      read(slice, bufferA);
-      r2->read(slice, bufferB);
-      for(int j = 0; j < get_nx(); j++)bufferA[j] += bufferB[j];
-      ras_out->write(slice, bufferA);
-    }
+    *ras_out = *this + *r2;
   }
 
-  GeoStar::Raster * Raster::operator-(const GeoStar::Raster & r2)
+  GeoStar::RasterExpr Raster::operator-(const GeoStar::Raster & r2) const
   {
-    GeoStar::Image * img = Raster::getParent();
-    std::string str = rastername + "_MINUS_" + r2.rastername;
-    GeoStar::Raster * result= new GeoStar::Raster(img, str, raster_datatype, get_nx(), get_ny());
-    this->subtract(&r2, result);
-    return result;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::MINUS, *this, r2);
   }
   void Raster::subtract(const GeoStar::Raster * r2, GeoStar::Raster * ras_out)
   {
-    long int nx = get_nx(), ny = get_ny();
-    if(nx != r2->get_nx() || ny != r2->get_ny())throw RasterSizeErrorException();
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = nx; slice[3] = 1;
-    std::vector<float> bufferA(nx);
-    std::vector<float> bufferB(nx);
-    for(long int i = 0; i < ny; i++)
-    {
-      slice[1] = i;
-      read(slice, bufferA);
-      r2->read(slice, bufferB);
-      for(int j = 0; j < get_nx(); j++)bufferA[j] -= bufferB[j];
-      ras_out->write(slice, bufferA);
-    }
+    *ras_out = *this - *r2;
   }
 
-  GeoStar::Raster * Raster::operator*(const GeoStar::Raster & r2)
+  GeoStar::RasterExpr Raster::operator*(const GeoStar::Raster & r2) const
   {
-    GeoStar::Image * img = Raster::getParent();
-    std::string str = rastername + "_TIMES_" + r2.rastername;
-    GeoStar::Raster * result= new GeoStar::Raster(img, str, raster_datatype, get_nx(), get_ny());
-    this->multiply(&r2, result);
-    return result;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::TIMES, *this, r2);
   }
   void Raster::multiply(const GeoStar::Raster * r2, GeoStar::Raster * ras_out)
   {
-    long int nx = get_nx(), ny = get_ny();
-    if(nx != r2->get_nx() || ny != r2->get_ny())throw RasterSizeErrorException();
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = nx; slice[3] = 1;
-    std::vector<float> bufferA(nx);
-    std::vector<float> bufferB(nx);
-    for(long int i = 0; i < ny; i++)
-    {
-      slice[1] = i;
-      read(slice, bufferA);
-      r2->read(slice, bufferB);
-      for(int j = 0; j < get_nx(); j++)bufferA[j] *= bufferB[j];
-      ras_out->write(slice, bufferA);
-    }
+    *ras_out = *this * *r2;
   }
 
-  GeoStar::Raster * Raster::operator/(const GeoStar::Raster & r2)
+  GeoStar::RasterExpr Raster::operator/(const GeoStar::Raster & r2) const
   {
-    GeoStar::Image * img = Raster::getParent();
-    std::string str = rastername + "_DIVIDEDBY_" + r2.rastername;
-    GeoStar::Raster * result= new GeoStar::Raster(img, str, raster_datatype, get_nx(), get_ny());
-    this->divide(&r2, result);
-    return result;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::DIVIDEDBY, *this, r2);
   }
   void Raster::divide(const GeoStar::Raster * r2, GeoStar::Raster * ras_out)
   {
-    long int nx = get_nx(), ny = get_ny();
-    if(nx != r2->get_nx() || ny != r2->get_ny())throw RasterSizeErrorException();
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = nx; slice[3] = 1;
-    std::vector<float> bufferA(nx);
-    std::vector<float> bufferB(nx);
-    for(long int i = 0; i < ny; i++)
-    {
-      slice[1] = i;
-      read(slice, bufferA);
-      r2->read(slice, bufferB);
-      for(int j = 0; j < get_nx(); j++)
-      {
-        if(bufferB[j] == 0)bufferA[j] = 255; // divide by zero goes to max value
-        else bufferA[j] /= bufferB[j];
-      }
-      ras_out->write(slice, bufferA);
-    }
+    *ras_out = *this / *r2;
   }
 
-  Raster* Raster::resize(Image *img, int resize_width, int resize_height){
-    /*long int nx = get_nx(), ny = get_ny();
-
-    if (resize_width < 0 || resize_height < 0){
-      throw RasterSizeErrorException();
-    }
-
-    if (resize_width == nx && resize_height == ny){
-      return this;
-    }
-
-    Raster *ras_temp = img->create_raster("temp", GeoStar::INT8U, resize_width, ny);
-    Raster *ras2 = img->create_raster("resized", GeoStar::INT8U, resize_width, resize_height);
-
-
-    //first width, then height
-    vector<float> src_width(nx);
-    vector<float> src_height(ny);
-
-    vector<float> destination_width(resize_width);
-    vector<float> destination_height(resize_height);
-
-    std::vector<long int> slice(4);
-    slice[0]=0; slice [1]=0;
-    slice[2]=nx; slice[3]=1;
-
-    std::vector<long int> output_slice(4);
-    output_slice[0]=0; output_slice [1]=0;
-    output_slice[2]=resize_width; output_slice[3]=1;
+  void Raster::resize(GeoStar::Raster *rasOut, const ResampleKernel &kernel) const {
+    Resample::resize(this, rasOut, kernel);
+  }
 
-    for (int i = 0; i < ny; ++i){
-      //get new row
-      slice[1] = i;
-      read(slice, src_width);
-      //change each row in ras2
-      cv::resize(cv::InputArray(src_width), cv::OutputArray(destination_width), cv::Size(resize_width, 1), resize_width/nx, 1);
-      output_slice[1] = i;
-      ras_temp->write(output_slice, destination_width);
-    }
+  Raster* Raster::resize(Image *img, int resize_width, int resize_height, const ResampleKernel &kernel){
+    RasterSizeErrorException RasterSizeError;
+    if (resize_width < 1 || resize_height < 1) throw RasterSizeError;
 
-    slice[3] = ny;
-    slice[2] = 1;
-    slice[1] = 0;
-    output_slice[1] = 0;
-    output_slice[2] = 1;
-    output_slice[3] = resize_height;
-
-    //now adjust the height
-    for (int i = 0; i < resize_width; ++i){
-      //get new column
-      slice[0] = i;
-      ras_temp->read(slice, src_height);
-      //change each col in ras2
-      cv::resize(cv::InputArray(src_height), cv::OutputArray(destination_height), cv::Size(resize_height, 1), resize_height/ny, 1);
-
-      output_slice[0] = i;
-      ras2->write(output_slice, destination_height);
-    }
+    Raster *ras2 = img->create_raster(rastername + "_resized", raster_datatype, resize_width, resize_height);
+    try {
+      Resample::resize(this, ras2, kernel);
+    } catch(...) {
       delete ras2;
-      return ras2;
-	*/
+      throw;
+    }
+    return ras2;
   }
 
-  GeoStar::Image * Raster::getParent()
+  GeoStar::Image * Raster::getParent() const
   {
-    size_t len = H5Iget_name(rasterobj->getId(),NULL,0);
-    char buffer[len];
-    H5Iget_name(rasterobj->getId(),buffer,len+1);
-    std::string imgName = buffer;
-    int a = imgName.find_first_of("/");
-    imgName = imgName.substr(a,imgName.find_last_of("/")-a);
-
-    std::string fileName = rasterobj->getFileName();
-    GeoStar::File * f = new GeoStar::File(fileName, "existing");
-    GeoStar::Image * img = new Image(f,imgName);
-    delete f;
-    return img;
+    return new Image(parent_group, parent_name);
   }
 
-  GeoStar::Raster * GeoStar::Raster::operator+(const float & val)
+  GeoStar::RasterExpr GeoStar::Raster::operator+(const float & val) const
   {
-    GeoStar::Image * img = getParent();
-    std::string str = rastername+"_PLUS_val";
-    GeoStar::Raster * r2 = new GeoStar::Raster(img, str, raster_datatype, get_nx(),get_ny());
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = get_nx(); slice[3] = 1;
-    std::vector<float> buffer(get_nx());
-    for(int i = 0; i < get_ny(); i++)
-    {
-      slice[1] = i;
-      read(slice, buffer);
-      for(int j = 0; j < get_nx(); j++)buffer[j]+=val;
-      r2->write(slice, buffer);
-    }
-    return r2;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::PLUS, *this, GeoStar::RasterExpr::constant(val));
   }
-  GeoStar::Raster * GeoStar::Raster::operator-(const float & val)
+  GeoStar::RasterExpr GeoStar::Raster::operator-(const float & val) const
   {
-    GeoStar::Image * img = getParent();
-    std::string str = rastername+"_MINUS_val";
-    GeoStar::Raster * r2 = new GeoStar::Raster(img, str, raster_datatype, get_nx(),get_ny());
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = get_nx(); slice[3] = 1;
-    std::vector<float> buffer(get_nx());
-    for(int i = 0; i < get_ny(); i++)
-    {
-      slice[1] = i;
-      read(slice, buffer);
-      for(int j = 0; j < get_nx(); j++)buffer[j]-=val;
-      r2->write(slice, buffer);
-    }
-    return r2;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::MINUS, *this, GeoStar::RasterExpr::constant(val));
   }
-  GeoStar::Raster * GeoStar::Raster::operator*(const float & val)
+  GeoStar::RasterExpr GeoStar::Raster::operator*(const float & val) const
   {
-    GeoStar::Image * img = getParent();
-    std::string str = rastername+"_TIMES_val";
-    GeoStar::Raster * r2 = new GeoStar::Raster(img, str, raster_datatype, get_nx(),get_ny());
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = get_nx(); slice[3] = 1;
-    std::vector<float> buffer(get_nx());
-    for(int i = 0; i < get_ny(); i++)
-    {
-      slice[1] = i;
-      read(slice, buffer);
-      for(int j = 0; j < get_nx(); j++)buffer[j]*=val;
-      r2->write(slice, buffer);
-    }
-    return r2;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::TIMES, *this, GeoStar::RasterExpr::constant(val));
   }
-  GeoStar::Raster * GeoStar::Raster::operator/(const float & val)
+  GeoStar::RasterExpr GeoStar::Raster::operator/(const float & val) const
   {
-    GeoStar::Image * img = getParent();
-    std::string str = rastername+"_DIVIDEDBY_val";
-    GeoStar::Raster * r2 = new GeoStar::Raster(img, str, raster_datatype, get_nx(),get_ny());
-    std::vector<long int> slice(4);
-    slice[0] = 0; slice[1] = 0; slice[2] = get_nx(); slice[3] = 1;
-    std::vector<float> buffer(get_nx());
-    if(val == 0) // can't divide by zero
-    {
-      throw GeoStar::DivideByZeroException();
-    }
-    else
-    {
-      for(int i = 0; i < get_ny(); i++)
-      {
-        slice[1] = i;
-        read(slice, buffer);
-        for(int j = 0; j < get_nx(); j++)buffer[j]/=val;
-        r2->write(slice, buffer);
-      }
-    }
-    return r2;
+    return GeoStar::RasterExpr(GeoStar::RasterExpr::DIVIDEDBY, *this, GeoStar::RasterExpr::constant(val));
+  }
+
+  GeoStar::Raster & GeoStar::Raster::operator=(const GeoStar::RasterExpr & expr)
+  {
+    expr.evaluate(this);
+    return *this;
   }
 }// end namespace GeoStar
@@ -9,19 +9,108 @@
 
 #include <string>
 #include <vector>
+#include <complex>
 
 #include "H5Cpp.h"
 #include "Exceptions.hpp"
 #include "RasterType.hpp"
 #include "attributes.hpp"
+#include "RasterExpr.hpp"
+#include "Kernel.hpp"
+#include "Neighborhood.hpp"
+#include "TileCache.hpp"
+#include "Resample.hpp"
+#include "DrawBatch.hpp"
+#include "Noise.hpp"
+#include "LUT.hpp"
 
 //#include <opencv2/opencv.hpp>
 #include <fftw3.h>
 
+#ifdef GEOSTAR_MPI
+#include <mpi.h>
+#ifndef H5_HAVE_PARALLEL
+#error "GEOSTAR_MPI needs an HDF5 library built with --enable-parallel"
+#endif
+#endif
+
 namespace GeoStar {
   class Image;
   class File;
+  class TileSource;
+
+
+
+  /** \brief RasterCreateOptions -- storage layout options for a new raster
+
+  By default a new raster is stored as one contiguous 2-D HDF5 dataset.  This structure lets
+  the caller ask for a chunked (tiled) layout instead, optionally compressed with the HDF5
+  shuffle and deflate filters, and with a fill value for pixels that are never written.
+
+  \see Raster, Image::create_raster, Image::read_file
+
+  \Par Example
+	creating a 7000x8000 Landsat band stored as compressed 256x256 tiles:
+	\code
+	GeoStar::RasterCreateOptions opts;
+	opts.setChunk(256, 256).setDeflate(4, true).setFill(0.0);
+
+	GeoStar::Raster *ras = img->create_raster("B04", GeoStar::INT16U, 7000, 8000, opts);
+	\endcode
+
+  \Par Details
+	chunkX/chunkY are the tile size in pixels; when both are zero (the default) the dataset is
+	contiguous.  Compression requires a chunked layout, so asking for deflate or shuffle without
+	a chunk size uses 256x256 tiles.  Chunks larger than the raster are clipped to the raster size.
+
+	With a chunked layout only the chunks that intersect a slice are read and decompressed by
+	Raster::read.  The HDF5 chunk cache of each chunked raster is sized to hold one full row of
+	chunks, so the scanline-at-a-time operators decompress each chunk once per pass.
+  */
+  struct RasterCreateOptions {
+    long int chunkX;     // tile width in pixels, 0 for a contiguous layout
+    long int chunkY;     // tile height in pixels, 0 for a contiguous layout
+    int deflate;         // gzip level 1-9, 0 for no compression
+    bool shuffle;        // apply the byte-shuffle filter before deflate
+    bool useFill;        // write fillValue into never-written pixels
+    double fillValue;
+
+    RasterCreateOptions() : chunkX(0), chunkY(0), deflate(0), shuffle(false),
+                            useFill(false), fillValue(0.0) {}
+
+    inline RasterCreateOptions &setChunk(const long int &x, const long int &y) {
+      chunkX = x; chunkY = y; return *this;
+    }
+    inline RasterCreateOptions &setDeflate(const int &level, const bool &useShuffle) {
+      deflate = level; shuffle = useShuffle; return *this;
+    }
+    inline RasterCreateOptions &setFill(const double &value) {
+      useFill = true; fillValue = value; return *this;
+    }
+
+    // true when the options call for a chunked dataset
+    inline bool isChunked() const {
+      return chunkX > 0 || chunkY > 0 || deflate > 0 || shuffle;
+    }
+  }; // end struct: RasterCreateOptions
+
+
+  // a rectangle of pixels, x0, y0, dx, dy: the same four numbers as the slice vectors taken by
+  // Raster::read and Raster::write, which convert to it.
+  struct Slice {
+    long int x0, y0, dx, dy;
+
+    Slice(const long int &x0, const long int &y0, const long int &dx, const long int &dy)
+      : x0(x0), y0(y0), dx(dx), dy(dy) {}
+
+    Slice(const std::vector<long int> &slice) {
+      SliceSizeException SliceSizeError;
+      if(slice.size() < 4) throw SliceSizeError;
+      x0 = slice[0]; y0 = slice[1]; dx = slice[2]; dy = slice[3];
+    }
 
+    inline long int size() const { return dx*dy; }
+  }; // end struct: Slice
 
 
   /** \brief Raster -- Class to implement image and channel manipulation functions for HDF5-Raster Files
@@ -58,9 +147,59 @@ namespace GeoStar {
     std::string rastertype;
     RasterType  raster_datatype;
 
+    // metadata read once, when the raster is opened or created; see refresh_metadata
+    long int raster_nx, raster_ny;
+    long int raster_chunk_nx, raster_chunk_ny;
+    mutable H5::DataSpace raster_space;   // the file dataspace, reselected by every read/write
+    H5::Group parent_group;               // the image holding the raster, for getParent
+    std::string parent_name;
+
+    // the whole raster in memory, between load and unload; NULL otherwise.  The buffer is also
+    // registered with the dataset's TileSource, and buffer() finds it from any Raster open on
+    // the dataset.
+    struct Loaded;
+    Loaded *loaded;
+    Loaded *buffer() const;
+
+    // the raster's tiles in the shared TileCache
+    TileSource *tiles;
+
+    // the stored pixel type in native form.  Uncached transfers in another numeric type go
+    // through the staging buffer in this type and are converted by PixelConvert.
+    H5::DataType raster_native;
+    mutable std::vector<char> raster_stage;
+    mutable PixelScratch raster_scratch;
+    bool convertsItself(const H5::DataType &memtype) const;
+
+    // the "statistics" or "histogram" attribute may exist, and the overviews may; the next write
+    // removes them.  Kept with the dataset's TileSource, so a write through any Raster open on the
+    // dataset sees what another saved; stats_stored and overviews_stored only hold it when tiles
+    // is NULL.
+    mutable bool stats_stored, overviews_stored;
+    bool get_stats_stored() const;
+    void set_stats_stored(const bool &stored) const;
+    bool get_overviews_stored() const;
+    void set_overviews_stored(const bool &stored) const;
+    void statistics_changed() const;
+
+    // deletes the "overviews" attribute and the "<name>.overviews" group with its levels
+    void remove_overviews() const;
+
+    // frees the loaded buffer and the raster's tiles, writing what changed; never throws
+    void release();
+
+    void cache_metadata();
+    void *loadedPixels(const H5::DataType &type);
+
+    // selects slice in the cached file dataspace, which is returned, and builds memspace
+    H5::DataSpace &selectSlice(const Slice &slice, const long int &stride, H5::DataSpace &memspace) const;
+
   public:
     H5::DataSet *rasterobj;
 
+    // queued shapes burnt into a raster tile by tile; see DrawBatch
+    typedef GeoStar::DrawBatch DrawBatch;
+
     /** \brief Raster Constructor -- allows you to open an existing raster
 
     This constructor allows you to open an existing raster from within a preexisting HDF5-image object
@@ -124,7 +263,7 @@ namespace GeoStar {
 
     \param[in] type
 	Specifies, out of the existing Raster Types, what data type you want your new raster to be.
-	Only accepts INT8U, INT16U, REAL32
+	Accepts INT8U, INT16U, INT16S, INT32U, INT32S, REAL32, REAL64 and the complex types
 
     \param[in] nx
 	specifies x-size (horizontal size) of new raster
@@ -132,6 +271,10 @@ namespace GeoStar {
     \param[in] ny
 	specifies y-size (vertical size) of new raster
 
+    \param[in] options
+	optional storage layout (chunk size, compression, fill value).  The default is an
+	uncompressed contiguous dataset.  See RasterCreateOptions.
+
     \returns
 	A valid raster object upon success
 
@@ -165,9 +308,12 @@ namespace GeoStar {
     \Par Details
 	The HDF5 Attribute named "object_type" will be created with the value "Geostar::HDF5"
 	so it is considered a Geostar file, else an exception is thrown
+
+	RasterCreationError is also thrown if options.deflate is outside 0-9.
     */
     Raster(Image *image, const std::string &name, const RasterType &type,
-           const int &nx, const int &ny);
+           const int &nx, const int &ny,
+           const RasterCreateOptions &options = RasterCreateOptions());
 
 /** \brief write_object_type -- allows you to write the type attribute of the raster
 
@@ -266,7 +412,8 @@ namespace GeoStar {
     /** \brief Raster destructor allows one to delete a Raster object from memory.
 
    The Raster destructor is automatically called to clean up memory used by the Raster object.
-   There is a single pointer to the HDF5 Raster object that must be deleted.
+   There is a single pointer to the HDF5 Raster object that must be deleted.  A loaded raster
+   is flushed first if it has been changed.
 
    \see open, close
 
@@ -299,10 +446,12 @@ namespace GeoStar {
   */
 
     inline ~Raster() {
+      release();
       delete rasterobj;
     }
 
-     template <typename T> static H5::PredType getHdf5Type() {return H5::PredType::NATIVE_UINT8;}
+     // the HDF5 memory type of a pixel buffer of T; specialized in Raster.cpp
+     template <typename T> static const H5::DataType &getHdf5Type() {return H5::PredType::NATIVE_UINT8;}
 
 /** \brief write -- allows you to write data to a raster
 
@@ -373,37 +522,13 @@ namespace GeoStar {
     */
 
       template<typename T>
-      void write(const std::vector<long int> slice, std::vector<T> buffer) const {
-
-          RasterWriteErrorException RasterWriteError;
+      void write(const std::vector<long int> &slice, const std::vector<T> &buffer) const {
           SliceSizeException SliceSizeError;
 
           // slice needs to have: x0, y0, dx, dy
-          if(slice.size() < 4) throw SliceSizeError;
-
-          // size of the slice of data is the SAME as the size of the slice in the file:
-          hsize_t memdims[2];
-          memdims[0]=slice[3];
-          memdims[1]=slice[2];
-          H5::DataSpace memspace(2,memdims);
-
-          H5::DataSpace dataspace = rasterobj->getSpace();
-
-          // set the slice within the file's dataset we want to write to:
-          hsize_t count[2];
-          hsize_t start[2];
-          start[0]=slice[1];
-          start[1]=slice[0];
-          count[0]=slice[3];
-          count[1]=slice[2];
-          dataspace.selectHyperslab(H5S_SELECT_SET, count, start);
-
-          //int totalSize = (count[0] - start[0]) * (count[1] - start[1]);
-          int totalSize = count[0] * count[1];
-          if (buffer.size() < totalSize) throw SliceSizeError;
-
-          H5::PredType h5Type = Raster::getHdf5Type<T>();
-          rasterobj->write( (void *)&buffer[0], h5Type, memspace, dataspace );
+          const Slice s(slice);
+          if ((long int)buffer.size() < s.size()) throw SliceSizeError;
+          write(s, &buffer[0]);
       }
 
 
@@ -477,40 +602,69 @@ namespace GeoStar {
     */
 
       template<typename T>
-      void read(const std::vector<long int> slice, std::vector<T> &buffer) const {
+      void read(const std::vector<long int> &slice, std::vector<T> &buffer) const {
+          // slice needs to have: x0, y0, dx, dy
+          const Slice s(slice);
+          if ((long int)buffer.size() < s.size()) buffer.resize(s.size());
+          read(s, &buffer[0]);
+      } // end: read
 
-          RasterReadErrorException RasterReadError;
-          SliceSizeException SliceSizeError;
 
-          // slice needs to have: x0, y0, dx, dy
-          if(slice.size() < 4) throw SliceSizeError;
-
-          // size of the slice of data is the SAME as the size of the slice in the file:
-          hsize_t memdims[2];
-          memdims[0]=slice[3];
-          memdims[1]=slice[2];
-          H5::DataSpace memspace(2,memdims);
-
-          H5::DataSpace dataspace = rasterobj->getSpace();
-
-          // set the slice within the file's dataset we want to write to:
-          // we want an offset of (50,50), and a size of 100X100
-          hsize_t count[2];
-          hsize_t start[2];
-          start[0]=slice[1];
-          start[1]=slice[0];
-          count[0]=slice[3];
-          count[1]=slice[2];
-          dataspace.selectHyperslab(H5S_SELECT_SET, count, start);
-
-          //int totalSize = (count[0] - start[0]) * (count[1] - start[1]);
-          int totalSize = count[0] * count[1];
-          if (buffer.size() < totalSize) buffer.resize(totalSize);
-
-          H5::PredType h5Type = Raster::getHdf5Type<T>();
-          rasterobj->read( (void *)&buffer[0], h5Type, memspace, dataspace);
+
+/** \brief read, write -- read or write a slice straight from or into memory the caller owns
+
+    The same as the vector read and write, but the pixels go to or come from data, which can be any
+	buffer: an FFTW array, a GDAL or Cairo buffer, a row of a larger image.  Nothing is copied or
+	allocated on the way, and the vector versions are built on these.
+
+    \see read, write, Slice
+
+    \param[in] slice
+	The rectangle to read or write, x0, y0, dx, dy.  A slice vector converts to a Slice.
+
+    \param[in,out] data
+	The first pixel of the buffer.  Row y of the slice is at data + y*stride, dx pixels long.
+
+    \param[in] stride
+	optional: pixels from the start of one row of data to the next, at least dx.  0, the default,
+	means dx, a packed buffer.
+
+    \returns
+	Nothing
+
+    \Par Exceptions
+	SliceSizeError if stride is less than dx; the HDF5 exception if the slice is outside the raster.
+
+    \Par Example
+	reading a 100x50 block into the top left of a 256-wide FFTW array, and writing it back:
+	\code
+	fftw_complex *buf = fftw_alloc_complex(256*256);
+	ras->read(GeoStar::Slice(0, 0, 100, 50), (std::complex<double> *)buf, 256);
+	ras->write(GeoStar::Slice(0, 0, 100, 50), (const std::complex<double> *)buf, 256);
+	\endcode
+
+    \Par Details
+	T may be any type with a getHdf5Type specialization; HDF5 converts between it and the raster's
+	type.  fftw_complex is layout-compatible with std::complex<double>, so cast it as above.  A strided
+	buffer is described to HDF5 as a selection in memory, so it is still one HDF5 call.
+    */
+
+      template<typename T>
+      void read(const Slice &slice, T *data, const long int &stride = 0) const {
+          if (slice.size() <= 0) return;
+          H5::DataSpace memspace;
+          H5::DataSpace &dataspace = selectSlice(slice, stride, memspace);
+          readSelection((void *)data, Raster::getHdf5Type<T>(), memspace, dataspace);
       } // end: read
 
+      template<typename T>
+      void write(const Slice &slice, const T *data, const long int &stride = 0) const {
+          if (slice.size() <= 0) return;
+          H5::DataSpace memspace;
+          H5::DataSpace &dataspace = selectSlice(slice, stride, memspace);
+          writeSelection((const void *)data, Raster::getHdf5Type<T>(), memspace, dataspace);
+      } // end: write
+
 
     /** \brief get_nx -- allows you to get the x-size of the raster
 
@@ -548,7 +702,7 @@ namespace GeoStar {
 	\endcode
 
     */
-    long int get_nx() const;
+    inline long int get_nx() const { return raster_nx; }
 
     /** \brief get_ny -- allows you to get the y-size of the raster
 
@@ -586,7 +740,205 @@ namespace GeoStar {
 	\endcode
 
     */
-    long int get_ny() const;
+    inline long int get_ny() const { return raster_ny; }
+
+    /** \brief get_chunk_nx, get_chunk_ny -- the chunk (tile) size of the raster
+
+    returns the x- and y-size of one HDF5 chunk of the raster, or 0 if the raster
+	is stored contiguously.
+
+    \see get_nx, get_ny, RasterCreateOptions, BlockIterator
+
+    \returns
+	A long int containing the chunk size, 0 for a contiguous raster
+
+    \Par Exceptions
+	None
+    */
+    inline long int get_chunk_nx() const { return raster_chunk_nx; }
+    inline long int get_chunk_ny() const { return raster_chunk_ny; }
+
+    /** \brief refresh_metadata -- re-reads the size and layout of the raster from the file
+
+    The size, chunk layout and data type of a raster are read when it is opened or created, and
+	get_nx, get_ny, get_chunk_nx, get_chunk_ny and get_datatype return the saved values without
+	calling HDF5.  A program that changes the dataset behind the raster's back, e.g. with
+	H5Dset_extent on rasterobj, calls refresh_metadata afterwards.
+
+    \see get_nx, get_ny, get_chunk_nx, get_chunk_ny
+
+    \returns
+	Nothing
+
+    \Par Exceptions
+	None
+    */
+    void refresh_metadata();
+
+
+    /** \brief load, flush, unload -- keep the whole raster in memory between operations
+
+    load reads the raster into one contiguous, 64-byte aligned buffer owned by the Raster.  From
+	then on every read and write of the raster, and so every operator (thresh, the filters, FFT,
+	the drawing routines, raster expressions) works on that buffer, and the file is not touched
+	until flush writes the buffer back.  unload flushes and frees the buffer; the destructor does
+	the same.  The raster's tiles in the TileCache are written and dropped by load, as the buffer
+	takes their place.
+
+    \see pixels, readSelection, writeSelection, TileCache
+
+    \param[in] async
+	flush only: when true, and the HDF5 library is thread-safe, the buffer is written by a
+	background thread and flush returns at once.  The next change to the buffer, flush or unload
+	waits for it.  With a library that is not thread-safe the write happens before flush returns.
+
+    \returns
+	Nothing
+
+    \Par Exceptions
+	RasterWriteErrorException if an asynchronous flush failed, thrown by whatever waits for it.
+
+    \Par Example
+	running a string of operators on a 4k x 4k chip without going back to the file:
+	\code
+	ras->load();
+	ras->thresh(10);
+	ras->drawFilledCircle(2000, 2000, 50, 255);
+	ras->meanFilter(rasOut, 5);
+	ras->flush();
+	\endcode
+
+    \Par Details
+	Pixels are held in the raster's own type, so a loaded INT8U raster takes one byte per pixel.
+	Reads and writes of a loaded raster are type-converted in memory by PixelConvert (through
+	TileCache::copyOut and copyIn), as they are on the way to or from the file: floats are truncated
+	towards zero and saturate at the limits of an integer type, and NaN becomes 0 for every integer
+	type; complex pixels are still converted by HDF5.  Only changed rasters are written by flush.  load
+	of a loaded raster, and flush of an unchanged one, do nothing.
+
+	The buffer is the dataset's, not just the Raster's: every other Raster open on the same dataset,
+	opened before the load or after it, reads and writes the buffer too, and is_loaded is true for it.
+	load through one of those does nothing, and the buffer is written back and freed only by flush,
+	unload or the destructor of the Raster that loaded it.
+    */
+    void load();
+    void flush(const bool &async = false);
+    void unload();
+    inline bool is_loaded() const { return buffer() != NULL; }
+
+    /** \brief pixels -- the loaded buffer itself, for code that works on pixels in place
+
+    returns the buffer of a loaded raster as T, row-major with get_nx() pixels per row, or NULL
+	if the raster is not loaded or T is not its pixel type (uint16_t for INT16U, std::complex<float>
+	for COMPLEX_REAL64, ...).  The buffer is marked as changed, so the next flush writes it.
+
+    \see load
+    */
+    template<typename T>
+    T *pixels() {
+      return (T *)loadedPixels(Raster::getHdf5Type<T>());
+    }
+
+    // every pixel transfer of the raster goes through these two: to the loaded buffer, the
+    // TileCache, or HDF5.  filespace is a selection on the raster's dataspace, memspace one on data.
+    void readSelection(void *data, const H5::DataType &memtype, const H5::DataSpace &memspace,
+                       const H5::DataSpace &filespace) const;
+    void writeSelection(const void *data, const H5::DataType &memtype, const H5::DataSpace &memspace,
+                        const H5::DataSpace &filespace) const;
+
+    // the name of the raster within its image
+    inline const std::string &get_name() const { return rastername; }
+
+    // the RasterType the raster was created or opened with
+    inline RasterType get_datatype() const { return raster_datatype; }
+
+
+    /** \brief BlockIterator -- walks a raster block by block
+
+    Pixel-wise operators do not care in which order pixels are visited, so instead of reading and
+	writing one scanline at a time they can use a BlockIterator, which visits the raster in
+	blocks that match its chunk shape.  A 10k x 10k raster with 256x256 chunks is covered by
+	~1600 blocks instead of 10000 rows, and every block touches exactly one chunk.
+
+    \see read, write, get_chunk_nx, get_chunk_ny
+
+    \Par Example
+	adding one to every pixel of a raster:
+	\code
+	GeoStar::Raster::BlockIterator block(ras);
+	std::vector<float> data(block.maxSize());
+
+	while(block.next()) {
+	  block.read(ras, data);
+	  for(long int i=0; i<block.size(); ++i) data[i] += 1;
+	  block.write(ras, data);
+	}
+	\endcode
+
+    \Par Details
+	The block shape is taken from the raster the iterator was made for: its chunk size for a
+	chunked raster, or full-width bands of about a million pixels for a contiguous one.  The
+	caller can also ask for an explicit block size.  Blocks at the right and bottom edges are
+	clipped to the raster.
+
+	The iterator can read and write any raster of the same size as the one it was made for,
+	so one iterator drives a multi-raster operator such as add.  Each raster keeps its own file
+	dataspace from the time it is opened, and the memory dataspace is only rebuilt when the block shape
+	changes, so each block costs one hyperslab selection and one HDF5 read or write.
+
+	Block data is stored row-major, slice()[2] pixels per row.
+    */
+    class BlockIterator {
+
+    public:
+      // blockX, blockY of 0 mean "pick the block shape from the raster"
+      BlockIterator(const Raster *ras, const long int &blockX = 0, const long int &blockY = 0);
+
+      // moves to the next block, returns false when the whole raster has been visited.
+      bool next();
+
+      // starts over from the first block.
+      void reset();
+
+      // the current block: x0, y0, dx, dy
+      inline const long int *slice() const { return blockSlice; }
+
+      // number of pixels in the current block
+      inline long int size() const { return blockSlice[2]*blockSlice[3]; }
+
+      // number of pixels in the largest block, i.e. the buffer size needed
+      inline long int maxSize() const { return blockNx*blockNy; }
+
+      // reads the current block of ras into buffer, which is grown if needed
+      template<typename T>
+      void read(const Raster *ras, std::vector<T> &buffer) {
+        if((long int)buffer.size() < size()) buffer.resize(size());
+        H5::DataSpace &space = selectBlock(ras);
+        ras->readSelection((void *)&buffer[0], Raster::getHdf5Type<T>(), memspace, space);
+      }
+
+      // writes buffer to the current block of ras
+      template<typename T>
+      void write(Raster *ras, const std::vector<T> &buffer) {
+        SliceSizeException SliceSizeError;
+        if((long int)buffer.size() < size()) throw SliceSizeError;
+        H5::DataSpace &space = selectBlock(ras);
+        ras->writeSelection((const void *)&buffer[0], Raster::getHdf5Type<T>(), memspace, space);
+      }
+
+    private:
+      long int nx, ny;              // raster size
+      long int blockNx, blockNy;    // full block size
+      long int blockSlice[4];       // current block
+      bool started;
+
+      hsize_t memdims[2];
+      H5::DataSpace memspace;
+
+      // selects the current block in the file dataspace of ras, and returns it.
+      H5::DataSpace &selectBlock(const Raster *ras);
+
+    }; // end class: BlockIterator
 
     /** \brief thresh -- sets all values under a threshhold to zero
 
@@ -632,6 +984,7 @@ namespace GeoStar {
     \Par Details
 	If it looks like nothing is happening, try threshholding at a higher value for better results or consider
 	scaling the image down before the threshholding operation.
+	8 and 16-bit integer rasters are thresholded through a lookup table (applyLUT).
     */
     void thresh(const double &value);
 
@@ -696,6 +1049,7 @@ namespace GeoStar {
 	Make sure the types of your rasters are consistient - output raster of type double is best.
 
 	linear scaling: out = scale* (in -offset)
+	8 and 16-bit integer rasters are scaled through a lookup table (applyLUT).
     */
     void scale(Raster *ras_out, const double &offset, const double &mult) const;
 
@@ -824,7 +1178,7 @@ namespace GeoStar {
     draws a point at a location in an image with a desired color and radius.
 	Essentially just the set function, but implemented differently and meant to work with drawing.
 
-    \see drawLine, drawRectangle
+    \see drawLine, drawRectangle, DrawBatch
 
     \param[in] x0
 	the center x-coordinate of the circle.  Should be able to accomodate the circle radius from this
@@ -872,9 +1226,8 @@ namespace GeoStar {
 	\endcode
 
 	\par Details
-	The radius will extend in all directions from the center x0 y0 pair, and a slice will be set using the size of that
-	radius.  Pixel distance from circle is calculated using dx^2 + dy^2, where dx and dy are the difference from that
-	pixel to the center of the circle.  If these distances are less than the radius, the pixel is lit up.
+	Every pixel whose distance from x0, y0 is at most the radius is set.  The circle is drawn by a DrawBatch, one row
+	span at a time, so only the pixels inside it are changed; to draw many shapes, queue them on one DrawBatch.
 
 	radiussizeerror exception will be thrown if the radius is less than zero.
 	rastersizeerror exception will be thrown if the circle is larger than the raster.
@@ -886,7 +1239,7 @@ namespace GeoStar {
 
     draws a line at a point in an image to another point with a desired color and thickness
 
-    \see drawPoint
+    \see drawPoint, DrawBatch
 
     \param[in] slice
 	vector with 4 dimensions.  dimensions are as follows:
@@ -961,10 +1314,10 @@ namespace GeoStar {
 	SliceSizeError will be thrown if slice.size() < 4.
 	radiussizeerror exception will be thrown if the radius is less than zero.
 
-	This function first calculates the slope of the desired line, then iterates through the slice and draws the bare
-	line in y=mx format.  Then the slice is looped through again and the minimum perpendicular distance to the line is found 
-	for each point in the slice using the formula (Ax + By + C) / sqrt(A^2 + B^2).  If distance is less than radius, the pixel
-	is lit up.  Note that this distance calculation will not work for a vertical line.
+	Every pixel within radius of the segment is set, which gives the round ends; a radius of 0 draws a one-pixel
+	Bresenham line.  The line is drawn by a DrawBatch, a row span at a time, so the work grows with the length of the
+	line and not with its bounding box, and any direction, vertical included, works.  To draw many lines, queue them on
+	one DrawBatch.
 
     */
 
@@ -1031,6 +1384,7 @@ namespace GeoStar {
 	\par Details
 	The two points connected are diagonal from each other - the function fills in the corners itself.
 	This function generates an empty rectangle - to draw a filled rectangle, use drawFilledRectangle.
+	The four edges are queued on one DrawBatch, so each tile they cross is read and written once.
 	slizesizeerror exception will be thrown if slize.size() != 4
 	rastersizeerror exception will be thrown if your slice is bigger than the raster or goes off the raster.
 	radiussizeerror exception will be thrown if the radius is less than zero.
@@ -1103,6 +1457,7 @@ namespace GeoStar {
 	\par Details
 	The two points connected are diagonal from each other - the function fills in the corners itself.
 	This function generates a filled rectangle - to draw an empty rectangle, use drawRectangle.
+	The fill and the edges are queued on one DrawBatch, so each tile is read and written once.
 	slizesizeerror exception will be thrown if slize.size() != 4
 	rastersizeerror exception will be thrown if your slice is bigger than the raster or goes off the raster.
 	radiussizeerror exception will be thrown if the radius is less than zero.
@@ -1183,6 +1538,7 @@ namespace GeoStar {
 
 	rastersizeerror exception will be thrown if your rasterOut is not the same size as the original raster
 	bitvalueerror exception will be thrown if you try to bitshift a negative number of bits.
+	8 and 16-bit integer rasters are shifted through a lookup table (applyLUT).
 
     */
   void bitShift(Raster *rasterOut, int bits, bool direction);
@@ -1258,8 +1614,47 @@ namespace GeoStar {
 	probability exception will be thrown if low is <0 or >0.5.
 	High end value will be defaulted to 15000, if a higher value is needed some image preprocessing may be required.
 	high end value will be between 0.5 and 1, and high + low must equal 1.
+
+	The random value of each pixel comes from a Philox generator keyed by seed and counted by the pixel's index (see
+	Noise), so the same seed gives the same noise every run and on any number of threads; pass a different seed for
+	different noise.
+    */
+  void addSaltPepper(Raster *rasterOut, const double low, const uint64_t &seed = 0);
+
+/** \brief addGaussianNoise, addSpeckleNoise -- add Gaussian or multiplicative Gaussian noise to a raster
+
+    write rasterOut = this + sigma * z, or this * (1 + sigma * z) for speckle, with z a standard normal drawn for
+	each pixel.
+
+    \see addSaltPepper, Noise
+
+    \param[out] rasterOut
+	the noisy raster, the same size as this one.  It may be this raster.
+
+    \param[in] sigma
+	the standard deviation of the noise: in pixel values for Gaussian noise, relative for speckle.
+
+    \param[in] seed
+	the key of the generator; the same seed gives the same noise.
+
+    \returns
+	nothing
+
+    \par Exceptions
+	RasterSizeErrorException if rasterOut is not the size of this raster.
+
+    \par Example
+	\code
+	ras->addGaussianNoise(noisy, 5.0, 42);
+	ras->addSpeckleNoise(sar, 0.25, 42);
+	\endcode
+
+	\par Details
+	Done by Noise::apply: z comes from the Philox numbers of the pixel's index, so the result is bit-identical on any
+	number of threads.  Integer outputs are rounded and saturate at the limits of their type.
     */
-  void addSaltPepper(Raster *rasterOut, const double low);
+  void addGaussianNoise(Raster *rasterOut, const double sigma, const uint64_t &seed = 0) const;
+  void addSpeckleNoise(Raster *rasterOut, const double sigma, const uint64_t &seed = 0) const;
 
 /** \brief autoLocalThresh -- threshholds a raster in chunks with an automatic threshhold
 
@@ -1345,10 +1740,222 @@ namespace GeoStar {
 	The threshholding tends to get less strict as the number of partitions goes up as well - more partitions means the
 	threshhold of each sector tends to be lower and more accurate for that small area.  A good way to view this function is that
 	partitions is just a threshhold parameter, and the higher the partitions the lower the threshhold.
+	There are exactly partitions sectors across and down: when the raster is not a multiple of
+	partitions the sectors differ in size by one pixel, and every pixel is threshholded.  Each row of
+	sectors is read twice, in strips of about a million pixels, first for the max and min of its
+	sectors and then to threshhold them, the sectors in parallel; memory stays at two strips.
     */
   void autoLocalThresh(Raster *rasterOut, const int partitions);
 
 
+    /** \brief Statistics, Histogram -- what statistics and histogram return
+
+    count is the number of pixels that were counted (NaN pixels are skipped), and min, max, mean
+	and stddev (the population standard deviation) are 0 when count is 0.  A Histogram has
+	counts.size() equal bins over [low, high]; pixels outside the range are not counted, and
+	pixels equal to high go in the last bin.
+    */
+    struct Statistics {
+      long int count;
+      double min, max, mean, stddev;
+    };
+
+    struct Histogram {
+      double low, high;
+      std::vector<unsigned long> counts;
+
+      // the width of one bin
+      inline double binWidth() const { return counts.empty() ? 0 : (high-low)/counts.size(); }
+
+      // the value below which the given fraction (0..1) of the counted pixels lie,
+      // interpolated within its bin
+      double percentile(const double &fraction) const;
+    };
+
+
+/** \brief statistics, histogram -- min, max, mean, standard deviation and histogram of a raster
+
+    statistics reads the raster once and returns its minimum, maximum, mean and standard deviation;
+	histogram counts its pixels into bins equal-width bins over [low, high], or over [min, max]
+	of the raster when no range is given.  Both are kept with the raster, as the HDF5 attributes
+	"statistics" and "histogram", so asking again costs nothing until the raster is written.
+
+    \see stretch, otsuThreshold, autoLocalThresh, scale
+
+    \param[in] bins
+	the number of bins, at least 1.
+
+    \param[in] low, high
+	the range the bins cover.
+
+    \returns
+	A Statistics or Histogram
+
+    \Par Exceptions
+	HistogramBinException if bins is less than 1.
+
+    \Par Example
+	the mean and a 256-bin histogram of a band:
+	\code
+	GeoStar::Raster::Statistics s = ras->statistics();
+	std::cout << s.min << " " << s.max << " " << s.mean << " " << s.stddev << "\n";
+	GeoStar::Raster::Histogram h = ras->histogram(256);
+	std::cout << "median " << h.percentile(0.5) << "\n";
+	\endcode
+
+    \Par Details
+	The raster is read block by block, with the next blocks read while the current one is
+	counted, and each block is split over the File::set_num_threads pool, every thread adding up
+	its own partial count, sum, min and max (or its own bins) before they are combined.  The mean
+	and standard deviation are combined with the pairwise update of Chan et al, so they stay
+	accurate on large rasters.  histogram without a range needs the statistics first, so the first
+	call on a raster reads it twice.  Writing the raster through any Raster object open on the
+	dataset, or taking its pixels, removes the saved attributes.  Only the last histogram asked for
+	is kept.
+    */
+    Statistics statistics() const;
+    Histogram histogram(const int &bins) const;
+    Histogram histogram(const int &bins, const double &low, const double &high) const;
+
+#ifdef GEOSTAR_MPI
+/** \brief rankRows, readRows, writeRows, statistics, histogram -- a raster shared by the ranks of an MPI job
+
+    On a File opened over an MPI communicator every rank has the same Raster, and each works on its own rows of it.
+	rankRows gives the rows [y0, y1) that rank of ranks owns: rows of whole tiles of the tile cache, one chunk high (or
+	TileCache::CONTIGUOUS_TILE rows for a contiguous raster), dealt out evenly in order, so ranks never share a tile,
+	and a rank writing its own rows through its own tile cache never writes back another rank's.  readRows and writeRows move
+	rows [y0, y0+rows) of the raster to or from data, as doubles converted by PixelConvert, in one collective
+	hyperslab transfer over the communicator the File was opened with: every rank calls them together, each with its
+	own rows, 0 rows for none.
+	statistics and histogram are those of the whole raster, each rank counting its own rows and the counts combined
+	over comm, so every rank gets the same answer.
+
+    \see File, TileExecutor::run, statistics, histogram
+
+    \Par Exceptions
+	DataTypeException for complex rasters; RasterSizeErrorException for rows outside the raster; HistogramBinException
+	if bins is less than 1.
+
+    \Par Example
+	the statistics of a mosaic band, the pixels counted by all the ranks of the job:
+	\code
+	GeoStar::File *file = new GeoStar::File("mosaic.h5", "existing", MPI_COMM_WORLD);
+	GeoStar::Image *img = file->open_image("mosaic");
+	GeoStar::Raster *band = img->open_raster("B4");
+	GeoStar::Raster::Statistics s = band->statistics(MPI_COMM_WORLD);
+	\endcode
+
+    \Par Details
+	The transfers go straight to the dataset, past the tile cache, whose changed tiles of the raster are written
+	first and dropped after a write.  A rank that has the raster loaded reads its rows from the buffer, still taking
+	part in the transfer, and a write goes to the file and the buffer both.  Rows are read in slabs of about 4M pixels, so the
+	ranks' memory does not grow with the raster; the slabs are counted across the ranks, as collective calls must be
+	matched.  The partial moments are combined in rank order with the update of Chan et al, so the result does not
+	depend on which rank finished first.  Unlike the serial versions the results are not saved as attributes.
+    */
+    void rankRows(const int &rank, const int &ranks, long int &y0, long int &y1) const;
+    void readRows(const long int &y0, const long int &rows, double *data) const;
+    void writeRows(const long int &y0, const long int &rows, const double *data);
+    Statistics statistics(MPI_Comm comm) const;
+    Histogram histogram(const int &bins, MPI_Comm comm) const;
+    Histogram histogram(const int &bins, const double &low, const double &high, MPI_Comm comm) const;
+#endif
+
+
+/** \brief otsuThreshold -- the threshold that best splits a raster into two classes
+
+    returns the threshold of Otsu's method: the value that maximises the variance between the
+	pixels below it and those above it, found from a histogram of the raster.  Pass it to thresh.
+
+    \see histogram, thresh, autoLocalThresh
+
+    \param[in] bins
+	the number of histogram bins searched.
+
+    \returns
+	the threshold, the upper edge of the best bin
+
+    \Par Exceptions
+	HistogramBinException if bins is less than 1.
+
+    \Par Example
+	\code
+	ras->thresh(ras->otsuThreshold());
+	\endcode
+    */
+    double otsuThreshold(const int &bins = 256) const;
+
+
+/** \brief stretch -- linear contrast stretch of a raster into an output raster
+
+    maps [low, high] of the raster onto [outMin, outMax] and clips what falls outside.  low and
+	high are the minimum and maximum of the raster, or, with clip greater than 0, the values that
+	cut off the fraction clip of pixels at each end, taken from a 1024-bin histogram.
+
+    \see statistics, histogram, scale
+
+    \param[out] ras_out
+	the stretched raster, the same size as this one.  It may be this raster.
+
+    \param[in] outMin, outMax
+	the output range, e.g. 0 and 255 for display.
+
+    \param[in] clip
+	fraction (0 .. 0.5) of pixels saturated at each end, e.g. 0.02 for a 2% stretch.
+
+    \returns
+	nothing
+
+    \Par Exceptions
+	RasterSizeErrorException if ras_out is not the same size as the raster.
+
+    \Par Example
+	a 2% stretch of a band to 8 bits:
+	\code
+	GeoStar::Raster *out = img->create_raster("B4_8bit", GeoStar::INT8U, ras->get_nx(), ras->get_ny());
+	ras->stretch(out, 0, 255, 0.02);
+	\endcode
+
+    \Par Details
+	The range comes from the saved statistics and histogram, so only the stretch itself reads the
+	raster once they have been made.  A raster with a single value is mapped to outMin.  8 and
+	16-bit integer rasters are stretched through a lookup table (applyLUT).
+    */
+    void stretch(Raster *ras_out, const double &outMin, const double &outMax,
+                 const double &clip = 0.0) const;
+
+
+
+    /** \brief applyLUT -- a chain of point operations, through a table of every input value
+
+    \see LUT, thresh, scale, bitShift, stretch
+
+    \param[in] lut
+	the steps, compiled into a table for this raster's type and ras_out's.
+
+    \param[out] ras_out
+	the result, the same size as this raster.  It may be this raster.
+
+    \returns
+	nothing
+
+    \Par Exceptions
+	DataTypeException if this raster is not INT8U, INT8S, INT16U or INT16S, or ras_out is complex.
+	RasterSizeErrorException if ras_out is not the same size as the raster.
+
+    \Par Example
+	a gamma curve on an 8-bit band, in place:
+	\code
+	ras->applyLUT(GeoStar::LUT().gamma(0.5, 0, 255, 0, 255), ras);
+	\endcode
+
+    \Par Details
+	See LUT.  The table has one entry per possible input value, so building it costs the same
+	for any raster, and the pixels are then read, looked up and written in their stored types.
+    */
+    void applyLUT(const LUT &lut, Raster *ras_out) const;
+
+
 
 /** \brief FFT_2D -- Performs a two-dimensional Fast Fourier Transform
 
@@ -1422,11 +2029,46 @@ namespace GeoStar {
 
 	rastersizeerror exception will be thrown if your rasOutReal and rasOutImg are not the same size as your input raster.
 
-	The FFT will perform a complex to complex transfer - the real part of the complex numbers will be data from the raster this 		function is called on, but the imaginary part will be set to all zeros.  Data is read line by line and 1D transforms are performed
-	row by row to real and imaginary buffer rasters, then column by column from the buffers to the output rasters.
+	The FFT will perform a complex to complex transfer - the real part of the complex numbers will be data from the raster this 		function is called on, but the imaginary part will be set to all zeros.  The transform is done by the FFT engine: in memory
+	with one 2-D plan when the raster fits in FFT::get_memory_limit(), otherwise in bands of rows and then panels of columns, using
+	an anonymous complex<double> dataset for the intermediate result.  img is deprecated: it is not used and no buffer rasters
+	are made in it.  See FFT.
     */
   void FFT_2D(GeoStar::Image *img, Raster *rasOutReal, Raster *rasOutImg);
 
+/** \brief FFT_2D -- Fourier transform of a real raster into its half spectrum
+
+    writes the forward transform of this raster to one complex raster.  The spectrum of real data is
+	symmetric, so only its nx/2+1 non-redundant columns are kept.
+
+    \see FFT_2D_Inv, FFT::forwardReal
+
+    \param[out] rasOut
+	A COMPLEX_REAL64 or COMPLEX_REAL128 raster of nx/2+1 by ny pixels.
+
+    \returns
+	nothing
+
+    \par Exceptions
+	RasterSizeErrorException, DataTypeException
+
+    \par Example
+	the half spectrum of a 1024x1024 raster, and back:
+
+	\code
+	GeoStar::Raster *spec = img->create_raster("spec", GeoStar::COMPLEX_REAL64, 513, 1024);
+	ras->FFT_2D(spec);
+	spec->FFT_2D_Inv(rasOut);
+	\endcode
+
+	\par Details
+	RasterSizeErrorException is thrown if rasOut is not nx/2+1 by ny, and DataTypeException if it is
+	not a complex raster.  The output is unnormalized, like FFT_2D(img, rasOutReal, rasOutImg), and
+	pixel (x,y) holds the same value as that overload's real and imaginary pixel (x,y).  It takes
+	about half the time, and a quarter of the storage, of the two-raster form.
+    */
+  void FFT_2D(Raster *rasOut);
+
 /** \brief FFT_2D_Inv -- Performs a two-dimensional Inverse Fast Fourier Transform
 
     writes to one output raster for the real output.  Takes in real data from the raster this is called on, and imaginary data 
@@ -1503,12 +2145,35 @@ namespace GeoStar {
 
 	rastersizeerror exception will be thrown if your rasOut and rasImg are not the same size as your input raster.
 
-	The FFT will perform a complex to complex transfer - the real part of the complex numbers will be data from the raster this 		function is called on, and imaginary from the rasImg parameter.  Data is read line by line and 1D transforms are performed
-	col by col to real and imaginary buffer rasters, then row by row from the buffers to the output raster.  The data is divided
-	by a factor of 10 after the final transformation to normalize it - otherwise the values are far larger than they should be.
+	The FFT will perform a complex to complex transfer - the real part of the complex numbers will be data from the raster this 		function is called on, and imaginary from the rasImg parameter.  The transform is done by the FFT engine, in memory when the
+	raster fits and out of core otherwise; img is deprecated: it is not used and no buffer rasters are made in it.  See FFT.  The data is divided
+	by a factor of 200000 after the final transformation to normalize it - otherwise the values are far larger than they should be.
     */
   void FFT_2D_Inv(GeoStar::Image *img, Raster *rasOut, Raster *rasInImg);
 
+/** \brief FFT_2D_Inv -- inverse Fourier transform of a half spectrum
+
+    this raster is a half spectrum, as written by FFT_2D(rasOut); the real image it stands for is
+	written to rasOut.
+
+    \see FFT_2D, FFT::inverseReal
+
+    \param[out] rasOut
+	The real raster to write.  Its width sets the width of the transform, so this raster must be
+	rasOut's nx/2+1 by ny.
+
+    \returns
+	nothing
+
+    \par Exceptions
+	RasterSizeErrorException, DataTypeException
+
+    \par Details
+	Unlike FFT_2D_Inv(img, rasOut, rasInImg) the result is divided by nx*ny, so FFT_2D followed by
+	FFT_2D_Inv gives back the original pixels.
+    */
+  void FFT_2D_Inv(Raster *rasOut);
+
 /** \brief LowPassFilter -- Performs a low-pass filter on an image
 
     writes to an output raster, performing a set of Fourier transforms by row and col on the input raster, setting a square of all zeros
@@ -1593,8 +2258,9 @@ namespace GeoStar {
 
 	rastersizeerror exception will be thrown if your rasinReal, rasinImg, and rasOut are not the same size as your input raster.
 
-	The FFT will perform a complex to complex transfer - the real part of the complex numbers will be data from the raster this 		function is called on, but the imaginary part will be set to all zeros.  Data is read line by line and 1D transforms are performed
-	row by row to real and imaginary buffer rasters, then column by column from the buffers to the output rasters.
+	The FFT will perform a complex to complex transfer - the real part of the complex numbers will be data from the raster this 		function is called on, but the imaginary part will be set to all zeros.  When the raster fits in FFT::get_memory_limit() it is
+	read once, filtered in memory and written once, and rasInReal/rasInImg only receive the filtered spectrum; otherwise it goes
+	through FFT_2D, set and FFT_2D_Inv on those rasters.
 	A square with width hard set to 1/3 the input raster's size and data of all zero's is created in the center of the real and imaginary 		rasters using set(), and then this data is inversely transformed using the FFT once more.
 
 	The smaller the square width, the more accurate the final product is to the original image.  1/3 the input raster's size is about as 
@@ -1602,6 +2268,43 @@ namespace GeoStar {
     */
   void lowPassFilter(GeoStar::Image *img, Raster *rasInReal, Raster *rasInImg, Raster *rasOut);
 
+/** \brief convolve -- convolves a raster with a kernel
+
+    writes the convolution of this raster with kernel to an output raster of the same size.
+
+    \see Kernel, downsample, upsample, gradientMask
+
+    \param[in] kernel
+	The kernel to convolve with.  It is centred on its pixel (nx/2, ny/2).
+
+    \param[out] rasOut
+	The output raster, the same size as the raster this is called on.  It may not be the input raster.
+
+    \param[in] border
+	How pixels beyond the edges are filled in: BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT (the default) or BORDER_WRAP.
+
+    \returns
+	nothing
+
+    \par Exceptions
+	RasterSizeErrorException
+
+    \par Example
+	a 5x5 Gaussian blur:
+
+	\code
+	GeoStar::Raster *rasOut = img->create_raster("blur", GeoStar::REAL32, ras->get_nx(), ras->get_ny());
+	ras->convolve(GeoStar::Kernel::binomial(5), rasOut);
+	\endcode
+
+	\par Details
+	RasterSizeErrorException will be thrown if rasOut is not the same size as the raster this is called on.
+
+	Separable kernels are run as a pass along the rows and a pass down the columns, so the 5x5 binomial costs 10 multiply-adds
+	per pixel rather than 25.  Each input row is read once and the output is written once, in bands of rows; see Kernel.
+    */
+  void convolve(const Kernel &kernel, Raster *rasOut, const BorderMode &border = BORDER_REFLECT) const;
+
 /** \brief downsample -- downsample an image
 
     writes to an output raster,  convoluting an image with a Gaussian kernel to downsample to 1/2 its original size.
@@ -1661,10 +2364,14 @@ namespace GeoStar {
 
 	rastersizeerror exception will be thrown if your rasOut is not half the size of your input raster.
 
-	This function will define a gaussian kernel used to convolve the input raster.  Then all even-numbered rows and cols are
-	removed and data is written to the output raster.  This produces a raster 1/4 the area of the original, with a gaussian blur applied.  		This process can be repeated in order to form a Gaussian pyramid.
+	The input raster is convolved with the 5x5 binomial kernel (1 4 6 4 1 along each axis, normalized to one), and the
+	odd-numbered rows and cols are written to the output raster.  This produces a raster 1/4 the area of the original, with a
+	gaussian blur applied.  The input raster is not changed.  This process can be repeated in order to form a Gaussian pyramid.
+
+	The blur is done in one pass by the convolution engine, which only computes the pixels that are kept; see Kernel.
+	Edges are mirrored (BORDER_REFLECT).
     */
-  void downsample(Raster *rasOut);
+  void downsample(Raster *rasOut) const;
 
   /** \brief upsample -- upsample an image
 
@@ -1729,22 +2436,23 @@ namespace GeoStar {
 
 	rastersizeerror exception will be thrown if your rasOut is not twice the size of your input raster.
 
-	This function will define a gaussian kernel used to convolve the input raster.  All even-numbered rows and cols are
-	added back in and filled with zeros, the image is convolved, and data is written to the output raster.  This produces a raster twice
-	the size of the original, with a gaussian blur removed. This process can be repeated in order to form a Laplacian pyramid.
+	The input pixels are placed in the odd-numbered rows and cols of the output, the even-numbered rows and cols are filled
+	with zeros, and the result is convolved with the 5x5 binomial kernel scaled by 4 so that the output has the same brightness
+	as the input.  This produces a raster twice the size of the original, with the missing pixels interpolated from their
+	neighbors.  This process can be repeated in order to form a Laplacian pyramid.
 
-	Note that the rasOut should be an empty raster of doubles, i.e. all data points should be zero.
+	rasOut does not need to be empty: every pixel of it is written.  The zeros are never stored; see Kernel.
 
-	Moreover the image will not be exactly as it began before upsampling - some scaling must be done on both downsampling and 		upsampling to normalize the values after convolution. Information is lost when an image is downsampled, and though this function
-	attempts to restore it by estimating neighboring pixel values, multiple upsamples can cause an image to appear blocky.
+	The image will not be exactly as it began before downsampling - information is lost when an image is downsampled, and
+	upsampling only interpolates it.
     */
-  void upsample(Raster *rasOut);
+  void upsample(Raster *rasOut) const;
 
 /** \brief gaussianPyramid - produce a gaussian pyramid of an image
 
-    Given an input raster, computes the gaussian pyramid of this raster n times. Returns a vector of raster * of size n.
+    Given an input raster, computes the gaussian pyramid of this raster n times. Returns a vector of raster * of size n + 1.
 
-    \see read, write, upsample, downsample, laplacianPyramid
+    \see read, write, upsample, downsample, laplacianPyramid, Pyramid
 
     \param[in] img
 	The image within which you want to create your additional rasters.
@@ -1753,10 +2461,11 @@ namespace GeoStar {
 	The height of the pyramid, i.e. how many iterations and rasters you want to end up with.  Must be greater than zero.
 
     \returns
-	A vector of Raster *, which are the original rasters successively downsampled.
+	A vector of Raster *: this raster, followed by the n rasters "GPyramid1" .. "GPyramidn", each this raster
+	successively downsampled.
 
     \par Exceptions
-	IntegerParameterException
+	IntegerParameterException, RasterSizeErrorException
 
     \par Example
 	Producing a Gaussian Pyramid of height 4:
@@ -1809,20 +2518,22 @@ namespace GeoStar {
 
 	\par Details
 
-	IntegerParameterException will be thrown if n is less than 1
+	IntegerParameterException will be thrown if n is less than 1, and RasterSizeErrorException if level n would be empty
 
-	This function iterates n times, each time creating a new raster 1/2 the size of the previous, calling downsample, and 
-	pushing this new raster back into the output vector.  This function will produce a pyramid of height n, where the bottom layer is the
-	original raster.  So if gaussianPyramid is called with n = 1, it will return the original raster and the raster downsampled once.
+	This function creates n REAL32 rasters, each 1/2 the size of the previous, and fills them with Pyramid::build: level i is
+	exactly what downsample makes of level i - 1, but this raster is read once and the rows are cascaded up through all the
+	levels as they arrive, so no level is read back from the file.  This raster is not changed.  This function will produce a
+	pyramid of height n, where the bottom layer is the original raster.  So if gaussianPyramid is called with n = 1, it will
+	return the original raster and the raster downsampled once.
     */
   std::vector<Raster *> gaussianPyramid(Image *img, int n);
 
 /** \brief laplacianPyramid - produce a laplacian pyramid of an image
 
-    Given an input raster, computes the laplacian pyramid of this raster n times. Returns a vector of raster * of size n.
-	Typically used to restore a downsampled raster or undo a gaussian pyramid.
+    Given an input raster, computes the laplacian pyramid of this raster n times. Returns a vector of raster * of size n + 1.
+	Level i holds the detail lost between levels i and i + 1 of the gaussian pyramid, so the raster can be rebuilt from it.
 
-    \see read, write, downsample, upsample, gaussianPyramid
+    \see read, write, downsample, upsample, gaussianPyramid, Pyramid
 
     \param[in] img
 	The image within which you want to create your additional rasters.
@@ -1831,13 +2542,14 @@ namespace GeoStar {
 	The height of the pyramid, i.e. how many iterations and rasters you want to end up with.  Must be greater than zero.
 
     \returns
-	A vector of Raster *, which are the original rasters successively upsampled.
+	A vector of Raster *: the n residual rasters "LPyramid0" .. "LPyramid(n-1)", followed by the top of the gaussian
+	pyramid, "LPyramidn".
 
     \par Exceptions
-	IntegerParameterException
+	IntegerParameterException, RasterSizeErrorException
 
     \par Example
-	Restoring from a Gaussian Pyramid of height 4:
+	A Laplacian Pyramid of height 4:
 
 	\code
 	#include "Geostar.hpp"
@@ -1850,10 +2562,7 @@ namespace GeoStar {
 
   	GeoStar::Raster *ras = new GeoStar::Raster(img, "test", GeoStar::REAL32, 1024, 1024);
 
-	vector<GeoStar::Raster *> gaussianOutput = ras->gaussianPyramid(img, 4);
-
-	vector<GeoStar::Raster *> laplacianOutput;
-	laplacianOutput = gaussianOutput[4]->laplacianPyramid(img, 4);
+	vector<GeoStar::Raster *> laplacianOutput = ras->laplacianPyramid(img, 4);
 
 	delete ras;
 	delete img;
@@ -1863,59 +2572,205 @@ namespace GeoStar {
 
 	\endcode
 
-	<table>
-        <tr>
-        <td>
-        \imageSize{dogBefore.jpg,height:200px;width:400px;}
-        \image html dogBefore.jpg "Before pyramid - actual size 424x756"
-        </td>
-	<td>
-        \imageSize{aftergpyramid4_26_47.png,height:50px;width:100px;}
-        \image html aftergpyramid4_26_47.png "4th level gaussian pyramid: to be restored"
-        </td>
-        <td>
-        \imageSize{afterlpyramid1.png,height:75px;width:150px;}
-        \image html afterlpyramid1.png "1st level laplacian pyramid - called on 4th level gaussian"
-        </td>
-        <td>
-        \imageSize{afterlpyramid2.png,height:100px;width:200px;}
-        \image html afterlpyramid2.png "level 2"
-        </td>
-        <td>
-        \imageSize{afterlpyramid3.png,height:150px;width:300px;}
-        \image html afterlpyramid3.png "level 3"
-        </td>
-        <td>
-        \imageSize{afterlpyramid4.png,height:200px;width:400px;}
-        \image html afterlpyramid4.png "level 4"
-        </td>
-        </tr>
-        </table>
-
 	\par Details
 
-	IntegerParameterException will be thrown if n is less than 1
+	IntegerParameterException will be thrown if n is less than 1, and RasterSizeErrorException if level n would be empty
 
-	This function iterates n times, each time creating a new raster twice the size of the previous, calling upsample, and 
-	pushing this new raster back into the output vector.  This function will produce a pyramid of height n, where the bottom layer is the
-	original raster.  So if laplacianPyramid is called with n = 1, it will return the original raster and the raster upsampled once.
+	With G0 this raster and G1 .. Gn its gaussian pyramid, level i < n is Gi minus Gi+1 expanded back to the size of Gi as
+	upsample does it, and level n is Gn itself.  Level i is (nx >> i) by (ny >> i), REAL32, since the residuals are signed.
+	When the sizes are even, upsampling level n and adding level n - 1, and so on down, gives back this raster.
 
-	Be careful of calling high values of n (> 5) in this function.  Upsampling tries to restore lost data by estimating with
-	neighboring pixel values, but the data is still lost when changing size.  Upsampling many times will create very blocky images,
-	especially when upsampling many times from an image downsampled many times (as in the code example).
+	The rasters are filled with Pyramid::build, which reads this raster once and cascades its rows up through all the levels;
+	the gaussian levels are only held a few rows at a time and are not written.  This raster is not changed.
 
     */
   std::vector<Raster *> laplacianPyramid(Image *img, int n);
 
+/** \brief buildOverviews - stores reduced-resolution copies of a raster for fast display
+
+    Makes the gaussian pyramid of this raster and keeps it in the file next to the raster, where readWindow and
+	Map::drawRaster find it.
+
+    \see readWindow, overviewCount, gaussianPyramid, Map::drawRaster
+
+    \param[in] levels
+	The number of levels above this raster.  0 means as many as it takes for the top level to fit in 256 x 256.
+
+    \returns
+	nothing
+
+    \par Exceptions
+	IntegerParameterException if levels is negative.
+
+    \par Example
+	\code
+	ras->buildOverviews();
+	std::vector<float> quicklook;
+	ras->readWindow(GeoStar::Slice(0, 0, ras->get_nx(), ras->get_ny()), 512, 512, quicklook);
+	\endcode
+
+	\par Details
+	The levels are REAL32 rasters "1" .. "n", level k (nx >> k) by (ny >> k), in the group "<name>.overviews" of the
+	raster's image, whose "object_type" is "geostar::overviews"; the raster's "overviews" attribute holds n.  They are
+	made by Pyramid::build, in one read of this raster.  Building again replaces them.  Levels are never made smaller
+	than one pixel, so fewer than asked for may be made.  The next write to the raster, through any Raster object open
+	on it, deletes the attribute and the group with its levels, so no stale pyramid is left in the file; readWindow
+	then reads the raster itself until the overviews are built again.
+    */
+  void buildOverviews(const int &levels = 0);
+
+  // the number of stored overview levels that are up to date; 0 if there are none
+  int overviewCount() const;
+
+  // level k (1 .. overviewCount()) of the stored overviews, for the caller to delete
+  Raster *openOverview(const int &level) const;
+
+  // deletes the stored overviews from the file, levels and all; call it before unlinking the raster
+  void dropOverviews();
+
+/** \brief readWindow - reads a window of a raster at a reduced size
+
+    Reads slice of this raster into an outWidth by outHeight buffer, from the coarsest overview level that still
+	has a pixel for every output pixel.
+
+    \see buildOverviews, read, Map::drawRaster
+
+    \param[in] slice
+	The window, in pixels of this raster.
+
+    \param[in] outWidth, outHeight
+	The size of the result.
+
+    \param[out] buffer
+	outWidth * outHeight values, row by row.
+
+    \param[in] levels
+	Reduced-resolution copies of this raster to choose from, in place of the stored overviews.
+
+    \returns
+	nothing
+
+    \par Exceptions
+	SliceSizeException if the window is empty or reaches outside the raster, RasterSizeErrorException if outWidth or
+	outHeight is less than 1.
+
+    \par Example
+	a 256 x 256 tile of the whole scene, from the level nearest 1/32:
+	\code
+	std::vector<float> tile;
+	ras->readWindow(GeoStar::Slice(0, 0, 8192, 8192), 256, 256, tile);
+	\endcode
+
+	\par Details
+	Each output pixel takes the nearest pixel of the chosen level, so the cost depends on the output size and not on
+	the window: the level is read in bands of rows, and only the rows and the range of columns that are sampled.
+	Without overviews, or when the output is bigger than the window, this raster itself is sampled.
+    */
+  void readWindow(const Slice &slice, const long int &outWidth, const long int &outHeight,
+                  std::vector<float> &buffer) const;
+  void readWindow(const Slice &slice, const long int &outWidth, const long int &outHeight,
+                  std::vector<float> &buffer, const std::vector<Raster *> &levels) const;
+
+/** \brief minFilter - Applies a sliding-window minimum filter to an image
+
+    Writing to an output raster, each pixel becomes the minimum of the n * n square centred on it (grey-scale erosion).
+
+    \see maxFilter, meanFilter, rangeFilter, midpointFilter, harmonicMean, Neighborhood
+
+    \param[out] rasOut
+	The output raster to be written to.  Should be same size as raster this is called on.
+
+    \param[in] n
+	The width of the square window.  Should be a positive odd integer > 2.
+
+    \param[in] border
+	How the window is filled in beyond the edges of the raster.
+
+    \par Exceptions
+	IntegerParameterException
+	RasterSizeErrorException
+
+    \par Example
+	a 31x31 minimum:
+
+	\code
+	ras->minFilter(rasOut, 31);
+	\endcode
+
+    \par Details
+	Uses the van Herk/Gil-Werman running minimum along the rows and then down the columns: three comparisons per pixel per
+	axis whatever the window size.
+    */
+  void minFilter(Raster * rasOut, int n, const BorderMode &border = BORDER_REFLECT) const;
+
+/** \brief maxFilter - Applies a sliding-window maximum filter to an image
+
+    Writing to an output raster, each pixel becomes the maximum of the n * n square centred on it (grey-scale dilation).
+
+    \see minFilter, meanFilter, rangeFilter, midpointFilter, harmonicMean, Neighborhood
+
+    \par Details
+	n and border are as for minFilter.  The running maximum costs the same for any window size.
+    */
+  void maxFilter(Raster * rasOut, int n, const BorderMode &border = BORDER_REFLECT) const;
+
+/** \brief meanFilter - Applies a sliding-window mean (box) filter to an image
+
+    Writing to an output raster, each pixel becomes the mean of the n * n square centred on it.
+
+    \see minFilter, maxFilter, harmonicMean, convolve, Neighborhood
+
+    \par Details
+	n and border are as for minFilter; with BORDER_ZERO the pixels beyond the edge count as zeros.  The mean is kept as a
+	running sum along the rows and down the columns, so it costs four additions per pixel for any n.
+    */
+  void meanFilter(Raster * rasOut, int n, const BorderMode &border = BORDER_REFLECT) const;
+
+
+/** \brief medianFilter - Applies a sliding-window median filter to an image
+
+    Writing to an output raster, each pixel becomes the median of the (2*radius+1) square centred on it.  This removes
+	salt and pepper noise (see addSaltPepper) and speckle while keeping edges sharp.
+
+    \see minFilter, maxFilter, meanFilter, addSaltPepper, Neighborhood
+
+    \param[out] rasOut
+	The output raster to be written to.  Should be same size as raster this is called on.
+
+    \param[in] radius
+	The window is 2*radius+1 pixels wide and high.  Should be >= 0.
+
+    \param[in] border
+	How the window is filled in beyond the edges of the raster.
+
+    \par Exceptions
+	IntegerParameterException
+	RasterSizeErrorException
+
+    \par Example
+	despeckling a SAR band with a 7x7 median:
+
+	\code
+	ras->medianFilter(rasOut, 3);
+	\endcode
+
+    \par Details
+	For INT8U rasters the constant-time Perreault-Hebert algorithm is used, so the cost per pixel does not depend on the
+	radius.  INT16U rasters use a sliding two-level histogram, costing about 4*radius updates per pixel, and other types
+	(REAL32) find the middle of each window by selection, which is only practical for small radii.  Each input row is
+	read once; see RowWindow.
+    */
+  void medianFilter(Raster * rasOut, int radius, const BorderMode &border = BORDER_REFLECT) const;
+
+
 /** \brief harmonicMean - Applies a harmonic mean filter to an image
 
-    Writing to an output raster, computes the harmonic mean for an N * N square within the raster, applies the filter to 
-	each datapoint in that square, and repeats until the whole raster has been covered.
+    Writing to an output raster, computes the harmonic mean of the N * N square centred on each pixel of the raster.
 
     \see read, write, midpointFilter, rangeFilter
 
     \param[in] n
-	The dimensions of each local harmonic mean / square.  Should be a positive odd integer < 12 and > 2.
+	The width of the square window.  Should be a positive odd integer > 2.
 
     \param[out] rasOut
 	The output raster to be written to.  Should be same size as raster this is called on.
@@ -1970,13 +2825,15 @@ namespace GeoStar {
 
 	\par Details
 
-	IntegerParameterException will be thrown if n is less than 3, greater than 11, or not an odd integer.
+	IntegerParameterException will be thrown if n is less than 3 or not an odd integer.
 	RasterSizeErrorException will be thrown if rasOut is not the same size as the raster this is called on.
 
-	This function iterates until the entire raster has been covered, each time partitioning an N*N square of data and
-	calculating the harmonic mean for this area.  The value is then applied to all points in the square and moves on.
+	Each output pixel is the harmonic mean of the n*n window centred on it, a sliding window rather than fixed blocks.  The cost per
+	pixel does not depend on n, so 31x31 and 63x63 windows are practical on full scenes; see Neighborhood.  border says how the
+	window is filled in where it hangs over the edge of the raster.  A window with a 0 pixel in it, including the zeros BORDER_ZERO
+	adds past the edges, has a harmonic mean of 0.
     */
-  void harmonicMean(Raster * rasOut, int n);
+  void harmonicMean(Raster * rasOut, int n, const BorderMode &border = BORDER_REFLECT) const;
 
 
 /** \brief gradientMask - Applies the chosen gradient mask to an image
@@ -2052,9 +2909,9 @@ namespace GeoStar {
 	This function will define a kernel based on the chosen mask and convolves the raster with it, producing
 	a filtered output.
 
-	The HDF5 read/write does not allow negative numbers in rasters.  This prevents us from using the majority of these
-	gradient filters.  For now, the code will just default to a simple blurring filter.  The other gradient filters
-	will be kept however in hopes that they can be used one day.
+	The convolution is done by convolve, with the edge pixels repeated (BORDER_REPLICATE).  The north, east, south and
+	west masks are separable and run as two 1-D passes.  Gradients are signed: use a REAL32 output raster to keep the
+	negative values, as an unsigned output raster clips them to zero.
 
 
     */
@@ -2069,7 +2926,7 @@ namespace GeoStar {
     \see read, write, rangeFilter, harmonicMean
 
     \param[in] n
-	The dimensions of each local midpoint / square.  Should be a positive odd integer < 12 and > 2.
+	The dimensions of each local midpoint / square.  Should be a positive odd integer > 2.
 
     \param[out] rasOut
 	The output raster to be written to.  Should be same size as raster this is called on.
@@ -2128,13 +2985,14 @@ namespace GeoStar {
 
 	\par Details
 
-	IntegerParameterException will be thrown if n is less than 3, greater than 11, or not an odd integer.
+	IntegerParameterException will be thrown if n is less than 3 or not an odd integer.
 	RasterSizeErrorException will be thrown if rasOut is not the same size as the raster this is called on.
 
-	This function iterates until the entire raster has been covered, each time partitioning an N*N square of data and
-	calculating the midpoint for this area.  The value is then applied to all points in the square and moves on.
+	Each output pixel is the midpoint of the n*n window centred on it, a sliding window rather than fixed blocks.  The cost per
+	pixel does not depend on n, so 31x31 and 63x63 windows are practical on full scenes; see Neighborhood.  border says how the
+	window is filled in where it hangs over the edge of the raster.
     */
-  void midpointFilter(Raster * rasOut, int n);
+  void midpointFilter(Raster * rasOut, int n, const BorderMode &border = BORDER_REFLECT) const;
 
 
 /** \brief rangeFilter - applies a range filter for local regions across the raster
@@ -2145,7 +3003,7 @@ namespace GeoStar {
     \see read, write, midpointFilter, harmonicMean
 
     \param[in] n
-	The dimensions of each local range calculation / square.  Should be a positive odd integer < 12 and > 2.
+	The dimensions of each local range calculation / square.  Should be a positive odd integer > 2.
 
     \param[out] rasOut
 	The output raster to be written to.  Should be same size as raster this is called on.
@@ -2204,13 +3062,78 @@ namespace GeoStar {
 
 	\par Details
 
-	IntegerParameterException will be thrown if n is less than 3, greater than 11, or not an odd integer.
+	IntegerParameterException will be thrown if n is less than 3 or not an odd integer.
 	RasterSizeErrorException will be thrown if rasOut is not the same size as the raster this is called on.
 
-	This function iterates until the entire raster has been covered, each time partitioning an N*N square of data and
-	calculating the range for this area.  The value is then applied to all points in the square and moves on.
+	Each output pixel is the range of the n*n window centred on it, a sliding window rather than fixed blocks.  The cost per
+	pixel does not depend on n, so 31x31 and 63x63 windows are practical on full scenes; see Neighborhood.  border says how the
+	window is filled in where it hangs over the edge of the raster.
     */
-  void rangeFilter(Raster * rasOut, int n);
+  void rangeFilter(Raster * rasOut, int n, const BorderMode &border = BORDER_REFLECT) const;
+
+
+/** \brief integralImage, integralSquares - summed-area tables of an image
+
+    Writes the integral image of the raster to out: pixel (x,y) of out is the sum of every pixel of the raster above and to the
+	left of (x,y), itself included.  integralSquares writes the same sums of the squared pixels.  With them IntegralImage gives
+	the sum, mean and variance of any box in four lookups.
+
+    \see IntegralImage, niblackThresh, sauvolaThresh, statistics
+
+    \param[out] out
+	A REAL64 raster the same size as this one; a narrower type loses the low digits of the sums.
+
+    \par Exceptions
+	RasterSizeErrorException if out is not the same size as the raster.
+
+    \par Details
+	The raster is read once.  To make both tables in the same pass, call IntegralImage::build(ras, sums, squares).
+    */
+  void integralImage(Raster * out) const;
+  void integralSquares(Raster * out) const;
+
+
+/** \brief niblackThresh, sauvolaThresh - adaptive thresholds from the local mean and standard deviation
+
+    Writing to an output raster, each pixel is kept if it is at least the threshold of the n * n square centred on it, and set to 0
+	otherwise.  Niblack's threshold is mean + k * stddev; Sauvola's is mean * (1 + k * (stddev / range - 1)), which holds up
+	better on uneven backgrounds such as water and shadowed shorelines.
+
+    \see thresh, autoLocalThresh, otsuThreshold, meanFilter, IntegralImage
+
+    \param[out] rasOut
+	The thresholded raster, the same size as this one.
+
+    \param[in] n
+	The window size, odd and at least 3.  Any size costs the same per pixel.
+
+    \param[in] k
+	The weight of the standard deviation: usually -0.2 for Niblack and 0.2 to 0.5 for Sauvola.
+
+    \param[in] range
+	Sauvola only: the dynamic range of the standard deviation, 128 for 8-bit data.
+
+    \param[in] border
+	How the window is filled in where it hangs over the edge of the raster, as for minFilter.
+
+    \par Exceptions
+	IntegerParameterException if n is even or less than 3; RasterSizeErrorException if rasOut is not the same size.
+
+    \par Example
+	a Sauvola threshold with a 101 x 101 window:
+	\code
+	ras->sauvolaThresh(rasOut, 101, 0.3, 128);
+	\endcode
+
+    \par Details
+	Every band of rows, with its margin, is turned into summed-area tables of the pixels and their squares in memory, so each
+	pixel's window mean and variance cost a handful of additions whatever n is.  The rows are read once, as in the other
+	sliding-window filters.
+    */
+  void niblackThresh(Raster * rasOut, int n, const double &k = -0.2,
+                     const BorderMode &border = BORDER_REFLECT) const;
+  void sauvolaThresh(Raster * rasOut, int n, const double &k = 0.5, const double &range = 128,
+                     const BorderMode &border = BORDER_REFLECT) const;
 
 
 /** \brief add -- add two rasters
@@ -2375,10 +3298,16 @@ namespace GeoStar {
 
         /** \brief resize -- resize this raster to desired dimensions
 
-        This function resizes the given raster to the specified size
+        This function resamples the raster to a new size with the chosen interpolation kernel.  The first form fills an
+        existing raster of any size; the second makes a raster named <name>_resized, of this raster's type, in img.
+
+        \see Resample, ResampleKernel, downsample, upsample
+
+        \param[out] rasOut
+          The raster to fill.  Its size is the size resampled to.
 
         \param[in] image
-          The current GeoStar::Image must be passed to this function
+          The GeoStar::Image to make the resized raster in
 
         \param[in] resize_width
           The desired width of your raster
@@ -2386,56 +3315,25 @@ namespace GeoStar {
         \param[in] resize_height
           The desired height of your raster
 
+        \param[in] kernel
+          RESAMPLE_NEAREST, RESAMPLE_BILINEAR (the default), RESAMPLE_BICUBIC or RESAMPLE_LANCZOS3
+
         \returns
-          The resized raster
+          The resized raster, which the caller deletes
 
         \Par Exceptions
-          RasterSizeErrorException -- raised when the specified width or height are negative
+          RasterSizeErrorException -- raised when the specified width or height are less than 1
 
         \Par Example
-
+        a 15 m panchromatic band taken to the 30 m grid of the multispectral bands:
         \code
-        #include <string>
-#include <iostream>
-#include <cstdint>
-#include <vector>
+        GeoStar::Raster *pan = img->open_raster("B8");
+        GeoStar::Raster *b4 = img->open_raster("B4");
+        GeoStar::Raster *pan30 = img->create_raster("B8_30m", GeoStar::REAL32, b4->get_nx(), b4->get_ny());
+        pan->resize(pan30, GeoStar::RESAMPLE_BICUBIC);
 
-#include "geostar.hpp"
-
-#include "boost/filesystem.hpp"
-
-
-int main() {
-
-  std::vector<uint8_t> data(500*500);
-
-  for(int j=0;j<500;++j) for(int i=0;i<500;++i) data[j*100+i]=(j*100+i)%255;
-
-  // delete output file if already exists
-  boost::filesystem::path p("resize.h5");
-  boost::filesystem::remove(p);
-
-  GeoStar::File *file = new GeoStar::File("resize.h5","new");
-
-  GeoStar::Image *img = file->create_image("resize_1");
-
-  img = file->open_image("resize_1");
-
-  GeoStar::Raster *ras = img->create_raster("chan1", GeoStar::INT8U, 512, 1024);
-
-
-  std::vector<long int> slice(4);
-  slice[0]=10; slice [1]=15;
-  slice[2]=500; slice[3]=500;
-  ras->write(slice, data);
-
-  ras->resize(img, 100, 200);
-
-  delete ras;
-
-  delete img;
-
-  delete file;
+        GeoStar::Raster *thumb = pan->resize(img, 512, 512, GeoStar::RESAMPLE_LANCZOS3);
+        delete thumb;
         \endcode
 
         <table>
@@ -2451,8 +3349,13 @@ int main() {
         </tr>
         </table>
 
+        \par Details
+        The raster is read once, top to bottom, and nothing is read back column by column: see Resample.  When shrinking, the
+        kernel is widened by the shrink factor, so every input pixel counts towards the result.
         */
-        GeoStar::Raster* resize(GeoStar::Image *img, int resize_width, int resize_height);
+        void resize(GeoStar::Raster *rasOut, const ResampleKernel &kernel = RESAMPLE_BILINEAR) const;
+        GeoStar::Raster* resize(GeoStar::Image *img, int resize_width, int resize_height,
+                                const ResampleKernel &kernel = RESAMPLE_BILINEAR);
 
         void divide(const GeoStar::Raster * r2, GeoStar::Raster * ras_out);
 
@@ -2480,13 +3383,33 @@ int main() {
           \endcode
 
           \par Details
-          This function uses getFileName() to retrieve the raster's file, and gets the full file path in string form fo access the image name using substring operations. With both names, we can access an existing file and then access an existing image in that file.
+          The image group is kept open from the time the raster is opened or created, so this only wraps it in a
+          new Image object, which the caller deletes; the file is not reopened.
+          */
+        GeoStar::Image * getParent() const;
+
+        /** \brief operator= -- evaluates a raster expression into this raster
+
+          Evaluates expr in one block-by-block pass and writes the result into this raster, which
+          must already exist and have the size of the expression.  This raster may itself appear
+          in the expression.
+
+          \see RasterExpr, operator+, operator-, operator*, operator/
+
+          \par Exceptions
+            RasterSizeErrorException -- raised when this raster is not the size of the expression
+
+          \par Example
+          \code
+          *ndvi = (*nir - *red) / (*nir + *red);
+          *ras = *ras * 0.5 + 10;
+          \endcode
           */
-        GeoStar::Image * getParent();
+        GeoStar::Raster & operator=(const GeoStar::RasterExpr & expr);
 
         /** \brief operator+ -- add two rasters
 
-          Returns a raster pointer containing the sum of two rasters.
+          Returns a lazy expression for the sum of two rasters.
 
           \see add
 
@@ -2494,7 +3417,7 @@ int main() {
             The raster to add to this raster. Must have the same dimensions as this.
 
           \returns
-            A GeoStar::Raster pointer which contains the sum of the two rasters.
+            A GeoStar::RasterExpr for the sum of the two rasters.  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \par Exceptions
             RasterSizeErrorException -- raised when the two rasters have different sizes
@@ -2521,13 +3444,13 @@ int main() {
           \endcode
 
           \par Details
-            This function uses getParent() to be able to make a new raster in "this" raster's Image. It then uses the add() function on that raster to store the summed rasters.
+            Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
           */
-        GeoStar::Raster * operator+(const GeoStar::Raster & r2);
+        GeoStar::RasterExpr operator+(const GeoStar::Raster & r2) const;
 
         /** \brief operator- -- subtract a raster from another
 
-          Returns a raster pointer containing the difference between this raster and r2.
+          Returns a lazy expression for the difference between this raster and r2.
 
           \see subtract
 
@@ -2535,7 +3458,7 @@ int main() {
             The raster to subtract from this raster. Must have the same dimensions as this.
 
           \returns
-            A GeoStar::Raster pointer which contains the difference between the two rasters.
+            A GeoStar::RasterExpr for the difference between the two rasters.  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \Par Exceptions
             RasterSizeErrorException -- raised when the two rasters have different sizes
@@ -2562,13 +3485,13 @@ int main() {
             \endcode
 
             \par Details
-              This function uses getParent() to be able to make a new raster in "this" raster's Image. It then uses the subtract() function on that raster to store the difference between the rasters.
+              Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
             */
-        GeoStar::Raster * operator-(const GeoStar::Raster & r2);
+        GeoStar::RasterExpr operator-(const GeoStar::Raster & r2) const;
 
         /** \brief operator* -- multiply a raster by another
 
-          Returns a raster pointer containing the product of this raster and r2.
+          Returns a lazy expression for the product of this raster and r2.
 
           \see multiply
 
@@ -2576,7 +3499,7 @@ int main() {
             The raster to multiply this raster with. Must have the same dimensions as this.
 
           \returns
-            A GeoStar::Raster pointer which contains the product of the two rasters.
+            A GeoStar::RasterExpr for the product of the two rasters.  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \Par Exceptions
             RasterSizeErrorException -- raised when the two rasters have different sizes
@@ -2603,13 +3526,13 @@ int main() {
             \endcode
 
             \par Details
-              This function uses getParent() to be able to make a new raster in "this" raster's Image. It then uses the multiply() function on that raster to store the product of the rasters.
+              Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
             */
-        GeoStar::Raster * operator*(const GeoStar::Raster & r2);
+        GeoStar::RasterExpr operator*(const GeoStar::Raster & r2) const;
 
         /** \brief operator/ -- divide a raster by another
 
-          Returns a raster pointer containing the quotient of this raster and r2.
+          Returns a lazy expression for the quotient of this raster and r2.
 
           \see divide
 
@@ -2617,7 +3540,7 @@ int main() {
             The raster to divide this raster by. Must have the same dimensions as this.
 
           \returns
-            A GeoStar::Raster pointer which contains the quotient of the two rasters.
+            A GeoStar::RasterExpr for the quotient of the two rasters.  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \Par Exceptions
             RasterSizeErrorException -- raised when the two rasters have different sizes
@@ -2644,13 +3567,13 @@ int main() {
             \endcode
 
             \par Details
-              This function uses getParent() to be able to make a new raster in "this" raster's Image. It then uses the divide() function on that raster to store the quotient of the rasters.
+              Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
             */
-        GeoStar::Raster * operator/(const GeoStar::Raster & r2);
+        GeoStar::RasterExpr operator/(const GeoStar::Raster & r2) const;
 
         /** \brief operator+ -- add a constant to a raster
 
-          Returns a raster pointer containing the raster with a constant value added to each pixel
+          Returns a lazy expression for the raster with a constant value added to each pixel
 
           \see operator+
 
@@ -2658,7 +3581,7 @@ int main() {
             The float value to add to each pixel in the raster.
 
           \returns
-            A GeoStar::Raster pointer which contains the raster with a constant value added to each pixel
+            A GeoStar::RasterExpr for the raster with a constant value added to each pixel  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \Par Exceptions
             None
@@ -2685,13 +3608,13 @@ int main() {
             \endcode
 
             \par Details
-              This function uses getParent() to be able to make a new raster in "this" raster's Image. It then iterates through every pixel and adds the value to each.
+              Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
             */
-        GeoStar::Raster * operator+(const float & val);
+        GeoStar::RasterExpr operator+(const float & val) const;
 
         /** \brief operator- -- subtract a constant from a raster
 
-          Returns a raster pointer containing the raster with a constant value subtracted from each pixel
+          Returns a lazy expression for the raster with a constant value subtracted from each pixel
 
           \see operator-
 
@@ -2699,7 +3622,7 @@ int main() {
             The float value to subtract from each pixel in the raster.
 
           \returns
-            A GeoStar::Raster pointer which contains the raster with a constant value subtracted from each pixel.
+            A GeoStar::RasterExpr for the raster with a constant value subtracted from each pixel.  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \Par Exceptions
             None
@@ -2726,13 +3649,13 @@ int main() {
             \endcode
 
             \par Details
-              This function uses getParent() to be able to make a new raster in "this" raster's Image. It then iterates through every pixel and subtracts the value from each.
+              Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
             */
-        GeoStar::Raster * operator-(const float & val);
+        GeoStar::RasterExpr operator-(const float & val) const;
 
         /** \brief operator* -- multiply a raster by a constant
 
-          Returns a raster pointer containing the raster with a constant value multiplied by each pixel.
+          Returns a lazy expression for the raster with a constant value multiplied by each pixel.
 
           \see operator*
 
@@ -2740,7 +3663,7 @@ int main() {
             The float value to multiply each pixel by in the raster.
 
           \returns
-            A GeoStar::Raster pointer which contains the raster with a constant value multiplied by each pixel.
+            A GeoStar::RasterExpr for the raster with a constant value multiplied by each pixel.  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \Par Exceptions
             None
@@ -2767,13 +3690,13 @@ int main() {
             \endcode
 
             \par Details
-              This function uses getParent() to be able to make a new raster in "this" raster's Image. It then iterates through every pixel and multiplies the value by each.
+              Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
             */
-        GeoStar::Raster * operator*(const float & val);
+        GeoStar::RasterExpr operator*(const float & val) const;
 
         /** \brief operator/ -- divide a raster by a constant
 
-          Returns a raster pointer containing the raster with each pixel divided by a constant value
+          Returns a lazy expression for the raster with each pixel divided by a constant value
 
           \see operator/
 
@@ -2781,7 +3704,7 @@ int main() {
             The float value to divide each pixel by in the raster.
 
           \returns
-            A GeoStar::Raster pointer which contains the raster with each pixel divided by a constant value.
+            A GeoStar::RasterExpr for the raster with each pixel divided by a constant value.  Assigning it to a GeoStar::Raster pointer materializes it as a new raster.
 
           \Par Exceptions
             GeoStar::DivideByZeroException -- occurs when you divide by zero.
@@ -2808,11 +3731,26 @@ int main() {
             \endcode
 
             \par Details
-              This function uses getParent() to be able to make a new raster in "this" raster's Image. It then iterates through every pixel and divides the value into each.
+              Nothing is computed until the expression is evaluated; see RasterExpr.  Converting to a GeoStar::Raster pointer uses getParent() to make a new raster in "this" raster's Image and fills it in one block-by-block pass.
             */
-        GeoStar::Raster * operator/(const float & val);
+        GeoStar::RasterExpr operator/(const float & val) const;
   }; // end class: Raster
 
+
+  // defined in Raster.cpp; declared here so that every translation unit uses them
+  template <> const H5::DataType &Raster::getHdf5Type<uint8_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<int8_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<uint16_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<int16_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<uint32_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<int32_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<uint64_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<int64_t>();
+  template <> const H5::DataType &Raster::getHdf5Type<float>();
+  template <> const H5::DataType &Raster::getHdf5Type<double>();
+  template <> const H5::DataType &Raster::getHdf5Type<std::complex<float> >();
+  template <> const H5::DataType &Raster::getHdf5Type<std::complex<double> >();
+
 }// end namespace GeoStar
 
 
@@ -0,0 +1,341 @@
+// RasterExpr.cpp
+//
+// Implementations for lazy raster-algebra expressions
+// Documentation in RasterExpr.hpp
+//--------------------------------------------
+
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Image.hpp"
+#include "Raster.hpp"
+#include "RasterExpr.hpp"
+#include "ThreadPool.hpp"
+#include "BlockStream.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  // one node of the expression tree
+  struct RasterExpr::Node {
+    Op op;
+    const Raster *ras;                        // LEAF
+    float value;                              // CONSTANT
+    std::shared_ptr<const Node> lhs, rhs;     // binary ops
+    long int nx, ny;                          // 0 for a CONSTANT
+
+    Node() : op(CONSTANT), ras(NULL), value(0), nx(0), ny(0) {}
+  };
+
+
+
+  // The tree is flattened into a list of steps before evaluation.  Each step combines two
+  // operands into a slot; an operand is either a slot (slot>=0) or a constant.  Slots
+  // 0..nLeaves-1 hold the raster blocks, the rest hold intermediate results.
+  namespace {
+
+    struct Operand {
+      int slot;
+      float value;
+    };
+
+    struct Step {
+      RasterExpr::Op op;
+      Operand a, b;
+      int out;
+    };
+
+    struct Program {
+      std::vector<const Raster *> leaves;
+      std::vector<Step> steps;
+      int nSlots;
+      Operand result;
+    };
+
+    // distinct rasters each get one slot, so a raster used twice is read once per block
+    int leafSlot(Program &prog, const Raster *ras) {
+      for(size_t i=0; i<prog.leaves.size(); ++i) {
+        if(prog.leaves[i] == ras) return (int)i;
+      }// endfor: i
+      prog.leaves.push_back(ras);
+      return (int)prog.leaves.size()-1;
+    }// end: leafSlot
+
+    // the leaves are given the low slot numbers before any intermediate is
+    void collectLeaves(Program &prog, const RasterExpr::Node *node) {
+      if(node->op == RasterExpr::LEAF) leafSlot(prog, node->ras);
+      else if(node->op != RasterExpr::CONSTANT) {
+        collectLeaves(prog, node->lhs.get());
+        collectLeaves(prog, node->rhs.get());
+      }
+    }// end: collectLeaves
+
+    Operand compile(Program &prog, const RasterExpr::Node *node) {
+      Operand res;
+      res.slot = -1;
+      res.value = 0;
+      if(node->op == RasterExpr::CONSTANT) {
+        res.value = node->value;
+      } else if(node->op == RasterExpr::LEAF) {
+        res.slot = leafSlot(prog, node->ras);
+      } else {
+        Step step;
+        step.op = node->op;
+        step.a = compile(prog, node->lhs.get());
+        step.b = compile(prog, node->rhs.get());
+        step.out = prog.nSlots++;
+        prog.steps.push_back(step);
+        res.slot = step.out;
+      }
+      return res;
+    }// end: compile
+
+
+
+    struct Plus  { inline float operator()(const float &a, const float &b) const { return a+b; } };
+    struct Minus { inline float operator()(const float &a, const float &b) const { return a-b; } };
+    struct Times { inline float operator()(const float &a, const float &b) const { return a*b; } };
+    struct DividedBy {
+      // divide by zero goes to max value, as in Raster::divide
+      inline float operator()(const float &a, const float &b) const { return (b == 0) ? 255 : a/b; }
+    };
+
+    // separate loops for slot/slot, slot/constant and constant/slot so each one vectorizes
+    template<typename F>
+    void applyStep(const F &f, const float *a, const float &av, const float *b, const float &bv,
+                   float *out, const long int &n) {
+      if(a && b) {
+        for(long int i=0; i<n; ++i) out[i] = f(a[i], b[i]);
+      } else if(a) {
+        for(long int i=0; i<n; ++i) out[i] = f(a[i], bv);
+      } else if(b) {
+        for(long int i=0; i<n; ++i) out[i] = f(av, b[i]);
+      } else {
+        float v = f(av, bv);
+        for(long int i=0; i<n; ++i) out[i] = v;
+      }
+    }// end: applyStep
+
+    float applyConstant(const RasterExpr::Op &op, const float &a, const float &b) {
+      switch(op) {
+      case RasterExpr::PLUS:      return Plus()(a, b);
+      case RasterExpr::MINUS:     return Minus()(a, b);
+      case RasterExpr::TIMES:     return Times()(a, b);
+      case RasterExpr::DIVIDEDBY: return DividedBy()(a, b);
+      default:                    return 0;
+      }
+    }// end: applyConstant
+
+  }// end anonymous namespace
+
+
+
+  RasterExpr::RasterExpr(const Raster &ras) {
+    std::shared_ptr<Node> n(new Node);
+    n->op = LEAF;
+    n->ras = &ras;
+    n->nx = ras.get_nx();
+    n->ny = ras.get_ny();
+    node = n;
+  }// end: RasterExpr(Raster)
+
+
+  RasterExpr::RasterExpr(const Op &op, const RasterExpr &lhs, const RasterExpr &rhs) {
+    const Node *l = lhs.node.get();
+    const Node *r = rhs.node.get();
+
+    if(l->op != CONSTANT && r->op != CONSTANT && (l->nx != r->nx || l->ny != r->ny)) {
+      RasterSizeErrorException RasterSizeError;
+      throw RasterSizeError;
+    }
+    if(r->op == CONSTANT && r->value == 0 && op == DIVIDEDBY) {
+      DivideByZeroException DivideByZeroError;
+      throw DivideByZeroError;
+    }
+
+    std::shared_ptr<Node> n(new Node);
+    if(l->op == CONSTANT && r->op == CONSTANT) {
+      // fold constant sub-expressions
+      n->op = CONSTANT;
+      n->value = applyConstant(op, l->value, r->value);
+    } else {
+      n->op = op;
+      n->lhs = lhs.node;
+      n->rhs = rhs.node;
+      n->nx = (l->op == CONSTANT) ? r->nx : l->nx;
+      n->ny = (l->op == CONSTANT) ? r->ny : l->ny;
+    }
+    node = n;
+  }// end: RasterExpr(op, lhs, rhs)
+
+
+  RasterExpr RasterExpr::constant(const float &val) {
+    std::shared_ptr<Node> n(new Node);
+    n->op = CONSTANT;
+    n->value = val;
+    return RasterExpr(n);
+  }// end: constant
+
+
+  long int RasterExpr::get_nx() const {
+    return node->nx;
+  }// end: get_nx
+
+  long int RasterExpr::get_ny() const {
+    return node->ny;
+  }// end: get_ny
+
+
+  // builds the name the eager operators used to give their results
+  static std::string nodeName(const RasterExpr::Node *node) {
+    switch(node->op) {
+    case RasterExpr::LEAF:      return node->ras->get_name();
+    case RasterExpr::CONSTANT:  return "val";
+    case RasterExpr::PLUS:      return nodeName(node->lhs.get()) + "_PLUS_" + nodeName(node->rhs.get());
+    case RasterExpr::MINUS:     return nodeName(node->lhs.get()) + "_MINUS_" + nodeName(node->rhs.get());
+    case RasterExpr::TIMES:     return nodeName(node->lhs.get()) + "_TIMES_" + nodeName(node->rhs.get());
+    case RasterExpr::DIVIDEDBY: return nodeName(node->lhs.get()) + "_DIVIDEDBY_" + nodeName(node->rhs.get());
+    default:                    return "";
+    }
+  }// end: nodeName
+
+  std::string RasterExpr::name() const {
+    return nodeName(node.get());
+  }// end: name
+
+
+
+  void RasterExpr::evaluate(Raster *ras_out) const {
+    GEOSTAR_PROFILE_SCOPE("RasterExpr::evaluate");
+    Program prog;
+    collectLeaves(prog, node.get());
+    if(prog.leaves.empty()) {
+      RasterExprException RasterExprError;
+      throw RasterExprError;
+    }
+    if(ras_out->get_nx() != get_nx() || ras_out->get_ny() != get_ny()) {
+      RasterSizeErrorException RasterSizeError;
+      throw RasterSizeError;
+    }
+    prog.nSlots = (int)prog.leaves.size();
+    prog.result = compile(prog, node.get());
+
+    // follow the output's chunking: its blocks are the ones that get compressed.  The leaves
+    // fill the first slots of each block.
+    BlockStream<float> stream(ras_out, prog.leaves, prog.nSlots, ras_out, prog.result.slot);
+    stream.run([&](BlockStream<float>::Block &block) {
+        std::vector<std::vector<float> > &slots = block.slots;
+
+        // every range runs the whole program, so its intermediates stay in cache
+        parallel_for(block.n, [&](long int begin, long int end) {
+          long int len = end - begin;
+          for(size_t s=0; s<prog.steps.size(); ++s) {
+            const Step &step = prog.steps[s];
+            const float *a = (step.a.slot >= 0) ? &slots[step.a.slot][begin] : NULL;
+            const float *b = (step.b.slot >= 0) ? &slots[step.b.slot][begin] : NULL;
+            float *out = &slots[step.out][begin];
+            switch(step.op) {
+            case PLUS:      applyStep(Plus(),      a, step.a.value, b, step.b.value, out, len); break;
+            case MINUS:     applyStep(Minus(),     a, step.a.value, b, step.b.value, out, len); break;
+            case TIMES:     applyStep(Times(),     a, step.a.value, b, step.b.value, out, len); break;
+            case DIVIDEDBY: applyStep(DividedBy(), a, step.a.value, b, step.b.value, out, len); break;
+            default: break;
+            }
+          }// endfor: s
+        });
+      });
+
+  }// end: evaluate
+
+
+
+  // the first raster of the expression, left to right
+  static const Raster *firstLeaf(const RasterExpr::Node *node) {
+    if(node->op == RasterExpr::LEAF) return node->ras;
+    if(node->op == RasterExpr::CONSTANT) return NULL;
+    const Raster *ras = firstLeaf(node->lhs.get());
+    return ras ? ras : firstLeaf(node->rhs.get());
+  }// end: firstLeaf
+
+
+  Raster *RasterExpr::materialize(Image *img, const std::string &name) const {
+    const Raster *first = firstLeaf(node.get());
+    if(!first) {
+      RasterExprException RasterExprError;
+      throw RasterExprError;
+    }
+    Raster *ras_out = new Raster(img, name, first->get_datatype(), get_nx(), get_ny());
+    try {
+      evaluate(ras_out);
+    } catch(...) {
+      delete ras_out;
+      throw;
+    }
+    return ras_out;
+  }// end: materialize
+
+
+  Raster *RasterExpr::materialize() const {
+    const Raster *first = firstLeaf(node.get());
+    if(!first) {
+      RasterExprException RasterExprError;
+      throw RasterExprError;
+    }
+    Image *img = first->getParent();
+    Raster *ras_out;
+    try {
+      ras_out = materialize(img, name());
+    } catch(...) {
+      delete img;
+      throw;
+    }
+    delete img;
+    return ras_out;
+  }// end: materialize
+
+
+
+  RasterExpr operator+(const RasterExpr &lhs, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::PLUS, lhs, rhs);
+  }
+  RasterExpr operator-(const RasterExpr &lhs, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::MINUS, lhs, rhs);
+  }
+  RasterExpr operator*(const RasterExpr &lhs, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::TIMES, lhs, rhs);
+  }
+  RasterExpr operator/(const RasterExpr &lhs, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::DIVIDEDBY, lhs, rhs);
+  }
+
+  RasterExpr operator+(const RasterExpr &lhs, const float &val) {
+    return RasterExpr(RasterExpr::PLUS, lhs, RasterExpr::constant(val));
+  }
+  RasterExpr operator-(const RasterExpr &lhs, const float &val) {
+    return RasterExpr(RasterExpr::MINUS, lhs, RasterExpr::constant(val));
+  }
+  RasterExpr operator*(const RasterExpr &lhs, const float &val) {
+    return RasterExpr(RasterExpr::TIMES, lhs, RasterExpr::constant(val));
+  }
+  RasterExpr operator/(const RasterExpr &lhs, const float &val) {
+    return RasterExpr(RasterExpr::DIVIDEDBY, lhs, RasterExpr::constant(val));
+  }
+
+  RasterExpr operator+(const float &val, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::PLUS, RasterExpr::constant(val), rhs);
+  }
+  RasterExpr operator-(const float &val, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::MINUS, RasterExpr::constant(val), rhs);
+  }
+  RasterExpr operator*(const float &val, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::TIMES, RasterExpr::constant(val), rhs);
+  }
+  RasterExpr operator/(const float &val, const RasterExpr &rhs) {
+    return RasterExpr(RasterExpr::DIVIDEDBY, RasterExpr::constant(val), rhs);
+  }
+
+}// end namespace GeoStar
@@ -0,0 +1,132 @@
+// RasterExpr.hpp
+//
+// Lazy raster-algebra expressions
+//----------------------------------------
+#ifndef RASTEREXPR_HPP_
+#define RASTEREXPR_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace GeoStar {
+  class Raster;
+  class Image;
+
+  /** \brief RasterExpr -- a lazily evaluated pixel-wise expression over rasters
+
+  The arithmetic operators of Raster (+, -, *, / between two rasters or a raster and a constant)
+  do not touch the file.  They return a RasterExpr, a small tree whose leaves are rasters and
+  constants.  Expressions combine with further operators, and the whole tree is evaluated in one
+  block-by-block pass when it is assigned to a raster or materialized.
+
+  \see Raster::operator+, Raster::operator-, Raster::operator*, Raster::operator/, Raster::BlockIterator
+
+  \Par Example
+	NDVI from two bands, written to an existing raster:
+	\code
+	GeoStar::Raster *nir = img->open_raster("B05");
+	GeoStar::Raster *red = img->open_raster("B04");
+	GeoStar::Raster *ndvi = img->create_raster("ndvi", GeoStar::REAL32, nir->get_nx(), nir->get_ny());
+
+	*ndvi = (*nir - *red) / (*nir + *red);
+	\endcode
+
+	or, letting the expression make the output raster in nir's image:
+	\code
+	GeoStar::Raster *ndvi = (*nir - *red) / (*nir + *red);
+	\endcode
+
+  \Par Details
+	Nothing is read until the expression is evaluated.  Each distinct raster in the tree is then
+	read once per block, whatever number of times it appears, the operations run on the block
+	in memory, and the result is written once.  No intermediate datasets are made, so
+	(a+b)*0.5-c costs three reads and one write instead of three temporary rasters and six
+	full passes.
+
+	An expression only holds pointers to its rasters; they must stay open until it is evaluated.
+	The output may be one of the inputs (*a = *a * 2.0), since each block is read before it is
+	written.
+
+	The arithmetic is done in float, as in Raster::add and friends.  Dividing by a raster pixel
+	of 0 gives 255; dividing by the constant 0 throws DivideByZeroException when the expression
+	is built.  All rasters in an expression must have the same size, or RasterSizeErrorException
+	is thrown when it is built.
+
+	Converting an expression to a Raster* (for example returning it from a function declared to
+	return Raster*) materializes it in the parent image of its first raster, under the name the
+	old operators used, e.g. "B05_MINUS_B04_DIVIDEDBY_B05_PLUS_B04".  The caller owns the new raster.
+  */
+  class RasterExpr {
+
+  public:
+    enum Op { LEAF, CONSTANT, PLUS, MINUS, TIMES, DIVIDEDBY };
+
+    // a single raster
+    RasterExpr(const Raster &ras);
+
+    // lhs op rhs
+    RasterExpr(const Op &op, const RasterExpr &lhs, const RasterExpr &rhs);
+
+    // a constant; only meaningful as an operand of a binary expression
+    static RasterExpr constant(const float &val);
+
+    // the size of the rasters in the expression
+    long int get_nx() const;
+    long int get_ny() const;
+
+    // the name materialize() gives the result
+    std::string name() const;
+
+    /** \brief evaluate -- computes the expression into an existing raster
+
+    \param[in] ras_out
+	The raster to write to.  Must have the same size as the expression; it may also appear
+	in the expression.
+
+    \Par Exceptions
+	RasterSizeErrorException -- ras_out is not the size of the expression
+	RasterExprException -- the expression has no rasters in it
+    */
+    void evaluate(Raster *ras_out) const;
+
+    /** \brief materialize -- computes the expression into a new raster
+
+    Makes a new raster of the datatype of the first raster in the expression, and evaluates
+	the expression into it.  The version without arguments makes it in the parent image of
+	the first raster, named by name().  The caller must delete the returned raster.
+    */
+    Raster *materialize(Image *img, const std::string &name) const;
+    Raster *materialize() const;
+
+    inline operator Raster*() const { return materialize(); }
+
+    // a node of the tree; defined in RasterExpr.cpp
+    struct Node;
+
+  private:
+    std::shared_ptr<const Node> node;
+
+    explicit RasterExpr(const std::shared_ptr<const Node> &n) : node(n) {}
+
+  }; // end class: RasterExpr
+
+
+  RasterExpr operator+(const RasterExpr &lhs, const RasterExpr &rhs);
+  RasterExpr operator-(const RasterExpr &lhs, const RasterExpr &rhs);
+  RasterExpr operator*(const RasterExpr &lhs, const RasterExpr &rhs);
+  RasterExpr operator/(const RasterExpr &lhs, const RasterExpr &rhs);
+
+  RasterExpr operator+(const RasterExpr &lhs, const float &val);
+  RasterExpr operator-(const RasterExpr &lhs, const float &val);
+  RasterExpr operator*(const RasterExpr &lhs, const float &val);
+  RasterExpr operator/(const RasterExpr &lhs, const float &val);
+
+  RasterExpr operator+(const float &val, const RasterExpr &rhs);
+  RasterExpr operator-(const float &val, const RasterExpr &rhs);
+  RasterExpr operator*(const float &val, const RasterExpr &rhs);
+  RasterExpr operator/(const float &val, const RasterExpr &rhs);
+
+}// end namespace GeoStar
+
+#endif //RASTEREXPR_HPP_
@@ -23,7 +23,10 @@ namespace GeoStar {
     
   }; // end: RasterType
 
-  // yet to define complex types.....
+  // complex types are named by their total size in bits: COMPLEX_INT16 is a pair of 8-bit
+  // integers and COMPLEX_REAL64 a pair of floats.  Pixels are stored as an HDF5 compound with
+  // members "r" and "i", and COMPLEX_REAL64/COMPLEX_REAL128 pixels are read and written as
+  // std::complex<float>/std::complex<double>.
 
 }// end namespace GeoStar
 
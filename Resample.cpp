@@ -0,0 +1,186 @@
+// Resample.cpp
+//
+// Implementation of the separable resampler
+// Documentation in Resample.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "Resample.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    const double PI = 3.14159265358979323846;
+
+    // half-width of the kernel, in input pixels, before any stretching
+    double support(const ResampleKernel &kernel) {
+      switch(kernel) {
+      case RESAMPLE_BILINEAR: return 1.0;
+      case RESAMPLE_BICUBIC:  return 2.0;
+      case RESAMPLE_LANCZOS3: return 3.0;
+      default:                return 0.5;
+      }// end case
+    }// end: support
+
+    double weight(const ResampleKernel &kernel, double t) {
+      t = std::fabs(t);
+      switch(kernel) {
+      case RESAMPLE_BILINEAR:
+        return (t < 1.0) ? 1.0 - t : 0.0;
+      case RESAMPLE_BICUBIC: {
+        const double a = -0.5;
+        if(t < 1.0) return ((a + 2.0)*t - (a + 3.0))*t*t + 1.0;
+        if(t < 2.0) return ((a*t - 5.0*a)*t + 8.0*a)*t - 4.0*a;
+        return 0.0;
+      }
+      case RESAMPLE_LANCZOS3:
+        if(t < 1e-12) return 1.0;
+        if(t < 3.0) return 3.0 * std::sin(PI*t) * std::sin(PI*t/3.0) / (PI*PI*t*t);
+        return 0.0;
+      default:
+        return (t <= 0.5) ? 1.0 : 0.0;
+      }// end case
+    }// end: weight
+
+
+    // output pixel i is the sum over k < count[i] of w[i*width + k] * input[first[i] + k]
+    struct Taps {
+      long int width;
+      std::vector<long int> first, count;
+      std::vector<double> w;
+
+      Taps(const long int &nIn, const long int &nOut, const ResampleKernel &kernel)
+        : first(nOut), count(nOut) {
+        const double scale = (double)nIn / nOut;
+
+        if(kernel == RESAMPLE_NEAREST) {
+          width = 1;
+          w.assign(nOut, 1.0);
+          for(long int i=0; i<nOut; ++i) {
+            first[i] = std::min(nIn-1, (long int)((i + 0.5) * scale));
+            count[i] = 1;
+          }// endfor: i
+          return;
+        }// endif
+
+        // shrinking stretches the kernel, so it averages every input pixel it covers
+        const double stretch = std::max(1.0, scale);
+        const double reach = support(kernel) * stretch;
+        width = 2*(long int)std::ceil(reach) + 1;
+        w.assign(nOut*width, 0.0);
+
+        for(long int i=0; i<nOut; ++i) {
+          const double centre = (i + 0.5) * scale - 0.5;
+          const long int lo = std::max(0L, (long int)std::ceil(centre - reach));
+          const long int hi = std::min(nIn-1, (long int)std::floor(centre + reach));
+          double *wi = &w[i*width];
+          double sum = 0.0;
+          for(long int j=lo; j<=hi; ++j) sum += (wi[j-lo] = weight(kernel, (j - centre) / stretch));
+          first[i] = lo;
+          count[i] = hi - lo + 1;
+          if(sum != 0.0) {
+            for(long int k=0; k<count[i]; ++k) wi[k] /= sum;
+          } else {
+            // nothing under the kernel: the nearest pixel
+            first[i] = std::min(nIn-1, std::max(0L, (long int)std::floor(centre + 0.5)));
+            count[i] = 1;
+            wi[0] = 1.0;
+          }
+        }// endfor: i
+      }
+    };
+
+  }// end anonymous namespace
+
+
+
+  void Resample::resize(const Raster *in, Raster *out, const ResampleKernel &kernel) {
+    GEOSTAR_PROFILE_SCOPE("Resample::resize");
+    const long int nx = in->get_nx(), ny = in->get_ny();
+    const long int onx = out->get_nx(), ony = out->get_ny();
+    if(nx == 0 || ny == 0 || onx == 0 || ony == 0) return;
+
+    const Taps tx(nx, onx, kernel), ty(ny, ony, kernel);
+    const bool integer = out->get_datatype() <= INT64S;
+
+    // bands of output rows, held to about 1M filtered input pixels however far the raster
+    // shrinks; the input is read in strips of about 1M pixels
+    long int band = out->get_chunk_ny();
+    if(band <= 0) band = std::max(1L, (1L << 20) / onx);
+    const long int perRow = std::max(1L, (ny + ony - 1) / ony);
+    band = std::min(band, std::max(1L, (1L << 20) / (onx * perRow)));
+    const long int strip = std::max(1L, (1L << 20) / nx);
+
+    // input rows [h0,h1), filtered along x, onx doubles each
+    std::vector<double> ring, raw, outData;
+    long int h0 = 0, h1 = 0;
+
+    for(long int oy0=0; oy0<ony; oy0+=band) {
+      const long int rows = std::min(band, ony-oy0);
+
+      // the input rows this band of output rows needs
+      const long int a = ty.first[oy0];
+      long int b = a;
+      for(long int oy=oy0; oy<oy0+rows; ++oy) b = std::max(b, ty.first[oy] + ty.count[oy]);
+
+      // 1. drop the filtered rows above the band, and filter the new ones along x
+      if(a >= h1) {
+        h0 = h1 = a;
+      } else if(a > h0) {
+        std::copy(ring.begin() + (a-h0)*onx, ring.begin() + (h1-h0)*onx, ring.begin());
+        h0 = a;
+      }
+      if(b > h1) ring.resize((b-h0)*onx);
+      while(b > h1) {
+        const long int n = std::min(strip, b - h1);
+        raw.resize(n*nx);
+        in->read(Slice(0, h1, nx, n), &raw[0]);
+        parallel_for(n, [&](long int begin, long int end) {
+          for(long int r=begin; r<end; ++r) {
+            const double *p = &raw[r*nx];
+            double *h = &ring[(h1-h0+r)*onx];
+            for(long int x=0; x<onx; ++x) {
+              const double *src = p + tx.first[x];
+              const double *wx = &tx.w[x*tx.width];
+              double acc = 0.0;
+              for(long int k=0; k<tx.count[x]; ++k) acc += wx[k] * src[k];
+              h[x] = acc;
+            }// endfor: x
+          }// endfor: r
+        }, 1);
+        h1 += n;
+      }// endwhile
+
+      // 2. along y: each output row is a weighted sum of whole filtered rows
+      outData.resize(rows*onx);
+      parallel_for(rows, [&](long int begin, long int end) {
+        for(long int r=begin; r<end; ++r) {
+          const long int oy = oy0 + r;
+          double *o = &outData[r*onx];
+          std::fill(o, o+onx, 0.0);
+          for(long int k=0; k<ty.count[oy]; ++k) {
+            const double wy = ty.w[oy*ty.width + k];
+            const double *h = &ring[(ty.first[oy] + k - h0)*onx];
+            for(long int x=0; x<onx; ++x) o[x] += wy * h[x];
+          }// endfor: k
+          if(integer) {
+            for(long int x=0; x<onx; ++x) o[x] = std::floor(o[x] + 0.5);
+          }
+        }// endfor: r
+      }, 1);
+
+      out->write(Slice(0, oy0, onx, rows), &outData[0]);
+    }// endfor: oy0
+  }// end: resize
+
+}// end namespace GeoStar
@@ -0,0 +1,55 @@
+// Resample.hpp
+//
+// Separable resampling of a raster to a new size
+//----------------------------------------
+#ifndef RESAMPLE_HPP_
+#define RESAMPLE_HPP_
+
+#include <vector>
+
+namespace GeoStar {
+  class Raster;
+
+  // the interpolation kernels of Raster::resize
+  enum ResampleKernel { RESAMPLE_NEAREST, RESAMPLE_BILINEAR, RESAMPLE_BICUBIC, RESAMPLE_LANCZOS3 };
+
+
+  /** \brief Resample -- resizes a raster with a separable interpolation kernel
+
+  Output pixel centres are mapped onto the input, (x + 0.5) * nx_in / nx_out - 0.5 and the same
+  in y, and each output pixel is a weighted sum of the input pixels around that point: the nearest
+  one, or the 2x2, 4x4 or 6x6 pixels under the bilinear, bicubic (Keys, a = -0.5) or Lanczos-3
+  kernel.  When shrinking, the kernel is stretched by the shrink factor, so every input pixel
+  contributes and 15 m data taken to 30 m is averaged rather than sampled.
+
+  \see Raster::resize, ResampleKernel, Raster::downsample
+
+  \Par Example
+	a 15 m panchromatic band resampled onto a 30 m grid:
+	\code
+	GeoStar::Raster *pan30 = img->create_raster("B8_30m", GeoStar::REAL32, pan->get_nx()/2, pan->get_ny()/2);
+	GeoStar::Resample::resize(pan, pan30, GeoStar::RESAMPLE_BICUBIC);
+	\endcode
+
+  \Par Details
+	The weights of every output column and row are worked out once, before any pixel is read, and
+	normalised so that they sum to one; taps that would fall outside the raster are dropped.  The
+	input is read once, top to bottom, in strips of about 1M pixels.  Each input row is filtered
+	along x as it arrives and kept in a ring of filtered rows until no output row needs it, and
+	each band of output rows is then a weighted sum of whole filtered rows, a loop over contiguous
+	memory that the compiler vectorises (at -O2, see OPT in the Makefile).  The bands are kept
+	short enough that the ring holds about 1M filtered pixels plus the kernel's reach, so memory
+	does not grow with the shrink factor.  Both passes are spread over the File::set_num_threads pool, by rows.
+	Integer outputs are rounded to the nearest value.
+  */
+  class Resample {
+
+  public:
+    // resamples in onto the grid of out, whatever their sizes
+    static void resize(const Raster *in, Raster *out, const ResampleKernel &kernel);
+
+  }; // end class: Resample
+
+}// end namespace GeoStar
+
+#endif //RESAMPLE_HPP_
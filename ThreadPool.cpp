@@ -0,0 +1,155 @@
+// ThreadPool.cpp
+//
+// Implementation of the process-wide worker pool
+// Documentation in ThreadPool.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+#include "ThreadPool.hpp"
+
+namespace GeoStar {
+
+  // set on pool threads, and on the calling thread while it runs a job
+  static thread_local bool inPool = false;
+
+
+  ThreadPool &ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+  }// end: instance
+
+
+  ThreadPool::ThreadPool() : nThreads(1), quit(false), generation(0), job(NULL),
+                             jobSize(0), rangeSize(0), nRanges(0), nextRange(0), rangesLeft(0) {
+    start(0);
+  }// end-ThreadPool-constructor
+
+
+  ThreadPool::~ThreadPool() {
+    stop();
+  }// end-ThreadPool-destructor
+
+
+  void ThreadPool::start(const int &n) {
+    nThreads = n;
+    if(nThreads <= 0) nThreads = (int)std::thread::hardware_concurrency();
+    if(nThreads <= 0) nThreads = 1;
+
+    quit = false;
+    for(int i=1; i<nThreads; ++i) threads.push_back(std::thread(&ThreadPool::worker, this));
+  }// end: start
+
+
+  void ThreadPool::stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    wake.notify_all();
+    for(size_t i=0; i<threads.size(); ++i) threads[i].join();
+    threads.clear();
+  }// end: stop
+
+
+  void ThreadPool::set_num_threads(const int &n) {
+    std::lock_guard<std::mutex> run(runMutex);
+    stop();
+    start(n);
+  }// end: set_num_threads
+
+
+  int ThreadPool::get_num_threads() const {
+    return nThreads;
+  }// end: get_num_threads
+
+
+  // takes ranges of the current job until there are none left
+  void ThreadPool::runRanges() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(nextRange < nRanges) {
+      long int r = nextRange++;
+      const std::function<void(long int, long int)> &fn = *job;
+      long int begin = r*rangeSize;
+      long int end = std::min(begin+rangeSize, jobSize);
+      lock.unlock();
+
+      std::exception_ptr e;
+      try {
+        fn(begin, end);
+      } catch(...) {
+        e = std::current_exception();
+      }
+
+      lock.lock();
+      if(e && !error) error = e;
+      if(--rangesLeft == 0) done.notify_all();
+    }// endwhile
+  }// end: runRanges
+
+
+  void ThreadPool::worker() {
+    inPool = true;
+    unsigned long seen = 0;
+    for(;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(!quit && generation == seen) wake.wait(lock);
+        if(quit) return;
+        seen = generation;
+      }
+      runRanges();
+    }// endfor
+  }// end: worker
+
+
+  void ThreadPool::parallel_for(const long int &n, const std::function<void(long int, long int)> &fn,
+                                const long int &grain) {
+    if(n <= 0) return;
+
+    long int g = (grain > 0) ? grain : 1;
+    long int ranges = std::min((n + g - 1)/g, 4L*nThreads);
+
+    // nothing to share, or already on a pool thread: run here
+    if(ranges < 2 || nThreads < 2 || inPool) {
+      fn(0, n);
+      return;
+    }
+
+    std::lock_guard<std::mutex> run(runMutex);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &fn;
+      jobSize = n;
+      rangeSize = (n + ranges - 1)/ranges;
+      nRanges = (n + rangeSize - 1)/rangeSize;
+      nextRange = 0;
+      rangesLeft = nRanges;
+      error = std::exception_ptr();
+      ++generation;
+    }
+    wake.notify_all();
+
+    inPool = true;
+    runRanges();
+    inPool = false;
+
+    std::exception_ptr e;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while(rangesLeft > 0) done.wait(lock);
+      job = NULL;
+      e = error;
+      error = std::exception_ptr();
+    }
+    if(e) std::rethrow_exception(e);
+  }// end: parallel_for
+
+}// end namespace GeoStar
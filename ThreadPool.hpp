@@ -0,0 +1,164 @@
+// ThreadPool.hpp
+//
+// Process-wide worker threads for the pixel-wise operators
+//----------------------------------------
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+namespace GeoStar {
+
+  /** \brief ThreadPool -- the shared worker threads used by the Raster operators
+
+  There is one pool per process.  The pixel-wise operators read a block on the calling thread,
+  hand the arithmetic on that block to the pool with parallel_for, and write the result on the
+  calling thread again, so HDF5 is only ever called from one thread and a library built without
+  --enable-threadsafe is enough.
+
+  \see File::set_num_threads, Raster::BlockIterator
+
+  \Par Example
+	squaring a block of pixels on all cores:
+	\code
+	GeoStar::parallel_for(data.size(), [&](long int begin, long int end) {
+	  for(long int i=begin; i<end; ++i) data[i] *= data[i];
+	});
+	\endcode
+
+  \Par Details
+	The calling thread works alongside the pool threads, so a pool of n threads uses n-1 extra
+	threads.  The default size is std::thread::hardware_concurrency(); a size of 1 runs everything
+	on the calling thread.
+
+	parallel_for splits [0,n) into contiguous ranges of at least grain items.  A range count below
+	two runs inline, as does a parallel_for called from inside a worker, so operators can be
+	nested freely.  If a range throws, the first exception is rethrown on the calling thread once
+	every range has finished.  Only one parallel_for runs on the pool at a time; concurrent callers
+	take turns.
+  */
+  class ThreadPool {
+
+  public:
+    // the process-wide pool
+    static ThreadPool &instance();
+
+    // number of threads, including the calling thread.  0 means one per hardware thread.
+    void set_num_threads(const int &n);
+    int get_num_threads() const;
+
+    // calls fn(begin, end) on contiguous sub-ranges of [0,n), and waits for all of them.
+    void parallel_for(const long int &n, const std::function<void(long int, long int)> &fn,
+                      const long int &grain = 4096);
+
+    ~ThreadPool();
+
+  private:
+    ThreadPool();
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+
+    void start(const int &n);
+    void stop();
+    void worker();
+    void runRanges();
+
+    int nThreads;
+    std::vector<std::thread> threads;
+
+    std::mutex runMutex;               // one parallel_for at a time
+    std::mutex mutex;                  // guards everything below
+    std::condition_variable wake, done;
+    bool quit;
+    unsigned long generation;          // bumped for every job
+
+    // the current job
+    const std::function<void(long int, long int)> *job;
+    long int jobSize, rangeSize, nRanges, nextRange, rangesLeft;
+    std::exception_ptr error;
+
+  }; // end class: ThreadPool
+
+
+  // ThreadPool::instance().parallel_for(n, fn, grain)
+  inline void parallel_for(const long int &n, const std::function<void(long int, long int)> &fn,
+                           const long int &grain = 4096) {
+    ThreadPool::instance().parallel_for(n, fn, grain);
+  }
+
+
+
+  /** \brief BoundedQueue -- a blocking queue of at most capacity items between pipeline stages
+
+  One stage pushes work in, the next pops it out; push waits while the queue is full, so a fast
+  producer can only run capacity items ahead of its consumer.  close() ends the stream: pops
+  drain what is left and then return false, and pushes return false at once, so a failing stage
+  can stop the ones on either side of it.
+
+  \see Image::read_file, ThreadPool
+
+  \Par Example
+	a reader thread feeding the calling thread:
+	\code
+	GeoStar::BoundedQueue<Block *> queue(4);
+	std::thread reader([&]() {
+	  for(Block *b = first(); b != NULL; b = following(b)) queue.push(b);
+	  queue.close();
+	});
+	Block *b;
+	while(queue.pop(b)) use(b);
+	reader.join();
+	\endcode
+  */
+  template<class T>
+  class BoundedQueue {
+
+  public:
+    explicit BoundedQueue(const size_t &capacity) : capacity(capacity), closed(false) {}
+
+    // waits for room and appends item; false, without appending, once the queue is closed
+    bool push(const T &item) {
+      std::unique_lock<std::mutex> lock(mutex);
+      notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+      if(closed) return false;
+      items.push_back(item);
+      notEmpty.notify_one();
+      return true;
+    }
+
+    // waits for an item and removes it; false once the queue is closed and empty
+    bool pop(T &item) {
+      std::unique_lock<std::mutex> lock(mutex);
+      notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+      if(items.empty()) return false;
+      item = items.front();
+      items.pop_front();
+      notFull.notify_one();
+      return true;
+    }
+
+    void close() {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+      notFull.notify_all();
+      notEmpty.notify_all();
+    }
+
+  private:
+    const size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notFull, notEmpty;
+
+  }; // end class: BoundedQueue
+
+}// end namespace GeoStar
+
+#endif //THREADPOOL_HPP_
@@ -0,0 +1,569 @@
+// TileCache.cpp
+//
+// Implementation of the process-wide tile cache
+// Documentation in TileCache.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <map>
+#include <list>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <climits>
+#include <string.h>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "TileCache.hpp"
+#include "PixelConvert.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  // one dataset, however many Raster objects are open on it
+  class TileSource {
+  public:
+    H5::DataSet dataset;
+    H5::DataType type;          // the native form of the stored type
+    H5::DataSpace space;        // the dataset's file space, reselected for each tile transfer
+    size_t pixelSize;
+    long int nx, ny, tileNx, tileNy;
+    std::pair<unsigned long, haddr_t> id;
+    int users;
+    bool statsStored;           // see Raster::statistics_changed
+    bool overviewsStored;
+    void *loaded;               // see Raster::load
+  };
+
+  struct Tile {
+    TileSource *source;
+    long int tx, ty;
+    long int x0, y0, dx, dy;
+    std::vector<char> pixels;
+    bool dirty;
+    std::list<Tile *>::iterator lruPos;
+  };
+
+
+  namespace {
+
+    inline char *grow(std::vector<char> &buf, const size_t &nbytes) {
+      if(buf.size() < nbytes) buf.assign(nbytes, 0);
+      return &buf[0];
+    }
+
+    // hands H5Dscatter the whole of a packed buffer at once
+    herr_t scatterFrom(const void **src, size_t *nbytes, void *op_data) {
+      std::pair<const void *, size_t> *buf = (std::pair<const void *, size_t> *)op_data;
+      *src = buf->first;
+      *nbytes = buf->second;
+      return 0;
+    }
+
+    // selects a tile, or a block of the caller's rectangle, in the source's file space
+    void selectTile(H5::DataSpace &space, const Tile *tile) {
+      hsize_t start[2] = {(hsize_t)tile->y0, (hsize_t)tile->x0};
+      hsize_t count[2] = {(hsize_t)tile->dy, (hsize_t)tile->dx};
+      space.selectHyperslab(H5S_SELECT_SET, count, start);
+    }
+
+  }// end anonymous namespace
+
+
+
+  TileCache &TileCache::instance() {
+    static TileCache cache;
+    return cache;
+  }// end: instance
+
+
+  TileCache::TileCache() : capacity(256UL*1024*1024), bytes(0) {
+    stats.hits = stats.misses = stats.evictions = stats.writebacks = 0;
+  }
+
+
+  // rasters still open at exit have their changes written here
+  TileCache::~TileCache() {
+    try {
+      flush();
+    } catch(...) {
+    }// end: try
+    while(!tiles.empty()) drop(tiles.begin());
+    for(std::map<std::pair<unsigned long, haddr_t>, TileSource *>::iterator it=sources.begin();
+        it!=sources.end(); ++it) delete it->second;
+  }// end: ~TileCache
+
+
+
+  bool TileCache::Key::operator<(const Key &k) const {
+    if(source != k.source) return std::less<TileSource *>()(source, k.source);
+    if(ty != k.ty) return ty < k.ty;
+    return tx < k.tx;
+  }
+
+
+
+  void TileCache::set_capacity(const size_t &nbytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = nbytes;
+    trim(NULL);
+  }// end: set_capacity
+
+
+  size_t TileCache::get_capacity() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return capacity;
+  }// end: get_capacity
+
+
+  TileCache::Stats TileCache::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats s = stats;
+    s.bytes = bytes;
+    s.capacity = capacity;
+    return s;
+  }// end: get_stats
+
+
+  void TileCache::reset_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.hits = stats.misses = stats.evictions = stats.writebacks = 0;
+  }// end: reset_stats
+
+
+
+  TileSource *TileCache::attach(const H5::DataSet &dataset) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // the same dataset opened twice is one source: file number and object address
+    H5O_info_t info;
+    if(H5Oget_info(dataset.getId(), &info) < 0) return NULL;
+    const std::pair<unsigned long, haddr_t> id(info.fileno, info.addr);
+    std::map<std::pair<unsigned long, haddr_t>, TileSource *>::iterator it = sources.find(id);
+    if(it != sources.end()) {
+      ++it->second->users;
+      return it->second;
+    }
+
+    TileSource *source = new TileSource;
+    source->dataset = dataset;
+    const hid_t native = H5Tget_native_type(dataset.getDataType().getId(), H5T_DIR_ASCEND);
+    source->type = H5::DataType(native);
+    H5Tclose(native);
+    source->pixelSize = source->type.getSize();
+    source->space = dataset.getSpace();
+    hsize_t dims[2];
+    source->space.getSimpleExtentDims(dims);
+    source->ny = dims[0];
+    source->nx = dims[1];
+
+    source->tileNx = source->tileNy = TileCache::CONTIGUOUS_TILE;
+    H5::DSetCreatPropList plist = dataset.getCreatePlist();
+    if(plist.getLayout() == H5D_CHUNKED) {
+      hsize_t chunk[2];
+      plist.getChunk(2, chunk);
+      source->tileNy = chunk[0];
+      source->tileNx = chunk[1];
+    }// endif
+    source->id = id;
+    source->users = 1;
+    source->statsStored = false;
+    source->overviewsStored = false;
+    source->loaded = NULL;
+    sources[id] = source;
+    return source;
+  }// end: attach
+
+
+
+  void TileCache::detach(TileSource *source) {
+    if(source == NULL) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if(--source->users > 0) return;
+
+    // the tiles go whether or not they could be written
+    struct Release {
+      TileCache *cache;
+      TileSource *source;
+      ~Release() {
+        std::map<Key, Tile *>::iterator it = cache->tiles.lower_bound(Key{source, LONG_MIN, LONG_MIN});
+        while(it != cache->tiles.end() && it->first.source == source) cache->drop(it++);
+        cache->sources.erase(source->id);
+        delete source;
+      }
+    } release = {this, source};
+    flushSource(source, false);
+  }// end: detach
+
+
+
+  void TileCache::flush(TileSource *source) {
+    if(source == NULL) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    flushSource(source, false);
+  }// end: flush
+
+
+  void TileCache::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(std::map<Key, Tile *>::iterator it=tiles.begin(); it!=tiles.end(); ++it) {
+      if(it->second->dirty) writeBack(it->second);
+    }
+  }// end: flush
+
+
+  void TileCache::flush(const H5::H5File &file) {
+    H5O_info_t info;
+    if(H5Oget_info(file.getId(), &info) < 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    for(std::map<Key, Tile *>::iterator it=tiles.begin(); it!=tiles.end(); ++it) {
+      if(it->second->dirty && it->first.source->id.first == info.fileno) writeBack(it->second);
+    }
+  }// end: flush
+
+
+  void TileCache::evict(TileSource *source) {
+    if(source == NULL) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    flushSource(source, true);
+  }// end: evict
+
+
+
+  bool TileCache::get_stats_stored(const TileSource *source) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return source->statsStored;
+  }// end: get_stats_stored
+
+
+  void TileCache::set_stats_stored(TileSource *source, const bool &stored) {
+    std::lock_guard<std::mutex> lock(mutex);
+    source->statsStored = stored;
+  }// end: set_stats_stored
+
+
+  bool TileCache::get_overviews_stored(const TileSource *source) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return source->overviewsStored;
+  }// end: get_overviews_stored
+
+
+  void TileCache::set_overviews_stored(TileSource *source, const bool &stored) {
+    std::lock_guard<std::mutex> lock(mutex);
+    source->overviewsStored = stored;
+  }// end: set_overviews_stored
+
+
+
+  void *TileCache::get_loaded(const TileSource *source) const {
+    if(source == NULL) return NULL;
+    std::lock_guard<std::mutex> lock(mutex);
+    return source->loaded;
+  }// end: get_loaded
+
+
+  void TileCache::set_loaded(TileSource *source, void *buffer) {
+    if(source == NULL) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    source->loaded = buffer;
+  }// end: set_loaded
+
+
+
+  bool TileCache::read(TileSource *source, void *data, const H5::DataType &memtype,
+                       const H5::DataSpace &memspace, const H5::DataSpace &filespace) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(capacity == 0 || source == NULL) return false;
+    long int slice[4];
+    if(!rectangle(source, filespace, slice)) {
+      // HDF5 reads it, and must see the changes
+      flushSource(source, false);
+      return false;
+    }
+    const long int n = slice[2]*slice[3];
+    if(n == 0) return true;
+    const size_t ps = source->pixelSize;
+    char *packed = grow(rect, n*ps);
+
+    for(long int ty=slice[1]/source->tileNy; ty*source->tileNy < slice[1]+slice[3]; ++ty) {
+      for(long int tx=slice[0]/source->tileNx; tx*source->tileNx < slice[0]+slice[2]; ++tx) {
+        const Tile *t = fetch(source, tx, ty, true);
+        const long int x0 = std::max(slice[0], t->x0), x1 = std::min(slice[0]+slice[2], t->x0+t->dx);
+        const long int y0 = std::max(slice[1], t->y0), y1 = std::min(slice[1]+slice[3], t->y0+t->dy);
+        for(long int y=y0; y<y1; ++y) {
+          memcpy(packed + ((y-slice[1])*slice[2] + x0-slice[0])*ps,
+                 &t->pixels[((y-t->y0)*t->dx + x0-t->x0)*ps], (x1-x0)*ps);
+        }
+      }// endfor: tx
+    }// endfor: ty
+
+    hsize_t dims[2] = {(hsize_t)slice[3], (hsize_t)slice[2]};
+    H5::DataSpace rectspace(2, dims);
+    copyOut(packed, source->type, rectspace, data, memtype, memspace, scratch);
+    return true;
+  }// end: read
+
+
+
+  bool TileCache::write(TileSource *source, const void *data, const H5::DataType &memtype,
+                        const H5::DataSpace &memspace, const H5::DataSpace &filespace) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(capacity == 0 || source == NULL) return false;
+    long int slice[4];
+    if(!rectangle(source, filespace, slice)) {
+      // HDF5 writes it, and the cached tiles would go stale
+      flushSource(source, true);
+      return false;
+    }
+    const long int n = slice[2]*slice[3];
+    if(n == 0) return true;
+    const size_t ps = source->pixelSize;
+    char *packed = grow(rect, n*ps);
+    hsize_t dims[2] = {(hsize_t)slice[3], (hsize_t)slice[2]};
+    H5::DataSpace rectspace(2, dims);
+    copyIn(data, memtype, memspace, packed, source->type, rectspace, scratch);
+
+    for(long int ty=slice[1]/source->tileNy; ty*source->tileNy < slice[1]+slice[3]; ++ty) {
+      for(long int tx=slice[0]/source->tileNx; tx*source->tileNx < slice[0]+slice[2]; ++tx) {
+        // a tile the write covers completely is not read first
+        const long int tx0 = tx*source->tileNx, tx1 = std::min(tx0+source->tileNx, source->nx);
+        const long int ty0 = ty*source->tileNy, ty1 = std::min(ty0+source->tileNy, source->ny);
+        const bool covered = (slice[0] <= tx0 && tx1 <= slice[0]+slice[2]
+                              && slice[1] <= ty0 && ty1 <= slice[1]+slice[3]);
+        Tile *t = fetch(source, tx, ty, !covered);
+
+        const long int x0 = std::max(slice[0], tx0), x1 = std::min(slice[0]+slice[2], tx1);
+        const long int y0 = std::max(slice[1], ty0), y1 = std::min(slice[1]+slice[3], ty1);
+        for(long int y=y0; y<y1; ++y) {
+          memcpy(&t->pixels[((y-t->y0)*t->dx + x0-t->x0)*ps],
+                 packed + ((y-slice[1])*slice[2] + x0-slice[0])*ps, (x1-x0)*ps);
+        }
+        t->dirty = true;
+      }// endfor: tx
+    }// endfor: ty
+    return true;
+  }// end: write
+
+
+
+  // the tile, made most recently used; a new tile is read from the file when fill is set
+  Tile *TileCache::fetch(TileSource *source, const long int &tx, const long int &ty, const bool &fill) {
+    const Key key = {source, tx, ty};
+    std::map<Key, Tile *>::iterator it = tiles.find(key);
+    if(it != tiles.end()) {
+      ++stats.hits;
+      GEOSTAR_PROFILE_HIT("TileCache");
+      Tile *t = it->second;
+      lru.splice(lru.begin(), lru, t->lruPos);
+      return t;
+    }
+    ++stats.misses;
+    GEOSTAR_PROFILE_MISS("TileCache");
+
+    Tile *t = new Tile;
+    t->source = source;
+    t->tx = tx;
+    t->ty = ty;
+    t->x0 = tx*source->tileNx;
+    t->y0 = ty*source->tileNy;
+    t->dx = std::min(source->tileNx, source->nx - t->x0);
+    t->dy = std::min(source->tileNy, source->ny - t->y0);
+    t->dirty = false;
+    try {
+      t->pixels.resize(t->dx*t->dy*source->pixelSize);
+      if(fill) {
+        hsize_t dims[2] = {(hsize_t)t->dy, (hsize_t)t->dx};
+        H5::DataSpace memspace(2, dims);
+        selectTile(source->space, t);
+        GEOSTAR_PROFILE_BYTES("HDF5::read", (double)t->pixels.size());
+        source->dataset.read(&t->pixels[0], source->type, memspace, source->space);
+      }
+    } catch(...) {
+      delete t;
+      throw;
+    }// end: try
+
+    tiles[key] = t;
+    lru.push_front(t);
+    t->lruPos = lru.begin();
+    bytes += t->pixels.size();
+    trim(t);
+    return t;
+  }// end: fetch
+
+
+
+  void TileCache::writeBack(Tile *tile) {
+    TileSource *source = tile->source;
+    hsize_t dims[2] = {(hsize_t)tile->dy, (hsize_t)tile->dx};
+    H5::DataSpace memspace(2, dims);
+    selectTile(source->space, tile);
+    GEOSTAR_PROFILE_BYTES("HDF5::write", (double)tile->pixels.size());
+    source->dataset.write(&tile->pixels[0], source->type, memspace, source->space);
+    tile->dirty = false;
+    ++stats.writebacks;
+  }// end: writeBack
+
+
+
+  void TileCache::drop(std::map<Key, Tile *>::iterator it) {
+    Tile *t = it->second;
+    lru.erase(t->lruPos);
+    bytes -= t->pixels.size();
+    tiles.erase(it);
+    delete t;
+  }// end: drop
+
+
+
+  // evicts least recently used tiles until the cache is within its budget, never keep
+  void TileCache::trim(const Tile *keep) {
+    while(bytes > capacity && !lru.empty()) {
+      Tile *victim = lru.back();
+      if(victim == keep) break;
+      if(victim->dirty) writeBack(victim);
+      drop(tiles.find(Key{victim->source, victim->tx, victim->ty}));
+      ++stats.evictions;
+    }// endwhile
+  }// end: trim
+
+
+
+  void TileCache::flushSource(TileSource *source, const bool &evicting) {
+    std::map<Key, Tile *>::iterator it = tiles.lower_bound(Key{source, LONG_MIN, LONG_MIN});
+    while(it != tiles.end() && it->first.source == source) {
+      if(it->second->dirty) writeBack(it->second);
+      if(evicting) drop(it++);
+      else ++it;
+    }// endwhile
+  }// end: flushSource
+
+
+
+  // [x0,y0,dx,dy] of a file selection that is one rectangle: one that fills its bounding box.
+  // (A hyperslab of count pixels with no block is count blocks of one pixel to HDF5, so the
+  // blocks are not counted.)  A selection reaching past the raster is left to HDF5 to report.
+  bool TileCache::rectangle(const TileSource *source, const H5::DataSpace &filespace,
+                            long int *slice) const {
+    const hid_t id = filespace.getId();
+    switch(H5Sget_select_type(id)) {
+    case H5S_SEL_ALL:
+      slice[0] = slice[1] = 0;
+      slice[2] = source->nx;
+      slice[3] = source->ny;
+      return true;
+    case H5S_SEL_NONE:
+      slice[0] = slice[1] = slice[2] = slice[3] = 0;
+      return true;
+    default: {
+      hsize_t start[2], end[2];
+      if(H5Sget_select_bounds(id, start, end) < 0) return false;
+      slice[0] = start[1];
+      slice[1] = start[0];
+      slice[2] = end[1] - start[1] + 1;
+      slice[3] = end[0] - start[0] + 1;
+      if(slice[0] + slice[2] > source->nx || slice[1] + slice[3] > source->ny) return false;
+      return H5Sget_select_npoints(id) == (hssize_t)(slice[2]*slice[3]);
+    }
+    }// end case
+  }// end: rectangle
+
+
+
+  void TileCache::copyOut(const char *pixels, const H5::DataType &type, const H5::DataSpace &pixelspace,
+                          void *data, const H5::DataType &memtype, const H5::DataSpace &memspace,
+                          PixelScratch &scratch) {
+    RasterReadErrorException RasterReadError;
+    const hssize_t npoints = pixelspace.getSelectNpoints();
+    if(npoints <= 0) return;
+    const size_t n = npoints;
+    const size_t inSize = type.getSize(), outSize = memtype.getSize();
+    const bool same = (memtype == type);
+    const bool packed = (H5Sget_select_type(memspace.getId()) == H5S_SEL_ALL);
+
+    // numeric types: gathered in the buffer's type, converted by PixelConvert straight into data,
+    // or into bkg on the way to a scattered memspace
+    if(!same && PixelConvert::supported(type) && PixelConvert::supported(memtype)) {
+      char *stage = grow(scratch.stage, n*inSize);
+      if(H5Dgather(pixelspace.getId(), pixels, type.getId(), n*inSize, stage, NULL, NULL) < 0)
+        throw RasterReadError;
+      char *out = packed ? (char *)data : grow(scratch.bkg, n*outSize);
+      PixelConvert::convert(stage, type, out, memtype, n);
+      if(packed) return;
+      std::pair<const void *, size_t> src(out, n*outSize);
+      if(H5Dscatter(scatterFrom, &src, memtype.getId(), memspace.getId(), data) < 0)
+        throw RasterReadError;
+      return;
+    }// endif
+
+    // the selected pixels, packed, in the buffer's type; converted in place to the memory type
+    const size_t nbytes = n * std::max(inSize, outSize);
+    char *stage = (packed && (same || outSize >= inSize)) ? (char *)data : grow(scratch.stage, nbytes);
+    if(H5Dgather(pixelspace.getId(), pixels, type.getId(), n*inSize, stage, NULL, NULL) < 0)
+      throw RasterReadError;
+    if(!same) {
+      void *bkg = (memtype.getClass() == H5T_COMPOUND) ? grow(scratch.bkg, nbytes) : NULL;
+      if(H5Tconvert(type.getId(), memtype.getId(), n, stage, bkg, H5P_DEFAULT) < 0)
+        throw RasterReadError;
+    }
+    if(stage == (char *)data) return;
+
+    if(packed) {
+      memcpy(data, stage, n*outSize);
+    } else {
+      std::pair<const void *, size_t> src(stage, n*outSize);
+      if(H5Dscatter(scatterFrom, &src, memtype.getId(), memspace.getId(), data) < 0)
+        throw RasterReadError;
+    }// endif
+  }// end: copyOut
+
+
+
+  void TileCache::copyIn(const void *data, const H5::DataType &memtype, const H5::DataSpace &memspace,
+                         char *pixels, const H5::DataType &type, const H5::DataSpace &pixelspace,
+                         PixelScratch &scratch) {
+    RasterWriteErrorException RasterWriteError;
+    const hssize_t npoints = pixelspace.getSelectNpoints();
+    if(npoints <= 0) return;
+    const size_t n = npoints;
+    const size_t inSize = memtype.getSize(), outSize = type.getSize();
+    const bool same = (memtype == type);
+    const bool packed = (H5Sget_select_type(memspace.getId()) == H5S_SEL_ALL);
+
+    // the caller's pixels, packed and converted to the buffer's type
+    const void *src = data;
+    if(!same && PixelConvert::supported(type) && PixelConvert::supported(memtype)) {
+      const void *in = data;
+      if(!packed) {
+        char *gathered = grow(scratch.bkg, n*inSize);
+        if(H5Dgather(memspace.getId(), data, memtype.getId(), n*inSize, gathered, NULL, NULL) < 0)
+          throw RasterWriteError;
+        in = gathered;
+      }
+      char *stage = grow(scratch.stage, n*outSize);
+      PixelConvert::convert(in, memtype, stage, type, n);
+      src = stage;
+    } else if(!same || !packed) {
+      const size_t nbytes = n * std::max(inSize, outSize);
+      char *stage = grow(scratch.stage, nbytes);
+      if(packed) {
+        memcpy(stage, data, n*inSize);
+      } else if(H5Dgather(memspace.getId(), data, memtype.getId(), n*inSize, stage, NULL, NULL) < 0) {
+        throw RasterWriteError;
+      }
+      if(!same) {
+        void *bkg = (memtype.getClass() == H5T_COMPOUND) ? grow(scratch.bkg, nbytes) : NULL;
+        if(H5Tconvert(memtype.getId(), type.getId(), n, stage, bkg, H5P_DEFAULT) < 0)
+          throw RasterWriteError;
+      }
+      src = stage;
+    }// endif
+
+    std::pair<const void *, size_t> buf(src, n*outSize);
+    if(H5Dscatter(scatterFrom, &buf, type.getId(), pixelspace.getId(), pixels) < 0)
+      throw RasterWriteError;
+  }// end: copyIn
+
+}// end namespace GeoStar
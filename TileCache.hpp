@@ -0,0 +1,157 @@
+// TileCache.hpp
+//
+// Process-wide LRU cache of raster tiles, shared by every open Raster
+//----------------------------------------
+#ifndef TILECACHE_HPP_
+#define TILECACHE_HPP_
+
+#include <vector>
+#include <map>
+#include <list>
+#include <mutex>
+#include <utility>
+
+#include "H5Cpp.h"
+
+namespace GeoStar {
+
+  class TileSource;
+  struct Tile;
+
+  // scratch space for the type conversions of TileCache::copyOut and copyIn
+  struct PixelScratch {
+    std::vector<char> stage, bkg;
+  };
+
+
+  /** \brief TileCache -- keeps recently used tiles of every raster in memory, under one budget
+
+  HDF5 gives each dataset its own small chunk cache, so a pipeline that moves between several
+  bands of an image evicts each band's chunks before it comes back to them.  TileCache holds
+  tiles of all the rasters of all open files in one pool with one memory budget and evicts the
+  least recently used tile, whichever raster it belongs to.  Raster::readSelection and
+  Raster::writeSelection go through it, so every reader and writer of a raster (the operators,
+  BlockIterator, Slice reads and writes, FFT, the filters) shares it without knowing.
+
+  \see File::set_tile_cache_size, File::get_tile_cache_stats, File::flush_tile_cache, Raster::load
+
+  \Par Example
+	band math over two bands of a chunked image, with room for 512 MB of tiles:
+	\code
+	GeoStar::File::set_tile_cache_size(512*1024*1024);
+	GeoStar::Raster *b4 = img->open_raster("B4"), *b5 = img->open_raster("B5");
+	*ndvi = (*b5 - *b4) / (*b5 + *b4);
+	GeoStar::TileCache::Stats s = GeoStar::File::get_tile_cache_stats();
+	std::cout << s.hits << " hits, " << s.misses << " misses\n";
+	\endcode
+
+  \Par Details
+	A tile is a chunk of a chunked raster and 256 x 256 pixels of a contiguous one, held in the
+	native form of the raster's stored type.  Writes go to the cached tiles and reach the file when
+	a tile is evicted, when the last Raster open on the dataset is destroyed, when its File is
+	destroyed, or on File::flush_tile_cache.  A write that covers a whole tile does not read it
+	first.  Several Raster objects open on one dataset share its tiles, and whether its saved
+	statistics must be deleted on the next write.  Selections that are not a
+	single rectangle bypass the cache, after the raster's changed tiles have been written.  A size
+	of 0 turns the cache off; the default is 256 MB.  The cache is guarded by a mutex, but like the
+	rest of the library it calls HDF5 from the thread that uses it.
+  */
+  class TileCache {
+
+  public:
+    struct Stats {
+      unsigned long hits, misses, evictions, writebacks;
+      size_t bytes, capacity;
+    };
+
+    // the process-wide cache
+    static TileCache &instance();
+
+    // the width and height of the tiles of a contiguous raster
+    static const long int CONTIGUOUS_TILE = 256;
+
+    // the memory budget in bytes; shrinking it evicts, 0 empties and disables the cache
+    void set_capacity(const size_t &bytes);
+    size_t get_capacity() const;
+
+    Stats get_stats() const;
+    void reset_stats();
+
+    // a Raster registers its dataset when opened and releases it when destroyed; the last
+    // release writes the dataset's changed tiles and drops them
+    TileSource *attach(const H5::DataSet &dataset);
+    void detach(TileSource *source);
+
+    // the transfers of Raster::readSelection and writeSelection.  false when the cache is off or
+    // the file selection is not a rectangle: the caller then goes to HDF5 itself.
+    bool read(TileSource *source, void *data, const H5::DataType &memtype,
+              const H5::DataSpace &memspace, const H5::DataSpace &filespace);
+    bool write(TileSource *source, const void *data, const H5::DataType &memtype,
+               const H5::DataSpace &memspace, const H5::DataSpace &filespace);
+
+    // writes the changed tiles of one source, or of all of them, to the file; evict also drops
+    // the source's tiles, so the next read comes from the file
+    void flush(TileSource *source);
+    void flush();
+    // writes the changed tiles of every raster in one file
+    void flush(const H5::H5File &file);
+    void evict(TileSource *source);
+
+    // whether one of the Rasters open on the source's dataset may have saved statistics or a
+    // histogram in its attributes, or overviews next to it, so the next write must delete them
+    bool get_stats_stored(const TileSource *source) const;
+    void set_stats_stored(TileSource *source, const bool &stored);
+    bool get_overviews_stored(const TileSource *source) const;
+    void set_overviews_stored(TileSource *source, const bool &stored);
+
+    // the buffer of the Raster that loaded the source's dataset (Raster::load), shared by all
+    // the Rasters open on it; NULL when none is loaded
+    void *get_loaded(const TileSource *source) const;
+    void set_loaded(TileSource *source, void *buffer);
+
+    // the pixels selected by pixelspace in a buffer of the given type, converted to memtype and
+    // placed at the selection of memspace in data; and the reverse.  Numeric types are converted
+    // by PixelConvert, others by HDF5.
+    static void copyOut(const char *pixels, const H5::DataType &type, const H5::DataSpace &pixelspace,
+                        void *data, const H5::DataType &memtype, const H5::DataSpace &memspace,
+                        PixelScratch &scratch);
+    static void copyIn(const void *data, const H5::DataType &memtype, const H5::DataSpace &memspace,
+                       char *pixels, const H5::DataType &type, const H5::DataSpace &pixelspace,
+                       PixelScratch &scratch);
+
+    ~TileCache();
+
+  private:
+    TileCache();
+    TileCache(const TileCache &);
+    TileCache &operator=(const TileCache &);
+
+    struct Key {
+      TileSource *source;
+      long int tx, ty;
+      bool operator<(const Key &k) const;
+    };
+
+    Tile *fetch(TileSource *source, const long int &tx, const long int &ty, const bool &fill);
+    void writeBack(Tile *tile);
+    void drop(std::map<Key, Tile *>::iterator it);
+    void trim(const Tile *keep);
+    void flushSource(TileSource *source, const bool &evicting);
+    bool rectangle(const TileSource *source, const H5::DataSpace &filespace, long int *slice) const;
+
+    mutable std::mutex mutex;
+    size_t capacity, bytes;
+    Stats stats;
+
+    std::map<Key, Tile *> tiles;
+    std::list<Tile *> lru;                    // most recently used first
+    std::map<std::pair<unsigned long, haddr_t>, TileSource *> sources;
+
+    std::vector<char> rect;                   // a request's pixels, packed, in the source type
+    PixelScratch scratch;
+
+  }; // end class: TileCache
+
+}// end namespace GeoStar
+
+#endif //TILECACHE_HPP_
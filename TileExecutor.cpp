@@ -0,0 +1,236 @@
+// TileExecutor.cpp
+//
+// Implementation of the tiled executor
+// Documentation in TileExecutor.hpp
+//--------------------------------------------
+
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <map>
+
+#include "H5Cpp.h"
+#include "Exceptions.hpp"
+#include "Raster.hpp"
+#include "Neighborhood.hpp"
+#include "TileExecutor.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+namespace GeoStar {
+
+  namespace {
+
+    // the tiles [front, back) not yet taken from one thread's run
+    struct Run {
+      std::mutex mutex;
+      long int front, back;
+    };
+
+  }// end anonymous namespace
+
+
+
+  TileExecutor::TileExecutor(const Raster *in, const long int &hx, const long int &hy,
+                             const BorderMode &border, const long int &tileNx, const long int &tileNy)
+    : in(in), hx(hx), hy(hy), tileNx(tileNx), tileNy(tileNy), border(border) {
+    IntegerParameterException IntegerParameterError;
+    if(hx < 0 || hy < 0 || tileNx < 0 || tileNy < 0) throw IntegerParameterError;
+    if(this->tileNx == 0) {
+      this->tileNx = (in->get_chunk_nx() > 0) ? in->get_chunk_nx() : 256;
+      this->tileNx = std::max(this->tileNx, 4*(2*hx+1));
+    }
+    if(this->tileNy == 0) {
+      this->tileNy = (in->get_chunk_ny() > 0) ? in->get_chunk_ny() : 256;
+      this->tileNy = std::max(this->tileNy, 4*(2*hy+1));
+    }
+  }// end-TileExecutor-constructor
+
+
+
+  void TileExecutor::run(Raster *out, const Step &step) const {
+    GEOSTAR_PROFILE_SCOPE("TileExecutor::run");
+    RasterSizeErrorException RasterSizeError;
+    const long int nx = in->get_nx();
+    const long int ny = in->get_ny();
+    if(out->get_nx() != nx || out->get_ny() != ny) throw RasterSizeError;
+    if(nx <= 0 || ny <= 0) return;
+
+    // enough tile rows in a band for two tiles a thread
+    const long int across = (nx + tileNx - 1) / tileNx;
+    const long int wanted = 2L * ThreadPool::instance().get_num_threads();
+    const long int tileRows = std::max(1L, (wanted + across - 1) / across);
+    RowWindow win(in, hx, hy, border, tileRows * tileNy);
+
+    std::vector<double> outData;
+    std::vector<const double *> rows;
+    while(win.next()) {
+      const long int bandRows = win.rows();
+      rows.resize(bandRows + 2*hy);
+      for(long int k=0; k<bandRows+2*hy; ++k) rows[k] = win.row(k);
+      runBand(rows, win.y0(), bandRows, outData, step);
+      win.write(out, &outData[0]);
+    }// endwhile
+  }// end: run
+
+
+
+  // the tiles of output rows [y0, y0+bandRows), from the padded input rows, into outData
+  void TileExecutor::runBand(const std::vector<const double *> &rows, const long int &y0,
+                             const long int &bandRows, std::vector<double> &outData,
+                             const Step &step) const {
+    const long int nx = in->get_nx();
+    const long int across = (nx + tileNx - 1) / tileNx;
+    const long int down = (bandRows + tileNy - 1) / tileNy;
+    outData.resize(std::max(1L, bandRows * nx));
+    schedule(across * down, [&](long int i) {
+        GEOSTAR_PROFILE_SCOPE("TileExecutor::tile");
+        const long int tx = i % across, ty = i / across;
+        Tile t;
+        t.x0 = tx * tileNx;
+        t.dx = std::min(tileNx, nx - t.x0);
+        t.dy = std::min(tileNy, bandRows - ty*tileNy);
+        t.y0 = y0 + ty*tileNy;
+        t.hx = hx;
+        t.hy = hy;
+        t.rows = &rows[ty*tileNy];
+        t.outData = &outData[ty*tileNy*nx];
+        t.stride = nx;
+        step(t);
+      });
+  }// end: runBand
+
+
+
+#ifdef GEOSTAR_MPI
+  // each rank works out which rows every rank needs from every other, so one Alltoallv moves
+  // all the halos with no requests sent first
+  void TileExecutor::run(Raster *out, const Step &step, MPI_Comm comm) const {
+    GEOSTAR_PROFILE_SCOPE("TileExecutor::run");
+    RasterSizeErrorException RasterSizeError;
+    const long int nx = in->get_nx();
+    const long int ny = in->get_ny();
+    if(out->get_nx() != nx || out->get_ny() != ny) throw RasterSizeError;
+    if(nx <= 0 || ny <= 0) return;
+
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+    std::vector<long int> first(ranks), last(ranks);
+    for(int q=0; q<ranks; ++q) in->rankRows(q, ranks, first[q], last[q]);
+    const long int y0 = first[rank];
+    const long int bandRows = last[rank] - y0;
+
+    std::vector<double> own(std::max(1L, bandRows * nx));
+    in->readRows(y0, bandRows, &own[0]);
+
+    // the input rows each rank's padded rows need from another rank, in order
+    std::vector<int> owner(ny);
+    for(int q=0; q<ranks; ++q) {
+      for(long int y=first[q]; y<last[q]; ++y) owner[y] = q;
+    }
+    std::vector<std::vector<long int> > needs(ranks);
+    for(int q=0; q<ranks; ++q) {
+      if(last[q] == first[q]) continue;
+      for(long int k=0; k<last[q]-first[q]+2*hy; ++k) {
+        const long int y = borderIndex(first[q]-hy+k, ny, border);
+        if(y >= 0 && owner[y] != q) needs[q].push_back(y);
+      }// endfor: k
+      std::sort(needs[q].begin(), needs[q].end());
+      needs[q].erase(std::unique(needs[q].begin(), needs[q].end()), needs[q].end());
+    }// endfor: q
+
+    // rows this rank sends to q, and those it gets from q, whole rows at a time
+    std::vector<int> sendCounts(ranks, 0), sendOffsets(ranks, 0);
+    std::vector<int> recvCounts(ranks, 0), recvOffsets(ranks, 0);
+    std::vector<double> sendData, recvData;
+    for(int q=0; q<ranks; ++q) {
+      sendOffsets[q] = (int)sendData.size();
+      for(size_t i=0; i<needs[q].size(); ++i) {
+        const long int y = needs[q][i];
+        if(owner[y] != rank) continue;
+        sendData.insert(sendData.end(), &own[(y-y0)*nx], &own[(y-y0)*nx] + nx);
+      }// endfor: i
+      sendCounts[q] = (int)sendData.size() - sendOffsets[q];
+    }// endfor: q
+    std::map<long int, const double *> halo;
+    long int received = 0;
+    for(size_t i=0; i<needs[rank].size(); ++i) ++recvCounts[owner[needs[rank][i]]];
+    for(int q=0; q<ranks; ++q) {
+      recvOffsets[q] = (int)(received * nx);
+      received += recvCounts[q];
+      recvCounts[q] *= (int)nx;
+    }// endfor: q
+    recvData.resize(std::max(1L, received * nx));
+    if(sendData.empty()) sendData.resize(1);
+    {
+      GEOSTAR_PROFILE_SCOPE("TileExecutor::halo");
+      MPI_Alltoallv(&sendData[0], &sendCounts[0], &sendOffsets[0], MPI_DOUBLE,
+                    &recvData[0], &recvCounts[0], &recvOffsets[0], MPI_DOUBLE, comm);
+    }
+    std::vector<long int> next(ranks, 0);
+    for(size_t i=0; i<needs[rank].size(); ++i) {
+      const long int y = needs[rank][i];
+      const int q = owner[y];
+      halo[y] = &recvData[recvOffsets[q] + next[q]*nx];
+      ++next[q];
+    }// endfor: i
+
+    // the padded rows, as RowWindow makes them
+    const long int width = nx + 2*hx;
+    std::vector<long int> xsource(width);
+    for(long int x=0; x<width; ++x) xsource[x] = borderIndex(x-hx, nx, border);
+    std::vector<double> padded(std::max(1L, (bandRows + 2*hy) * width), 0.0);
+    std::vector<const double *> rows(bandRows + 2*hy);
+    if(bandRows > 0) {
+      for(long int k=0; k<bandRows+2*hy; ++k) {
+        double *row = &padded[k*width];
+        rows[k] = row;
+        const long int y = borderIndex(y0-hy+k, ny, border);
+        if(y < 0) continue;
+        const double *src = (owner[y] == rank) ? &own[(y-y0)*nx] : halo[y];
+        for(long int x=0; x<width; ++x) row[x] = xsource[x] >= 0 ? src[xsource[x]] : 0.0;
+      }// endfor: k
+    }// endif
+
+    std::vector<double> outData;
+    if(bandRows > 0) runBand(rows, y0, bandRows, outData, step);
+    else outData.resize(1);
+    out->writeRows(y0, bandRows, &outData[0]);
+  }// end: run
+#endif
+
+
+
+  void TileExecutor::schedule(const long int &n, const std::function<void(long int)> &fn) {
+    if(n <= 0) return;
+    const long int workers = std::min<long int>(n, ThreadPool::instance().get_num_threads());
+    std::vector<Run> runs(workers);
+    for(long int w=0; w<workers; ++w) {
+      runs[w].front = n * w / workers;
+      runs[w].back = n * (w+1) / workers;
+    }
+
+    // the next tile of run w: its own from the front, or another's from the back
+    parallel_for(workers, [&](long int begin, long int end) {
+        for(long int w=begin; w<end; ++w) {
+          for(;;) {
+            long int i = -1;
+            {
+              std::lock_guard<std::mutex> lock(runs[w].mutex);
+              if(runs[w].front < runs[w].back) i = runs[w].front++;
+            }
+            for(long int v=1; i < 0 && v<workers; ++v) {
+              Run &victim = runs[(w + v) % workers];
+              std::lock_guard<std::mutex> lock(victim.mutex);
+              if(victim.front < victim.back) i = --victim.back;
+            }// endfor: v
+            if(i < 0) break;
+            fn(i);
+          }// endfor
+        }// endfor: w
+      }, 1);
+  }// end: schedule
+
+}// end namespace GeoStar
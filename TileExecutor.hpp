@@ -0,0 +1,116 @@
+// TileExecutor.hpp
+//
+// Tiles with a halo of neighbouring pixels, run on the pool with work stealing
+//----------------------------------------
+#ifndef TILEEXECUTOR_HPP_
+#define TILEEXECUTOR_HPP_
+
+#include <vector>
+#include <functional>
+
+#include "Kernel.hpp"
+
+#ifdef GEOSTAR_MPI
+#include <mpi.h>
+#endif
+
+namespace GeoStar {
+  class Raster;
+
+  /** \brief TileExecutor -- runs a neighborhood operator tile by tile, each tile with its halo
+
+  A neighborhood operator needs, for every output pixel, the input pixels around it.  TileExecutor
+  cuts the raster into tiles and hands the operator one tile at a time: the tile's output pixels
+  and its input padded with a halo of hx columns and hy rows from the neighbouring tiles, and past
+  the edges of the raster from the border mode (BORDER_ZERO for a constant 0, REPLICATE to clamp,
+  REFLECT, WRAP).  Edge tiles and the short tiles at the right and bottom, when the raster is not a
+  multiple of the tile size, look the same as any other, so operators have no edge cases.
+
+  \see RowWindow, BorderMode, Neighborhood::median
+
+  \Par Example
+	a 3x3 box sum, written to out:
+	\code
+	GeoStar::TileExecutor tiles(in, 1, 1, GeoStar::BORDER_REFLECT);
+	tiles.run(out, [](const GeoStar::TileExecutor::Tile &t) {
+	  for(long int y=0; y<t.dy; ++y) {
+	    double *o = t.out(y);
+	    for(long int x=0; x<t.dx; ++x) {
+	      double s = 0;
+	      for(long int k=0; k<3; ++k) s += t.row(y+k)[x] + t.row(y+k)[x+1] + t.row(y+k)[x+2];
+	      o[x] = s;
+	    }
+	  }
+	});
+	\endcode
+
+  \Par Details
+	The raster streams through bands of whole tile rows, read once each through a RowWindow, so
+	it may be far larger than memory; all HDF5 access stays on the calling thread.  The tiles of a
+	band are dealt out in runs, one run per pool thread (File::set_num_threads); a thread that
+	finishes its run steals tiles from the far end of another's, so a few slow tiles do not hold
+	up the band.  Tiles default to the chunk size of the raster, or 256 x 256, and at least four
+	window sizes (2*halo+1) each way; the band is made of enough tile rows to give every thread two
+	tiles.  Tiles of a band write disjoint output, and the band is written after all are done.
+
+	Built with GEOSTAR_MPI, run(out, step, comm) spreads the work over the ranks of an MPI job, on
+	a File opened over comm.  Each rank takes its own rows (Raster::rankRows, whole tile rows),
+	reads them in one collective transfer, and gets the hy rows above and below that other ranks
+	hold from them in one exchange; then its tiles run on its pool as above, and every rank
+	writes its rows to out together.  All ranks of comm must call it, with the same step.  A
+	rank's rows, and their padded copy and output, are held in memory as doubles, so the job
+	needs enough ranks that a share fits.
+  */
+  class TileExecutor {
+
+  public:
+    struct Tile {
+      long int x0, y0, dx, dy;     // the output pixels [x0, x0+dx) x [y0, y0+dy)
+      long int hx, hy;             // the halo
+
+      // padded input row k, k in [0, dy+2*hy): input row y0-hy+k, from column x0-hx
+      inline const double *row(const long int &k) const { return rows[k] + x0; }
+
+      // output row j, j in [0, dy), from column x0
+      inline double *out(const long int &j) const { return outData + j*stride + x0; }
+
+      const double *const *rows;
+      double *outData;
+      long int stride;
+    };
+
+    typedef std::function<void(const Tile &)> Step;
+
+    // tileNx, tileNy of 0 choose the tile size
+    TileExecutor(const Raster *in, const long int &hx, const long int &hy, const BorderMode &border,
+                 const long int &tileNx = 0, const long int &tileNy = 0);
+
+    // step on every tile; the outputs, as doubles, are written to out, the same size as in
+    void run(Raster *out, const Step &step) const;
+
+#ifdef GEOSTAR_MPI
+    // run over the ranks of comm, each computing its own rows
+    void run(Raster *out, const Step &step, MPI_Comm comm) const;
+#endif
+
+    inline long int get_tile_nx() const { return tileNx; }
+    inline long int get_tile_ny() const { return tileNy; }
+
+    // fn(i) for i in [0,n) on the pool, each thread taking from its own run and stealing from
+    // the others when it is done
+    static void schedule(const long int &n, const std::function<void(long int)> &fn);
+
+  private:
+    const Raster *in;
+    long int hx, hy, tileNx, tileNy;
+    BorderMode border;
+
+    // step on the tiles of output rows [y0, y0+bandRows), from the padded rows, into outData
+    void runBand(const std::vector<const double *> &rows, const long int &y0,
+                 const long int &bandRows, std::vector<double> &outData, const Step &step) const;
+
+  }; // end class: TileExecutor
+
+}// end namespace GeoStar
+
+#endif //TILEEXECUTOR_HPP_
@@ -67,4 +67,68 @@ namespace GeoStar {
   }// end read_object_type
 
 
+
+
+  void write_double_attribute(H5::H5Location *obj, const std::string &name,
+                              const std::vector<double> &values){
+    AttributeErrorException AttributeError;
+
+    // 1. delete the attribute, if it's there:
+    if(obj->attrExists(name)){
+      obj->removeAttr(name);
+    }// endif
+
+    // 2. create the attribute:
+    hsize_t dims[1] = {values.size()};
+    H5::DataSpace att_space = values.empty() ? H5::DataSpace(H5S_NULL) : H5::DataSpace(1, dims);
+    H5::Attribute att = obj->createAttribute( name, H5::PredType::NATIVE_DOUBLE, att_space );
+
+    // 3. write to the attribute:
+    if(values.empty()) return;
+    try {
+      att.write( H5::PredType::NATIVE_DOUBLE, &values[0] );
+    }
+    catch (...) {
+      throw AttributeError;
+    }
+
+  }// end write_double_attribute
+
+
+
+
+  bool read_double_attribute(const H5::H5Location *obj, const std::string &name,
+                             std::vector<double> &values) {
+    AttributeErrorException AttributeError;
+
+    if(!obj->attrExists(name)) return false;
+    try {
+      H5::Attribute att = obj->openAttribute(name);
+      const hssize_t n = att.getSpace().getSimpleExtentNpoints();
+      values.assign(n, 0.0);
+      if(n > 0) att.read(H5::PredType::NATIVE_DOUBLE, &values[0]);
+      return true;
+    }
+    catch (...) {
+      throw AttributeError;
+    }
+  }// end read_double_attribute
+
+
+
+
+  void delete_attribute(H5::H5Location *obj, const std::string &name) {
+    AttributeErrorException AttributeError;
+
+    try {
+      if(obj->attrExists(name)){
+        obj->removeAttr(name);
+      }// endif
+    }
+    catch (...) {
+      throw AttributeError;
+    }
+  }// end delete_attribute
+
+
 }// end namespace GeoStar
@@ -7,6 +7,7 @@
 #define ATTRIBUTES_HPP_
 
 #include <string>
+#include <vector>
 
 #include "H5Cpp.h"
 
@@ -31,6 +32,34 @@ namespace GeoStar {
   //          is attached to this object.
   std::string read_object_type(const H5::H5Location *obj);
 
+
+  // write_double_attribute: writes an attribute holding an array of doubles
+  //                         to the object, replacing any of that name.
+  // inputs: obj: an HDF5 object (file, group, or dataset)
+  //         name: the name of the attribute
+  //         values: the values to store
+  // effects: the object in the file now has an attribute with the given
+  //          name holding the values, as a 1-D array of doubles.
+  void write_double_attribute(H5::H5Location *obj, const std::string &name,
+                              const std::vector<double> &values);
+
+
+  // read_double_attribute: reads an attribute written by write_double_attribute.
+  // inputs: obj: an HDF5 object (file, group, or dataset)
+  //         name: the name of the attribute
+  // outputs: values: the values of the attribute, converted to double
+  // effects: returns false, and leaves values alone, if the object has
+  //          no attribute of that name.
+  bool read_double_attribute(const H5::H5Location *obj, const std::string &name,
+                             std::vector<double> &values);
+
+
+  // delete_attribute: removes the named attribute from the object, if
+  //                   it has one.
+  // inputs: obj: an HDF5 object (file, group, or dataset)
+  //         name: the name of the attribute
+  void delete_attribute(H5::H5Location *obj, const std::string &name);
+
 }// end namespace GeoStar
 
 #endif // ATTRIBUTES_HPP_
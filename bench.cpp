@@ -0,0 +1,317 @@
+// bench.cpp
+//
+// times the Raster operators on synthetic rasters
+//
+// usage: bench [--nx N] [--ny N] [--type INT16U] [--chunk N] [--threads N]
+//              [--warmup N] [--reps N] [--only name,name,...] [--ingest file.tif]
+//              [--json out.json] [--baseline old.json] [--tolerance 0.10]
+//
+// Every operator is run --warmup times untimed and --reps times timed, on
+// rasters made in bench.h5.  The results (median and best time, MPix/s and
+// MB/s of the median, and the process's peak resident set so far, which only
+// grows, so an operator shows the peak of the largest one run before it) go
+// to --json, or to stdout, as JSON, with the build's optimisation (OPT).  With --baseline, each operator's MPix/s is
+// compared with the same operator in an earlier output, and the exit status
+// is 1 if any is slower by more than --tolerance.
+//
+//---------------------------------------------------------
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <sys/resource.h>
+
+#include "geostar.hpp"
+
+#include "boost/filesystem.hpp"
+
+// the OPT the library was built with; the Makefile passes it
+#ifndef GEOSTAR_BUILD_OPT
+#define GEOSTAR_BUILD_OPT "unknown"
+#endif
+
+namespace {
+
+  struct Config {
+    long int nx, ny, chunk;
+    int threads, warmup, reps;
+    GeoStar::RasterType type;
+    std::string typeName, only, ingest, json, baseline;
+    double tolerance;
+  };
+
+  // one timed operator: setup runs untimed before every repetition; rasters is the number of
+  // rasters of the base size the operator reads and writes, for MB/s (0 where that means nothing)
+  struct Op {
+    std::string name;
+    double rasters;
+    std::function<void()> setup, run;
+  };
+
+  struct Result {
+    std::string name;
+    double median, best, mpix, mbps, processRss;
+  };
+
+  const char *typeNames[] = {"INT8U", "INT8S", "INT16U", "INT16S", "INT32U", "INT32S", "INT64U",
+                             "INT64S", "REAL32", "REAL64"};
+  const int typeBytes[] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+
+  // the high-water mark of the whole process, not of one operator
+  double processPeakRssMB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+  }
+
+  bool parseArgs(int argc, char **argv, Config &cfg) {
+    cfg.nx = cfg.ny = 4096;
+    cfg.chunk = 256;
+    cfg.threads = 0;
+    cfg.warmup = 1;
+    cfg.reps = 5;
+    cfg.type = GeoStar::INT16U;
+    cfg.typeName = "INT16U";
+    cfg.tolerance = 0.10;
+    for(int i=1; i<argc; ++i) {
+      const std::string arg = argv[i];
+      if(i+1 >= argc) return false;
+      const std::string val = argv[++i];
+      if(arg == "--nx") cfg.nx = atol(val.c_str());
+      else if(arg == "--ny") cfg.ny = atol(val.c_str());
+      else if(arg == "--chunk") cfg.chunk = atol(val.c_str());
+      else if(arg == "--threads") cfg.threads = atoi(val.c_str());
+      else if(arg == "--warmup") cfg.warmup = atoi(val.c_str());
+      else if(arg == "--reps") cfg.reps = atoi(val.c_str());
+      else if(arg == "--only") cfg.only = val;
+      else if(arg == "--ingest") cfg.ingest = val;
+      else if(arg == "--json") cfg.json = val;
+      else if(arg == "--baseline") cfg.baseline = val;
+      else if(arg == "--tolerance") cfg.tolerance = atof(val.c_str());
+      else if(arg == "--type") {
+        int k = 0;
+        while(k < 10 && val != typeNames[k]) ++k;
+        if(k == 10) return false;
+        cfg.type = (GeoStar::RasterType)k;
+        cfg.typeName = val;
+      }
+      else return false;
+    }// endfor
+    return cfg.nx > 0 && cfg.ny > 0 && cfg.reps > 0 && cfg.warmup >= 0;
+  }// end: parseArgs
+
+  Result timeOp(const Op &op, const Config &cfg) {
+    for(int i=0; i<cfg.warmup; ++i) {
+      op.setup();
+      op.run();
+    }
+    std::vector<double> times;
+    for(int i=0; i<cfg.reps; ++i) {
+      op.setup();
+      const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      op.run();
+      const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+      times.push_back(std::chrono::duration<double>(t1 - t0).count());
+    }
+    std::sort(times.begin(), times.end());
+
+    Result r;
+    r.name = op.name;
+    r.median = times[times.size()/2];
+    r.best = times[0];
+    const double mpix = (double)cfg.nx * cfg.ny / 1e6;
+    r.mpix = mpix / r.median;
+    r.mbps = op.rasters * mpix * typeBytes[cfg.type] / r.median;
+    r.processRss = processPeakRssMB();
+    return r;
+  }// end: timeOp
+
+  // the "mpix_per_s" of every "name" in an earlier output
+  std::map<std::string, double> readBaseline(const std::string &fileName) {
+    std::map<std::string, double> base;
+    std::ifstream in(fileName.c_str());
+    std::stringstream text;
+    text << in.rdbuf();
+    const std::string s = text.str();
+    size_t pos = 0;
+    while((pos = s.find("\"name\": \"", pos)) != std::string::npos) {
+      pos += 9;
+      const size_t end = s.find('"', pos);
+      const std::string name = s.substr(pos, end - pos);
+      const size_t m = s.find("\"mpix_per_s\": ", end);
+      if(m == std::string::npos) break;
+      base[name] = atof(s.c_str() + m + 14);
+      pos = m;
+    }// endwhile
+    return base;
+  }// end: readBaseline
+
+  std::vector<long int> whole(const GeoStar::Raster *ras) {
+    return std::vector<long int>{0, 0, ras->get_nx(), ras->get_ny()};
+  }
+
+}// end anonymous namespace
+
+
+int main(int argc, char **argv) {
+  Config cfg;
+  if(!parseArgs(argc, argv, cfg)) {
+    std::cerr << "usage: bench [--nx N] [--ny N] [--type INT16U] [--chunk N] [--threads N]\n"
+              << "             [--warmup N] [--reps N] [--only name,...] [--ingest file.tif]\n"
+              << "             [--json out.json] [--baseline old.json] [--tolerance 0.10]\n";
+    return 2;
+  }
+  if(cfg.threads > 0) GeoStar::File::set_num_threads(cfg.threads);
+
+  boost::filesystem::path p("bench.h5");
+  boost::filesystem::remove(p);
+  GeoStar::File *file = new GeoStar::File("bench.h5", "new");
+  GeoStar::Image *img = file->create_image("bench");
+
+  const long int nx = cfg.nx, ny = cfg.ny;
+  const GeoStar::RasterCreateOptions opts = GeoStar::RasterCreateOptions().setChunk(cfg.chunk, cfg.chunk);
+  const bool integer = cfg.type <= GeoStar::INT64S;
+  const double top = (cfg.type == GeoStar::INT8U || cfg.type == GeoStar::INT8S) ? 100 : 10000;
+
+  // a smooth field with noise on it, and a second one for the binary operators
+  GeoStar::Raster *a = img->create_raster("a", cfg.type, nx, ny, opts);
+  GeoStar::Raster *b = img->create_raster("b", cfg.type, nx, ny, opts);
+  GeoStar::Raster *out = img->create_raster("out", cfg.type, nx, ny, opts);
+  GeoStar::Raster *work = img->create_raster("work", cfg.type, nx, ny, opts);
+  GeoStar::Raster *real = img->create_raster("real", GeoStar::REAL64, nx, ny, opts);
+  GeoStar::Raster *half = img->create_raster("half", cfg.type, nx/2, ny/2, opts);
+  GeoStar::Raster *thumb = img->create_raster("thumb", cfg.type, std::max(1L, nx/32), std::max(1L, ny/32));
+  GeoStar::Raster *spec = img->create_raster("spec", GeoStar::COMPLEX_REAL64, nx/2 + 1, ny, opts);
+  {
+    std::vector<double> row(nx);
+    for(long int y=0; y<ny; ++y) {
+      for(long int x=0; x<nx; ++x) row[x] = top * (0.5 + 0.25 * std::sin(x * 0.01) * std::cos(y * 0.013));
+      a->write(GeoStar::Slice(0, y, nx, 1), &row[0]);
+    }
+    a->addGaussianNoise(a, top * 0.02, 1);
+    a->scale(b, top * 0.1, 0.8);
+  }
+
+  std::vector<GeoStar::Raster *> pyramid(4, (GeoStar::Raster *)NULL);
+  for(int k=1; k<4; ++k) {
+    pyramid[k] = img->create_raster("pyr" + std::to_string(k), GeoStar::REAL32, nx >> k, ny >> k, opts);
+  }
+
+  GeoStar::DrawBatch roads;
+  for(int i=0; i<10000; ++i) {
+    const double x0 = (i * 7919) % nx, y0 = (i * 104729) % ny;
+    roads.line(x0, y0, x0 + (i % 61) - 30, y0 + (i % 47) - 23, 1, top);
+  }
+
+  const std::function<void()> nothing = []() {};
+  const std::function<void()> fresh = [&]() { a->copy(&whole(a)[0], work); };
+
+  std::vector<Op> ops = {
+    {"read", 1, nothing, [&]() { std::vector<double> d; a->read(whole(a), d); }},
+    {"write", 1, nothing, [&]() {
+        std::vector<double> row(nx, 1.0);
+        for(long int y=0; y<ny; ++y) work->write(GeoStar::Slice(0, y, nx, 1), &row[0]); }},
+    {"add", 3, nothing, [&]() { a->add(b, out); }},
+    {"expression", 3, nothing, [&]() { (GeoStar::RasterExpr(*a) * 0.5 + GeoStar::RasterExpr(*b) * 0.5).evaluate(out); }},
+    {"thresh", 2, fresh, [&]() { work->thresh(top * 0.5); }},
+    {"scale", 2, nothing, [&]() { a->scale(out, 1.0, 0.9); }},
+    {"bitShift", 2, nothing, [&]() { a->bitShift(out, 2, true); }},
+    {"statistics", 1, [&]() { work->write(std::vector<long int>{0, 0, 1, 1}, std::vector<double>(1, 0)); },
+     [&]() { work->statistics(); }},
+    {"stretch", 2, nothing, [&]() { a->stretch(out, 0, integer ? 255 : 1, 0.02); }},
+    {"noise", 2, nothing, [&]() { a->addGaussianNoise(out, top * 0.01, 7); }},
+    {"convolve5", 2, nothing, [&]() { a->convolve(GeoStar::Kernel::binomial(5), out); }},
+    {"meanFilter5", 2, nothing, [&]() { a->meanFilter(out, 5); }},
+    {"minFilter5", 2, nothing, [&]() { a->minFilter(out, 5); }},
+    {"medianFilter2", 2, nothing, [&]() { a->medianFilter(out, 2); }},
+    {"niblack15", 2, nothing, [&]() { a->niblackThresh(out, 15); }},
+    {"fft", 1 + 8.0 / typeBytes[cfg.type], nothing, [&]() { a->FFT_2D(spec); }},
+    {"downsample", 1.25, nothing, [&]() { a->downsample(half); }},
+    {"pyramid", 1.33, nothing, [&]() { GeoStar::Pyramid::build(a, pyramid, std::vector<GeoStar::Raster *>()); }},
+    {"resizeBilinear", 1.25, nothing, [&]() { a->resize(half, GeoStar::RESAMPLE_BILINEAR); }},
+    {"resizeLanczos", 1.25, nothing, [&]() { a->resize(half, GeoStar::RESAMPLE_LANCZOS3); }},
+    {"resizeThumbnail", 1, nothing, [&]() { a->resize(thumb, GeoStar::RESAMPLE_BILINEAR); }},
+    {"overviews", 1.33, nothing, [&]() { a->buildOverviews(); }},
+    {"drawBatch", 0, nothing, [&]() { roads.apply(work); }},
+    {"toReal64", 1 + 8.0 / typeBytes[cfg.type], nothing, [&]() { a->copy(&whole(a)[0], real); }},
+  };
+
+  if(!cfg.ingest.empty()) {
+    static int serial = 0;
+    ops.push_back(Op{"ingest", 1, nothing, [&]() {
+          GeoStar::Raster *r = img->read_file(cfg.ingest, "ingest" + std::to_string(serial++), 1);
+          delete r; }});
+  }
+
+  std::set<std::string> only;
+  {
+    std::stringstream list(cfg.only);
+    std::string name;
+    while(std::getline(list, name, ',')) if(!name.empty()) only.insert(name);
+  }
+
+  std::vector<Result> results;
+  for(size_t i=0; i<ops.size(); ++i) {
+    if(!only.empty() && only.count(ops[i].name) == 0) continue;
+    results.push_back(timeOp(ops[i], cfg));
+    std::cerr << results.back().name << ": " << results.back().median << " s, "
+              << results.back().mpix << " MPix/s" << std::endl;
+  }
+
+  // the JSON
+  std::ostringstream json;
+  json << "{\n  \"config\": {\"nx\": " << nx << ", \"ny\": " << ny << ", \"type\": \"" << cfg.typeName
+       << "\", \"chunk\": " << cfg.chunk << ", \"threads\": " << cfg.threads
+       << ", \"warmup\": " << cfg.warmup << ", \"reps\": " << cfg.reps
+       << ", \"opt\": \"" << GEOSTAR_BUILD_OPT << "\"},\n  \"results\": [\n";
+  for(size_t i=0; i<results.size(); ++i) {
+    const Result &r = results[i];
+    json << "    {\"name\": \"" << r.name << "\", \"seconds\": " << r.median << ", \"best_seconds\": " << r.best
+         << ", \"mpix_per_s\": " << r.mpix << ", \"mb_per_s\": " << r.mbps << ", \"process_peak_rss_mb\": " << r.processRss
+         << "}" << (i+1 < results.size() ? "," : "") << "\n";
+  }
+  json << "  ]\n}\n";
+  if(cfg.json.empty()) {
+    std::cout << json.str();
+  } else {
+    std::ofstream o(cfg.json.c_str());
+    o << json.str();
+  }
+
+  // against the baseline
+  int status = 0;
+  if(!cfg.baseline.empty()) {
+    const std::map<std::string, double> base = readBaseline(cfg.baseline);
+    for(size_t i=0; i<results.size(); ++i) {
+      std::map<std::string, double>::const_iterator it = base.find(results[i].name);
+      if(it == base.end() || it->second <= 0) continue;
+      const double ratio = results[i].mpix / it->second;
+      const bool slower = ratio < 1 - cfg.tolerance;
+      std::cerr << (slower ? "REGRESSION " : "ok         ") << results[i].name << ": "
+                << ratio << "x baseline" << std::endl;
+      if(slower) status = 1;
+    }// endfor
+  }
+
+  for(int k=1; k<4; ++k) delete pyramid[k];
+  delete a;
+  delete b;
+  delete out;
+  delete work;
+  delete real;
+  delete half;
+  delete thumb;
+  delete spec;
+  delete img;
+  delete file;
+  return status;
+}
@@ -9,6 +9,22 @@
 #include "File.hpp"
 #include "Image.hpp"
 #include "Raster.hpp"
+#include "ThreadPool.hpp"
+#include "FFT.hpp"
+#include "Kernel.hpp"
+#include "Neighborhood.hpp"
+#include "Pyramid.hpp"
+#include "IntegralImage.hpp"
+#include "Resample.hpp"
+#include "DrawBatch.hpp"
+#include "Noise.hpp"
+#include "LUT.hpp"
+#include "TileExecutor.hpp"
+#include "Pipeline.hpp"
+#include "Profiler.hpp"
+#include "TileCache.hpp"
+#include "PixelConvert.hpp"
+#include "BlockStream.hpp"
 #include "Map.hpp"
 
 #endif // GEOSTAR_HPP_
@@ -13,12 +13,34 @@
 #include <cstdint>
 #include <vector>
 #include <exception>
+#include <cmath>
 
 #include "geostar.hpp"
 
 #include "boost/filesystem.hpp"
 
 
+// a flat raster with one 0 pixel: windows holding the 0, and with BORDER_ZERO the windows
+// over the edge, have a harmonic mean of 0, and every other window the flat value
+void harmonicMeanZeroTest(GeoStar::Image *img);
+
+// two Raster objects open on one dataset share it: writes through one, held in the TileCache or
+// in the loaded buffer of the other, are read back through the other; saved statistics are
+// dropped whichever handle writes; and the pixels reach the file when the last handle on the
+// dataset, or the one that loaded it, is destroyed
+void sharedDatasetTest(GeoStar::Image *img);
+
+// every value of each 8 and 16-bit type, through the one step LUTs behind thresh, scale,
+// bitShift and stretch, and through the float operators on a REAL32 copy: the results, in each
+// output type, are identical
+void lutEquivalenceTest(GeoStar::Image *img);
+
+// a Pipeline writes what the same chain of Raster calls writes: a fused scale, convert and thresh
+// into INT8U, and a scale whose intermediate is median filtered into INT16S and thresholded, with
+// the intermediate in memory and, with no memory budget, on disk
+void pipelineEquivalenceTest(GeoStar::Image *img);
+
+
 main() {
 
   // delete output file if already exists
@@ -69,6 +91,14 @@ main() {
 	//ras->midpointFilter(ras2, 11);
 	ras->rangeFilter(ras2, 11);
 
+  harmonicMeanZeroTest(img);
+
+  sharedDatasetTest(img);
+
+  lutEquivalenceTest(img);
+
+  pipelineEquivalenceTest(img);
+
   delete ras;
   
   delete ras2; 
@@ -78,3 +108,264 @@ main() {
   delete file;
 
 }// end-main
+
+
+
+void harmonicMeanZeroTest(GeoStar::Image *img) {
+  const long int nx = 20, ny = 12, zx = 7, zy = 5;
+  GeoStar::Raster *flat = img->create_raster("flat", GeoStar::REAL32, nx, ny);
+  GeoStar::Raster *hm = img->create_raster("flat_hm", GeoStar::REAL32, nx, ny);
+  std::vector<double> data(nx*ny, 5.0);
+  data[zy*nx + zx] = 0.0;
+  flat->write(GeoStar::Slice(0, 0, nx, ny), &data[0]);
+
+  const GeoStar::BorderMode borders[2] = {GeoStar::BORDER_REFLECT, GeoStar::BORDER_ZERO};
+  for(int b=0; b<2; ++b) {
+    flat->harmonicMean(hm, 3, borders[b]);
+    std::vector<double> out(nx*ny);
+    hm->read(GeoStar::Slice(0, 0, nx, ny), &out[0]);
+    long int nans = 0, wrong = 0;
+    for(long int y=0; y<ny; ++y) {
+      for(long int x=0; x<nx; ++x) {
+        const double v = out[y*nx + x];
+        const bool zero = (std::abs(x-zx) <= 1 && std::abs(y-zy) <= 1)
+          || (b == 1 && (x == 0 || y == 0 || x == nx-1 || y == ny-1));
+        if(std::isnan(v)) ++nans;
+        else if(std::abs(v - (zero ? 0.0 : 5.0)) > 1.0e-4) ++wrong;
+      }//endfor: x
+    }//endfor: y
+    std::cout << "harmonicMean with a zero pixel, border " << b << ": " << nans << " NaN, "
+              << wrong << " wrong" << std::endl;
+  }//endfor: b
+
+  delete hm;
+  delete flat;
+}// end: harmonicMeanZeroTest
+
+
+
+void sharedDatasetTest(GeoStar::Image *img) {
+  // more than one 256 x 256 tile of a contiguous raster
+  const long int nx = 300, ny = 280;
+  const GeoStar::Slice all(0, 0, nx, ny);
+  std::vector<double> data(nx*ny), got(nx*ny);
+  auto fill = [&](const double &base) {
+    for(long int i=0; i<nx*ny; ++i) data[i] = base + (i*37) % 101;
+  };
+  auto differ = [&](const GeoStar::Raster *ras) {
+    ras->read(all, &got[0]);
+    long int n = 0;
+    for(long int i=0; i<nx*ny; ++i) if(got[i] != data[i]) ++n;
+    return n;
+  };
+  auto mean = [&]() {
+    double sum = 0;
+    for(long int i=0; i<nx*ny; ++i) sum += data[i];
+    return sum / (nx*ny);
+  };
+
+  // the TileCache: a write through a is read through b before it reaches the file, stays in
+  // the cache while either is open, and is written back when the last of them is destroyed
+  GeoStar::Raster *a = img->create_raster("shared_cache", GeoStar::REAL32, nx, ny);
+  GeoStar::Raster *b = img->open_raster("shared_cache");
+  fill(0);
+  GeoStar::File::reset_tile_cache_stats();
+  a->write(all, &data[0]);
+  long int wrong = differ(b);
+  delete a;
+  const unsigned long early = GeoStar::File::get_tile_cache_stats().writebacks;
+  delete b;
+  const unsigned long late = GeoStar::File::get_tile_cache_stats().writebacks;
+  GeoStar::File::reset_tile_cache_stats();
+  GeoStar::Raster *c = img->open_raster("shared_cache");
+  wrong += differ(c);
+  const unsigned long misses = GeoStar::File::get_tile_cache_stats().misses;
+  std::cout << "shared TileCache: " << wrong << " pixels wrong through the other Raster or after "
+            << "reopening, " << early << " tiles written with one Raster left, " << late
+            << " after the last, " << misses << " read back from the file"
+            << ((early == 0 && late > 0 && misses > 0) ? "" : " -- wrong") << std::endl;
+
+  // saved statistics: a's are dropped by a write through b, opened before they were saved
+  a = img->open_raster("shared_cache");
+  b = img->open_raster("shared_cache");
+  const double before = a->statistics().mean;
+  fill(50);
+  b->write(all, &data[0]);
+  const double after = a->statistics().mean;
+  GeoStar::Raster *d = img->open_raster("shared_cache");
+  const double reopened = d->statistics().mean;
+  std::cout << "statistics through another Raster: mean " << before << ", after its write "
+            << after << ", reopened " << reopened
+            << ((std::abs(after - mean()) < 1.0e-6 && reopened == after) ? "" : " -- stale") << std::endl;
+  delete d;
+  delete c;
+  delete b;
+  delete a;
+
+  // the loaded buffer: shared with a Raster opened before the load and one opened after, which
+  // read and write it; the file sees the writes once the loading Raster is destroyed
+  a = img->open_raster("shared_cache");
+  b = img->create_raster("shared_loaded", GeoStar::INT16S, nx, ny);
+  b->load();
+  c = img->open_raster("shared_loaded");
+  fill(-20);
+  c->write(all, &data[0]);
+  wrong = differ(b);
+  d = img->open_raster("shared_loaded");
+  const bool sharing = c->is_loaded() && d->is_loaded();
+  wrong += differ(d);
+  fill(100);
+  d->write(all, &data[0]);
+  wrong += differ(b);
+  wrong += differ(c);
+  delete b;
+  const bool released = !c->is_loaded() && !d->is_loaded();
+  delete c;
+  delete d;
+  b = img->open_raster("shared_loaded");
+  wrong += differ(b);
+  delete b;
+
+  // a raster loaded with another handle open: that handle reads the buffer, and the load is
+  // written back by the loading Raster's destructor
+  b = img->open_raster("shared_cache");
+  b->load();
+  fill(7);
+  b->write(all, &data[0]);
+  wrong += differ(a);
+  delete b;
+  wrong += differ(a);
+  delete a;
+  std::cout << "shared loaded buffer: " << wrong << " pixels wrong, "
+            << (sharing ? "" : "not ") << "loaded through every Raster, "
+            << (released ? "" : "not ") << "released by the loading one" << std::endl;
+}// end: sharedDatasetTest
+
+
+
+void lutEquivalenceTest(GeoStar::Image *img) {
+  const GeoStar::RasterType ins[4] = {GeoStar::INT8U, GeoStar::INT8S, GeoStar::INT16U, GeoStar::INT16S};
+  const double lows[4] = {0, -128, 0, -32768};
+  const std::string names[10] = {"INT8U", "INT8S", "INT16U", "INT16S", "INT32U", "INT32S",
+                                 "INT64U", "INT64S", "REAL32", "REAL64"};
+
+  for(int t=0; t<4; ++t) {
+    const long int nx = 256, ny = (t < 2) ? 1 : 256;
+    std::vector<double> data(nx*ny);
+    for(long int i=0; i<nx*ny; ++i) data[i] = lows[t] + i;
+    GeoStar::Raster *in = img->create_raster("lut_in" + names[t], ins[t], nx, ny);
+    GeoStar::Raster *copy = img->create_raster("lut_f" + names[t], GeoStar::REAL32, nx, ny);
+    in->write(GeoStar::Slice(0, 0, nx, ny), &data[0]);
+    copy->write(GeoStar::Slice(0, 0, nx, ny), &data[0]);
+
+    // a results in its type, b results as floats, per pixel
+    std::vector<double> a(nx*ny), b(nx*ny);
+    auto differ = [&](const GeoStar::Raster *ra, const GeoStar::Raster *rb) {
+      ra->read(GeoStar::Slice(0, 0, nx, ny), &a[0]);
+      rb->read(GeoStar::Slice(0, 0, nx, ny), &b[0]);
+      long int n = 0;
+      for(long int i=0; i<nx*ny; ++i) if(a[i] != b[i]) ++n;
+      return n;
+    };
+
+    // thresh is in place, so its output type is the input's
+    GeoStar::Raster *th = img->create_raster("lut_th" + names[t], ins[t], nx, ny);
+    GeoStar::Raster *thf = img->create_raster("lut_thf" + names[t], ins[t], nx, ny);
+    th->write(GeoStar::Slice(0, 0, nx, ny), &data[0]);
+    copy->thresh(17);
+    copy->read(GeoStar::Slice(0, 0, nx, ny), &b[0]);
+    thf->write(GeoStar::Slice(0, 0, nx, ny), &b[0]);
+    copy->write(GeoStar::Slice(0, 0, nx, ny), &data[0]);
+    th->thresh(17);
+    long int wrong = differ(th, thf);
+    delete th;
+    delete thf;
+
+    for(int o=GeoStar::INT8U; o<=GeoStar::REAL64; ++o) {
+      const GeoStar::RasterType out = GeoStar::RasterType(o);
+      GeoStar::Raster *lut = img->create_raster("lut_" + names[t] + "_" + names[o], out, nx, ny);
+      GeoStar::Raster *flt = img->create_raster("lut_f" + names[t] + "_" + names[o], out, nx, ny);
+      in->scale(lut, -100, 1.7);
+      copy->scale(flt, -100, 1.7);
+      wrong += differ(lut, flt);
+      in->bitShift(lut, 3, true);
+      copy->bitShift(flt, 3, true);
+      wrong += differ(lut, flt);
+      in->bitShift(lut, 2, false);
+      copy->bitShift(flt, 2, false);
+      wrong += differ(lut, flt);
+      in->stretch(lut, 0, 255);
+      copy->stretch(flt, 0, 255);
+      wrong += differ(lut, flt);
+      in->stretch(lut, -20, 300, 0.02);
+      copy->stretch(flt, -20, 300, 0.02);
+      wrong += differ(lut, flt);
+      delete lut;
+      delete flt;
+    }//endfor: o
+
+    std::cout << "LUT vs float operators, " << names[t] << " input: " << wrong << " pixels differ"
+              << std::endl;
+    delete copy;
+    delete in;
+  }//endfor: t
+}// end: lutEquivalenceTest
+
+
+
+void pipelineEquivalenceTest(GeoStar::Image *img) {
+  const long int nx = 300, ny = 200;
+  const GeoStar::Slice all(0, 0, nx, ny);
+  std::vector<double> data(nx*ny);
+  for(long int i=0; i<nx*ny; ++i) data[i] = ((i*7919) % 4517) / 10.0 - 50.25;
+  GeoStar::Raster *in = img->create_raster("pipe_in", GeoStar::REAL32, nx, ny);
+  in->write(all, &data[0]);
+
+  std::vector<double> a(nx*ny), b(nx*ny);
+  auto differ = [&](const GeoStar::Raster *ra, const GeoStar::Raster *rb) {
+    ra->read(all, &a[0]);
+    rb->read(all, &b[0]);
+    long int n = 0;
+    for(long int i=0; i<nx*ny; ++i) if(a[i] != b[i]) ++n;
+    return n;
+  };
+
+  // scale -> thresh into INT8U: values below 0 and above 255 saturate, fractions truncate
+  GeoStar::Raster *steps = img->create_raster("pipe_steps8", GeoStar::INT8U, nx, ny);
+  in->scale(steps, -20, 0.7);
+  steps->thresh(60);
+  GeoStar::Raster *fused = img->create_raster("pipe_fused8", GeoStar::INT8U, nx, ny);
+  GeoStar::Pipeline bytesChain;
+  GeoStar::Pipeline::Node source = bytesChain.source(in);
+  GeoStar::Pipeline::Node bytes = bytesChain.convert(bytesChain.scale(source, -20, 0.7), GeoStar::INT8U);
+  bytesChain.output(bytesChain.thresh(bytes, 60), fused);
+  bytesChain.run();
+  std::cout << "Pipeline scale, thresh into INT8U vs Raster calls: " << differ(fused, steps)
+            << " pixels differ, " << bytesChain.get_passes() << " passes" << std::endl;
+  delete fused;
+  delete steps;
+
+  // scale into a REAL32 intermediate, median filtered into INT16S, then thresh
+  GeoStar::Raster *scaled = img->create_raster("pipe_scaled", GeoStar::REAL32, nx, ny);
+  steps = img->create_raster("pipe_steps16", GeoStar::INT16S, nx, ny);
+  in->scale(scaled, 10, 1.3);
+  scaled->medianFilter(steps, 2);
+  steps->thresh(100);
+  for(int m=0; m<2; ++m) {
+    fused = img->create_raster("pipe_fused16_" + std::to_string(m), GeoStar::INT16S, nx, ny);
+    GeoStar::Pipeline chain;
+    if(m == 1) chain.set_memory_budget(0);
+    GeoStar::Pipeline::Node src = chain.source(in);
+    GeoStar::Pipeline::Node median = chain.medianFilter(chain.scale(src, 10, 1.3), 2, GeoStar::INT16S);
+    chain.output(chain.thresh(median, 100), fused);
+    chain.run();
+    std::cout << "Pipeline scale, medianFilter, thresh into INT16S vs Raster calls, intermediates "
+              << (m ? "on disk: " : "in memory: ") << differ(fused, steps) << " pixels differ, "
+              << chain.get_passes() << " passes, " << chain.get_peak_memory() << " bytes held in memory"
+              << std::endl;
+    delete fused;
+  }//endfor: m
+  delete steps;
+  delete scaled;
+  delete in;
+}// end: pipelineEquivalenceTest
@@ -27,6 +27,10 @@ void FFTW_2D_C2C_Test(const long int nx, const long int ny, GeoStar::Image *img,
 void FFTW_2D_C2C_Cos_Test(long int nx, long int ny, GeoStar::Image *img, 
 			GeoStar::Raster *rasOutReal, GeoStar::Raster *rasOutImg, GeoStar::Raster *rasOutSquared);
 
+// the out-of-core FFT, forced by a small memory limit, writes what the in-memory one does, to
+// within the rounding of the output type; for transform, forwardReal and inverseReal
+void FFT_outOfCoreTest(GeoStar::Image *img);
+
 
 main() {
 
@@ -61,6 +65,8 @@ main() {
 	//ras2->FFT_2D_Inv(img, ras4, ras3);
 	ras->lowPassFilter(img, ras2, ras3, ras4);
 
+	FFT_outOfCoreTest(img);
+
   delete ras;
   
   delete ras2; 
@@ -291,3 +297,103 @@ main() {
 	
 	
 
+
+
+
+void FFT_outOfCoreTest(GeoStar::Image *img) {
+  const long int nx = 48, ny = 40;
+  GeoStar::Raster *in = img->create_raster("fft_in", GeoStar::REAL32, nx, ny);
+  std::vector<double> data(nx*ny);
+  for(long int i=0; i<nx*ny; ++i) data[i] = (i*7919) % 251 - 125;
+  in->write(GeoStar::Slice(0, 0, nx, ny), &data[0]);
+
+  const GeoStar::RasterType types[4] = {GeoStar::INT16S, GeoStar::INT32S, GeoStar::REAL32, GeoStar::REAL64};
+  const std::string names[4] = {"INT16S", "INT32S", "REAL32", "REAL64"};
+  const size_t limit = GeoStar::FFT::get_memory_limit();
+  for(int t=0; t<4; ++t) {
+    std::vector<double> out[2][2];
+    for(int m=0; m<2; ++m) {
+      // m == 1: out of core, 8 rows or columns of complex doubles at a time
+      GeoStar::FFT::set_memory_limit(m == 0 ? limit : 8*nx*sizeof(fftw_complex));
+      const std::string run = std::to_string(2*t + m);
+      GeoStar::Raster *re = img->create_raster("fft_re" + run, types[t], nx, ny);
+      GeoStar::Raster *im = img->create_raster("fft_im" + run, types[t], nx, ny);
+      GeoStar::FFT::transform(in, NULL, re, im, FFTW_FORWARD, 1.0);
+      out[m][0].resize(nx*ny);
+      out[m][1].resize(nx*ny);
+      re->read(GeoStar::Slice(0, 0, nx, ny), &out[m][0][0]);
+      im->read(GeoStar::Slice(0, 0, nx, ny), &out[m][1][0]);
+      delete re;
+      delete im;
+    }//endfor: m
+    GeoStar::FFT::set_memory_limit(limit);
+
+    // the paths round differently (FFTW's 2-D plan against row and column passes), so integer
+    // outputs may be 1 apart where a value is truncated on either side of a whole number, and
+    // real ones differ by the rounding of their type, relative to the largest value
+    long int differ = 0;
+    double largest = 0, worst = 0;
+    for(int c=0; c<2; ++c) {
+      for(long int i=0; i<nx*ny; ++i) {
+        if(out[0][c][i] != out[1][c][i]) ++differ;
+        largest = std::max(largest, std::abs(out[0][c][i]));
+        worst = std::max(worst, std::abs(out[0][c][i] - out[1][c][i]));
+      }//endfor: i
+    }//endfor: c
+    const double tolerance = (t < 2) ? 1 : ((t == 2) ? 1.0e-6 : 1.0e-14) * largest;
+    std::cout << "FFT out of core vs in memory, " << names[t] << " outputs: " << differ << " of "
+              << 2*nx*ny << " values differ, by at most " << worst
+              << ((worst <= tolerance) ? "" : " -- too far") << std::endl;
+  }//endfor: t
+
+  // the half spectrum: forwardReal into a COMPLEX_REAL64 raster, then inverseReal of the
+  // in-memory spectrum back to REAL64, each in memory and out of core.  Only the last pass
+  // rounds to float, so each part of the spectra agrees to a float ulp or two of its own size.
+  const long int half = nx/2 + 1;
+  std::vector<std::complex<float> > spec[2];
+  std::vector<double> back[2];
+  GeoStar::Raster *specIn = NULL;
+  for(int m=0; m<2; ++m) {
+    GeoStar::FFT::set_memory_limit(m == 0 ? limit : 8*half*sizeof(fftw_complex));
+    const std::string run = std::to_string(m);
+    GeoStar::Raster *sp = img->create_raster("fft_spec" + run, GeoStar::COMPLEX_REAL64, half, ny);
+    GeoStar::Raster *bk = img->create_raster("fft_back" + run, GeoStar::REAL64, nx, ny);
+    GeoStar::FFT::forwardReal(in, sp);
+    if(m == 0) specIn = sp;
+    GeoStar::FFT::inverseReal(specIn, bk, 1.0/(nx*ny));
+    spec[m].resize(half*ny);
+    back[m].resize(nx*ny);
+    sp->read(GeoStar::Slice(0, 0, half, ny), &spec[m][0]);
+    bk->read(GeoStar::Slice(0, 0, nx, ny), &back[m][0]);
+    if(m == 1) delete sp;
+    delete bk;
+  }//endfor: m
+  GeoStar::FFT::set_memory_limit(limit);
+  delete specIn;
+
+  double largest = 0, worst = 0;
+  for(long int i=0; i<half*ny; ++i) largest = std::max(largest, (double)std::abs(spec[0][i]));
+  long int differ = 0;
+  for(long int i=0; i<half*ny; ++i) {
+    const double part[2][2] = {{spec[0][i].real(), spec[0][i].imag()}, {spec[1][i].real(), spec[1][i].imag()}};
+    for(int c=0; c<2; ++c) {
+      const double size = std::max(std::abs(part[0][c]), std::abs(part[1][c]));
+      const double off = std::abs(part[0][c] - part[1][c]);
+      worst = std::max(worst, off / (size + 1.0e-12 * largest));
+      if(off > 2.4e-7 * size + 1.0e-12 * largest) ++differ;
+    }//endfor: c
+  }//endfor: i
+  std::cout << "FFT::forwardReal out of core vs in memory, COMPLEX_REAL64 spectrum: differ by at most "
+            << worst << " relative" << ((differ == 0) ? "" : " -- too far") << std::endl;
+
+  largest = 0;
+  worst = 0;
+  for(long int i=0; i<nx*ny; ++i) {
+    largest = std::max(largest, std::abs(back[0][i]));
+    worst = std::max(worst, std::abs(back[0][i] - back[1][i]));
+  }//endfor: i
+  std::cout << "FFT::inverseReal out of core vs in memory, COMPLEX_REAL64 spectrum: differ by at most "
+            << worst << ((worst <= 1.0e-14 * largest) ? "" : " -- too far") << std::endl;
+
+  delete in;
+}// end: FFT_outOfCoreTest